@@ -0,0 +1,102 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <cassert>
+#include <climits> // INT_MAX
+#include <string_view>
+
+#include "aes128.h"
+
+#include <openssl/evp.h>
+
+static auto hexvalue(char c) -> int;
+
+// ---
+
+auto parse_iv(std::string const& hex) -> std::optional<aes128_block_t>
+{
+  std::string_view digits = hex;
+  if(digits.starts_with("0x") or digits.starts_with("0X"))
+    digits.remove_prefix(2);
+
+  if(digits.empty() or digits.length() > 2*sizeof(aes128_block_t))
+    return {};
+
+  // Shorter IVs are padded with zeros in front, it is a 128 bit integer.
+  aes128_block_t iv = {};
+  size_t pos = 2*iv.size() - digits.length();
+  for(char c : digits)
+  {
+    int const value = hexvalue(c);
+    if(value < 0)
+      return {};
+
+    iv[pos/2] |= (pos % 2 == 0) ? (value << 4) : value;
+    pos++;
+  }
+
+  return iv;
+}
+
+auto iv_from_sequence(uint64_t sequence) -> aes128_block_t
+{
+  aes128_block_t iv = {};
+  for(size_t i=0; i<sizeof(sequence); i++)
+    iv[iv.size()-1-i] = static_cast<uint8_t>(sequence >> (8*i));
+  return iv;
+}
+
+auto hexvalue(char c) -> int
+{
+  if('0' <= c and c <= '9')
+    return c - '0';
+  if('a' <= c and c <= 'f')
+    return c - 'a' + 10;
+  if('A' <= c and c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// ---
+
+aes128_decrypter_t::aes128_decrypter_t(aes128_t const& aes128)
+{
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  if(ctx == nullptr)
+    return;
+
+  if(EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, aes128.key.data(), aes128.iv.data()) != 1)
+  {
+    EVP_CIPHER_CTX_free(ctx);
+    return;
+  }
+
+  m_ctx = ctx;
+}
+
+aes128_decrypter_t::~aes128_decrypter_t()
+{
+  if(m_ctx != nullptr)
+    EVP_CIPHER_CTX_free(static_cast<EVP_CIPHER_CTX*>(m_ctx));
+}
+
+auto aes128_decrypter_t::update(uint8_t const* in, size_t len, uint8_t* out) -> std::optional<size_t>
+{
+  assert(ok());
+  assert(len <= INT_MAX - BLOCKSIZE);
+
+  int outlen = 0;
+  if(EVP_DecryptUpdate(static_cast<EVP_CIPHER_CTX*>(m_ctx), out, &outlen, in, static_cast<int>(len)) != 1)
+    return {};
+
+  return static_cast<size_t>(outlen);
+}
+
+auto aes128_decrypter_t::finish(uint8_t* out) -> std::optional<size_t>
+{
+  assert(ok());
+
+  int outlen = 0;
+  if(EVP_DecryptFinal_ex(static_cast<EVP_CIPHER_CTX*>(m_ctx), out, &outlen) != 1)
+    return {};
+
+  return static_cast<size_t>(outlen);
+}
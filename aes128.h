@@ -0,0 +1,60 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <array>
+#include <cstdint> // uint8_t, uint64_t
+#include <optional>
+#include <string>
+
+//
+// AES-128-CBC decryption of segments encrypted with #EXT-X-KEY:METHOD=AES-128
+// (see https://datatracker.ietf.org/doc/html/rfc8216#section-5.2).
+// Uses OpenSSL's EVP-interface, which uses AES-NI if the cpu supports it.
+//
+
+using aes128_block_t = std::array<uint8_t, 16>;
+
+//! Key and initialization vector to decrypt one segment.
+struct aes128_t
+{
+  aes128_block_t key;
+  aes128_block_t iv;
+
+  auto operator==(aes128_t const& other) const -> bool = default;
+};
+
+//! Parse a hexadecimal IV-attribute e.g. "0x0123456789abcdef0123456789abcdef".
+auto parse_iv(std::string const& hex) -> std::optional<aes128_block_t>;
+
+//! Without IV-attribute the media sequence number is the IV (as big-endian 128 bit integer).
+auto iv_from_sequence(uint64_t sequence) -> aes128_block_t;
+
+//! Decrypts a stream chunk by chunk, so it can be used directly in the write-callback.
+class aes128_decrypter_t
+{
+public:
+
+  // Decrypting a chunk outputs at most that many bytes more than was put in.
+  static constexpr size_t BLOCKSIZE = 16;
+
+  aes128_decrypter_t(aes128_t const& aes128);
+  ~aes128_decrypter_t();
+
+  aes128_decrypter_t(aes128_decrypter_t const&) = delete;
+  auto operator=(aes128_decrypter_t const&) -> aes128_decrypter_t& = delete;
+
+  //! Decrypt len bytes from in to out, out needs space for len + BLOCKSIZE bytes.
+  //! Returns the number of bytes written to out or nothing on error.
+  //! The last block is held back until finish() as it contains the padding.
+  auto update(uint8_t const* in, size_t len, uint8_t* out) -> std::optional<size_t>;
+
+  //! Decrypt the last block and strip the padding, out needs space for BLOCKSIZE bytes.
+  //! Returns the number of bytes written to out or nothing on error (e.g. wrong key).
+  auto finish(uint8_t* out) -> std::optional<size_t>;
+
+  inline bool ok() const { return m_ctx != nullptr; }
+
+
+private:
+
+  void* m_ctx = nullptr; // EVP_CIPHER_CTX, so openssl isn't included everywhere
+};
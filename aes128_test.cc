@@ -0,0 +1,81 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include "aes128.h"
+
+static auto encrypt(aes128_t const& aes128, std::vector<uint8_t> const& plain) -> std::vector<uint8_t>
+{
+  std::vector<uint8_t> cipher(plain.size() + aes128_decrypter_t::BLOCKSIZE);
+
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, aes128.key.data(), aes128.iv.data());
+  int len = 0, finallen = 0;
+  EVP_EncryptUpdate(ctx, cipher.data(), &len, plain.data(), static_cast<int>(plain.size()));
+  EVP_EncryptFinal_ex(ctx, cipher.data() + len, &finallen);
+  EVP_CIPHER_CTX_free(ctx);
+
+  cipher.resize(len + finallen);
+  return cipher;
+}
+
+TEST(aes128_tests, parse_iv)
+{
+  auto const iv = parse_iv("0x000102030405060708090A0B0C0D0E0F");
+  ASSERT_TRUE(iv.has_value());
+  for(size_t i=0; i<iv->size(); i++)
+    EXPECT_EQ((*iv)[i], i);
+
+  auto const short_iv = parse_iv("0x1f");
+  ASSERT_TRUE(short_iv.has_value());
+  EXPECT_EQ((*short_iv)[15], 0x1f);
+  EXPECT_EQ((*short_iv)[14], 0x00);
+
+  EXPECT_FALSE(parse_iv("0xNOTHEX").has_value());
+  EXPECT_FALSE(parse_iv("0x000102030405060708090A0B0C0D0E0F00").has_value());
+}
+
+TEST(aes128_tests, iv_from_sequence)
+{
+  auto const iv = iv_from_sequence(0x0102);
+
+  for(size_t i=0; i<14; i++)
+    EXPECT_EQ(iv[i], 0);
+  EXPECT_EQ(iv[14], 0x01);
+  EXPECT_EQ(iv[15], 0x02);
+}
+
+TEST(aes128_tests, decrypt_chunkwise)
+{
+  aes128_t const aes128{
+    {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+    iv_from_sequence(42)};
+
+  std::vector<uint8_t> plain(1'000);
+  for(size_t i=0; i<plain.size(); i++)
+    plain[i] = static_cast<uint8_t>(i*7);
+
+  auto const cipher = encrypt(aes128, plain);
+
+  // Chunks of odd sizes as they arrive in the write-callback.
+  aes128_decrypter_t decrypter{aes128};
+  ASSERT_TRUE(decrypter.ok());
+
+  std::vector<uint8_t> decrypted = {};
+  std::vector<uint8_t> out(100 + aes128_decrypter_t::BLOCKSIZE);
+  for(size_t pos = 0; pos < cipher.size(); pos += 37)
+  {
+    size_t const len = std::min<size_t>(37, cipher.size() - pos);
+    auto const n = decrypter.update(cipher.data() + pos, len, out.data());
+    ASSERT_TRUE(n.has_value());
+    decrypted.insert(decrypted.end(), out.begin(), out.begin() + n.value());
+  }
+
+  auto const n = decrypter.finish(out.data());
+  ASSERT_TRUE(n.has_value());
+  decrypted.insert(decrypted.end(), out.begin(), out.begin() + n.value());
+
+  EXPECT_EQ(decrypted, plain);
+}
@@ -0,0 +1,400 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::ranges::any_of, std::ranges::copy, std::ranges::min_element, std::ranges::transform
+#include <array>
+#include <cctype>    // std::tolower
+#include <cstdlib>   // std::getenv
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <thread>    // std::this_thread::get_id
+#include <vector>
+
+#include <fcntl.h>     // open
+#include <linux/fs.h>  // FICLONE
+#include <sys/file.h>  // flock
+#include <sys/ioctl.h> // ioctl
+#include <unistd.h>    // close, getpid
+
+#include "cache.h"
+#include "url.h"
+
+#include <openssl/evp.h>
+
+static auto to_hex(unsigned char const* data, size_t len) -> std::string;
+static auto to_lower(std::string s) -> std::string;
+static auto clone_file(std::filesystem::path const& from, std::filesystem::path const& to) -> bool;
+
+//! Holds an exclusive lock of the file while in scope (for the index shared by the processes).
+class file_lock_t
+{
+public:
+
+  explicit file_lock_t(std::filesystem::path const& path)
+    : m_fd{::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)}
+  {
+    if(m_fd >= 0)
+      flock(m_fd, LOCK_EX);
+  }
+
+  ~file_lock_t()
+  {
+    if(m_fd >= 0)
+      ::close(m_fd); // releases the lock
+  }
+
+  file_lock_t(file_lock_t const&) = delete;
+  auto operator=(file_lock_t const&) -> file_lock_t& = delete;
+
+
+private:
+
+  int m_fd;
+};
+
+// ---
+
+segment_cache_t::segment_cache_t(std::filesystem::path const& dir, size_t max_bytes)
+  : m_dir{dir}, m_max_bytes{max_bytes}
+{
+  std::error_code errc;
+  std::filesystem::create_directories(m_dir / "objects", errc);
+
+  file_lock_t const lock{m_dir / "index.lock"};
+  std::ifstream file{index_path()};
+  if(file)
+    m_entries = parse_cache_index(file);
+}
+
+auto segment_cache_t::default_dir() -> std::filesystem::path
+{
+  char const* const cache_home = std::getenv("XDG_CACHE_HOME");
+  if(cache_home != nullptr and cache_home[0] != '\0')
+    return std::filesystem::path{cache_home} / "curl_m3u8";
+
+  char const* const home = std::getenv("HOME");
+  return std::filesystem::path{home != nullptr ? home : "/tmp"} / ".cache" / "curl_m3u8";
+}
+
+auto segment_cache_t::make_key(std::string const& url, std::optional<aes128_t> const& aes128,
+    std::optional<std::tuple<uint64_t, uint64_t>> const& range) -> std::string
+{
+  url_t normalized = parse_url(url);
+  normalized.scheme = to_lower(normalized.scheme);
+  normalized.authority = to_lower(normalized.authority);
+  if((normalized.scheme == "http" and normalized.authority.ends_with(":80"))
+      or (normalized.scheme == "https" and normalized.authority.ends_with(":443")))
+    normalized.authority.erase(normalized.authority.rfind(':'));
+  if(normalized.has_authority and normalized.path.empty())
+    normalized.path = "/";
+  normalized.fragment = "";
+  normalized.has_fragment = false;
+
+  std::string key = normalized.str();
+  if(aes128.has_value())
+  {
+    // Only a fingerprint, the index mustn't reveal the key.
+    std::array<unsigned char, 2*sizeof(aes128_block_t)> material = {};
+    std::ranges::copy(aes128->key, material.begin());
+    std::ranges::copy(aes128->iv, material.begin() + sizeof(aes128_block_t));
+
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest = {};
+    unsigned int len = 0;
+    EVP_Digest(material.data(), material.size(), digest.data(), &len, EVP_sha256(), nullptr);
+    key += " aes128:" + to_hex(digest.data(), 8);
+  }
+  if(range.has_value())
+    key += std::format(" bytes:{}+{}", std::get<0>(range.value()), std::get<1>(range.value()));
+
+  return key;
+}
+
+auto segment_cache_t::lookup(std::string const& key, clock::time_point now) -> std::optional<entry_t>
+{
+  std::lock_guard lock{m_mutex};
+
+  auto it = m_entries.find(key);
+  if(it == m_entries.end())
+    return {};
+
+  std::error_code errc;
+  if(not std::filesystem::exists(object_path(it->second.digest), errc)) // evicted by another process
+  {
+    m_entries.erase(it);
+    m_changed = true;
+    return {};
+  }
+
+  it->second.used = now;
+  m_changed = true;
+  return it->second;
+}
+
+auto segment_cache_t::is_fresh(entry_t const& entry, clock::time_point now) -> bool
+{
+  return now - entry.validated < max_age;
+}
+
+auto segment_cache_t::link(entry_t const& entry, std::filesystem::path const& path) const -> bool
+{
+  std::error_code errc;
+  std::filesystem::remove(path, errc);
+
+  return clone_file(object_path(entry.digest), path);
+}
+
+void segment_cache_t::revalidated(std::string const& key, clock::time_point now)
+{
+  std::lock_guard lock{m_mutex};
+
+  auto it = m_entries.find(key);
+  if(it == m_entries.end())
+    return;
+
+  it->second.validated = now;
+  it->second.used = now;
+  m_changed = true;
+}
+
+auto segment_cache_t::store(std::string const& key, std::filesystem::path const& path, std::string const& etag,
+    clock::time_point now) -> bool
+{
+  std::string const digest = sha256_file(path);
+  if(digest.empty())
+    return false;
+
+  std::error_code errc;
+  auto const size = std::filesystem::file_size(path, errc);
+  if(errc)
+    return false;
+
+  auto const object = object_path(digest);
+  if(not std::filesystem::exists(object, errc))
+  {
+    // Renamed when complete, as other processes and threads could take it meanwhile.
+    std::filesystem::path const tmp = object.string()
+      + std::format(".{}-{}", getpid(), std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::filesystem::create_directories(object.parent_path(), errc);
+    if(not clone_file(path, tmp))
+    {
+      std::filesystem::remove(tmp, errc);
+      return false;
+    }
+    std::filesystem::rename(tmp, object, errc);
+    if(errc)
+      return false;
+  }
+
+  std::lock_guard lock{m_mutex};
+  m_entries[key] = entry_t{digest, etag, static_cast<size_t>(size), now, now};
+  m_changed = true;
+  return true;
+}
+
+void segment_cache_t::save()
+{
+  std::lock_guard lock{m_mutex};
+
+  if(not m_changed)
+    return;
+
+  file_lock_t const file_lock{m_dir / "index.lock"};
+
+  // Merge with the index on disk, other processes could have saved theirs in the meantime.
+  std::ifstream file{index_path()};
+  if(file)
+  {
+    for(auto& [key, other] : parse_cache_index(file))
+    {
+      auto it = m_entries.find(key);
+      if(it == m_entries.end())
+        m_entries.emplace(key, other);
+      else if(other.validated > it->second.validated)
+        it->second = other;
+    }
+  }
+  file.close();
+
+  evict();
+
+  std::filesystem::path const tmp = index_path().string() + std::format(".{}", getpid());
+  {
+    std::ofstream out{tmp};
+    write_cache_index(out, m_entries);
+    if(not out)
+      return;
+  }
+
+  std::error_code errc;
+  std::filesystem::rename(tmp, index_path(), errc);
+  if(not errc)
+    m_changed = false;
+}
+
+auto segment_cache_t::size() const -> size_t
+{
+  std::lock_guard lock{m_mutex};
+  return bodies_size();
+}
+
+auto segment_cache_t::bodies_size() const -> size_t
+{
+  std::map<std::string, size_t> bodies = {};
+  for(auto const& [key, entry] : m_entries)
+    bodies[entry.digest] = entry.size;
+
+  size_t bytes = 0;
+  for(auto const& [digest, size] : bodies)
+    bytes += size;
+  return bytes;
+}
+
+void segment_cache_t::evict()
+{
+  size_t bytes = bodies_size();
+  while(bytes > m_max_bytes and not m_entries.empty())
+  {
+    auto lru = std::ranges::min_element(m_entries, {}, [](auto const& e) { return e.second.used; });
+    entry_t const entry = lru->second;
+    m_entries.erase(lru);
+
+    // The body is removed, when no other url has it.
+    bool const shared = std::ranges::any_of(m_entries, [&entry](auto const& e) { return e.second.digest == entry.digest; });
+    if(not shared)
+    {
+      std::error_code errc;
+      std::filesystem::remove(object_path(entry.digest), errc);
+      bytes -= entry.size;
+    }
+  }
+}
+
+auto segment_cache_t::object_path(std::string const& digest) const -> std::filesystem::path
+{
+  return m_dir / "objects" / digest.substr(0, 2) / digest;
+}
+
+auto segment_cache_t::index_path() const -> std::filesystem::path
+{
+  return m_dir / "index";
+}
+
+// ---
+
+auto parse_cache_index(std::istream& in) -> std::map<std::string, segment_cache_t::entry_t>
+{
+  using clock = segment_cache_t::clock;
+
+  std::map<std::string, segment_cache_t::entry_t> entries = {};
+
+  std::string line = "";
+  while(std::getline(in, line))
+  {
+    std::vector<std::string> fields = {};
+    std::stringstream ss{line};
+    for(std::string field; std::getline(ss, field, '\t');)
+      fields.push_back(field);
+    if(line.ends_with('\t')) // an empty last field
+      fields.push_back("");
+
+    if(fields.size() != 6 or fields[0].empty() or fields[1].size() != 64)
+      continue;
+
+    try
+    {
+      segment_cache_t::entry_t entry;
+      entry.digest = fields[1];
+      entry.etag = fields[2];
+      entry.size = std::stoull(fields[3]);
+      entry.validated = clock::time_point{std::chrono::seconds{std::stoll(fields[4])}};
+      entry.used = clock::time_point{std::chrono::seconds{std::stoll(fields[5])}};
+      entries[fields[0]] = entry;
+    }
+    catch(std::exception const&) // std::invalid_argument or std::out_of_range
+    {}
+  }
+
+  return entries;
+}
+
+void write_cache_index(std::ostream& out, std::map<std::string, segment_cache_t::entry_t> const& entries)
+{
+  using namespace std::chrono;
+
+  for(auto const& [key, entry] : entries)
+  {
+    out << std::format("{}\t{}\t{}\t{}\t{}\t{}\n", key, entry.digest, entry.etag, entry.size,
+        duration_cast<seconds>(entry.validated.time_since_epoch()).count(),
+        duration_cast<seconds>(entry.used.time_since_epoch()).count());
+  }
+}
+
+auto sha256_file(std::filesystem::path const& path) -> std::string
+{
+  std::ifstream file{path, std::ios::binary};
+  if(not file)
+    return "";
+
+  EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+  if(ctx == nullptr or EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1)
+  {
+    EVP_MD_CTX_free(ctx);
+    return "";
+  }
+
+  std::array<char, 64*1'024> buffer;
+  while(file)
+  {
+    file.read(buffer.data(), buffer.size());
+    EVP_DigestUpdate(ctx, buffer.data(), static_cast<size_t>(file.gcount()));
+  }
+
+  std::array<unsigned char, EVP_MAX_MD_SIZE> digest = {};
+  unsigned int len = 0;
+  bool const ok = file.eof() and EVP_DigestFinal_ex(ctx, digest.data(), &len) == 1;
+  EVP_MD_CTX_free(ctx);
+
+  return ok ? to_hex(digest.data(), len) : "";
+}
+
+auto to_hex(unsigned char const* data, size_t len) -> std::string
+{
+  static constexpr char digits[] = "0123456789abcdef";
+
+  std::string hex(2*len, '0');
+  for(size_t i=0; i<len; i++)
+  {
+    hex[2*i]   = digits[data[i] >> 4];
+    hex[2*i+1] = digits[data[i] & 0xf];
+  }
+  return hex;
+}
+
+auto to_lower(std::string s) -> std::string
+{
+  std::ranges::transform(s, s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return s;
+}
+
+//! Copies the file, as a reflink (sharing the blocks until either is written) if the filesystem supports it.
+//! Not a hard link, as the parts are changed in place (e.g. by the PNG fake-header check).
+auto clone_file(std::filesystem::path const& from, std::filesystem::path const& to) -> bool
+{
+  int const in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if(in < 0)
+    return false;
+
+  int const out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool const cloned = out >= 0 and ioctl(out, FICLONE, in) == 0;
+  if(out >= 0)
+    ::close(out);
+  ::close(in);
+
+  if(out < 0)
+    return false;
+  if(cloned)
+    return true;
+
+  std::error_code errc;
+  std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, errc);
+  return not errc;
+}
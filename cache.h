@@ -0,0 +1,101 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+
+#include "aes128.h"
+
+/**
+ * On-disk cache of downloaded segments, so downloading the same programme again (another variant's
+ * audio, a re-run after failures, someone else on the machine) copies the segments instead of fetching them.
+ *
+ * The bodies are stored content-addressed in <DIR>/objects/<XX>/<SHA-256> and shared by all urls with the
+ * same content. The index <DIR>/index maps the key (normalized url and decryption, see make_key()) to the body
+ * with its ETag and size. It's evicted least recently used first to stay below the maximum size.
+ *
+ * An entry is used without a request for max_age after it was stored or revalidated. Later it needs to be
+ * revalidated with a conditional request (If-None-Match), without ETag it's downloaded again.
+ *
+ * It's thread-safe, so the concurrent runs of the daemon can share it.
+ */
+class segment_cache_t
+{
+public:
+
+  using clock = std::chrono::system_clock;
+
+  static constexpr std::chrono::hours max_age{24};
+
+  struct entry_t
+  {
+    std::string digest = "";          // SHA-256 of the body (hex)
+    std::string etag = "";            // empty if the server sent none
+    size_t size = 0;                  // bytes
+    clock::time_point validated = {}; // stored or revalidated
+    clock::time_point used = {};
+  };
+
+  //! Loads the index of the cache in dir (created if it doesn't exist).
+  segment_cache_t(std::filesystem::path const& dir, size_t max_bytes);
+
+  //! $XDG_CACHE_HOME/curl_m3u8 or otherwise ~/.cache/curl_m3u8.
+  static auto default_dir() -> std::filesystem::path;
+
+  //! The url normalized (lower-case scheme and host, without default port and fragment),
+  //! for encrypted segments with a fingerprint of key and IV, as the body is stored decrypted,
+  //! and for a byte range (offset, length) with the range.
+  static auto make_key(std::string const& url, std::optional<aes128_t> const& aes128 = {},
+      std::optional<std::tuple<uint64_t, uint64_t>> const& range = {}) -> std::string;
+
+  //! The entry of the key (marked as used), if there is one with its body.
+  auto lookup(std::string const& key, clock::time_point now = clock::now()) -> std::optional<entry_t>;
+
+  //! Can the entry be used without revalidation?
+  static auto is_fresh(entry_t const& entry, clock::time_point now = clock::now()) -> bool;
+
+  //! Copies the body of the entry to path (as a reflink if the filesystem supports it).
+  //! Never a hard link, so changing the file doesn't change the body.
+  auto link(entry_t const& entry, std::filesystem::path const& path) const -> bool;
+
+  //! The server confirmed, that the entry of the key is still valid.
+  void revalidated(std::string const& key, clock::time_point now = clock::now());
+
+  //! Stores a copy of the downloaded file at path as body of the key.
+  auto store(std::string const& key, std::filesystem::path const& path, std::string const& etag,
+      clock::time_point now = clock::now()) -> bool;
+
+  //! Evicts and writes the index, merged with the changes of other processes in the meantime.
+  void save();
+
+  //! Bytes of all bodies.
+  auto size() const -> size_t;
+
+
+private:
+
+  auto object_path(std::string const& digest) const -> std::filesystem::path;
+  auto index_path() const -> std::filesystem::path;
+
+  void evict();                        // with locked mutex
+  auto bodies_size() const -> size_t;  // with locked mutex
+
+  std::filesystem::path m_dir;
+  size_t m_max_bytes;
+
+  mutable std::mutex m_mutex;
+  std::map<std::string, entry_t> m_entries = {};
+  bool m_changed = false;
+};
+
+//! Parse the index of the cache, a line "<KEY>\t<DIGEST>\t<ETAG>\t<SIZE>\t<VALIDATED>\t<USED>" per entry
+//! (times in seconds since the epoch). Broken lines are skipped.
+auto parse_cache_index(std::istream& in) -> std::map<std::string, segment_cache_t::entry_t>;
+void write_cache_index(std::ostream& out, std::map<std::string, segment_cache_t::entry_t> const& entries);
+
+//! SHA-256 of the file as hex-string, empty on error.
+auto sha256_file(std::filesystem::path const& path) -> std::string;
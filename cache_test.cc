@@ -0,0 +1,119 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#include "cache.h"
+
+using namespace std::chrono_literals;
+
+static void write_file(std::filesystem::path const& path, std::string const& content)
+{
+  std::ofstream file{path};
+  file << content;
+}
+
+TEST(cache_tests, make_key)
+{
+  EXPECT_EQ(segment_cache_t::make_key("HTTPS://CDN.Example.com:443/a/Seg1.ts?t=1#x"), "https://cdn.example.com/a/Seg1.ts?t=1");
+  EXPECT_EQ(segment_cache_t::make_key("http://cdn.example.com:8080"), "http://cdn.example.com:8080/");
+
+  aes128_t const aes128{{1, 2, 3}, {4, 5, 6}};
+  std::string const key = segment_cache_t::make_key("https://cdn.example.com/seg1.ts", aes128);
+  EXPECT_TRUE(key.starts_with("https://cdn.example.com/seg1.ts aes128:"));
+  EXPECT_NE(key, segment_cache_t::make_key("https://cdn.example.com/seg1.ts", aes128_t{{1, 2, 3}, {4, 5, 7}}));
+
+  EXPECT_EQ(segment_cache_t::make_key("https://cdn.example.com/seg1.ts", {}, std::make_tuple(1'000, 500)),
+      "https://cdn.example.com/seg1.ts bytes:1000+500");
+}
+
+TEST(cache_tests, index)
+{
+  using clock = segment_cache_t::clock;
+  std::string const digest(64, 'a');
+
+  std::map<std::string, segment_cache_t::entry_t> const entries = {
+    {"https://cdn/1.ts", {digest, "\"etag-1\"", 2'048, clock::time_point{100s}, clock::time_point{200s}}},
+    {"https://cdn/2.ts", {digest, "", 2'048, clock::time_point{100s}, clock::time_point{300s}}},
+  };
+
+  std::stringstream ss;
+  write_cache_index(ss, entries);
+  ss << "broken\tline\n";
+
+  auto const parsed = parse_cache_index(ss);
+  ASSERT_EQ(parsed.size(), 2);
+  EXPECT_EQ(parsed.at("https://cdn/1.ts").etag, "\"etag-1\"");
+  EXPECT_EQ(parsed.at("https://cdn/2.ts").etag, "");
+  EXPECT_EQ(parsed.at("https://cdn/2.ts").size, 2'048);
+  EXPECT_EQ(parsed.at("https://cdn/2.ts").used, clock::time_point{300s});
+}
+
+TEST(cache_tests, store_lookup_evict)
+{
+  auto const dir = std::filesystem::temp_directory_path() / std::format("cache_test-{}", getpid());
+  std::filesystem::create_directories(dir);
+  auto const now = segment_cache_t::clock::now();
+
+  {
+    segment_cache_t cache{dir / "cache", 5'000};
+
+    write_file(dir / "a.ts", std::string(2'000, 'a'));
+    write_file(dir / "b.ts", std::string(2'000, 'b'));
+    write_file(dir / "c.ts", std::string(2'000, 'a')); // the same content as a.ts
+    ASSERT_TRUE(cache.store("https://cdn/a.ts", dir / "a.ts", "\"a\"", now - 2h));
+    ASSERT_TRUE(cache.store("https://cdn/b.ts", dir / "b.ts", "", now - 1h));
+    ASSERT_TRUE(cache.store("https://cdn/c.ts", dir / "c.ts", "", now - 1h));
+    EXPECT_EQ(cache.size(), 4'000); // a.ts and c.ts share their body
+
+    auto const entry = cache.lookup("https://cdn/a.ts", now);
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->etag, "\"a\"");
+    EXPECT_TRUE(segment_cache_t::is_fresh(entry.value(), now));
+    EXPECT_FALSE(segment_cache_t::is_fresh(entry.value(), now + 25h));
+    EXPECT_FALSE(cache.lookup("https://cdn/d.ts", now).has_value());
+
+    std::filesystem::remove(dir / "a.ts");
+    ASSERT_TRUE(cache.link(entry.value(), dir / "a.ts"));
+    EXPECT_EQ(std::filesystem::file_size(dir / "a.ts"), 2'000);
+
+    write_file(dir / "d.ts", std::string(2'000, 'd'));
+    ASSERT_TRUE(cache.store("https://cdn/d.ts", dir / "d.ts", "", now));
+    cache.save(); // evicts b.ts, the least recently used
+  }
+
+  segment_cache_t cache{dir / "cache", 5'000};
+  EXPECT_EQ(cache.size(), 4'000);
+  EXPECT_FALSE(cache.lookup("https://cdn/b.ts", now).has_value());
+  EXPECT_TRUE(cache.lookup("https://cdn/a.ts", now).has_value());
+  EXPECT_TRUE(cache.lookup("https://cdn/d.ts", now).has_value());
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(cache_tests, copies)
+{
+  // The parts are changed in place (e.g. by the PNG fake-header check), which mustn't change the bodies.
+  auto const dir = std::filesystem::temp_directory_path() / std::format("cache_test-copies-{}", getpid());
+  std::filesystem::create_directories(dir);
+
+  segment_cache_t cache{dir / "cache", 5'000};
+  write_file(dir / "a.ts", std::string(2'000, 'a'));
+  ASSERT_TRUE(cache.store("https://cdn/a.ts", dir / "a.ts", ""));
+  write_file(dir / "a.ts", std::string(1'000, 'x'));
+
+  auto const entry = cache.lookup("https://cdn/a.ts");
+  ASSERT_TRUE(entry.has_value());
+  ASSERT_TRUE(cache.link(entry.value(), dir / "b.ts"));
+  write_file(dir / "b.ts", std::string(1'000, 'y'));
+
+  ASSERT_TRUE(cache.link(entry.value(), dir / "c.ts"));
+  std::ifstream file{dir / "c.ts"};
+  std::stringstream content;
+  content << file.rdbuf();
+  EXPECT_EQ(content.str(), std::string(2'000, 'a'));
+  EXPECT_EQ(sha256_file(dir / "c.ts"), entry->digest);
+
+  std::filesystem::remove_all(dir);
+}
@@ -1,11 +1,21 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::ranges::all_of, std::ranges::any_of, std::ranges::find, std::ranges::transform
+#include <array>
 #include <cassert>
+#include <cctype> // std::isalnum
+#include <cstdio> // std::remove
+#include <chrono>
 #include <cstring> // strerror, strncpy
+#include <deque>
 #include <format>
 #include <fstream> // ifstream
-#include <memory> // std::shared_ptr
+#include <map>
+#include <memory>  // std::shared_ptr
+#include <mutex>
+#include <numeric> // std::accumulate, std::iota
 #include <optional>
 #include <regex>
+#include <set>
 #include <string>
 #include <system_error> // std::error_code
 #include <vector>
@@ -13,7 +23,15 @@
 #include <iostream> // for debugging
 
 #include "curl_wrapper.h"
+#include "hedge.h"
 #include "progressmeter.h"
+#include "schedule.h"
+#include "string_util.h" // trim()
+#include "url.h"
+
+#include <fcntl.h>   // fallocate, open
+#include <strings.h> // strncasecmp
+#include <unistd.h>  // close, pwrite
 
 #include <curl/curl.h>
 
@@ -32,27 +50,95 @@ void curl_wrapper::cleanup()
 
 using byte_t = curl_wrapper::byte_t;
 using pathurl_t = curl_wrapper::pathurl_t;
+using download_t = curl_wrapper::download_t;
 
 namespace
 {
   struct curl_context_t;
   struct curl_handle_t;
+  struct decrypt_sink_t;
+  struct pwrite_sink_t;
+  class output_files_t;
 
-  auto curl_multi_add_handle(CURLM* multi_handle, curl_context_t const& context, std::filesystem::path const& path,
+  auto curl_multi_add_handle(CURLM* multi_handle, curl_context_t const& context, download_t const& download,
       int index, download_process_t* process) -> std::variant<curl_handle_t, curl_wrapper_error>;
   auto curl_multi_handle_message(CURLM* multi_handle, CURLMsg* m) -> std::tuple<CURLcode, size_t>;
 
-  auto verify_file(std::filesystem::path const& path, std::string const& url) -> std::optional<curl_wrapper_error>;
+  //! The times, bytes and new connections of a finished transfer.
+  auto transfer_timing(CURL* handle) -> timing_t;
+
+  //! Records the finished (or canceled) transfer of the handle from begin to end on the track of its slot:
+  //! Its span (with the url, bytes and the args) and in it the connect (DNS, TCP and TLS), wait (for the
+  //! first byte) and transfer (receiving and writing) spans by the times of libcurl.
+  void trace_transfer(trace_t& trace, int slot, std::string const& name, std::string const& category,
+      trace_t::clock::time_point begin, trace_t::clock::time_point end, CURL* handle, json_t::object_t args);
+
+  //! Appends the statistics as JSON-line to the file and prints them as table, see curl_wrapper::stats_file().
+  void write_stats(std::filesystem::path const& path, curl_wrapper::results_t const& results, bool print);
+
+  auto verify_file(std::filesystem::path const& path, std::string const& url,
+      std::optional<std::tuple<uint64_t, uint64_t>> const& range = {}) -> std::optional<curl_wrapper_error>;
+
+  //! An error if not exactly the expected length was written, see pwrite_file().
+  auto verify_written(pwrite_sink_t const& sink, std::string const& url, std::filesystem::path const& path)
+    -> std::optional<curl_wrapper_error>;
+
+  //! An error if the free space of a directory isn't enough for the lengths of the downloads to it.
+  auto check_free_space(std::vector<download_t> const& downloads, std::vector<size_t> const& lengths)
+    -> std::optional<curl_wrapper_error>;
 
   void curl_easy_setup(CURL* handle, curl_context_t const& context, curl_write_callback callback, void* userdata);
 
   auto append_file(curl_wrapper::byte_t* ptr,   size_t size, size_t nmemb, void* userdata) -> size_t;
   auto append_buffer(curl_wrapper::byte_t* ptr, size_t size, size_t nmemb, void* userdata) -> size_t;
+  auto decrypt_file(curl_wrapper::byte_t* ptr,  size_t size, size_t nmemb, void* userdata) -> size_t;
+  auto pwrite_file(curl_wrapper::byte_t* ptr,   size_t size, size_t nmemb, void* userdata) -> size_t;
+  auto capture_etag(char* buffer, size_t size, size_t nitems, void* userdata) -> size_t;
 
   int progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
 
   // ---
 
+  //! Userdata of decrypt_file().
+  struct decrypt_sink_t
+  {
+    decrypt_sink_t(FILE* fh, aes128_t const& aes128)
+      : fh(fh), decrypter(aes128)
+    {}
+
+    FILE* fh;
+    aes128_decrypter_t decrypter;
+  };
+
+  //! Userdata of pwrite_file().
+  struct pwrite_sink_t
+  {
+    int fd;
+    uint64_t offset;  // of the download in the file
+    uint64_t length;  // expected
+    uint64_t written;
+    CURL* handle;
+  };
+
+  //! The files of download_t::output, opened once for all their downloads.
+  class output_files_t
+  {
+  public:
+
+    output_files_t() = default;
+    ~output_files_t();
+
+    output_files_t(output_files_t const&) = delete;
+    auto operator=(output_files_t const&) -> output_files_t& = delete;
+
+    //! The file descriptor of the file, that is created with (at least) the size. -1 on error.
+    auto open(std::filesystem::path const& path, uint64_t size) -> int;
+
+  private:
+
+    std::map<std::filesystem::path, int> m_fds = {};
+  };
+
   //! Container-class for some elements that need to be initialised and cleaned up.
   //! Helper so I don't need to deal with this in the curl_wrapper::download_*()-functions.
   struct curl_handle_t
@@ -71,6 +157,9 @@ namespace
 
     void close();
 
+    //! Write the last decrypted block (see decrypt_file()), needs to be called before close().
+    bool finish_decryption();
+
     inline auto get() const -> CURL* { return m_handle; }
     inline auto errormsg() const -> std::string { return std::string{m_errbuf}; }
 
@@ -81,14 +170,26 @@ namespace
 
     std::filesystem::path m_path = "";
     FILE* m_fh = nullptr;
+
+    // On the heap, because libcurl holds a pointer to it while the handle is moved around.
+    std::unique_ptr<decrypt_sink_t> m_decrypt = nullptr;
+    std::unique_ptr<pwrite_sink_t> m_pwrite = nullptr;
+    std::unique_ptr<std::string> m_etag = std::make_unique<std::string>(); // of the response, see capture_etag()
+
+    curl_slist* m_headers = nullptr; // extra request-headers
   };
 
+
   struct curl_context_t
   {
     std::string url;
     std::string useragent;
     bool verbose_flag;
     bool default_progressmeter;
+    curl_off_t maxrecv; // max receive speed in bytes/s
+    void* share;        // CURLSH or nullptr
+    std::string if_none_match = ""; // ETag for a conditional request
+    int output = -1;                 // file descriptor of download_t::output
   };
 
   void curl_easy_setup(CURL* handle, curl_context_t const& context,
@@ -105,8 +206,10 @@ namespace
     curl_easy_setopt(handle, CURLOPT_VERBOSE,     context.verbose_flag ? 1 : 0);
     curl_easy_setopt(handle, CURLOPT_NOPROGRESS,  context.default_progressmeter ? 0 : 1);
 
-    curl_off_t const maxrecv = 1*1'024*1'024; // max receive speed 1MB/s
-    curl_easy_setopt(handle, CURLOPT_MAX_RECV_SPEED_LARGE, maxrecv);
+    curl_easy_setopt(handle, CURLOPT_MAX_RECV_SPEED_LARGE, context.maxrecv);
+
+    if(context.share != nullptr)
+      curl_easy_setopt(handle, CURLOPT_SHARE, context.share);
 
     // https://curl.se/libcurl/c/CURLOPT_WRITEFUNCTION.html
     curl_easy_setopt(handle, CURLOPT_WRITEDATA, userdata); // set userdata
@@ -114,13 +217,16 @@ namespace
   }
 
   curl_handle_t::curl_handle_t(curl_handle_t&& other)
-    : m_handle(other.m_handle), m_errbuf(other.m_errbuf), m_url(other.m_url), m_path(other.m_path), m_fh(other.m_fh)
+    : m_handle(other.m_handle), m_errbuf(other.m_errbuf), m_url(other.m_url), m_path(other.m_path), m_fh(other.m_fh),
+      m_decrypt(std::move(other.m_decrypt)), m_pwrite(std::move(other.m_pwrite)), m_etag(std::move(other.m_etag)),
+      m_headers(other.m_headers)
   {
     other.m_handle = nullptr;
     other.m_errbuf = nullptr;
     other.m_url = "";
     other.m_path = "";
     other.m_fh = nullptr;
+    other.m_headers = nullptr;
   }
 
   curl_handle_t::~curl_handle_t()
@@ -133,6 +239,9 @@ namespace
 
     if(m_fh != nullptr)
       fclose(m_fh);
+
+    if(m_headers != nullptr)
+      curl_slist_free_all(m_headers);
   }
 
   void curl_handle_t::close()
@@ -151,10 +260,27 @@ namespace
     std::swap(m_url, other.m_url);
     std::swap(m_path, other.m_path);
     std::swap(m_fh, other.m_fh);
+    std::swap(m_decrypt, other.m_decrypt);
+    std::swap(m_pwrite, other.m_pwrite);
+    std::swap(m_etag, other.m_etag);
+    std::swap(m_headers, other.m_headers);
 
     return *this;
   }
 
+  bool curl_handle_t::finish_decryption()
+  {
+    assert(m_decrypt != nullptr);
+    assert(m_fh != nullptr);
+
+    std::array<uint8_t, aes128_decrypter_t::BLOCKSIZE> last;
+    auto const len = m_decrypt->decrypter.finish(last.data());
+    if(not len.has_value())
+      return false;
+
+    return fwrite(last.data(), 1, len.value(), m_fh) == len.value();
+  }
+
   bool curl_handle_t::init(std::string const& url)
   {
     m_url = url;
@@ -183,6 +309,8 @@ namespace
     if(not success)
       return false;
 
+    // Always a new file, an old one could be a hard link to another file.
+    std::remove(path.c_str());
     m_fh = fopen(path.c_str(), "w");
     if(m_fh == nullptr)
     {
@@ -197,10 +325,58 @@ namespace
     return true;
   }
 
+  output_files_t::~output_files_t()
+  {
+    for(auto const& [_, fd] : m_fds)
+      close(fd);
+  }
+
+  auto output_files_t::open(std::filesystem::path const& path, uint64_t size) -> int
+  {
+    if(not m_fds.contains(path))
+    {
+      int const fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+      if(fd == -1)
+        return -1;
+      m_fds[path] = fd;
+
+      // The blocks of all parts at once, without (e.g. unsupported by the filesystem) pwrite() extends it.
+      fallocate(fd, 0, 0, static_cast<off_t>(size));
+    }
+
+    return m_fds.at(path);
+  }
+
 } // namespace
 
 // ---
 
+/**
+ * The share is used by several threads at once (the concurrent runs of the daemon),
+ * so it's locked by a mutex per shared data.
+ * See https://curl.se/libcurl/c/libcurl-share.html
+ */
+auto curl_wrapper::make_share() -> std::shared_ptr<void>
+{
+  CURLSH* share = curl_share_init();
+  if(share == nullptr) // Works without, only slower.
+    return nullptr;
+
+  static std::array<std::mutex, CURL_LOCK_DATA_LAST> mutexes;
+  using lock_function_t = void(*)(CURL*, curl_lock_data, curl_lock_access, void*);
+  using unlock_function_t = void(*)(CURL*, curl_lock_data, void*);
+  curl_share_setopt(share, CURLSHOPT_LOCKFUNC, static_cast<lock_function_t>(
+        [](CURL*, curl_lock_data data, curl_lock_access, void*) { mutexes.at(data).lock(); }));
+  curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, static_cast<unlock_function_t>(
+        [](CURL*, curl_lock_data data, void*) { mutexes.at(data).unlock(); }));
+
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+  return std::shared_ptr<void>{share, [](void* p) { curl_share_cleanup(static_cast<CURLSH*>(p)); }};
+}
+
 auto curl_wrapper::download_file(std::filesystem::path const& path, std::string const& url) const
   -> std::variant<std::filesystem::path, curl_wrapper_error>
 {
@@ -212,7 +388,8 @@ auto curl_wrapper::download_file(std::filesystem::path const& path, std::string
   if(not success)
     return curl_wrapper_error(handle.errormsg());
 
-  curl_context_t context {url, m_useragent, m_verbose_flag, m_default_progressmeter};
+  curl_context_t context {url, m_useragent, m_verbose_flag, m_default_progressmeter,
+    static_cast<curl_off_t>(m_max_speed/m_parallel), m_share.get()};
 
   curl_easy_setup(handle.get(), context, append_file, handle.m_fh);
   CURLcode const res = curl_easy_perform(handle.get());
@@ -240,7 +417,8 @@ auto curl_wrapper::download_buffer(std::string const& url) const
   if(not success)
     return curl_wrapper_error(handle.errormsg());
 
-  curl_context_t context {url, m_useragent, m_verbose_flag, m_default_progressmeter};
+  curl_context_t context {url, m_useragent, m_verbose_flag, m_default_progressmeter,
+    static_cast<curl_off_t>(m_max_speed/m_parallel), m_share.get()};
 
   curl_easy_setup(handle.get(), context, append_buffer, &buffer);
   CURLcode const res = curl_easy_perform(handle.get());
@@ -252,8 +430,37 @@ auto curl_wrapper::download_buffer(std::string const& url) const
 
 auto curl_wrapper::download_files(std::vector<pathurl_t> const pathurls)
   -> results_t
+{
+  std::vector<download_t> downloads = {};
+  downloads.reserve(pathurls.size());
+  for(auto const& [path, url] : pathurls)
+    downloads.push_back(download_t{path, url});
+
+  return download_files(downloads);
+}
+
+auto curl_wrapper::download_files(std::vector<download_t> const& downloads)
+  -> results_t
+{
+  return download_files(downloads, hooks_t{});
+}
+
+auto curl_wrapper::download_files(std::vector<download_t> const& downloads, hooks_t const& hooks)
+  -> results_t
 {
   results_t results;
+  auto const start = std::chrono::steady_clock::now();
+
+  auto make_results = [this, &results, &start]()
+  {
+    if(m_cache != nullptr)
+      m_cache->save();
+
+    results.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(not m_stats_file.empty())
+      write_stats(m_stats_file, results, m_progress_format == progress_format_t::terminal);
+    return results;
+  };
 
   std::shared_ptr<CURLM> multi_handle {curl_multi_init(),
     [](CURLM* p) { curl_multi_cleanup(p); }};
@@ -281,41 +488,298 @@ auto curl_wrapper::download_files(std::vector<pathurl_t> const pathurls)
   //
 
   progressmeter_t progressmeter;
-  progressmeter.set_number_of_downloads(pathurls.size());
+  progressmeter.set_format(m_progress_format);
+  progressmeter.set_interval(m_progress_interval);
+  progressmeter.set_number_of_downloads(downloads.size());
+  if(m_playback_window > 0)
+    progressmeter.set_watermark(0);
 
   int active_handles = 0;
-  const int max_active_handles = 5;
+  const int max_active_handles = m_parallel;
 
   //curl_multi_setopt(multi_handle.get(), CURLMOPT_MAX_TOTAL_CONNECTIONS, max_active_handles);
 
-  std::vector<curl_handle_t> handles(pathurls.size());
+  std::vector<curl_handle_t> handles(downloads.size());
+  std::set<size_t> running = {}; // indices of the active handles
+
+  // Hedging of stragglers, see hedge_policy_t.
+  // CURLOPT_PRIVATE of a hedge is hedge_offset+index to tell it apart from the download itself.
+  using clock = std::chrono::steady_clock;
+  hedge_policy_t hedge_policy{m_hedge_budget};
+  size_t const hedge_offset = downloads.size();
+  std::map<size_t, curl_handle_t> hedges = {};                // index -> hedge
+  std::vector<download_t> started_downloads(downloads.size()); // after on_start()
+  std::vector<clock::time_point> started(downloads.size());
+
+  // Tracing, see trace(): Every handle takes the lowest free slot (a track) while it's active.
+  trace_t* const trace = m_trace.get();
+  auto const queued = clock::now();
+  std::vector<bool> slots = {};                                     // taken ones
+  std::map<size_t, std::tuple<int, clock::time_point>> traced = {}; // CURLOPT_PRIVATE -> (track, start)
+  std::vector<size_t> attempts(downloads.size(), 0);
+
+  auto trace_begin = [&](size_t key)
+  {
+    if(trace == nullptr)
+      return;
+
+    size_t const slot = std::ranges::find(slots, false) - slots.begin();
+    if(slot == slots.size())
+      slots.push_back(true);
+    else
+      slots[slot] = true;
+    traced[key] = std::make_tuple(trace->track(trace_t::transfers, std::format("slot {}", slot+1)), clock::now());
+  };
+
+  // Ends the trace of the handle (key is its CURLOPT_PRIVATE) and frees its slot.
+  // Returns the track of the slot or -1 if the handle isn't traced.
+  auto trace_end = [&](size_t key, CURL* handle, clock::time_point end, json_t::object_t args = {}) -> int
+  {
+    auto const it = traced.find(key);
+    if(it == traced.end())
+      return -1;
+
+    auto const [track, begin] = it->second;
+    traced.erase(it);
+    slots[static_cast<size_t>(track-1)] = false;
+
+    bool const hedge = key >= hedge_offset;
+    size_t const index = hedge ? key - hedge_offset : key;
+    if(attempts[index] > 1)
+      args["attempt"] = attempts[index];
+
+    std::string const name = downloads[index].path.filename().string();
+    trace_transfer(*trace, track, hedge ? "hedge " + name : name, hedge ? "hedge" : "transfer", begin, end, handle,
+        std::move(args));
+    return track;
+  };
+
+  // Failover between the mirrors of a download, see host_health_t.
+  std::vector<std::vector<std::string>> mirror_urls(downloads.size()); // url and mirrors of a download
+  std::vector<std::set<size_t>> tried(downloads.size());               // positions in mirror_urls
 
-  size_t i = 0;
+  // The exact sizes, see preflight().
+  std::vector<size_t> lengths(downloads.size(), 0);
+  if(m_preflight)
+  {
+    auto [sizes, total] = run_preflight(downloads);
+    lengths = std::move(sizes);
+    if(total.has_value())
+      progressmeter.set_total_bytes(total.value());
+
+    if(auto const error = check_free_space(downloads, lengths); error.has_value())
+    {
+      results.errors.push_back(error.value());
+      return make_results();
+    }
+  }
+
+  // The order to start the downloads in, see largest_first().
+  std::vector<size_t> predicted(downloads.size());
+  std::ranges::transform(downloads, predicted.begin(), &download_t::predicted_bytes);
+  for(size_t k=0; k<downloads.size(); k++)
+    if(lengths[k] > 0)
+      predicted[k] = lengths[k];
+
+  // Positional writes, see download_t::output.
+  output_files_t outputs;
+  std::map<std::filesystem::path, uint64_t> output_sizes = {};
+  for(auto const& download : downloads)
+  {
+    if(not download.output.has_value())
+      continue;
+
+    auto const& [output, offset] = download.output.value();
+    output_sizes[output] = std::max(output_sizes[output], offset + download.content_length);
+  }
+  bool const is_predicted = std::ranges::any_of(predicted, [](size_t bytes) { return bytes > 0; });
+
+  std::vector<size_t> start_order(downloads.size());
+  std::iota(start_order.begin(), start_order.end(), 0);
+  if(m_largest_first and m_playback_window == 0 and is_predicted)
+    start_order = lpt_order(predicted);
+
+  if(is_predicted)
+    results.predicted_seconds = predict_makespan(predicted, start_order, static_cast<size_t>(m_parallel),
+        static_cast<double>(m_max_speed)/m_parallel);
+
+  size_t i = 0; // position in start_order of the next download to start
+
+  // Caching, see segment_cache_t.
+  std::vector<std::string> cache_keys(downloads.size());
+  std::vector<std::string> cache_etags(downloads.size()); // of the cached version, to revalidate it
+
+  // The cached version is still valid (the answer to If-None-Match was 304), link it to path.
+  auto take_cached = [&](size_t index, std::string const& url, std::filesystem::path const& path)
+    -> std::optional<curl_wrapper_error>
+  {
+    auto const entry = m_cache != nullptr ? m_cache->lookup(cache_keys[index]) : std::nullopt;
+    if(not entry.has_value() or not m_cache->link(entry.value(), path))
+      return curl_wrapper_error{"not modified, but not in the cache anymore", url, path};
+
+    m_cache->revalidated(cache_keys[index]);
+    return {};
+  };
+  std::deque<size_t> failover = {}; // downloads to start again with another mirror
+  std::vector<download_process_t*> processes(downloads.size(), nullptr);
+
+  // Playback order, see playback_window().
+  size_t const window = m_playback_window > 0 ? m_playback_window : downloads.size();
+  std::vector<bool> finished(downloads.size(), false);
+  size_t watermark = 0;
+  std::set<size_t> paused = {}; // indices of the paused handles
+
+  // The download with the index is finished for good (successful or not).
+  auto finish = [&](size_t index, transfer_t const& transfer)
+  {
+    if(hooks.on_finish)
+      hooks.on_finish(index, transfer);
+
+    finished[index] = true;
+    if(index != watermark)
+      return;
+
+    while(watermark < downloads.size() and finished[watermark])
+      watermark++;
+    if(m_playback_window > 0)
+      progressmeter.set_watermark(watermark);
+    if(hooks.on_watermark)
+      hooks.on_watermark(watermark);
+  };
+
+  auto can_start = [&]()
+  {
+    return not failover.empty() or (i < downloads.size() and i < watermark + window);
+  };
+
+  // The handles that finished in the last curl_multi_perform() and whose message isn't handled yet.
+  // They aren't counted in active_handles anymore.
+  std::set<CURL*> done_handles = {};
+
+  // Cancel the hedge of the download with the index (if it has one).
+  auto drop_hedge = [&](size_t index)
+  {
+    auto it = hedges.find(index);
+    if(it == hedges.end())
+      return;
+
+    curl_off_t bytes = 0;
+    curl_easy_getinfo(it->second.get(), CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+    hedge_policy.hedged(static_cast<size_t>(bytes));
+    trace_end(hedge_offset+index, it->second.get(), clock::now(), {{"canceled", true}});
+
+    if(done_handles.erase(it->second.get()) == 0) // otherwise its message is void
+      active_handles--;
+    curl_multi_remove_handle(multi_handle.get(), it->second.get());
+    it->second.close();
+    std::remove(it->second.m_path.c_str());
+    hedges.erase(it);
+  };
 
   // Run as long there are active handles or there are handles still waiting.
-  while(active_handles > 0 or i<pathurls.size())
+  while(active_handles > 0 or i<downloads.size() or not failover.empty())
   {
-    // Make handles active (up to max_active_handles).
-    while(active_handles < max_active_handles and i<pathurls.size())
+    // Make handles active (up to max_active_handles), the ones to fail over first.
+    while(active_handles < max_active_handles and can_start())
     {
-      auto [path, url] = pathurls[i];
-      curl_context_t const context {url, m_useragent, m_verbose_flag, false};
+      bool const again = not failover.empty();
+      size_t const index = again ? failover.front() : start_order[i];
+      if(again)
+        failover.pop_front();
+      else
+        i++;
+
+      if(hooks.is_canceled and hooks.is_canceled(index))
+      {
+        results.errors.push_back(curl_wrapper_error{"canceled", downloads[index].url, downloads[index].path});
+        if(again)
+          progressmeter.finish_download(index, "canceled");
+        finish(index, transfer_t{});
+
+        continue;
+      }
+
+      download_t download = again ? started_downloads[index] : downloads[index];
+      if(not again and hooks.on_start)
+        hooks.on_start(index, download);
+      if(not again and lengths[index] > 0 and download.url == downloads[index].url) // not switched by on_start
+        download.content_length = lengths[index];
+
+      // A positional write needs the exact length (of what's written) and the cache needs a file.
+      if(download.output.has_value()
+          and (download.content_length == 0 or download.aes128.has_value() or m_cache != nullptr))
+        download.output.reset();
 
-      download_process_t* process = progressmeter.add_download(i, path);
+      // Link it from the cache if it's fresh there, otherwise revalidate it.
+      if(not again and m_cache != nullptr)
+      {
+        cache_keys[index] = segment_cache_t::make_key(download.url, download.aes128, download.range);
+        auto const entry = m_cache->lookup(cache_keys[index]);
+        if(entry.has_value() and segment_cache_t::is_fresh(entry.value()) and m_cache->link(entry.value(), download.path))
+        {
+          if(m_verbose_flag)
+            messages() << std::format("Take from the cache: {}", download.url) << std::endl;
+
+          results.succeeded_files.push_back(download.path);
+          progressmeter.add_download(index, download.path);
+          progressmeter.finish_download(index);
+          finish(index, transfer_t{0, 0.0, true});
+          continue;
+        }
+        if(entry.has_value())
+          cache_etags[index] = entry->etag;
+      }
 
-      auto handle_error = curl_multi_add_handle(multi_handle.get(), context, path, i, process);
+      // Take the mirror with the healthiest host.
+      if(not again)
+      {
+        mirror_urls[index] = {download.url};
+        mirror_urls[index].insert(mirror_urls[index].end(), download.mirrors.begin(), download.mirrors.end());
+      }
+      if(mirror_urls[index].size() > 1)
+      {
+        size_t const pick = m_health->pick(mirror_urls[index], tried[index]).value_or(0);
+        tried[index].insert(pick);
+        download.url = mirror_urls[index][pick];
+      }
+
+      int output = -1;
+      if(download.output.has_value())
+      {
+        auto const& path = std::get<0>(download.output.value());
+        output = outputs.open(path, output_sizes[path]);
+        if(output == -1) // then to its own file
+          download.output.reset();
+      }
+
+      curl_context_t const context {download.url, m_useragent, m_verbose_flag, false,
+        static_cast<curl_off_t>(m_max_speed/m_parallel), m_share.get(), cache_etags[index], output};
+
+      download_process_t* process = again ? processes[index] : progressmeter.add_download(index, download.path);
+      processes[index] = process;
+
+      auto handle_error = curl_multi_add_handle(multi_handle.get(), context, download, index, process);
       if(std::holds_alternative<curl_handle_t>(handle_error))
       {
-        handles[i] = std::move(std::get<curl_handle_t>(handle_error));
+        handles[index] = std::move(std::get<curl_handle_t>(handle_error));
+        running.insert(index);
         active_handles++;
+
+        started_downloads[index] = download;
+        started[index] = clock::now();
+
+        attempts[index]++;
+        if(trace != nullptr and not again)
+          trace->async_span("queued", "queue", trace_t::transfers, index, queued, started[index]);
+        trace_begin(index);
       }
       else
       {
         results.errors.push_back(std::get<curl_wrapper_error>(handle_error));
-        progressmeter.remove_download(i);
-      }
+        progressmeter.remove_download(index);
 
-      i++;
+        finish(index, transfer_t{});
+      }
     }
 
     // Note: Returns the number of currently active_handles.
@@ -323,29 +787,174 @@ auto curl_wrapper::download_files(std::vector<pathurl_t> const pathurls)
     if(res != CURLM_OK)
     {
       results.errors.push_back(curl_wrapper_error{ curl_multi_strerror(res) } );
-      return results;
+      return make_results();
     }
 
     // Handle messages.
     int consecutive_errors = 0;
+    // Take all messages first, as a download and its hedge can finish in the same perform.
+    std::vector<CURLMsg> done_messages = {};
     int msgs_in_queue = 0;
     while(CURLMsg* msg = curl_multi_info_read(multi_handle.get(), &msgs_in_queue))
     {
+      done_messages.push_back(*msg);
+      done_handles.insert(msg->easy_handle);
+    }
+
+    for(CURLMsg& message : done_messages)
+    {
+      CURLMsg* const msg = &message;
+      if(done_handles.erase(msg->easy_handle) == 0) // canceled meanwhile
+        continue;
+
+      if(msg->msg == CURLMSG_DONE)
+        results.stats.add(transfer_timing(msg->easy_handle));
+
       auto [errorcode, index] = curl_multi_handle_message(multi_handle.get(), msg);
 
+      if(index >= hedge_offset) // A hedge finished before its download.
+      {
+        index -= hedge_offset;
+        curl_handle_t hedge = std::move(hedges.at(index));
+        hedges.erase(index);
+
+        bool const decrypted = errorcode != CURLE_OK or hedge.m_decrypt == nullptr or hedge.finish_decryption();
+
+        curl_off_t bytes = 0;
+        curl_off_t microseconds = 0;
+        curl_easy_getinfo(hedge.get(), CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+        curl_easy_getinfo(hedge.get(), CURLINFO_TOTAL_TIME_T, &microseconds);
+        hedge_policy.hedged(static_cast<size_t>(bytes));
+        trace_end(hedge_offset+index, hedge.get(), clock::now(), errorcode != CURLE_OK
+            ? json_t::object_t{{"error", curl_easy_strerror(errorcode)}} : json_t::object_t{});
+
+        hedge.close();
+
+        // A failed hedge doesn't matter, the download is still running.
+        if(errorcode != CURLE_OK or not decrypted or verify_file(hedge.m_path, hedge.m_url, started_downloads[index].range).has_value())
+        {
+          std::remove(hedge.m_path.c_str());
+          continue;
+        }
+
+        // The hedge won, cancel the download and take the file of the hedge.
+        curl_handle_t handle = std::move(handles[index]);
+        running.erase(index);
+        paused.erase(index);
+        if(done_handles.erase(handle.get()) == 0) // otherwise its message is void
+          active_handles--;
+        curl_multi_remove_handle(multi_handle.get(), handle.get());
+        handle.close();
+        trace_end(index, handle.get(), clock::now(), {{"canceled", true}});
+
+        std::error_code errc;
+        std::filesystem::rename(hedge.m_path, handle.m_path, errc);
+        if(errc)
+        {
+          consecutive_errors++;
+          results.errors.push_back(curl_wrapper_error{errc.message(), handle.m_url, handle.m_path});
+        }
+        else
+        {
+          consecutive_errors = 0;
+          results.succeeded_files.push_back(handle.m_path);
+          hedge_policy.finished(static_cast<size_t>(bytes), static_cast<double>(microseconds)/1e6);
+          if(m_cache != nullptr)
+            m_cache->store(cache_keys[index], handle.m_path, *hedge.m_etag);
+        }
+
+        progressmeter.finish_download(index);
+
+        bool const succeeded = not errc;
+        finish(index, transfer_t{static_cast<size_t>(bytes), static_cast<double>(microseconds)/1e6, succeeded});
+
+        if(consecutive_errors >= 5)
+          return make_results();
+        continue;
+      }
+
+      drop_hedge(index); // The download finished first.
+
       curl_handle_t handle = std::move(handles[index]);
+      running.erase(index);
+      paused.erase(index);
       std::string const url = handle.m_url;
       std::filesystem::path const path = handle.m_path;
 
+      long status = 0;
+      curl_easy_getinfo(handle.get(), CURLINFO_RESPONSE_CODE, &status);
+      bool const not_modified = errorcode == CURLE_OK and status == 304 and not cache_etags[index].empty();
+
+      auto const finishing = clock::now();
+      bool const decrypted = errorcode != CURLE_OK or not_modified or handle.m_decrypt == nullptr
+        or handle.finish_decryption();
+
+      curl_off_t bytes = 0;
+      curl_off_t microseconds = 0;
+      curl_easy_getinfo(handle.get(), CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+      curl_easy_getinfo(handle.get(), CURLINFO_TOTAL_TIME_T, &microseconds);
+
       handle.close();
+      auto const written = clock::now();
 
       // verify_file() is only possible after handle is close (and thus its file-handle written and closed).
-      auto verify_error = errorcode == CURLE_OK ? verify_file(path, url) : std::optional<curl_wrapper_error>{};
+      auto const verify_error = not decrypted
+        ? std::optional<curl_wrapper_error>{curl_wrapper_error{"decryption failed (wrong key?)", url, path}}
+        : not_modified ? take_cached(index, url, path)
+        : errorcode == CURLE_OK and handle.m_pwrite != nullptr ? verify_written(*handle.m_pwrite, url, path)
+        : errorcode == CURLE_OK ? verify_file(path, url, started_downloads[index].range)
+        : std::optional<curl_wrapper_error>{};
+
+      bool const ok = errorcode == CURLE_OK and not verify_error.has_value();
+
+      // The last bytes are written (and decrypted) at closing, then the file is verified on the same slot.
+      json_t::object_t trace_args = {};
+      if(not ok)
+        trace_args["error"] = errorcode != CURLE_OK ? curl_easy_strerror(errorcode) : verify_error->what();
+      if(int const track = trace_end(index, handle.get(), finishing, std::move(trace_args)); track != -1)
+      {
+        trace->span("write", "transfer", trace_t::transfers, track, finishing, written);
+        trace->span("verify", "transfer", trace_t::transfers, track, written, clock::now());
+      }
+      if(ok)
+        m_health->succeeded(host_health_t::host_of(url), static_cast<size_t>(bytes), static_cast<double>(microseconds)/1e6);
+      else
+        m_health->failed(host_health_t::host_of(url));
+
+      // A positional write went wrong (e.g. the length differs from the announced one),
+      // then it's downloaded to its own file.
+      if(not ok and started_downloads[index].output.has_value() and not (hooks.is_canceled and hooks.is_canceled(index)))
+      {
+        if(m_verbose_flag)
+          messages() << std::format("Download to its own file: {}", url) << std::endl;
+
+        started_downloads[index].output.reset();
+        tried[index].clear();
+        failover.push_back(index);
+        continue;
+      }
+
+      // Fail over to another mirror, the error only counts if there is none left.
+      if(not ok and mirror_urls[index].size() > 1 and m_health->pick(mirror_urls[index], tried[index]).has_value()
+          and not (hooks.is_canceled and hooks.is_canceled(index)))
+      {
+        if(m_verbose_flag)
+          messages() << std::format("Fail over to a mirror of: {}", url) << std::endl;
+
+        failover.push_back(index);
+        continue;
+      }
 
       if(errorcode  == CURLE_OK and not verify_error.has_value()) // good case
       {
         consecutive_errors = 0;
         results.succeeded_files.push_back(path);
+        if(not not_modified)
+        {
+          hedge_policy.finished(static_cast<size_t>(bytes), static_cast<double>(microseconds)/1e6);
+          if(m_cache != nullptr)
+            m_cache->store(cache_keys[index], path, *handle.m_etag);
+        }
       }
       else if(errorcode  == CURLE_OK and verify_error.has_value()) // error case
       {
@@ -358,11 +967,119 @@ auto curl_wrapper::download_files(std::vector<pathurl_t> const pathurls)
         results.errors.push_back( curl_wrapper_error{curl_easy_strerror(errorcode), url, path} );
       }
 
-      progressmeter.finish_download(index);
+      bool const succeeded = consecutive_errors == 0; // see above, only reset in the good case
+      progressmeter.finish_download(index,
+          succeeded ? std::optional<std::string>{} : std::optional<std::string>{results.errors.back().what()});
+
+      finish(index, transfer_t{static_cast<size_t>(bytes), static_cast<double>(microseconds)/1e6, succeeded});
 
       // Break up after 5 consecutive errors.
       if(consecutive_errors >= 5)
-        return results;
+        return make_results();
+    }
+
+    // Cancel running downloads.
+    if(hooks.is_canceled)
+    {
+      for(auto it = running.begin(); it != running.end();)
+      {
+        size_t const index = *it;
+        if(not hooks.is_canceled(index))
+        {
+          ++it;
+          continue;
+        }
+
+        drop_hedge(index);
+
+        curl_handle_t handle = std::move(handles[index]);
+        curl_multi_remove_handle(multi_handle.get(), handle.get());
+        handle.close();
+        std::remove(handle.m_path.c_str());
+        trace_end(index, handle.get(), clock::now(), {{"canceled", true}});
+
+        results.errors.push_back(curl_wrapper_error{"canceled", handle.m_url, handle.m_path});
+        progressmeter.finish_download(index, "canceled");
+        finish(index, transfer_t{});
+
+        active_handles--;
+        paused.erase(index);
+        it = running.erase(it);
+      }
+    }
+
+    // Playback order: Pause the running downloads in the far half of the window
+    // and resume the ones the watermark caught up with.
+    if(m_playback_window > 0)
+    {
+      size_t const near = watermark + (window+1)/2;
+      for(size_t const index : running)
+      {
+        bool const far = index >= near;
+        if(far == paused.contains(index))
+          continue;
+
+        if(far)
+        {
+          drop_hedge(index);
+          curl_easy_pause(handles[index].get(), CURLPAUSE_RECV);
+          paused.insert(index);
+        }
+        else
+        {
+          curl_easy_pause(handles[index].get(), CURLPAUSE_CONT);
+          paused.erase(index);
+          started[index] = clock::now(); // the pause doesn't make it a straggler
+        }
+      }
+    }
+
+    // Hedge stragglers, but only in idle slots (when no more downloads can be started),
+    // the ones holding up the watermark first.
+    if(not can_start() and active_handles < max_active_handles and m_hedge_budget > 0.0)
+    {
+      auto const now = clock::now();
+      for(size_t const index : running)
+      {
+        if(active_handles >= max_active_handles or not hedge_policy.has_budget())
+          break;
+        if(hedges.contains(index) or paused.contains(index) or started_downloads[index].output.has_value())
+          continue;
+
+        curl_off_t bytes = 0;
+        curl_easy_getinfo(handles[index].get(), CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+        double const seconds = std::chrono::duration<double>(now - started[index]).count();
+        if(not hedge_policy.is_straggler(static_cast<size_t>(bytes), seconds))
+          continue;
+
+        download_t hedge = started_downloads[index];
+        hedge.path += ".hedge";
+
+        // Spread to another mirror if there is one.
+        if(mirror_urls[index].size() > 1)
+        {
+          auto const current = std::ranges::find(mirror_urls[index], hedge.url) - mirror_urls[index].begin();
+          auto const other = m_health->pick(mirror_urls[index], {static_cast<size_t>(current)});
+          if(other.has_value())
+            hedge.url = mirror_urls[index][other.value()];
+        }
+
+        curl_context_t const context {hedge.url, m_useragent, m_verbose_flag, false,
+          static_cast<curl_off_t>(m_max_speed/m_parallel), m_share.get()};
+
+        auto handle_error = curl_multi_add_handle(multi_handle.get(), context, hedge, hedge_offset+index, nullptr);
+        if(std::holds_alternative<curl_handle_t>(handle_error)) // otherwise simply no hedge
+        {
+          if(m_verbose_flag)
+            messages() << std::format("Hedge the straggler: {}", hedge.url) << std::endl;
+
+          hedges.emplace(index, std::move(std::get<curl_handle_t>(handle_error)));
+          active_handles++;
+          trace_begin(hedge_offset+index);
+        }
+        else
+          std::remove(hedge.path.c_str());
+      }
     }
 
     if(m_default_progressmeter)
@@ -374,7 +1091,7 @@ auto curl_wrapper::download_files(std::vector<pathurl_t> const pathurls)
     if(res != CURLM_OK)
     {
       results.errors.push_back( curl_wrapper_error{curl_multi_strerror(res)} );
-      return results;
+      return make_results();
     }
 
     if(timeout == -1) // No timeout set. This happens!?
@@ -386,27 +1103,66 @@ auto curl_wrapper::download_files(std::vector<pathurl_t> const pathurls)
     if(res != CURLM_OK)
     {
       results.errors.push_back( curl_wrapper_error{curl_multi_strerror(res)} );
-      return results;
+      return make_results();
     }
   }
 
-  return results;
+  return make_results();
 }
 
 namespace
 {
-  auto curl_multi_add_handle(CURLM* multi_handle, curl_context_t const& context, std::filesystem::path const& path,
+  auto curl_multi_add_handle(CURLM* multi_handle, curl_context_t const& context, download_t const& download,
       int index, download_process_t* process) -> std::variant<curl_handle_t, curl_wrapper_error>
   {
+    auto const& path = download.path;
+
     curl_handle_t handle;
-    bool success = handle.init(context.url, path);
+    bool success = download.output.has_value() ? handle.init(context.url) : handle.init(context.url, path);
     if(not success)
       return curl_wrapper_error{handle.errormsg(), context.url, path.c_str()};
     // else
 
-    curl_easy_setup(handle.get(), context, append_file, handle.m_fh);
+    // Reserve the blocks at once, so the file isn't fragmented by the parallel downloads.
+    // The size of the file stays (it's appended to), failing is fine (e.g. unsupported by the filesystem).
+    if(download.content_length > 0 and handle.m_fh != nullptr)
+      fallocate(fileno(handle.m_fh), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(download.content_length));
+
+    if(download.output.has_value())
+    {
+      std::remove(path.c_str()); // It only exists if the download isn't in the output.
+      handle.m_path = path;
+      handle.m_pwrite = std::make_unique<pwrite_sink_t>(context.output, std::get<1>(download.output.value()),
+          download.content_length, 0, handle.get());
+
+      curl_easy_setup(handle.get(), context, pwrite_file, handle.m_pwrite.get());
+    }
+    else if(download.aes128.has_value())
+    {
+      handle.m_decrypt = std::make_unique<decrypt_sink_t>(handle.m_fh, download.aes128.value());
+      if(not handle.m_decrypt->decrypter.ok())
+        return curl_wrapper_error{"Initialising decryption failed", context.url, path.c_str()};
+
+      curl_easy_setup(handle.get(), context, decrypt_file, handle.m_decrypt.get());
+    }
+    else
+      curl_easy_setup(handle.get(), context, append_file, handle.m_fh);
     curl_easy_setopt(handle.get(), CURLOPT_PRIVATE, index);
 
+    if(download.range.has_value())
+    {
+      auto const [offset, length] = download.range.value();
+      curl_easy_setopt(handle.get(), CURLOPT_RANGE, std::format("{}-{}", offset, offset + length - 1).c_str());
+    }
+
+    curl_easy_setopt(handle.get(), CURLOPT_HEADERDATA, handle.m_etag.get());
+    curl_easy_setopt(handle.get(), CURLOPT_HEADERFUNCTION, capture_etag);
+    if(not context.if_none_match.empty())
+    {
+      handle.m_headers = curl_slist_append(nullptr, std::format("If-None-Match: {}", context.if_none_match).c_str());
+      curl_easy_setopt(handle.get(), CURLOPT_HTTPHEADER, handle.m_headers);
+    }
+
     // ---
     curl_easy_setopt(handle.get(), CURLOPT_NOPROGRESS, 0);
     curl_easy_setopt(handle.get(), CURLOPT_XFERINFODATA, process);
@@ -455,7 +1211,78 @@ namespace
     return std::make_tuple(CURLE_OK, -1);
   }
 
-  auto verify_file(std::filesystem::path const& path, std::string const& url) -> std::optional<curl_wrapper_error>
+  auto transfer_timing(CURL* handle) -> timing_t
+  {
+    auto seconds = [handle](CURLINFO info)
+    {
+      curl_off_t microseconds = 0;
+      curl_easy_getinfo(handle, info, &microseconds);
+      return static_cast<double>(microseconds)/1e6;
+    };
+
+    timing_t timing;
+    timing.namelookup = seconds(CURLINFO_NAMELOOKUP_TIME_T);
+    timing.connect = seconds(CURLINFO_CONNECT_TIME_T);
+    timing.appconnect = seconds(CURLINFO_APPCONNECT_TIME_T);
+    timing.starttransfer = seconds(CURLINFO_STARTTRANSFER_TIME_T);
+    timing.total = seconds(CURLINFO_TOTAL_TIME_T);
+
+    curl_off_t bytes = 0;
+    curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+    timing.bytes = static_cast<size_t>(bytes);
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &timing.connects);
+
+    return timing;
+  }
+
+  void trace_transfer(trace_t& trace, int slot, std::string const& name, std::string const& category,
+      trace_t::clock::time_point begin, trace_t::clock::time_point end, CURL* handle, json_t::object_t args)
+  {
+    using namespace std::chrono;
+
+    timing_t const timing = transfer_timing(handle);
+    auto at = [begin, end](double seconds)
+    {
+      return std::min(begin + duration_cast<trace_t::clock::duration>(duration<double>{seconds}), end);
+    };
+
+    char* url = nullptr;
+    curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url);
+    if(url != nullptr)
+      args["url"] = url;
+    args["bytes"] = timing.bytes;
+    args["connects"] = static_cast<int64_t>(timing.connects);
+
+    int const pid = trace_t::transfers;
+    trace.span(name, category, pid, slot, begin, end, std::move(args));
+
+    double const connected = std::max(timing.connect, timing.appconnect);
+    if(connected > 0.0)
+      trace.span("connect", category, pid, slot, begin, at(connected));
+    if(timing.starttransfer > 0.0)
+    {
+      trace.span("wait", category, pid, slot, at(connected), at(timing.starttransfer));
+      trace.span("transfer", category, pid, slot, at(timing.starttransfer), at(timing.total));
+    }
+  }
+
+  void write_stats(std::filesystem::path const& path, curl_wrapper::results_t const& results, bool print)
+  {
+    json_t::object_t json = results.stats.json().as_object();
+    json["seconds"] = results.seconds;
+    json["errors"] = results.errors.size();
+
+    std::ofstream file{path, std::ios::app};
+    file << json_t{json}.str() << '\n';
+    if(file.fail())
+      std::cerr << std::format("Error: Couldn't write the statistics to {}!", path.string()) << std::endl;
+
+    if(print and results.stats.transfers() > 0)
+      std::cout << results.stats.str() << std::endl;
+  }
+
+  auto verify_file(std::filesystem::path const& path, std::string const& url,
+      std::optional<std::tuple<uint64_t, uint64_t>> const& range) -> std::optional<curl_wrapper_error>
   {
     std::error_code errc;
     auto const size = std::filesystem::file_size(path, errc);
@@ -463,6 +1290,15 @@ namespace
     if(errc)
       return curl_wrapper_error{errc.message(), url, path};
 
+    // A byte range can be small, but it's exactly its length (unless the server ignored the range).
+    if(range.has_value())
+    {
+      if(size != std::get<1>(range.value()))
+        return curl_wrapper_error{std::format("got {} bytes of a byte range of {}", size, std::get<1>(range.value())),
+          url, path};
+      return {};
+    }
+
     if(size <= 1'024) // 1 KB - too small something went wrong
     {
       // To small probably the server returned an error code like
@@ -481,6 +1317,13 @@ namespace
       // Maybe should just take the complete file-content instead of only a line.
       // Maybe only if it is <html> or text. Or only the html-part, I saw funny mixes.
       std::string line = "";
+
+      // A subtitle segment (WebVTT, with or without byte order mark) is small, but no error.
+      if(std::getline(file, line) and (line.starts_with("WEBVTT") or line.starts_with("\xEF\xBB\xBFWEBVTT")))
+        return {};
+      file.clear();
+      file.seekg(0);
+
       while(std::getline(file, line))
       {
         std::smatch results;
@@ -501,32 +1344,207 @@ namespace
     return {};
   }
 
+  auto verify_written(pwrite_sink_t const& sink, std::string const& url, std::filesystem::path const& path)
+    -> std::optional<curl_wrapper_error>
+  {
+    if(sink.written != sink.length)
+      return curl_wrapper_error{std::format("got {} bytes instead of {}", sink.written, sink.length), url, path};
+    return {};
+  }
+
+  auto check_free_space(std::vector<download_t> const& downloads, std::vector<size_t> const& lengths)
+    -> std::optional<curl_wrapper_error>
+  {
+    std::map<std::filesystem::path, size_t> needed = {}; // per directory
+    for(size_t i=0; i<downloads.size(); i++)
+    {
+      auto const directory = downloads[i].path.parent_path();
+      needed[directory.empty() ? "." : directory] += lengths[i];
+    }
+
+    for(auto const& [directory, bytes] : needed)
+    {
+      std::error_code errc;
+      auto const space = std::filesystem::space(directory, errc);
+      if(errc or space.available >= bytes) // unknown is fine, it shows while downloading
+        continue;
+
+      auto const [need, need_unit] = shorten_bytes(bytes);
+      auto const [available, available_unit] = shorten_bytes(static_cast<size_t>(space.available));
+      return curl_wrapper_error{std::format("Not enough free space in `{}': {:.1f} {} needed, {:.1f} {} available",
+          directory.string(), need, need_unit, available, available_unit)};
+    }
+
+    return {};
+  }
+
 } // namespace
 
-auto curl_wrapper::get_filename_from_url(std::string const& surl) -> std::string
+auto curl_wrapper::head_files(std::vector<download_t> const& downloads) const -> std::vector<head_t>
 {
-  char* cpath;
+  std::vector<head_t> heads(downloads.size());
+
+  std::shared_ptr<CURLM> multi_handle {curl_multi_init(),
+    [](CURLM* p) { curl_multi_cleanup(p); }};
+  if(multi_handle.get() == nullptr)
+    return heads;
+
+  std::vector<curl_handle_t> handles(downloads.size());
+  std::vector<byte_t> body = {}; // stays empty with CURLOPT_NOBODY, but curl_easy_setup() needs a sink
+
+  size_t i = 0;
+  int active_handles = 0;
+  size_t answered = 0;
+  size_t with_length = 0;
+  auto no_lengths = [&]() { return answered >= static_cast<size_t>(m_parallel) and with_length == 0; };
+
+  while(active_handles > 0 or (i < downloads.size() and not no_lengths()))
   {
-    CURLU *url = curl_url();
-    curl_url_set(url, CURLUPART_URL, surl.c_str(), 0);
+    while(active_handles < m_parallel and i < downloads.size() and not no_lengths())
+    {
+      size_t const index = i++;
+      auto const& download = downloads[index];
 
-    CURLUcode const rc = curl_url_get(url, CURLUPART_PATH, &cpath, 0);
+      if(download.range.has_value())
+      {
+        heads[index].content_length = std::get<1>(download.range.value());
+        continue;
+      }
 
-    curl_url_cleanup(url);
+      curl_handle_t handle;
+      if(not handle.init(download.url))
+        continue;
 
-    if(rc != CURLUE_OK)
-      return std::string {""};
-    // else
+      curl_context_t const context {download.url, m_useragent, m_verbose_flag, false, 0, m_share.get()};
+      curl_easy_setup(handle.get(), context, append_buffer, &body);
+      curl_easy_setopt(handle.get(), CURLOPT_NOBODY, 1L);
+      curl_easy_setopt(handle.get(), CURLOPT_PRIVATE, index);
+      curl_easy_setopt(handle.get(), CURLOPT_HEADERDATA, handle.m_etag.get());
+      curl_easy_setopt(handle.get(), CURLOPT_HEADERFUNCTION, capture_etag);
+
+      if(::curl_multi_add_handle(multi_handle.get(), handle.get()) != CURLM_OK)
+        continue;
+
+      handles[index] = std::move(handle);
+      active_handles++;
+    }
+
+    if(curl_multi_perform(multi_handle.get(), &active_handles) != CURLM_OK)
+      break;
+
+    int msgs_in_queue = 0;
+    while(CURLMsg* msg = curl_multi_info_read(multi_handle.get(), &msgs_in_queue))
+    {
+      auto const [errorcode, index] = curl_multi_handle_message(multi_handle.get(), msg);
+      curl_handle_t handle = std::move(handles[index]);
+      answered++;
+
+      long status = 0;
+      curl_off_t length = -1;
+      curl_easy_getinfo(handle.get(), CURLINFO_RESPONSE_CODE, &status);
+      curl_easy_getinfo(handle.get(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+
+      // The status is 0 for file://-urls.
+      if(errorcode != CURLE_OK or status >= 300 or length <= 0)
+        continue;
+
+      heads[index] = head_t{static_cast<size_t>(length), *handle.m_etag};
+      with_length++;
+    }
+
+    if(curl_multi_wait(multi_handle.get(), nullptr, 0, 100, nullptr) != CURLM_OK)
+      break;
   }
 
-  std::string const path{cpath};
-  curl_free(cpath);
+  if(no_lengths() and m_verbose_flag)
+    messages() << "No Content-Length in the HEAD-responses, skip the preflight" << std::endl;
+
+  return heads;
+}
+
+auto curl_wrapper::run_preflight(std::vector<download_t> const& downloads)
+  -> std::tuple<std::vector<size_t>, std::optional<size_t>>
+{
+  std::vector<size_t> lengths(downloads.size(), 0);
+
+  // No need to ask for the downloads that are fresh in the cache or whose length is known.
+  std::vector<size_t> asked = {};
+  std::vector<download_t> to_ask = {};
+  std::vector<std::string> cache_keys(downloads.size());
+  for(size_t index=0; index<downloads.size(); index++)
+  {
+    auto const& download = downloads[index];
+    if(m_cache != nullptr)
+    {
+      cache_keys[index] = segment_cache_t::make_key(download.url, download.aes128, download.range);
+      auto const entry = m_cache->lookup(cache_keys[index]);
+      if(entry.has_value() and segment_cache_t::is_fresh(entry.value()))
+        continue;
+    }
+
+    if(download.content_length > 0) // known already
+    {
+      lengths[index] = download.content_length;
+      continue;
+    }
+
+    asked.push_back(index);
+    to_ask.push_back(download);
+  }
+
+  auto const heads = head_files(to_ask);
+
+  bool complete = true;
+  for(size_t k=0; k<asked.size(); k++)
+  {
+    size_t const index = asked[k];
+    auto const& head = heads[k];
+
+    // The same ETag, so the cached version is still valid, which spares the conditional request.
+    auto const entry = m_cache != nullptr ? m_cache->lookup(cache_keys[index]) : std::nullopt;
+    if(entry.has_value() and not entry->etag.empty() and entry->etag == head.etag)
+    {
+      m_cache->revalidated(cache_keys[index]);
+      continue;
+    }
+
+    lengths[index] = head.content_length;
+    if(head.content_length == 0)
+      complete = false;
+  }
 
-  std::smatch match;
-  if(not std::regex_match(path, match, std::regex {".*/([-\\w]+(.\\w+)?)$"}))
+  if(not complete)
+    return std::make_tuple(lengths, std::nullopt);
+  return std::make_tuple(lengths, std::accumulate(lengths.begin(), lengths.end(), size_t{0}));
+}
+
+/**
+ * The filename is the last segment of the url-path, if it looks like a filename
+ * i.e. it is of the form "[-\w]+(\.\w+)?" e.g. "segment-1.ts".
+ */
+auto curl_wrapper::get_filename_from_url(std::string const& surl) -> std::string
+{
+  url_t const url = parse_url(surl);
+
+  auto const pos = url.path.rfind('/');
+  if(pos == std::string::npos)
     return std::string {""};
   // else
-  return match[1].str();
+
+  std::string_view const filename = std::string_view{url.path}.substr(pos+1);
+
+  auto is_word = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) or c == '_'; };
+
+  auto const dot = filename.find('.');
+  std::string_view const stem = filename.substr(0, dot);
+  std::string_view const extension = dot != std::string::npos ? filename.substr(dot+1) : "";
+
+  if(stem.empty() or not std::ranges::all_of(stem, [&](char c) { return is_word(c) or c == '-'; }))
+    return std::string {""};
+  if(dot != std::string::npos and (extension.empty() or not std::ranges::all_of(extension, is_word)))
+    return std::string {""};
+  // else
+  return std::string {filename};
 }
 
 // ---
@@ -551,10 +1569,86 @@ namespace
     return buffer->size() - size_old;
   }
 
+  //! Decrypts the received bytes straight into the file, so there is no extra pass over the data.
+  auto decrypt_file(curl_wrapper::byte_t* ptr, size_t size, size_t nmemb, void* userdata) -> size_t
+  {
+    auto sink = reinterpret_cast<decrypt_sink_t*>(userdata);
+
+    constexpr size_t CHUNKSIZE = CURL_MAX_WRITE_SIZE;
+    std::array<uint8_t, CHUNKSIZE + aes128_decrypter_t::BLOCKSIZE> buffer;
+
+    auto const in = reinterpret_cast<uint8_t const*>(ptr);
+    size_t const len = size*nmemb;
+
+    for(size_t done = 0; done < len; done += CHUNKSIZE)
+    {
+      size_t const chunk = std::min(len - done, CHUNKSIZE);
+
+      auto const decrypted = sink->decrypter.update(in + done, chunk, buffer.data());
+      if(not decrypted.has_value())
+        return 0; // Signals an error to libcurl.
+
+      if(fwrite(buffer.data(), 1, decrypted.value(), sink->fh) != decrypted.value())
+        return 0;
+    }
+
+    return len;
+  }
+
+  //! Writes the received bytes at their place into the output (see download_t::output), no buffering or copying.
+  //! More than the expected length, an error-response or a PNG fake-header (see check_and_remove_pngfakeheader())
+  //! fail the transfer, so it's downloaded to its own file instead.
+  auto pwrite_file(curl_wrapper::byte_t* ptr, size_t size, size_t nmemb, void* userdata) -> size_t
+  {
+    auto sink = reinterpret_cast<pwrite_sink_t*>(userdata);
+    size_t const len = size*nmemb;
+
+    if(sink->written == 0)
+    {
+      long status = 0;
+      curl_easy_getinfo(sink->handle, CURLINFO_RESPONSE_CODE, &status);
+      bool const is_png = len >= 4 and std::memcmp(ptr, "\x89PNG", 4) == 0;
+      if(status >= 300 or is_png)
+        return 0; // Signals an error to libcurl.
+    }
+
+    if(sink->written + len > sink->length)
+      return 0;
+
+    for(size_t done = 0; done < len;)
+    {
+      auto const offset = static_cast<off_t>(sink->offset + sink->written + done);
+      ssize_t const n = pwrite(sink->fd, ptr + done, len - done, offset);
+      if(n == -1 and errno == EINTR)
+        continue;
+      if(n <= 0)
+        return 0;
+      done += static_cast<size_t>(n);
+    }
+
+    sink->written += len;
+    return len;
+  }
+
+  //! Keeps the ETag of the (last) response for the cache, the header-lines arrive one by one.
+  auto capture_etag(char* buffer, size_t size, size_t nitems, void* userdata) -> size_t
+  {
+    auto etag = reinterpret_cast<std::string*>(userdata);
+    std::string_view const line{buffer, size*nitems};
+
+    if(line.starts_with("HTTP/")) // a new response e.g. after a redirect
+      etag->clear();
+    else if(line.size() > 5 and strncasecmp(line.data(), "etag:", 5) == 0)
+      *etag = trim(std::string{line.substr(5)});
+
+    return size*nitems;
+  }
+
   int progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
   {
     download_process_t* process = static_cast<download_process_t*>(clientp);
-    process->update(dltotal, dlnow);
+    if(process != nullptr) // nullptr for hedges
+      process->update(dltotal, dlnow);
     return 0;
   }
 } // namespace
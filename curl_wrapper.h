@@ -1,11 +1,25 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
 #pragma once
 #include <cassert>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <iostream> // std::cout, std::cerr
+#include <memory> // std::shared_ptr
+#include <optional>
 #include <string>
+#include <tuple>
 #include <variant>
 #include <vector>
 
+#include "aes128.h"
+#include "cache.h"
+#include "mirror.h"
+#include "profiler.h"
+#include "progressmeter.h" // progress_format_t
+#include "stats.h"
+#include "trace.h"
+
 /**
  */
 class curl_wrapper_error
@@ -56,10 +70,74 @@ class curl_wrapper
     using byte_t = char;
     using pathurl_t = std::tuple<std::filesystem::path, std::string>;
 
+    //! A single download of download_files().
+    struct download_t
+    {
+      std::filesystem::path path;
+      std::string url;
+
+      //! Decrypt the download while it arrives (#EXT-X-KEY:METHOD=AES-128).
+      std::optional<aes128_t> aes128 = {};
+
+      //! The same content at other urls (e.g. on another CDN), ordered by priority.
+      //! download_files() picks the url with the healthiest host and fails over to the others.
+      std::vector<std::string> mirrors = {};
+
+      //! The expected size in bytes (0 if unknown) e.g. from the runtime and bandwidth, see largest_first().
+      size_t predicted_bytes = 0;
+
+      //! Only the bytes (offset, length) of the url (HTTP Range e.g. of #EXT-X-BYTERANGE), otherwise all of it.
+      std::optional<std::tuple<uint64_t, uint64_t>> range = {};
+
+      //! The exact size in bytes (0 if unknown) e.g. by a HEAD-request, the file is preallocated with it.
+      size_t content_length = 0;
+
+      //! Write the download right into this file at the offset (pwrite), instead of to path,
+      //! e.g. all parts of a playlist into one file. Needs the content_length and is ignored
+      //! for decrypted downloads and with a cache. If the length turns out to be wrong, the transfer fails
+      //! or it starts with a PNG fake-header (see pngfakeheader.h), it's downloaded to path after all.
+      //! So an existing path tells the download isn't in the file.
+      std::optional<std::tuple<std::filesystem::path, uint64_t>> output = {};
+    };
+
+    //! What a HEAD-request tells about a download, see head_files().
+    struct head_t
+    {
+      size_t content_length = 0; // 0 if unknown
+      std::string etag = "";
+    };
+
+    //! What download_files() knows about a finished download.
+    struct transfer_t
+    {
+      size_t bytes = 0;     // downloaded bytes
+      double seconds = 0.0; // duration of the transfer
+      bool succeeded = false;
+    };
+
+    //! Hooks into download_files().
+    struct hooks_t
+    {
+      //! Called before the download with the index is started, it may change the download (e.g. to another variant).
+      std::function<void(size_t index, download_t& download)> on_start = {};
+      //! Called after the download with the index is finished (successful or not).
+      std::function<void(size_t index, transfer_t const& transfer)> on_finish = {};
+      //! Called regularly for the running and waiting downloads, returning true cancels the download.
+      std::function<bool(size_t index)> is_canceled = {};
+      //! Called when the watermark grows: The number of downloads at the beginning that are all finished
+      //! (successful or not) e.g. 3 when the downloads 0, 1 and 2 are finished.
+      std::function<void(size_t watermark)> on_watermark = {};
+    };
+
     struct results_t
     {
       std::vector<std::filesystem::path> succeeded_files;
       std::vector<curl_wrapper_error> errors;
+
+      double seconds = 0.0; // makespan of the downloads
+      std::optional<double> predicted_seconds = {}; // from the predicted sizes, see predict_makespan()
+
+      transfer_stats_t stats = {}; // of all finished transfers (hedges and failed ones included)
     };
 
   public:
@@ -68,7 +146,7 @@ class curl_wrapper
       : curl_wrapper("curl_wrapper/0.6")
     {}
     explicit curl_wrapper(std::string const& useragent)
-      : m_useragent(useragent)
+      : m_useragent(useragent), m_share(make_share())
     {}
 
     curl_wrapper(curl_wrapper const&) = default;
@@ -90,9 +168,16 @@ class curl_wrapper
     auto download_buffer(std::string const& url) const
       -> std::variant<std::vector<byte_t>, curl_wrapper_error>;
 
-    //! Downloads a bunch of urls to paths.
+    //! Downloads a bunch of urls to paths (parallel() at a time).
     //! The order of files in the results can differ from pathurls, beside that errors can occurre.
     auto download_files(std::vector<pathurl_t> const pathurls) -> results_t;
+    auto download_files(std::vector<download_t> const& downloads) -> results_t;
+    auto download_files(std::vector<download_t> const& downloads, hooks_t const& hooks) -> results_t;
+
+    //! HEAD-requests for the downloads (parallel() at a time, over the shared connections).
+    //! A byte range isn't requested, its length is known. When the first responses have no Content-Length,
+    //! the servers don't send it and the rest is skipped.
+    auto head_files(std::vector<download_t> const& downloads) const -> std::vector<head_t>;
 
     static auto get_filename_from_url(std::string const& url) -> std::string;
 
@@ -110,6 +195,92 @@ class curl_wrapper
       return m_useragent;
     }
 
+    //! Number of parallel transfers of download_files().
+    void parallel(int n)
+    {
+      assert(n > 0);
+      m_parallel = n;
+    }
+
+    auto parallel() const -> int
+    {
+      return m_parallel;
+    }
+
+    //! Bandwidth budget in bytes/s, which is split evenly between the parallel transfers.
+    void max_speed(size_t bytes_per_second)
+    {
+      assert(bytes_per_second > 0);
+      m_max_speed = bytes_per_second;
+    }
+
+    auto max_speed() const -> size_t
+    {
+      return m_max_speed;
+    }
+
+    //! Extra bytes for hedging stragglers in download_files() as fraction of the downloaded bytes (0 disables it).
+    void hedge_budget(double budget)
+    {
+      assert(budget >= 0.0);
+      m_hedge_budget = budget;
+    }
+
+    auto hedge_budget() const -> double
+    {
+      return m_hedge_budget;
+    }
+
+    //! Playback order in download_files() (0 disables it): Downloads are only started within the window
+    //! of n downloads from the watermark (see hooks_t::on_watermark) and the ones in the far half of the window
+    //! are paused until the watermark catches up. So the beginning is complete early, e.g. for a preview,
+    //! and the free slots go to failovers and hedges of the downloads holding up the watermark.
+    void playback_window(size_t n)
+    {
+      m_playback_window = n;
+    }
+
+    auto playback_window() const -> size_t
+    {
+      return m_playback_window;
+    }
+
+    //! Start the downloads in download_files() by their predicted size, largest first (see lpt_order()),
+    //! instead of in their order. Not together with playback_window().
+    void largest_first(bool flag)
+    {
+      m_largest_first = flag;
+    }
+
+    auto largest_first() const -> bool
+    {
+      return m_largest_first;
+    }
+
+    //! Take the downloads of download_files() from the cache (nullptr disables it) and store them there.
+    void cache(std::shared_ptr<segment_cache_t> cache)
+    {
+      m_cache = std::move(cache);
+    }
+
+    auto cache() const -> std::shared_ptr<segment_cache_t>
+    {
+      return m_cache;
+    }
+
+    //! Preflight of download_files(): HEAD-requests for all downloads first (see head_files()), to know the
+    //! exact total for the progressmeter and the largest_first() order, to fail early when the free space
+    //! isn't enough and to preallocate the files. Revalidates the cache by the ETags as well.
+    void preflight(bool flag)
+    {
+      m_preflight = flag;
+    }
+
+    auto preflight() const -> bool
+    {
+      return m_preflight;
+    }
+
     void set_verbose()    { m_verbose_flag = true; }
     void clear_verbose()  { m_verbose_flag = false; }
     bool verbose() const  { return m_verbose_flag; }
@@ -118,11 +289,102 @@ class curl_wrapper
     void clear_default_progressmeter() { m_default_progressmeter = false; }
     bool default_progressmeter() const { return m_default_progressmeter; }
 
+    //! Append the timing statistics (see transfer_stats_t::json()) of every download_files()-run as a line
+    //! to the file (empty disables it), and print them as table (with the terminal progress format).
+    void stats_file(std::filesystem::path const& path)
+    {
+      m_stats_file = path;
+    }
+
+    auto stats_file() const -> std::filesystem::path const&
+    {
+      return m_stats_file;
+    }
+
+    //! How the progressmeter of download_files() prints and how often (see progressmeter_t::print()).
+    void progress_format(progress_format_t format)
+    {
+      m_progress_format = format;
+    }
+
+    auto progress_format() const -> progress_format_t
+    {
+      return m_progress_format;
+    }
+
+    void progress_interval(std::chrono::milliseconds interval)
+    {
+      assert(interval.count() > 0);
+      m_progress_interval = interval;
+    }
+
+    auto progress_interval() const -> std::chrono::milliseconds
+    {
+      return m_progress_interval;
+    }
+
+    //! Where to print messages: stdout, but stderr if the progress is printed there as JSON-lines.
+    auto messages() const -> std::ostream&
+    {
+      return m_progress_format == progress_format_t::json ? std::cerr : std::cout;
+    }
+
+    //! Record the transfers of download_files() into the trace (nullptr disables it): on one track per
+    //! handle slot the connecting, waiting for the first byte, transfer, writing and verifying of each download
+    //! and the time it was queued.
+    void trace(std::shared_ptr<trace_t> trace)
+    {
+      m_trace = std::move(trace);
+    }
+
+    auto trace() const -> std::shared_ptr<trace_t>
+    {
+      return m_trace;
+    }
+
+    //! The jobs downloading with this curl_wrapper add their phases to the profiler (nullptr disables it).
+    void profiler(std::shared_ptr<profiler_t> profiler)
+    {
+      m_profiler = std::move(profiler);
+    }
+
+    auto profiler() const -> std::shared_ptr<profiler_t>
+    {
+      return m_profiler;
+    }
+
 
   private:
 
+    //! DNS-cache, TLS-sessions and connections are shared by all downloads (and copies of the curl_wrapper).
+    static auto make_share() -> std::shared_ptr<void>;
+
+    //! The exact sizes of the downloads by the preflight (0 if unknown or taken from the cache)
+    //! and their sum, if all are known.
+    auto run_preflight(std::vector<download_t> const& downloads)
+      -> std::tuple<std::vector<size_t>, std::optional<size_t>>;
+
     std::string m_useragent;
     bool m_verbose_flag = false;
     bool m_default_progressmeter = false;
+    progress_format_t m_progress_format = progress_format_t::terminal;
+    std::chrono::milliseconds m_progress_interval{1'000};
+    std::filesystem::path m_stats_file = "";
+
+    int m_parallel = 5;
+    size_t m_max_speed = 5*1'024*1'024; // 1 MB/s per transfer
+    double m_hedge_budget = 0.1;
+    size_t m_playback_window = 0;
+    bool m_largest_first = false;
+    bool m_preflight = false;
+
+    std::shared_ptr<void> m_share = nullptr; // CURLSH
+
+    //! Health of the hosts, shared like the connections.
+    std::shared_ptr<host_health_t> m_health = std::make_shared<host_health_t>();
+
+    std::shared_ptr<segment_cache_t> m_cache = nullptr;
+    std::shared_ptr<trace_t> m_trace = nullptr;
+    std::shared_ptr<profiler_t> m_profiler = nullptr;
 };
 
@@ -0,0 +1,180 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+#include "curl_wrapper.h"
+
+//! Downloads of local files (file://) into a temporary directory.
+class curl_wrapper_tests : public testing::Test
+{
+protected:
+
+  void SetUp() override
+  {
+    curl_wrapper::init();
+
+    m_dir = std::filesystem::temp_directory_path() / std::format("curl_wrapper_test-{}", getpid());
+    std::filesystem::create_directories(m_dir / "src");
+    for(size_t i=0; i<count; i++)
+    {
+      std::ofstream file{m_dir / "src" / std::format("{}.ts", i)};
+      file << std::string(2'048, static_cast<char>('a' + i)); // bigger than an error page
+      m_downloads.push_back({m_dir / std::format("{}.ts", i), std::format("file://{}/src/{}.ts", m_dir.string(), i)});
+    }
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(m_dir);
+    curl_wrapper::cleanup();
+  }
+
+  static constexpr size_t count = 12;
+
+  std::filesystem::path m_dir = "";
+  std::vector<curl_wrapper::download_t> m_downloads = {};
+};
+
+TEST_F(curl_wrapper_tests, download_files)
+{
+  curl_wrapper curl;
+  auto const results = curl.download_files(m_downloads);
+
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), count);
+  EXPECT_EQ(std::filesystem::file_size(m_downloads.back().path), 2'048);
+}
+
+TEST_F(curl_wrapper_tests, playback_window)
+{
+  curl_wrapper curl;
+  curl.parallel(4);
+  curl.playback_window(3);
+
+  size_t watermark = 0;
+  std::vector<size_t> watermarks = {};
+  bool within_window = true;
+
+  curl_wrapper::hooks_t hooks = {};
+  hooks.on_start = [&](size_t index, curl_wrapper::download_t&)
+  {
+    within_window = within_window and index < watermark + 3;
+  };
+  hooks.on_watermark = [&](size_t n)
+  {
+    watermark = n;
+    watermarks.push_back(n);
+  };
+
+  auto const results = curl.download_files(m_downloads, hooks);
+
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), count);
+  EXPECT_TRUE(within_window);
+  ASSERT_FALSE(watermarks.empty());
+  EXPECT_TRUE(std::ranges::is_sorted(watermarks));
+  EXPECT_EQ(watermarks.back(), count);
+}
+
+TEST_F(curl_wrapper_tests, largest_first)
+{
+  for(size_t i=0; i<count; i++)
+    m_downloads[i].predicted_bytes = i % 3 == 0 ? 100 : 10;
+
+  curl_wrapper curl;
+  curl.parallel(2);
+  curl.largest_first(true);
+
+  std::vector<size_t> started = {};
+  curl_wrapper::hooks_t hooks = {};
+  hooks.on_start = [&](size_t index, curl_wrapper::download_t&)
+  {
+    started.push_back(index);
+  };
+
+  auto const results = curl.download_files(m_downloads, hooks);
+
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(started, (std::vector<size_t>{0, 3, 6, 9, 1, 2, 4, 5, 7, 8, 10, 11}));
+  EXPECT_TRUE(results.predicted_seconds.has_value());
+}
+
+TEST_F(curl_wrapper_tests, cache)
+{
+  curl_wrapper curl;
+  curl.cache(std::make_shared<segment_cache_t>(m_dir / "cache", 1'024*1'024));
+
+  auto results = curl.download_files(m_downloads);
+  ASSERT_TRUE(results.errors.empty());
+
+  // The second time they come from the cache.
+  std::filesystem::remove_all(m_dir / "src");
+  for(auto const& download : m_downloads)
+    std::filesystem::remove(download.path);
+
+  results = curl.download_files(m_downloads);
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), count);
+  EXPECT_EQ(std::filesystem::file_size(m_downloads.front().path), 2'048);
+}
+
+TEST_F(curl_wrapper_tests, preflight)
+{
+  std::ofstream{m_dir / "src" / "5.ts"} << std::string(4'096, 'x');
+  m_downloads[7].range = std::make_tuple(0, 1'500);
+
+  curl_wrapper curl;
+  auto const heads = curl.head_files(m_downloads);
+  ASSERT_EQ(heads.size(), count);
+  EXPECT_EQ(heads[0].content_length, 2'048);
+  EXPECT_EQ(heads[5].content_length, 4'096);
+  EXPECT_EQ(heads[7].content_length, 1'500);
+
+  // By their exact sizes the largest is started first.
+  curl.parallel(2);
+  curl.largest_first(true);
+  curl.preflight(true);
+
+  std::vector<size_t> started = {};
+  curl_wrapper::hooks_t hooks = {};
+  hooks.on_start = [&](size_t index, curl_wrapper::download_t&)
+  {
+    started.push_back(index);
+  };
+
+  auto const results = curl.download_files(m_downloads, hooks);
+
+  EXPECT_TRUE(results.errors.empty());
+  ASSERT_FALSE(started.empty());
+  EXPECT_EQ(started.front(), 5);
+  EXPECT_EQ(std::filesystem::file_size(m_downloads[5].path), 4'096);
+}
+
+TEST_F(curl_wrapper_tests, output)
+{
+  auto const output = m_dir / "all.ts";
+  for(size_t i=0; i<count; i++)
+  {
+    m_downloads[i].content_length = 2'048;
+    m_downloads[i].output = std::make_tuple(output, i*2'048);
+  }
+  m_downloads[4].content_length = 1'000; // wrong, so it's downloaded to its own file
+
+  curl_wrapper curl;
+  curl.parallel(4);
+  auto const results = curl.download_files(m_downloads);
+
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), count);
+  EXPECT_FALSE(std::filesystem::exists(m_downloads[3].path));
+  EXPECT_EQ(std::filesystem::file_size(m_downloads[4].path), 2'048);
+
+  std::ifstream file{output, std::ios::binary};
+  std::string const content{std::istreambuf_iterator<char>{file}, {}};
+  ASSERT_EQ(content.size(), count*2'048);
+  EXPECT_EQ(content.substr(3*2'048, 2'048), std::string(2'048, 'd'));
+  EXPECT_EQ(content.substr(11*2'048, 2'048), std::string(2'048, 'l'));
+}
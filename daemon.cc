@@ -0,0 +1,924 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>  // sigaction()
+#include <cstdlib>  // std::getenv()
+#include <cstring>  // strncpy
+#include <format>
+#include <iostream>
+#include <list>
+#include <memory> // std::shared_ptr
+#include <system_error> // std::error_code
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h> // umask()
+#include <sys/un.h>
+#include <unistd.h>   // close(), getuid()
+
+#include "daemon.h"
+
+auto default_socket_path() -> std::filesystem::path
+{
+  char const* const runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if(runtime_dir != nullptr and runtime_dir[0] != '\0')
+    return std::filesystem::path{runtime_dir} / "curl_m3u8.sock";
+
+  return std::format("/tmp/curl_m3u8-{}.sock", getuid());
+}
+
+auto numbered_path(std::filesystem::path const& path, size_t number) -> std::filesystem::path
+{
+  return path.parent_path() / std::format("{}-{}{}", path.stem().string(), number, path.extension().string());
+}
+
+auto to_string(job_registry_t::state_t state) -> std::string
+{
+  switch(state)
+  {
+    case job_registry_t::state_t::queued:      return "queued";
+    case job_registry_t::state_t::preparing:   return "preparing";
+    case job_registry_t::state_t::downloading: return "downloading";
+    case job_registry_t::state_t::done:        return "done";
+    case job_registry_t::state_t::failed:      return "failed";
+    case job_registry_t::state_t::canceled:    return "canceled";
+  }
+  return "";
+}
+
+static auto is_finished(job_registry_t::state_t state) -> bool
+{
+  return state == job_registry_t::state_t::done or state == job_registry_t::state_t::failed
+    or state == job_registry_t::state_t::canceled;
+}
+
+auto to_json(job_registry_t::entry_t const& entry) -> json_t
+{
+  json_t::object_t job = {
+    {"id", entry.id},
+    {"url", entry.spec.url},
+    {"name", entry.spec.name},
+    {"state", to_string(entry.state)},
+    {"finished", entry.finished},
+    {"ready", entry.ready},
+    {"total", entry.total},
+  };
+  if(not entry.error.empty())
+    job["error"] = entry.error;
+
+  return job;
+}
+
+auto parse_submit(json_t const& request) -> std::variant<jobspec_t, std::string>
+{
+  jobspec_t spec;
+
+  auto const url = request.get_string("url");
+  auto const name = request.get_string("name");
+  if(not url.has_value() or url->empty())
+    return "A submit needs an url";
+  if(not name.has_value() or name->empty())
+    return "A submit needs a name";
+  spec.url = url.value();
+  spec.name = name.value();
+
+  if(request.get("pick").has_value())
+  {
+    auto const pick = request.get_string("pick");
+    auto const policy = parse_variant_policy(pick.value_or(""));
+    if(not policy.has_value())
+      return std::format("Unknown pick-policy `{}'", pick.value_or(""));
+    if(policy.value() == variant_policy_t::ask)
+      return "The pick-policy ask isn't possible in a daemon";
+    spec.variant_policy = policy.value();
+  }
+
+  if(request.get("deadline").has_value())
+  {
+    auto const deadline = request.get_number("deadline");
+    if(not deadline.has_value() or deadline.value() <= 0.0)
+      return "The deadline must be a positive number of seconds";
+    spec.deadline = deadline.value();
+  }
+
+  if(auto const adaptive = request.get("adaptive"); adaptive.has_value())
+  {
+    if(not adaptive->is_bool())
+      return "Adaptive must be true or false";
+    spec.adaptive = adaptive->as_bool();
+  }
+
+  if(auto const one_file = request.get("one_file"); one_file.has_value())
+  {
+    if(not one_file->is_bool())
+      return "One_file must be true or false";
+    spec.one_file = one_file->as_bool();
+  }
+
+  if(request.get("preview").has_value())
+  {
+    auto const preview = parse_preview(request.get_string("preview").value_or(""));
+    if(not preview.has_value())
+      return "The preview must be keyframes or thumbnails";
+    spec.preview = preview.value();
+  }
+
+  // The time range as on the command line.
+  for(std::string const key : {"from", "to"})
+  {
+    if(not request.get(key).has_value())
+      continue;
+
+    auto const position = parse_position(request.get_string(key).value_or(""));
+    if(not position.has_value())
+      return std::format("The {} must be a time like \"1:30:00\" or a date-time", key);
+    (key == "from" ? spec.from : spec.to) = position.value();
+  }
+
+  return spec;
+}
+
+// ---
+
+auto job_registry_t::handle(json_t const& request) -> json_t
+{
+  auto error = [](std::string const& message) -> json_t
+  {
+    return json_t::object_t{{"ok", false}, {"error", message}};
+  };
+
+  auto const cmd = request.get_string("cmd");
+  if(not cmd.has_value())
+    return error("Expected an object with a cmd");
+
+  if(cmd.value() == "submit")
+  {
+    auto const spec_error = parse_submit(request);
+    if(std::holds_alternative<std::string>(spec_error))
+      return error(std::get<std::string>(spec_error));
+
+    size_t const id = submit(std::get<jobspec_t>(spec_error));
+    return json_t::object_t{{"ok", true}, {"id", id}};
+  }
+  else if(cmd.value() == "list")
+  {
+    auto const [entries, version] = changes(0);
+
+    json_t::array_t jobs = {};
+    for(auto const& entry : entries)
+      jobs.push_back(to_json(entry));
+    return json_t::object_t{{"ok", true}, {"jobs", std::move(jobs)}};
+  }
+  else if(cmd.value() == "status" or cmd.value() == "cancel")
+  {
+    auto const id = request.get_number("id");
+    if(not id.has_value() or id.value() < 1.0)
+      return error(std::format("A {} needs the id of a job", cmd.value()));
+
+    if(cmd.value() == "cancel")
+    {
+      auto const cancel_error = cancel(static_cast<size_t>(id.value()));
+      if(cancel_error.has_value())
+        return error(cancel_error.value());
+      return json_t::object_t{{"ok", true}};
+    }
+
+    auto const entry = find(static_cast<size_t>(id.value()));
+    if(not entry.has_value())
+      return error(std::format("There is no job {}", id.value()));
+    return json_t::object_t{{"ok", true}, {"job", to_json(entry.value())}};
+  }
+
+  return error(std::format("Unknown cmd `{}'", cmd.value()));
+}
+
+auto job_registry_t::submit(jobspec_t const& spec) -> size_t
+{
+  std::lock_guard lock{m_mutex};
+
+  size_t const id = m_next_id++;
+  auto& entry = m_entries[id];
+  entry.id = id;
+  entry.spec = spec;
+  touch(entry);
+
+  m_queued.notify_one();
+  return id;
+}
+
+auto job_registry_t::cancel(size_t id) -> std::optional<std::string>
+{
+  std::lock_guard lock{m_mutex};
+
+  auto it = m_entries.find(id);
+  if(it == m_entries.end())
+    return std::format("There is no job {}", id);
+
+  auto& entry = it->second;
+  if(is_finished(entry.state))
+    return std::format("The job {} is already {}", id, to_string(entry.state));
+
+  entry.cancel = true;
+  if(entry.state == state_t::queued)
+    entry.state = state_t::canceled;
+  touch(entry);
+
+  return {};
+}
+
+auto job_registry_t::is_canceled(size_t id) const -> bool
+{
+  std::lock_guard lock{m_mutex};
+
+  auto it = m_entries.find(id);
+  return it != m_entries.end() and it->second.cancel;
+}
+
+auto job_registry_t::find(size_t id) const -> std::optional<entry_t>
+{
+  std::lock_guard lock{m_mutex};
+
+  auto it = m_entries.find(id);
+  if(it == m_entries.end())
+    return {};
+  return it->second;
+}
+
+auto job_registry_t::take_queued() -> std::vector<entry_t>
+{
+  std::unique_lock lock{m_mutex};
+
+  std::vector<entry_t> queued = {};
+  m_queued.wait(lock, [this, &queued]()
+  {
+    if(m_stopped)
+      return true;
+
+    for(auto& [id, entry] : m_entries)
+    {
+      if(entry.state != state_t::queued)
+        continue;
+
+      entry.state = state_t::preparing;
+      touch(entry);
+      queued.push_back(entry);
+    }
+    return not queued.empty();
+  });
+
+  return queued;
+}
+
+void job_registry_t::set_state(size_t id, state_t state, std::string const& error)
+{
+  std::lock_guard lock{m_mutex};
+
+  auto& entry = m_entries.at(id);
+  entry.state = state;
+  entry.error = error;
+  touch(entry);
+}
+
+void job_registry_t::set_progress(size_t id, size_t finished, size_t ready, size_t total)
+{
+  std::lock_guard lock{m_mutex};
+
+  auto& entry = m_entries.at(id);
+  entry.finished = finished;
+  entry.ready = ready;
+  entry.total = total;
+  touch(entry);
+}
+
+void job_registry_t::stop()
+{
+  std::lock_guard lock{m_mutex};
+
+  m_stopped = true;
+  for(auto& [id, entry] : m_entries)
+  {
+    if(is_finished(entry.state))
+      continue;
+
+    entry.cancel = true;
+    if(entry.state == state_t::queued)
+      entry.state = state_t::canceled;
+    touch(entry);
+  }
+
+  m_queued.notify_all();
+}
+
+auto job_registry_t::changes(size_t since) const -> std::tuple<std::vector<entry_t>, size_t>
+{
+  std::lock_guard lock{m_mutex};
+
+  std::vector<entry_t> changed = {};
+  for(auto const& [id, entry] : m_entries)
+  {
+    if(entry.version > since)
+      changed.push_back(entry);
+  }
+
+  return {changed, m_version};
+}
+
+void job_registry_t::touch(entry_t& entry)
+{
+  entry.version = ++m_version;
+}
+
+// ---
+
+//! The error of a job as a single line for the protocol.
+static auto describe_error(std::exception_ptr error) -> std::string
+{
+  auto describe = [](curl_wrapper_error const& error)
+  {
+    if(not error.filename().empty())
+      return std::format("{} while downloading {} to {}", error.what(), error.url(), error.filename());
+    return std::format("{} while downloading {}", error.what(), error.url());
+  };
+
+  try
+  {
+    std::rethrow_exception(error);
+  }
+  catch(curl_wrapper_error const& error)
+  {
+    return describe(error);
+  }
+  catch(std::vector<curl_wrapper_error> const& errors)
+  {
+    std::string message = "";
+    for(auto const& error : errors)
+      message += (message.empty() ? "" : "; ") + describe(error);
+    return message;
+  }
+  catch(m3u8_errc const& error)
+  {
+    if(error == m3u8_errc::unsupported_encryption)
+      return "The m3u8-file uses an unsupported encryption method";
+    return "Url is not a m3u8-file";
+  }
+  catch(std::exception const& error) // includes std::filesystem::filesystem_error
+  {
+    return error.what();
+  }
+  catch(...)
+  {
+  }
+
+  return "Unknown error";
+}
+
+//! Prepares and downloads a batch of queued jobs. With recorders the batch has a trace and profiler of its own,
+//! written at the end to the files numbered by its first job.
+static void download_batch(curl_wrapper curl, job_registry_t& registry,
+    std::vector<job_registry_t::entry_t> const& queued, size_t muxers, daemon_recorders_t const& recorders)
+{
+  using state_t = job_registry_t::state_t;
+
+  auto const trace = recorders.trace_file.empty() ? nullptr : std::make_shared<trace_t>();
+  auto const profiler = recorders.profile_flag ? std::make_shared<profiler_t>() : nullptr;
+  curl.trace(trace);
+  curl.profiler(profiler);
+
+  std::vector<job_t> jobs = {};
+  std::vector<size_t> ids = {};
+  for(auto const& entry : queued)
+  {
+    std::cout << std::format("Job {}: {} {}", entry.id, entry.spec.name, entry.spec.url) << std::endl;
+
+    job_t job{entry.spec};
+    try
+    {
+      job.prepare(curl);
+    }
+    catch(...)
+    {
+      registry.set_state(entry.id, state_t::failed, describe_error(std::current_exception()));
+      continue;
+    }
+
+    if(registry.is_canceled(entry.id))
+    {
+      registry.set_state(entry.id, state_t::canceled);
+      continue;
+    }
+
+    registry.set_progress(entry.id, 0, 0, job.size());
+    registry.set_state(entry.id, state_t::downloading);
+    jobs.push_back(std::move(job));
+    ids.push_back(entry.id);
+  }
+
+  job_observer_t observer;
+  observer.on_progress = [&registry, &ids](size_t j, size_t finished, size_t ready, size_t total)
+  {
+    registry.set_progress(ids[j], finished, ready, total);
+  };
+  observer.on_done = [&registry, &ids](size_t j, job_result_t const& result)
+  {
+    if(registry.is_canceled(ids[j]))
+      registry.set_state(ids[j], state_t::canceled);
+    else if(result.error != nullptr)
+      registry.set_state(ids[j], state_t::failed, describe_error(result.error));
+    else if(result.status != 0)
+      registry.set_state(ids[j], state_t::failed, std::format("ffmpeg exited with {}", result.status));
+    else
+      registry.set_state(ids[j], state_t::done);
+  };
+  observer.is_canceled = [&registry, &ids](size_t j)
+  {
+    return registry.is_canceled(ids[j]);
+  };
+
+  try
+  {
+    run_jobs(curl, jobs, muxers, observer);
+  }
+  catch(...)
+  {
+    std::cerr << std::format("Error: {}", describe_error(std::current_exception())) << std::endl;
+  }
+
+  // Also of a failed run, to see what went wrong.
+  size_t const number = queued.front().id;
+  try
+  {
+    if(trace != nullptr)
+      trace->write(numbered_path(recorders.trace_file, number));
+
+    if(profiler != nullptr)
+    {
+      std::cerr << std::format("Jobs {}-{}:\n{}", number, queued.back().id, profiler->str()) << std::endl;
+      if(not recorders.profile_file.empty())
+        profiler->write(numbered_path(recorders.profile_file, number));
+    }
+  }
+  catch(std::exception const& error)
+  {
+    std::cerr << std::format("Error: {}", error.what()) << std::endl;
+  }
+}
+
+//! Takes the queued jobs until the registry is stopped and downloads every batch in a thread of its own,
+//! so jobs submitted during a run start at once instead of after it (sharing the connections with it).
+static void download_jobs(curl_wrapper const& curl, job_registry_t& registry, size_t muxers,
+    daemon_recorders_t const& recorders)
+{
+  struct batch_t
+  {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+  };
+  std::list<batch_t> batches = {};
+
+  while(true)
+  {
+    auto queued = registry.take_queued();
+
+    std::erase_if(batches, [](batch_t& batch)
+    {
+      if(not batch.done->load())
+        return false;
+      batch.thread.join();
+      return true;
+    });
+
+    if(queued.empty()) // stopped
+      break;
+
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    std::thread thread{[&curl, &registry, muxers, &recorders, queued = std::move(queued), done]()
+    {
+      download_batch(curl, registry, queued, muxers, recorders);
+      done->store(true);
+    }};
+    batches.push_back(batch_t{std::move(thread), std::move(done)});
+  }
+
+  for(auto& batch : batches)
+    batch.thread.join();
+}
+
+static void throw_errno(std::string const& what, std::filesystem::path const& path)
+{
+  std::error_code errc{errno, std::generic_category()};
+  throw std::filesystem::filesystem_error{what, path, errc};
+}
+
+static auto make_address(std::filesystem::path const& path) -> sockaddr_un
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if(path.native().size() >= sizeof(address.sun_path))
+  {
+    errno = ENAMETOOLONG;
+    throw_errno("Socket path too long", path);
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path)-1);
+  return address;
+}
+
+//! A connected socket or -1 if nobody listens there or another user does.
+static auto connect_socket(std::filesystem::path const& path) -> int
+{
+  sockaddr_un const address = make_address(path);
+
+  int const fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd < 0)
+    return -1;
+
+  if(connect(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  // Anybody can create /tmp/curl_m3u8-<UID>.sock first, only a daemon of the user gets the jobs.
+  ucred peer = {};
+  socklen_t length = sizeof(peer);
+  if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 or peer.uid != getuid())
+  {
+    close(fd);
+    std::cerr << std::format("Warning: Ignore {}, it's not a daemon of this user.", path.string()) << std::endl;
+    return -1;
+  }
+
+  return fd;
+}
+
+//! Send a JSON-value as line, false if the connection is broken.
+static auto send_json(int fd, json_t const& json) -> bool
+{
+  std::string const line = json.str() + "\n";
+
+  size_t sent = 0;
+  while(sent < line.size())
+  {
+    ssize_t const n = send(fd, line.data()+sent, line.size()-sent, MSG_NOSIGNAL);
+    if(n < 0 and errno == EINTR)
+      continue;
+    if(n <= 0)
+      return false;
+    sent += static_cast<size_t>(n);
+  }
+
+  return true;
+}
+
+//! Sends as much of the buffer as the socket (non-blocking) takes now and erases it from the buffer.
+//! Returns false if the connection is broken.
+static auto send_buffer(int fd, std::string& buffer) -> bool
+{
+  size_t sent = 0;
+  while(sent < buffer.size())
+  {
+    ssize_t const n = send(fd, buffer.data()+sent, buffer.size()-sent, MSG_NOSIGNAL);
+    if(n < 0 and errno == EINTR)
+      continue;
+    if(n < 0 and (errno == EAGAIN or errno == EWOULDBLOCK))
+      break;
+    if(n <= 0)
+      return false;
+    sent += static_cast<size_t>(n);
+  }
+
+  buffer.erase(0, sent);
+  return true;
+}
+
+//! Appends the received data to buffer and moves the complete lines out of it.
+//! Returns false if the connection is closed (or broken).
+static auto receive_lines(int fd, std::string& buffer, std::vector<std::string>& lines) -> bool
+{
+  char data[4096];
+  ssize_t const n = recv(fd, data, sizeof(data), 0);
+  if(n < 0 and (errno == EINTR or errno == EAGAIN or errno == EWOULDBLOCK))
+    return true;
+  if(n <= 0)
+    return false;
+
+  buffer.append(data, static_cast<size_t>(n));
+
+  size_t pos = 0;
+  while((pos = buffer.find('\n')) != std::string::npos)
+  {
+    lines.push_back(buffer.substr(0, pos));
+    buffer.erase(0, pos+1);
+  }
+
+  constexpr size_t max_line = 64*1024; // A request is never that long.
+  return buffer.size() <= max_line;
+}
+
+static volatile std::sig_atomic_t g_signal = 0;
+
+static void on_signal(int signal)
+{
+  g_signal = signal;
+}
+
+//! Without SA_RESTART, so a blocking poll() returns on the signal.
+static void set_signal_handler(int signal, void (*handler)(int))
+{
+  struct sigaction action = {};
+  action.sa_handler = handler;
+  sigemptyset(&action.sa_mask);
+  sigaction(signal, &action, nullptr);
+}
+
+auto run_daemon(curl_wrapper const& curl, std::filesystem::path const& socket_path, size_t muxers,
+    daemon_recorders_t const& recorders) -> int
+{
+  using namespace std::chrono_literals;
+
+  sockaddr_un const address = make_address(socket_path);
+
+  int const existing = connect_socket(socket_path);
+  if(existing >= 0)
+  {
+    close(existing);
+    std::cerr << std::format("Error: A daemon is already listening on {}!", socket_path.string()) << std::endl;
+    return -1;
+  }
+  std::filesystem::remove(socket_path); // a stale socket of a crashed daemon
+
+  int const listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(listener < 0)
+    throw_errno("Couldn't create socket", socket_path);
+
+  mode_t const old_umask = umask(0077); // only for the user
+  int const bound = bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address));
+  umask(old_umask);
+  if(bound != 0 or listen(listener, 16) != 0)
+  {
+    int const err = errno;
+    close(listener);
+    errno = err;
+    throw_errno("Couldn't listen on socket", socket_path);
+  }
+
+  set_signal_handler(SIGINT, on_signal);
+  set_signal_handler(SIGTERM, on_signal);
+  set_signal_handler(SIGPIPE, SIG_IGN);
+
+  std::cout << std::format("Listening on {}", socket_path.string()) << std::endl;
+
+  job_registry_t registry;
+  std::thread downloader{download_jobs, std::cref(curl), std::ref(registry), muxers, std::cref(recorders)};
+
+  // The clients are non-blocking, a client that doesn't read (e.g. a stopped subscriber) mustn't stop the daemon.
+  // Its replies and events wait in its outgoing buffer, until it overflows and the client is dropped.
+  constexpr size_t max_outgoing = 1024*1024;
+  struct client_t
+  {
+    int fd = -1;
+    std::string buffer = "";
+    std::string outgoing = "";
+
+    bool subscribed = false;
+    std::optional<size_t> job = {}; // subscribed to a single job
+    size_t version = 0;              // of the last sent changes
+  };
+  std::vector<client_t> clients = {};
+
+  auto close_client = [](client_t& client)
+  {
+    close(client.fd);
+    client.fd = -1;
+  };
+
+  // Queues the JSON-value as line, false if the client had to be dropped.
+  auto queue_json = [&](client_t& client, json_t const& json)
+  {
+    client.outgoing += json.str() + "\n";
+    if(client.outgoing.size() <= max_outgoing)
+      return true;
+
+    std::cerr << "Warning: Drop a client that doesn't read." << std::endl;
+    close_client(client);
+    return false;
+  };
+
+  while(g_signal == 0)
+  {
+    std::vector<pollfd> fds = {{listener, POLLIN, 0}};
+    for(auto const& client : clients)
+      fds.push_back({client.fd, static_cast<short>(client.outgoing.empty() ? POLLIN : POLLIN | POLLOUT), 0});
+
+    constexpr int timeout = std::chrono::milliseconds{200ms}.count(); // for pushing the progress
+    int const ready = poll(fds.data(), fds.size(), timeout);
+    if(ready < 0 and errno != EINTR)
+      throw_errno("Couldn't poll socket", socket_path);
+
+    for(size_t c=0; ready > 0 and c<clients.size(); c++)
+    {
+      auto& client = clients[c];
+      if(not (fds[c+1].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+
+      std::vector<std::string> lines = {};
+      if(not receive_lines(client.fd, client.buffer, lines))
+      {
+        close_client(client);
+        continue;
+      }
+
+      for(auto const& line : lines)
+      {
+        json_t reply = json_t::object_t{{"ok", true}};
+
+        auto const request = parse_json(line);
+        if(not request.has_value())
+          reply = json_t::object_t{{"ok", false}, {"error", "Invalid JSON"}};
+        else if(request->get_string("cmd") == "subscribe")
+        {
+          client.subscribed = true;
+          client.version = 0; // send the current state first
+          if(auto const id = request->get_number("id"); id.has_value())
+            client.job = static_cast<size_t>(id.value());
+        }
+        else
+          reply = registry.handle(request.value());
+
+        if(not queue_json(client, reply))
+          break;
+      }
+    }
+
+    if(ready > 0 and (fds[0].revents & POLLIN))
+    {
+      int const fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if(fd >= 0)
+        clients.push_back(client_t{fd});
+    }
+
+    // Push the changes to the subscribers.
+    for(auto& client : clients)
+    {
+      if(client.fd < 0 or not client.subscribed)
+        continue;
+
+      auto const [changed, version] = registry.changes(client.version);
+      client.version = version;
+      for(auto const& entry : changed)
+      {
+        if(client.job.has_value() and client.job.value() != entry.id)
+          continue;
+
+        if(not queue_json(client, json_t::object_t{{"event", "job"}, {"job", to_json(entry)}}))
+          break;
+      }
+    }
+
+    // Send what the clients take now, the rest when poll() reports them writable (POLLOUT).
+    for(auto& client : clients)
+      if(client.fd >= 0 and not client.outgoing.empty() and not send_buffer(client.fd, client.outgoing))
+        close_client(client);
+
+    std::erase_if(clients, [](client_t const& client) { return client.fd < 0; });
+  }
+
+  std::cout << "Stopping." << std::endl;
+  registry.stop();
+  downloader.join();
+
+  for(auto& client : clients)
+    close_client(client);
+  close(listener);
+  std::filesystem::remove(socket_path);
+
+  return 0;
+}
+
+// ---
+
+auto submit_to_daemon(std::filesystem::path const& socket_path, jobspec_t const& spec) -> std::optional<int>
+{
+  using namespace std::chrono_literals;
+
+  int const fd = connect_socket(socket_path);
+  if(fd < 0)
+    return {};
+
+  std::string buffer = "";
+  std::vector<std::string> lines = {};
+
+  // Waits for the next line from the daemon, nothing if the connection broke.
+  auto receive = [&]() -> std::optional<json_t>
+  {
+    while(lines.empty())
+    {
+      pollfd pfd{fd, POLLIN, 0};
+      int const ready = poll(&pfd, 1, std::chrono::milliseconds{200ms}.count());
+      if(ready < 0 and errno != EINTR)
+        return {};
+      if(g_signal != 0) // Ctrl-C cancels the job.
+        return json_t::object_t{{"event", "signal"}};
+      if(ready > 0 and not receive_lines(fd, buffer, lines))
+        return {};
+    }
+
+    auto json = parse_json(lines.front());
+    lines.erase(lines.begin());
+    return json;
+  };
+
+  auto fail = [fd](std::string const& message)
+  {
+    close(fd);
+    std::cerr << std::format("Error: {}!", message) << std::endl;
+    return -1;
+  };
+
+  json_t::object_t submit = {
+    {"cmd", "submit"},
+    {"url", spec.url},
+    {"name", spec.name},
+    {"adaptive", spec.adaptive},
+  };
+  if(spec.variant_policy != variant_policy_t::automatic)
+  {
+    for(auto const policy : {"max-resolution", "max-bandwidth", "min-bandwidth"})
+      if(parse_variant_policy(policy) == spec.variant_policy)
+        submit["pick"] = policy;
+  }
+  if(spec.deadline.has_value())
+    submit["deadline"] = spec.deadline.value();
+  if(spec.one_file)
+    submit["one_file"] = true;
+  if(spec.preview != preview_t::none)
+    submit["preview"] = spec.preview == preview_t::keyframes ? "keyframes" : "thumbnails";
+  if(spec.from.has_value())
+    submit["from"] = format_position(spec.from.value());
+  if(spec.to.has_value())
+    submit["to"] = format_position(spec.to.value());
+
+  if(not send_json(fd, submit))
+    return fail("Lost the connection to the daemon");
+
+  auto const submitted = receive();
+  if(not submitted.has_value() or not submitted->get_number("id").has_value())
+    return fail(submitted.has_value() ? submitted->get_string("error").value_or("Bad reply of the daemon")
+        : "Lost the connection to the daemon");
+
+  size_t const id = static_cast<size_t>(submitted->get_number("id").value());
+  std::cout << std::format("Submitted as job {} to the daemon on {}.", id, socket_path.string()) << std::endl;
+
+  set_signal_handler(SIGINT, on_signal);
+  if(not send_json(fd, json_t::object_t{{"cmd", "subscribe"}, {"id", id}}))
+    return fail("Lost the connection to the daemon");
+
+  std::string last_state = "";
+  bool cancel_sent = false;
+  while(true)
+  {
+    auto const message = receive();
+    if(not message.has_value())
+      return fail("Lost the connection to the daemon");
+
+    if(message->get_string("event") == "signal")
+    {
+      g_signal = 0;
+      if(not cancel_sent and not send_json(fd, json_t::object_t{{"cmd", "cancel"}, {"id", id}}))
+        return fail("Lost the connection to the daemon");
+      cancel_sent = true;
+      continue;
+    }
+
+    auto const job = message->get("job");
+    if(message->get_string("event") != "job" or not job.has_value())
+      continue; // a reply
+
+    std::string const state = job->get_string("state").value_or("");
+    size_t const finished = static_cast<size_t>(job->get_number("finished").value_or(0.0));
+    size_t const ready = static_cast<size_t>(job->get_number("ready").value_or(0.0));
+    size_t const total = static_cast<size_t>(job->get_number("total").value_or(0.0));
+
+    if(state == "downloading")
+      std::cout << std::format("\rDownloaded {} of {} files (the first {} are ready)", finished, total, ready)
+        << std::flush;
+    if(state != last_state and last_state == "downloading")
+      std::cout << std::endl;
+    last_state = state;
+
+    if(state == "done")
+    {
+      close(fd);
+      return 0;
+    }
+    if(state == "canceled")
+    {
+      close(fd);
+      std::cout << "Canceled." << std::endl;
+      return 0;
+    }
+    if(state == "failed")
+      return fail(job->get_string("error").value_or("The job failed"));
+  }
+}
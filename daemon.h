@@ -0,0 +1,129 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "curl_wrapper.h"
+#include "job.h"
+#include "json.h"
+
+//
+// Daemon-mode: A long-running process keeps one curl_wrapper (and with it the DNS-cache, TLS-sessions and
+// connections of its share-handle) for all jobs and takes them over a unix domain socket.
+// The jobs submitted at once are downloaded in a run, the runs concurrently.
+// The protocol is JSON, one request or reply per line:
+//   {"cmd":"submit","url":URL,"name":NAME[,"pick":POLICY][,"deadline":SECONDS][,"adaptive":BOOL]
+//    [,"from":TIME][,"to":TIME][,"preview":KIND][,"one_file":BOOL]}
+//                                  -> {"ok":true,"id":ID}
+//   {"cmd":"status","id":ID}       -> {"ok":true,"job":JOB}
+//   {"cmd":"cancel","id":ID}       -> {"ok":true}
+//   {"cmd":"list"}                 -> {"ok":true,"jobs":[JOB,...]}
+//   {"cmd":"subscribe"[,"id":ID]}  -> {"ok":true}, then {"event":"job","job":JOB} on every change of the job(s)
+// A failed request is answered with {"ok":false,"error":MESSAGE}.
+// JOB is {"id":ID,"url":URL,"name":NAME,"state":STATE,"finished":N,"ready":N,"total":N[,"error":MESSAGE]}
+// with STATE queued, preparing, downloading, done, failed or canceled
+// and ready the number of downloads at the beginning, that are all downloaded (in playback order).
+//
+
+//! $XDG_RUNTIME_DIR/curl_m3u8.sock or otherwise /tmp/curl_m3u8-<UID>.sock.
+auto default_socket_path() -> std::filesystem::path;
+
+//! The jobs of the daemon, shared between the connections and the downloading thread.
+class job_registry_t
+{
+public:
+
+  enum class state_t
+  {
+    queued,
+    preparing,
+    downloading,
+    done,
+    failed,
+    canceled,
+  };
+
+  struct entry_t
+  {
+    size_t id = 0;
+    jobspec_t spec = {};
+    state_t state = state_t::queued;
+    size_t finished = 0; // downloads
+    size_t ready = 0;    // downloads at the beginning, see run_jobs()
+    size_t total = 0;
+    std::string error = "";
+
+    bool cancel = false;  // requested, but not yet done
+    size_t version = 0;   // of the last change
+  };
+
+  //! Answers a request of the protocol, except subscribe (which is up to the connection).
+  auto handle(json_t const& request) -> json_t;
+
+  auto submit(jobspec_t const& spec) -> size_t;
+
+  //! Cancels a queued job at once and a running one at the next chance.
+  //! Returns an error-message if there is no such (unfinished) job.
+  auto cancel(size_t id) -> std::optional<std::string>;
+
+  auto is_canceled(size_t id) const -> bool;
+  auto find(size_t id) const -> std::optional<entry_t>;
+
+  //! Waits until there are queued jobs and hands them over (as preparing) or returns none after stop().
+  auto take_queued() -> std::vector<entry_t>;
+
+  void set_state(size_t id, state_t state, std::string const& error = "");
+  void set_progress(size_t id, size_t finished, size_t ready, size_t total);
+
+  //! Cancels everything and lets take_queued() return.
+  void stop();
+
+  //! The jobs changed after the version and the current version.
+  auto changes(size_t since) const -> std::tuple<std::vector<entry_t>, size_t>;
+
+
+private:
+
+  void touch(entry_t& entry); // with locked mutex
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_queued;
+  std::map<size_t, entry_t> m_entries = {};
+  size_t m_next_id = 1;
+  size_t m_version = 0;
+  bool m_stopped = false;
+};
+
+auto to_string(job_registry_t::state_t state) -> std::string;
+auto to_json(job_registry_t::entry_t const& entry) -> json_t;
+
+//! The jobspec of a submit-request or an error-message.
+auto parse_submit(json_t const& request) -> std::variant<jobspec_t, std::string>;
+
+//! The recorders of the daemon's runs (see --trace and --profile). Every run (the jobs taken at once) has its own,
+//! written when it's done to the files numbered by its first job, see numbered_path().
+struct daemon_recorders_t
+{
+  std::filesystem::path trace_file = "";
+  bool profile_flag = false;
+  std::filesystem::path profile_file = "";
+};
+
+//! The path with "-<NUMBER>" appended to the stem e.g. trace-7.json for trace.json.
+auto numbered_path(std::filesystem::path const& path, size_t number) -> std::filesystem::path;
+
+//! Serves the socket until SIGINT or SIGTERM. Returns the exit-code. Throws on error.
+//! The jobs are downloaded by copies of curl, every run concurrently to the others.
+auto run_daemon(curl_wrapper const& curl, std::filesystem::path const& socket, size_t muxers,
+    daemon_recorders_t const& recorders = {}) -> int;
+
+//! Thin client: Hands the job to the daemon listening on the socket and prints its progress until it is done.
+//! Ctrl-C cancels the job. Returns the exit-code or nothing if no daemon is listening.
+auto submit_to_daemon(std::filesystem::path const& socket, jobspec_t const& spec) -> std::optional<int>;
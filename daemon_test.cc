@@ -0,0 +1,115 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "daemon.h"
+
+static auto request(std::string const& text) -> json_t
+{
+  auto const json = parse_json(text);
+  EXPECT_TRUE(json.has_value()) << text;
+  return json.value_or(json_t{});
+}
+
+TEST(daemon_tests, parse_submit)
+{
+  auto const spec_error = parse_submit(request(
+      R"({"cmd":"submit","url":"https://server/master.m3u8","name":"/videos/a","pick":"max-bandwidth","deadline":60,"adaptive":true})"));
+  ASSERT_TRUE(std::holds_alternative<jobspec_t>(spec_error));
+
+  auto const& spec = std::get<jobspec_t>(spec_error);
+  EXPECT_EQ(spec.url, "https://server/master.m3u8");
+  EXPECT_EQ(spec.name, "/videos/a");
+  EXPECT_EQ(spec.variant_policy, variant_policy_t::max_bandwidth);
+  EXPECT_EQ(spec.deadline, 60.0);
+  EXPECT_TRUE(spec.adaptive);
+  EXPECT_FALSE(spec.from.has_value());
+  EXPECT_FALSE(spec.one_file);
+
+  auto const clip = parse_submit(request(R"({"cmd":"submit","url":"u","name":"a","from":"1:30","to":"2026-10-16T20:15:00Z"})"));
+  ASSERT_TRUE(std::holds_alternative<jobspec_t>(clip));
+  EXPECT_EQ(std::get<jobspec_t>(clip).from, position_t{90.0});
+  EXPECT_EQ(std::get<jobspec_t>(clip).to, parse_position("2026-10-16T20:15:00Z"));
+
+  auto error = [](std::string const& text)
+  {
+    auto const result = parse_submit(request(text));
+    return std::holds_alternative<std::string>(result) ? std::get<std::string>(result) : "";
+  };
+  EXPECT_EQ(error(R"({"cmd":"submit","name":"a"})"), "A submit needs an url");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":""})"), "A submit needs a name");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","pick":"ask"})"), "The pick-policy ask isn't possible in a daemon");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","pick":3})"), "Unknown pick-policy `'");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","deadline":0})"), "The deadline must be a positive number of seconds");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","adaptive":"yes"})"), "Adaptive must be true or false");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","one_file":1})"), "One_file must be true or false");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","preview":"all"})"), "The preview must be keyframes or thumbnails");
+  EXPECT_EQ(error(R"({"cmd":"submit","url":"u","name":"a","to":"soon"})"), "The to must be a time like \"1:30:00\" or a date-time");
+}
+
+TEST(daemon_tests, protocol)
+{
+  job_registry_t registry;
+
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"submit","url":"u1","name":"a"})")).str(), R"({"id":1,"ok":true})");
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"submit","url":"u2","name":"b"})")).str(), R"({"id":2,"ok":true})");
+
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"status","id":1})")).str(),
+      R"({"job":{"finished":0,"id":1,"name":"a","ready":0,"state":"queued","total":0,"url":"u1"},"ok":true})");
+
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"cancel","id":2})")).str(), R"({"ok":true})");
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"cancel","id":2})")).str(),
+      R"({"error":"The job 2 is already canceled","ok":false})");
+
+  auto const list = registry.handle(request(R"({"cmd":"list"})"));
+  ASSERT_TRUE(list.get("jobs").has_value());
+  ASSERT_EQ(list.get("jobs")->as_array().size(), 2);
+  EXPECT_EQ(list.get("jobs")->as_array()[1].get_string("state"), "canceled");
+
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"status","id":7})")).str(), R"({"error":"There is no job 7","ok":false})");
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"status"})")).str(),
+      R"({"error":"A status needs the id of a job","ok":false})");
+  EXPECT_EQ(registry.handle(request(R"({"cmd":"restart"})")).str(), R"({"error":"Unknown cmd `restart'","ok":false})");
+  EXPECT_EQ(registry.handle(request(R"([1,2])")).str(), R"({"error":"Expected an object with a cmd","ok":false})");
+}
+
+TEST(daemon_tests, registry)
+{
+  using state_t = job_registry_t::state_t;
+
+  job_registry_t registry;
+  size_t const id = registry.submit(jobspec_t{"u", "a"});
+
+  auto const queued = registry.take_queued();
+  ASSERT_EQ(queued.size(), 1);
+  EXPECT_EQ(queued.front().id, id);
+  EXPECT_EQ(registry.find(id)->state, state_t::preparing);
+
+  auto [changed, version] = registry.changes(0);
+  EXPECT_EQ(changed.size(), 1);
+
+  registry.set_progress(id, 3, 2, 10);
+  std::tie(changed, version) = registry.changes(version);
+  ASSERT_EQ(changed.size(), 1);
+  EXPECT_EQ(changed.front().finished, 3);
+  EXPECT_EQ(changed.front().ready, 2);
+  EXPECT_EQ(changed.front().total, 10);
+  EXPECT_TRUE(std::get<0>(registry.changes(version)).empty());
+
+  // A running job is canceled by the downloader.
+  EXPECT_FALSE(registry.cancel(id).has_value());
+  EXPECT_TRUE(registry.is_canceled(id));
+  EXPECT_EQ(registry.find(id)->state, state_t::preparing);
+
+  registry.set_state(id, state_t::canceled);
+  EXPECT_TRUE(registry.cancel(id).has_value());
+
+  registry.stop();
+  EXPECT_TRUE(registry.take_queued().empty());
+}
+
+TEST(daemon_tests, numbered_path)
+{
+  EXPECT_EQ(numbered_path("trace.json", 7), "trace-7.json");
+  EXPECT_EQ(numbered_path("/tmp/run.profile.json", 12), "/tmp/run.profile-12.json");
+  EXPECT_EQ(numbered_path("out/trace", 3), "out/trace-3");
+}
@@ -0,0 +1,316 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::ranges::sort
+#include <chrono>
+#include <csignal>   // sigaction()
+#include <cstdlib>   // std::strtod()
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h> // getrusage()
+#include <sys/wait.h>     // waitpid()
+#include <unistd.h>       // fork(), getpid()
+
+#include "curl_wrapper.h"
+#include "job.h"
+#include "origin.h"
+
+//
+// Benchmark of the download pipeline (playlists, variant pick, segments with their verification)
+// against a local HLS origin (see origin.h) on the loopback. The origin runs in a child process,
+// so the CPU time measured is the one of the download alone. The muxing is left out, ffmpeg
+// can't make anything of the generated segments.
+//
+
+struct options_t
+{
+  origin_config_t origin = {};
+  uint16_t port = 0;
+  bool serve_flag = false; // only run the origin
+
+  int parallel = 5;
+  double hedge = 10.0; // in percent
+  size_t runs = 3;
+};
+
+//! What a run of the benchmark measured.
+struct run_t
+{
+  double makespan = 0.0; // seconds of the whole pipeline
+  double cpu = 0.0;      // seconds
+  size_t bytes = 0;
+  size_t errors = 0;
+};
+
+static auto parse_options(int argc, char* argv[]) -> std::optional<options_t>;
+static auto parse_size(std::string const& size) -> std::optional<size_t>;
+static void print_usage(char const* progname);
+
+static auto run_benchmark(options_t const& options, std::string const& url, std::filesystem::path const& dir) -> run_t;
+static auto cpu_seconds(int who) -> double;
+static void print_run(std::string const& name, run_t const& run);
+
+static origin_t* g_origin = nullptr;
+
+static void on_signal(int)
+{
+  if(g_origin != nullptr)
+    g_origin->stop();
+}
+
+// ---
+
+int main(int argc, char** argv)
+{
+  auto const options_result = parse_options(argc, argv);
+  if(not options_result.has_value())
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+  options_t const options = options_result.value();
+
+  origin_t origin{options.origin, options.port};
+  g_origin = &origin;
+
+  struct sigaction action = {};
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  if(options.serve_flag)
+  {
+    std::cout << std::format("Serving {} (stop with Ctrl-C)", origin.url()) << std::endl;
+    origin.run();
+    std::cout << std::format("{} requests, {} bytes sent, {} injected errors",
+        origin.requests(), origin.sent_bytes(), origin.injected_errors()) << std::endl;
+    return 0;
+  }
+
+  pid_t const pid = fork();
+  if(pid < 0)
+  {
+    std::cerr << "Error: Couldn't start the origin!" << std::endl;
+    return 1;
+  }
+  if(pid == 0)
+  {
+    origin.run();
+    _exit(0);
+  }
+
+  auto const dir = std::filesystem::temp_directory_path() / std::format("download_bench-{}", getpid());
+  std::filesystem::create_directories(dir);
+
+  curl_wrapper::init();
+
+  std::cout << std::format("{} segments of {} bytes, {} parallel transfers against {}",
+      options.origin.segments, origin_segment_size(options.origin, options.origin.variants), options.parallel,
+      origin.url()) << std::endl;
+  std::cout << std::format("{:<8} {:>10} {:>12} {:>9} {:>9} {:>7}",
+      "run", "makespan", "throughput", "cpu", "cpu/GB", "errors") << std::endl;
+
+  std::vector<run_t> runs = {};
+  for(size_t r=0; r<options.runs; r++)
+  {
+    runs.push_back(run_benchmark(options, origin.url(), dir));
+    print_run(std::format("{}", r+1), runs.back());
+  }
+
+  // The median run by its makespan.
+  std::ranges::sort(runs, {}, &run_t::makespan);
+  if(not runs.empty())
+    print_run("median", runs[runs.size()/2]);
+
+  curl_wrapper::cleanup();
+  std::filesystem::remove_all(dir);
+
+  kill(pid, SIGTERM);
+  waitpid(pid, nullptr, 0);
+  std::cout << std::format("origin: {:.3f} s cpu", cpu_seconds(RUSAGE_CHILDREN)) << std::endl;
+
+  return 0;
+}
+
+auto run_benchmark(options_t const& options, std::string const& url, std::filesystem::path const& dir) -> run_t
+{
+  curl_wrapper curl{"download_bench"};
+  curl.parallel(options.parallel);
+  curl.max_speed(static_cast<size_t>(options.parallel)*1'024*1'024*1'024); // no limit
+  curl.hedge_budget(options.hedge/100.0);
+
+  jobspec_t spec;
+  spec.url = url;
+  spec.name = (dir / "bench").string();
+  spec.variant_policy = variant_policy_t::max_bandwidth;
+
+  double const cpu = cpu_seconds(RUSAGE_SELF);
+  auto const start = std::chrono::steady_clock::now();
+
+  job_t job{spec};
+  job.prepare(curl);
+  auto const results = curl.download_files(job.downloads());
+
+  run_t run;
+  run.makespan = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  run.cpu = cpu_seconds(RUSAGE_SELF) - cpu;
+  run.bytes = results.stats.bytes();
+  run.errors = results.errors.size();
+
+  job.discard();
+  return run;
+}
+
+auto cpu_seconds(int who) -> double
+{
+  rusage usage{};
+  getrusage(who, &usage);
+
+  auto seconds = [](timeval const& time)
+  {
+    return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec)/1e6;
+  };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+void print_run(std::string const& name, run_t const& run)
+{
+  double const gigabytes = static_cast<double>(run.bytes)/1e9;
+  double const throughput = run.makespan > 0.0 ? static_cast<double>(run.bytes)/run.makespan/1e6 : 0.0;
+  std::cout << std::format("{:<8} {:>8.3f} s {:>7.1f} MB/s {:>7.3f} s {:>7.3f} s {:>7}", name, run.makespan,
+      throughput, run.cpu, gigabytes > 0.0 ? run.cpu/gigabytes : 0.0, run.errors) << std::endl;
+}
+
+// ---
+
+auto parse_options(int argc, char* argv[]) -> std::optional<options_t>
+{
+  options_t options;
+
+  enum { error_429 = 256, error_1015, reset, truncate };
+  struct option long_options[] =
+  {
+    // long name, no_argument|required_argument, flag, val or nullptr
+    {"help", no_argument, nullptr, 'h'},
+    {"segments", required_argument, nullptr, 'n'},
+    {"size", required_argument, nullptr, 'b'},
+    {"variants", required_argument, nullptr, 'V'},
+    {"bandwidth", required_argument, nullptr, 'B'},
+    {"latency", required_argument, nullptr, 'l'},
+    {"jitter", required_argument, nullptr, 'J'},
+    {"429", required_argument, nullptr, error_429},
+    {"1015", required_argument, nullptr, error_1015},
+    {"reset", required_argument, nullptr, reset},
+    {"truncate", required_argument, nullptr, truncate},
+    {"seed", required_argument, nullptr, 'x'},
+    {"parallel", required_argument, nullptr, 'j'},
+    {"hedge", required_argument, nullptr, 'H'},
+    {"runs", required_argument, nullptr, 'R'},
+    {"port", required_argument, nullptr, 'p'},
+    {"serve", no_argument, nullptr, 's'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  auto number = [](char const* arg) -> std::optional<double>
+  {
+    char* end = nullptr;
+    double const value = std::strtod(arg, &end);
+    if(end == arg or *end != '\0' or value < 0.0)
+      return {};
+    return value;
+  };
+
+  int c = 0;
+  int option_index = 0;
+  while((c = getopt_long(argc, argv, "hn:b:V:B:l:J:x:j:H:R:p:s", long_options, &option_index)) != -1)
+  {
+    // A size (with suffix) or a number.
+    bool const is_size = c == 'b' or c == 'B';
+    auto const size = is_size ? (std::string{optarg} == "0" ? 0 : parse_size(optarg)) : std::optional<size_t>{};
+    auto const value = optarg != nullptr and not is_size ? number(optarg) : std::optional<double>{};
+    if(optarg != nullptr and not size.has_value() and not value.has_value())
+    {
+      std::cerr << std::format("Error: Invalid value `{}'!", optarg) << std::endl;
+      return {};
+    }
+
+    switch(c)
+    {
+      case 'n': options.origin.segments = static_cast<size_t>(value.value()); break;
+      case 'b': options.origin.segment_bytes = size.value(); break;
+      case 'V': options.origin.variants = std::max<size_t>(static_cast<size_t>(value.value()), 1); break;
+      case 'B': options.origin.bandwidth = size.value(); break;
+      case 'l': options.origin.latency = value.value()/1'000.0; break;
+      case 'J': options.origin.jitter = value.value()/1'000.0; break;
+      case error_429:  options.origin.error_429 = value.value(); break;
+      case error_1015: options.origin.error_1015 = value.value(); break;
+      case reset:      options.origin.reset = value.value(); break;
+      case truncate:   options.origin.truncate = value.value(); break;
+      case 'x': options.origin.seed = static_cast<uint32_t>(value.value()); break;
+      case 'j': options.parallel = std::max(static_cast<int>(value.value()), 1); break;
+      case 'H': options.hedge = value.value(); break;
+      case 'R': options.runs = static_cast<size_t>(value.value()); break;
+      case 'p': options.port = static_cast<uint16_t>(value.value()); break;
+      case 's': options.serve_flag = true; break;
+      default: return {}; // 'h' and '?'
+    }
+  }
+
+  if(optind != argc)
+    return {};
+
+  return options;
+}
+
+auto parse_size(std::string const& size) -> std::optional<size_t>
+{
+  char* end = nullptr;
+  double const value = std::strtod(size.c_str(), &end);
+  if(end == size.c_str() or value <= 0.0)
+    return {};
+
+  std::string const suffix = end;
+  double factor = 1.0;
+  if(suffix == "K" or suffix == "k")
+    factor = 1'024.0;
+  else if(suffix == "M" or suffix == "m")
+    factor = 1'024.0*1'024.0;
+  else if(suffix == "G" or suffix == "g")
+    factor = 1'024.0*1'024.0*1'024.0;
+  else if(not suffix.empty())
+    return {};
+
+  return static_cast<size_t>(value*factor);
+}
+
+void print_usage(char const* progname)
+{
+  std::cout << std::format(
+      "Usage: {0} [OPTIONS]\n"
+      "Benchmark of the download pipeline against a local HLS origin: throughput, makespan and CPU per GB.\n"
+      "Origin:\n"
+      "-n, --segments <N>\t\tSegments per playlist (default: 100).\n"
+      "-b, --size <SIZE>\t\tBytes of a segment of the highest variant, with suffix K, M or G\n"
+      "                 \t\t(default: 1M).\n"
+      "-V, --variants <N>\t\tVariants in the master m3u8-file (default: 3).\n"
+      "-B, --bandwidth <SPEED>\t\tBytes/s per connection (default: 0, unlimited).\n"
+      "-l, --latency <MS>\t\tMilliseconds until a response starts (default: 0).\n"
+      "-J, --jitter <MS>\t\tUp to so many milliseconds more latency (default: 0).\n"
+      "    --429 <P>    \t\tProbability of a 429 Too Many Requests per segment (default: 0).\n"
+      "    --1015 <P>   \t\tProbability of an \"error code: 1015\" page (default: 0).\n"
+      "    --reset <P>  \t\tProbability of a connection reset in the body (default: 0).\n"
+      "    --truncate <P>\t\tProbability of a truncated body (default: 0).\n"
+      "-x, --seed <N>   \t\tSeed of the jitter and the errors (default: 1).\n"
+      "-p, --port <PORT>\t\tPort of the origin (default: any free one).\n"
+      "-s, --serve      \t\tOnly run the origin, e.g. for curl_m3u8 <URL>/master.m3u8.\n"
+      "Download:\n"
+      "-j, --parallel <N>\t\tNumber of parallel transfers (default: 5).\n"
+      "-H, --hedge <PERCENT>\t\tHedge budget (default: 10).\n"
+      "-R, --runs <N>   \t\tNumber of runs, the median is reported as well (default: 3).", progname)
+    << std::endl;
+}
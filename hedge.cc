@@ -0,0 +1,62 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::nth_element
+#include <cmath>     // std::ceil
+#include <vector>
+
+#include "hedge.h"
+
+hedge_policy_t::hedge_policy_t(double budget)
+  : m_budget(budget)
+{}
+
+void hedge_policy_t::finished(size_t bytes, double seconds)
+{
+  m_downloaded += bytes;
+
+  m_samples.emplace_back(bytes, seconds);
+  if(m_samples.size() > max_samples)
+    m_samples.pop_front();
+}
+
+void hedge_policy_t::hedged(size_t bytes)
+{
+  m_hedged += bytes;
+}
+
+//! The value at the percentile (0.0 to 1.0) with nearest-rank.
+static auto percentile(std::vector<double> values, double p) -> double
+{
+  size_t const rank = static_cast<size_t>(std::ceil(p*static_cast<double>(values.size())));
+  size_t const n = rank > 0 ? rank-1 : 0;
+  std::nth_element(values.begin(), values.begin()+n, values.end());
+  return values[n];
+}
+
+auto hedge_policy_t::is_straggler(size_t bytes, double seconds) const -> bool
+{
+  if(m_samples.size() < min_samples)
+    return false;
+
+  std::vector<double> durations = {};
+  std::vector<double> rates = {};
+  for(auto const& [sample_bytes, sample_seconds] : m_samples)
+  {
+    durations.push_back(sample_seconds);
+    if(sample_seconds > 0.0)
+      rates.push_back(static_cast<double>(sample_bytes)/sample_seconds);
+  }
+
+  if(seconds > 2.0*percentile(durations, 0.9))
+    return true;
+
+  if(rates.empty() or seconds <= percentile(durations, 0.5))
+    return false;
+
+  double const rate = static_cast<double>(bytes)/seconds;
+  return rate < percentile(rates, 0.5)/4.0;
+}
+
+auto hedge_policy_t::has_budget() const -> bool
+{
+  return static_cast<double>(m_hedged) < m_budget*static_cast<double>(m_downloaded);
+}
@@ -0,0 +1,45 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <cstddef> // size_t
+#include <deque>
+#include <tuple>
+
+/**
+ * Decides when download_files() hedges a straggler: A second request for the same url is started
+ * in an otherwise idle slot and whichever finishes first wins, the other one is canceled.
+ *
+ * A running transfer is a straggler, if it takes longer than twice the 90th percentile of the durations
+ * of the finished transfers, or if it runs longer than the median duration at less than a quarter
+ * of the median throughput. The bytes of all hedges are limited to the budget (a fraction)
+ * of the downloaded bytes.
+ */
+class hedge_policy_t
+{
+public:
+
+  explicit hedge_policy_t(double budget);
+
+  //! Record a finished (successful) transfer.
+  void finished(size_t bytes, double seconds);
+
+  //! Record the bytes downloaded by a hedge (won or lost).
+  void hedged(size_t bytes);
+
+  //! Is the running transfer (so far bytes in seconds) a straggler?
+  auto is_straggler(size_t bytes, double seconds) const -> bool;
+
+  //! Is there budget left for another hedge?
+  auto has_budget() const -> bool;
+
+
+private:
+
+  static constexpr size_t min_samples = 5; // below there are no meaningful percentiles
+  static constexpr size_t max_samples = 64;
+
+  double m_budget;
+  size_t m_downloaded = 0; // bytes
+  size_t m_hedged = 0;     // bytes
+
+  std::deque<std::tuple<size_t, double>> m_samples = {}; // (bytes, seconds) of the last finished transfers
+};
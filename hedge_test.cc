@@ -0,0 +1,39 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "hedge.h"
+
+TEST(hedge_tests, is_straggler)
+{
+  hedge_policy_t policy{0.1};
+
+  // 1 MB in 1 s each.
+  for(int n=0; n<4; n++)
+    policy.finished(1'000'000, 1.0);
+  EXPECT_FALSE(policy.is_straggler(0, 100.0)); // too few samples yet
+
+  policy.finished(1'000'000, 1.0);
+  EXPECT_FALSE(policy.is_straggler(500'000, 0.5));
+  EXPECT_FALSE(policy.is_straggler(100'000, 0.9)); // slow, but not longer than the median yet
+  EXPECT_TRUE(policy.is_straggler(100'000, 1.5));  // a tenth of the median throughput
+  EXPECT_FALSE(policy.is_straggler(900'000, 1.5)); // a bit slower only
+  EXPECT_TRUE(policy.is_straggler(900'000, 2.5));  // beyond twice the 90th percentile
+}
+
+TEST(hedge_tests, budget)
+{
+  hedge_policy_t policy{0.1};
+  EXPECT_FALSE(policy.has_budget()); // nothing downloaded yet
+
+  policy.finished(1'000'000, 1.0);
+  EXPECT_TRUE(policy.has_budget());
+
+  policy.hedged(60'000);
+  EXPECT_TRUE(policy.has_budget());
+  policy.hedged(40'000);
+  EXPECT_FALSE(policy.has_budget());
+
+  hedge_policy_t disabled{0.0};
+  disabled.finished(1'000'000, 1.0);
+  EXPECT_FALSE(disabled.has_budget());
+}
@@ -0,0 +1,1469 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::max, std::min, std::ranges::any_of, std::ranges::stable_sort
+#include <cassert>
+#include <cerrno>   // errno
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>   // std::remove()
+#include <deque>
+#include <format>
+#include <fstream>  // std::ofstream
+#include <iostream>
+#include <memory>   // std::unique_ptr
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <sstream>
+#include <stdexcept>    // std::runtime_error
+#include <system_error> // std::error_code
+#include <thread>
+
+#include <spawn.h>    // posix_spawnp()
+#include <sys/wait.h> // waitpid()
+#include <unistd.h>   // environ
+
+#include "job.h"
+#include "pngfakeheader.h"
+#include "progressmeter.h" // shorten_bytes()
+#include "string_util.h"
+#include "webvtt.h"
+
+// Byte ranges of I-frames closer than this are fetched at once (about a round trip at a few MB/s).
+static constexpr uint64_t max_iframe_gap = 64*1'024;
+
+// In bits/s, to predict the sizes of segments without known bandwidth.
+static constexpr uint64_t typical_video_bandwidth = 2'000'000;
+static constexpr uint64_t typical_audio_bandwidth = 128'000;
+static constexpr uint64_t typical_subtitles_bandwidth = 1'000;
+
+namespace
+{
+  //! Where the phases are recorded: into the trace (on the track) and the profiler, each if there is one.
+  struct recorder_t
+  {
+    trace_t* trace = nullptr;
+    profiler_t* profiler = nullptr;
+    int track = 0; // of trace_t::pipeline
+  };
+
+  //! A phase from its construction to its destruction, a span in the trace and a run in the profile.
+  class phase_scope_t
+  {
+  public:
+
+    phase_scope_t(recorder_t const& recorder, std::string const& name, std::string const& category)
+      : m_trace{recorder.trace, name, category, trace_t::pipeline, recorder.track}, m_profile{recorder.profiler, name}
+    {}
+
+    //! Only shown in the trace.
+    void arg(std::string const& key, json_t value)
+    {
+      m_trace.arg(key, std::move(value));
+    }
+
+    void bytes(size_t bytes)
+    {
+      m_trace.arg("bytes", bytes);
+      m_profile.bytes(bytes);
+    }
+
+
+  private:
+
+    trace_scope_t m_trace;
+    profile_scope_t m_profile;
+  };
+} // namespace
+
+static auto pick_variant(curl_wrapper const& curl, m3u8_t const& master, jobspec_t const& spec,
+    job_t::ask_t const& ask) -> int;
+static auto pick_renditions(curl_wrapper const& curl, m3u8_t const& master, int picked) -> std::vector<track_t>;
+static auto probe_throughput(curl_wrapper& curl, std::string const& name, m3u8_t const& playlist) -> double;
+static auto make_switcher(curl_wrapper const& curl, m3u8_t const& master, int picked, m3u8_t const& playlist,
+    std::optional<double> deadline) -> std::optional<variant_switcher_t>;
+static auto fetch_keys(curl_wrapper const& curl, m3u8_t const& m3u8, std::map<std::string, aes128_block_t> keys)
+  -> std::map<std::string, aes128_block_t>; // throws on error
+static auto get_aes128(urlprops_t const& segment, std::map<std::string, aes128_block_t> const& keys)
+  -> std::optional<aes128_t>;
+static auto make_download(std::string const& name, size_t index, size_t ndigits, std::string const& suffix,
+    urlprops_t const& segment, std::map<std::string, aes128_block_t> const& keys) -> curl_wrapper::download_t;
+static auto fetch_path(std::string const& name, size_t index, size_t ndigits) -> std::filesystem::path;
+static auto steering_priority(curl_wrapper const& curl, m3u8_t const& master) -> std::vector<std::string>;
+static auto download_redundant(curl_wrapper const& curl, m3u8_t const& master, int& picked) -> std::vector<m3u8_t>;
+static void add_mirrors(track_t& track, std::map<std::string, aes128_block_t> const& keys);
+static void place_downloads(curl_wrapper const& curl, track_t& track, std::filesystem::path const& output);
+static void split_output(track_t& track); // throws on error
+static void merge_subtitles(track_t& track, std::filesystem::path const& output); // throws on error
+static auto resolve_range(jobspec_t const& spec, m3u8_t const& playlist)
+  -> std::optional<std::tuple<double, double>>; // throws on error
+static auto cut_playlist(m3u8_t& playlist, std::tuple<double, double> const& range) -> double;
+static auto interleave(std::vector<track_t> const& tracks) -> std::vector<std::tuple<size_t, size_t>>;
+static int concat_ffmpeg(recorder_t const& recorder, std::string const& name, std::vector<track_t> const& tracks,
+    std::optional<std::tuple<uint32_t, uint32_t>> scale, std::optional<std::tuple<double, double>> range, bool quiet);
+static int run_command(std::vector<std::string> const& args);
+
+static void print_lines(std::ostream& out, std::string const& str, int maxlines);
+
+// ---
+
+auto parse_batchfile(std::istream& istream, jobspec_t const& defaults)
+  -> std::variant<std::vector<jobspec_t>, std::string>
+{
+  std::vector<jobspec_t> jobs = {};
+
+  std::string line = "";
+  for(size_t n=1; std::getline(istream, line); n++)
+  {
+    std::string const trimmed = trim(line);
+    if(trimmed.empty() or trimmed.starts_with('#'))
+      continue;
+
+    std::vector<std::string> fields = {};
+    std::istringstream ss{trimmed};
+    for(std::string field; ss >> field;)
+      fields.push_back(field);
+
+    if(fields.size() < 2 or fields.size() > 3)
+      return std::format("Line {}: Expected `<URL> <NAME> [<POLICY>]'", n);
+
+    jobspec_t job = defaults;
+    job.url = fields[0];
+    job.name = fields[1];
+
+    if(fields.size() == 3)
+    {
+      auto const policy = parse_variant_policy(fields[2]);
+      if(not policy.has_value())
+        return std::format("Line {}: Unknown pick-policy `{}'", n, fields[2]);
+      job.variant_policy = policy.value();
+    }
+
+    // Nobody is there to ask.
+    if(job.variant_policy == variant_policy_t::ask)
+      return std::format("Line {}: The pick-policy ask isn't possible in a batch", n);
+
+    for(auto const& other : jobs)
+    {
+      if(other.name == job.name)
+        return std::format("Line {}: The name `{}' is used twice", n, job.name);
+    }
+
+    jobs.push_back(job);
+  }
+
+  return jobs;
+}
+
+// ---
+
+job_t::job_t(jobspec_t const& spec)
+  : m_spec{spec}
+{
+}
+
+bool job_t::prepare(curl_wrapper const& curl, ask_t const& ask)
+{
+  std::optional<m3u8_t> master = {};
+  int picked = -1;
+  std::vector<track_t> renditions = {};
+  std::vector<m3u8_t> mirrors = {};
+  uint64_t bandwidth = 0; // of the picked variant in bits/s, if known
+
+  m_trace = curl.trace();
+  m_profiler = curl.profiler();
+  m_messages = &curl.messages();
+  recorder_t const recorder{m_trace.get(), m_profiler.get()};
+  trace_scope_t prepare_span{m_trace.get(), std::format("prepare {}", m_spec.name), "prepare"};
+
+  std::optional<phase_scope_t> playlist_span{std::in_place, recorder, "playlist", "prepare"};
+  m3u8_t m3u8 = download_m3u8(curl, m_spec.url);
+  playlist_span.reset();
+  if(m_spec.preview != preview_t::none)
+    return prepare_preview(curl, m3u8);
+
+  if(m3u8.is_master()) // Pick and download playlist m3u8-file.
+  {
+    phase_scope_t pick_span{recorder, "pick variant", "prepare"};
+    master = m3u8;
+
+    picked = pick_variant(curl, master.value(), m_spec, ask);
+    if(picked == -1)
+      return false;
+
+    mirrors = download_redundant(curl, master.value(), picked);
+    bandwidth = parse_variants(master.value())[static_cast<size_t>(picked)].bandwidth;
+    m3u8 = mirrors.front();
+    mirrors.erase(mirrors.begin());
+    renditions = pick_renditions(curl, master.value(), picked);
+  }
+
+  if(not m3u8.is_playlist())
+    throw m3u8_errc::wrong_file_format;
+
+  m_tracks = {track_t{"VIDEO", "", m3u8}};
+  for(auto& rendition : renditions)
+    m_tracks.push_back(std::move(rendition));
+
+  // Of a time range only the overlapping segments are downloaded (of every track by its own runtimes),
+  // the rest is cut off when muxing.
+  m_range = resolve_range(m_spec, m3u8);
+  if(m_range.has_value())
+  {
+    for(auto& track : m_tracks)
+      track.offset = cut_playlist(track.playlist, m_range.value());
+  }
+
+  if(master.has_value() and m_spec.adaptive)
+  {
+    m_variants = parse_variants(master.value());
+    m_switcher = make_switcher(curl, master.value(), picked, m_tracks.front().playlist, m_spec.deadline);
+  }
+
+  if(not m_switcher.has_value()) // With switching every segment may come from another variant.
+    m_tracks.front().mirrors = std::move(mirrors);
+
+  // Fetch the keys before the segments, that need them.
+  // (With adaptive of all variants, as every variant could be picked.)
+  std::optional<phase_scope_t> keys_span{std::in_place, recorder, "keys", "prepare"};
+  for(auto const& track : m_tracks)
+    m_keys = fetch_keys(curl, track.playlist, std::move(m_keys));
+  if(m_switcher.has_value())
+  {
+    for(auto const& playlist : m_switcher->playlists())
+      m_keys = fetch_keys(curl, playlist, std::move(m_keys));
+  }
+
+  // A mirror without its keys just isn't used.
+  std::erase_if(m_tracks.front().mirrors, [this, &curl](m3u8_t const& mirror)
+  {
+    try
+    {
+      m_keys = fetch_keys(curl, mirror, m_keys);
+      return false;
+    }
+    catch(...)
+    {
+      return true;
+    }
+  });
+  keys_span.reset();
+
+  // Every track has its own numbering, the files are distinguished by the suffix
+  // e.g. "name-007-v1-a1.ts" (video), "name-007-a1.ts" (audio) and "name-007-s1.vtt" (subtitles).
+  size_t naudio = 0, nsubtitles = 0;
+  for(auto& track : m_tracks)
+  {
+    std::string suffix = "v1-a1.ts";
+    if(track.type == "AUDIO")
+      suffix = std::format("a{}.ts", ++naudio);
+    else if(track.type == "SUBTITLES")
+      suffix = std::format("s{}.vtt", ++nsubtitles);
+
+    // The size of a segment is predicted from its runtime at the bandwidth of the variant
+    // (see curl_wrapper::largest_first()), for the renditions at a typical bandwidth.
+    uint64_t track_bandwidth = bandwidth > 0 ? bandwidth : typical_video_bandwidth;
+    if(track.type == "AUDIO")
+      track_bandwidth = typical_audio_bandwidth;
+    else if(track.type == "SUBTITLES")
+      track_bandwidth = typical_subtitles_bandwidth;
+
+    auto const& urls = track.playlist.get_urls();
+    size_t const ndigits = calc_numberlength(urls.size());
+    for(size_t i=0; i<urls.size(); i++)
+    {
+      track.downloads.push_back(make_download(m_spec.name, i, ndigits, suffix, urls[i], m_keys));
+      track.downloads.back().predicted_bytes =
+        static_cast<size_t>(parse_runtime(urls[i])*static_cast<double>(track_bandwidth)/8.0);
+    }
+
+    add_mirrors(track, m_keys);
+
+    // Not with changing variants (no sizes in advance) and not for subtitles (WebVTT-files have headers).
+    if(m_spec.one_file and not m_switcher.has_value() and track.type != "SUBTITLES")
+      place_downloads(curl, track, std::format("{}-{}", m_spec.name, suffix));
+  }
+
+  // All tracks are downloaded at once in playback order.
+  m_order = interleave(m_tracks);
+
+  return true;
+}
+
+auto job_t::downloads() const -> std::vector<curl_wrapper::download_t>
+{
+  std::vector<curl_wrapper::download_t> downloads = {};
+  for(auto const& [t, i] : m_order)
+    downloads.push_back(m_tracks[t].downloads[i]);
+  return downloads;
+}
+
+//! Picks the variant of every video segment right before it is downloaded.
+void job_t::on_start(size_t index, curl_wrapper::download_t& download)
+{
+  auto const [t, i] = m_order[index];
+  if(t != 0 or not m_switcher.has_value())
+    return;
+
+  size_t const ndigits = calc_numberlength(m_tracks.front().downloads.size());
+  auto const [variant, segment] = m_switcher->select(i);
+  download = make_download(m_spec.name, i, ndigits, std::format("v{}-a1.ts", m_variants[variant].index+1),
+      segment, m_keys);
+  m_tracks.front().downloads[i] = download;
+}
+
+void job_t::on_finish(size_t index, curl_wrapper::transfer_t const& transfer)
+{
+  if(std::get<0>(m_order[index]) == 0 and m_switcher.has_value() and transfer.succeeded)
+    m_switcher->finished(transfer.bytes);
+}
+
+auto job_t::find_download(curl_wrapper_error const& error) const -> std::optional<curl_wrapper::download_t>
+{
+  for(auto const& track : m_tracks)
+  {
+    auto it = std::find_if(track.downloads.begin(), track.downloads.end(),
+        [&error](auto const& download) { return download.path == error.filename() and download.url == error.url(); });
+    if(it != track.downloads.end())
+      return *it;
+  }
+
+  return {};
+}
+
+void job_t::drop_download(std::filesystem::path const& path)
+{
+  auto is_dropped = [&path](auto const& download) { return download.path == path; };
+  for(auto& track : m_tracks)
+  {
+    // The output would have a gap.
+    if(not track.output.empty() and std::ranges::any_of(track.downloads, is_dropped))
+      split_output(track);
+
+    std::erase_if(track.downloads, is_dropped);
+  }
+  std::remove(path.c_str());
+}
+
+void job_t::discard()
+{
+  for(auto const& track : m_tracks)
+  {
+    for(auto const& download : track.downloads)
+      std::remove(download.path.c_str());
+    if(not track.output.empty())
+      std::remove(track.output.c_str());
+  }
+}
+
+int job_t::mux(bool quiet)
+{
+  if(m_preview.has_value())
+    return mux_preview(quiet);
+
+  // Every job has its own track, as the jobs are muxed in parallel.
+  int const track = m_trace != nullptr ? m_trace->track(trace_t::pipeline, std::format("mux {}", m_spec.name)) : 0;
+  trace_scope_t mux_span{m_trace.get(), std::format("mux {}", m_spec.name), "mux", trace_t::pipeline, track};
+  recorder_t const recorder{m_trace.get(), m_profiler.get(), track};
+
+  // A part with another size than announced is in its own file (see curl_wrapper::download_t::output),
+  // then its track is concatenated from the parts after all.
+  for(auto& track : m_tracks)
+  {
+    bool const fell_back = std::ranges::any_of(track.downloads,
+        [](auto const& download) { return std::filesystem::exists(download.path); });
+    if(not track.output.empty() and fell_back)
+      split_output(track);
+  }
+
+  // The WebVTT-parts have headers of their own, they are merged instead of concatenated by ffmpeg.
+  size_t nsubtitles = 0;
+  for(auto& track : m_tracks)
+  {
+    if(track.type == "SUBTITLES")
+      merge_subtitles(track, std::format("{}-s{}.vtt", m_spec.name, ++nsubtitles));
+  }
+
+  bool has_pngfakeheader = false;
+  std::optional<phase_scope_t> png_span{std::in_place, recorder, "pngfakeheader", "mux"};
+  for(auto const& t : m_tracks)
+  {
+    if(not t.output.empty()) // A part with one isn't written there, see curl_wrapper::download_t::output.
+      continue;
+    if(t.type == "SUBTITLES") // Text, never with a PNG fake-header.
+      continue;
+
+    for(auto const& download : t.downloads)
+    {
+      auto haspng_error = check_and_remove_pngfakeheader(download.path);
+      if(std::holds_alternative<std::filesystem::filesystem_error>(haspng_error))
+        throw std::get<std::filesystem::filesystem_error>(haspng_error);
+
+      if(std::get<bool>(haspng_error))
+        has_pngfakeheader = true;
+    }
+  }
+  png_span.reset();
+
+  if(has_pngfakeheader)
+    *m_messages << std::format("Found and removed PNG fake-header(s) in {}.", m_spec.name) << std::endl;
+
+  // If the variant changed, the resolution may change between the parts.
+  // Then scale everything to the highest resolution.
+  std::optional<std::tuple<uint32_t, uint32_t>> scale = {};
+  if(m_switcher.has_value() and m_switcher->used_variants().size() > 1)
+  {
+    uint32_t width = 0, height = 0;
+    for(size_t v : m_switcher->used_variants())
+    {
+      width  = std::max(width, m_variants[v].width);
+      height = std::max(height, m_variants[v].height);
+    }
+    if(width > 0 and height > 0)
+      scale = std::make_tuple(width, height);
+  }
+
+  if(m_switcher.has_value())
+    *m_messages << std::format("Variant changes in {}: {}", m_spec.name, m_switcher->switches()) << std::endl;
+
+  return concat_ffmpeg(recorder, m_spec.name, m_tracks, scale, m_range, quiet);
+}
+
+//! Instead of the segments the byte ranges of the I-frames are downloaded, neighbouring ones at once.
+bool job_t::prepare_preview(curl_wrapper const& curl, m3u8_t const& m3u8)
+{
+  m3u8_t playlist = m3u8;
+  if(m3u8.is_master())
+  {
+    auto const picked = pick_iframe_stream(m3u8, m_spec.variant_policy);
+    if(not picked.has_value())
+      throw std::runtime_error{"The m3u8-file has no I-frame playlist (#EXT-X-I-FRAME-STREAM-INF) for a preview"};
+    playlist = download_m3u8(curl, m3u8.get_iframe_streams()[picked.value()].url);
+  }
+
+  if(not playlist.is_playlist())
+    throw m3u8_errc::wrong_file_format;
+
+  // The time range is only cut to the I-frames, a preview is sparse anyway.
+  if(auto const range = resolve_range(m_spec, playlist); range.has_value())
+    cut_playlist(playlist, range.value());
+
+  m_preview = coalesce_ranges(iframe_ranges(playlist), max_iframe_gap);
+
+  track_t track{"IFRAMES", "", playlist};
+  size_t const ndigits = calc_numberlength(m_preview->fetches.size());
+  for(size_t f=0; f<m_preview->fetches.size(); f++)
+  {
+    auto const& fetch = m_preview->fetches[f];
+
+    curl_wrapper::download_t download{fetch_path(m_spec.name, f, ndigits), fetch.url};
+    if(fetch.length > 0)
+    {
+      download.range = std::make_tuple(fetch.offset, fetch.length);
+      download.predicted_bytes = fetch.length;
+    }
+    track.downloads.push_back(download);
+  }
+
+  m_tracks = {track};
+  m_order = interleave(m_tracks);
+
+  return true;
+}
+
+//! Puts the I-frames together into <NAME>-keyframes.ts and makes the video or thumbnails of it via ffmpeg.
+int job_t::mux_preview(bool quiet)
+{
+  assert(m_preview.has_value());
+
+  int const track = m_trace != nullptr ? m_trace->track(trace_t::pipeline, std::format("mux {}", m_spec.name)) : 0;
+  trace_scope_t mux_span{m_trace.get(), std::format("mux {}", m_spec.name), "mux", trace_t::pipeline, track};
+  recorder_t const recorder{m_trace.get(), m_profiler.get(), track};
+
+  size_t const ndigits = calc_numberlength(m_preview->fetches.size());
+  std::vector<std::filesystem::path> paths = {};
+  for(size_t f=0; f<m_preview->fetches.size(); f++)
+    paths.push_back(fetch_path(m_spec.name, f, ndigits));
+
+  std::filesystem::path const keyframes = m_spec.name + "-keyframes.ts";
+  std::optional<phase_scope_t> pieces_span{std::in_place, recorder, "keyframes", "mux"};
+  size_t const written = write_pieces(m_preview.value(), paths, keyframes);
+  for(auto const& path : paths)
+    std::remove(path.c_str());
+  pieces_span.reset();
+
+  if(not quiet)
+    *m_messages << std::format("Key frames of {}: {}", m_spec.name, written) << std::endl;
+
+  std::vector<std::string> command = {"ffmpeg"};
+  if(quiet)
+    command.insert(command.end(), {"-nostdin", "-loglevel", "error"});
+  command.insert(command.end(), {"-i", keyframes.string()});
+  if(m_spec.preview == preview_t::thumbnails)
+    command.insert(command.end(), {"-fps_mode", "passthrough", m_spec.name + "-%05d.jpg"});
+  else
+    command.push_back(m_spec.name + ".mp4");
+
+  std::optional<phase_scope_t> ffmpeg_span{std::in_place, recorder, "ffmpeg", "mux"};
+  int ret = run_command(command);
+  ffmpeg_span.reset();
+
+  std::remove(keyframes.c_str());
+
+  return ret;
+}
+
+// ---
+
+namespace
+{
+  //! Runs the submitted tasks on a fixed number of threads.
+  class worker_pool_t
+  {
+  public:
+
+    explicit worker_pool_t(size_t workers)
+    {
+      assert(workers > 0);
+      for(size_t i=0; i<workers; i++)
+        m_threads.emplace_back([this]() { work(); });
+    }
+
+    //! Waits until all submitted tasks are done.
+    ~worker_pool_t()
+    {
+      {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stop = true;
+      }
+      m_condition.notify_all();
+
+      for(auto& thread : m_threads)
+        thread.join();
+    }
+
+    worker_pool_t(worker_pool_t const&) = delete;
+    auto operator=(worker_pool_t const&) -> worker_pool_t& = delete;
+
+    void submit(std::function<void()> task)
+    {
+      {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_tasks.push_back(std::move(task));
+      }
+      m_condition.notify_one();
+    }
+
+
+  private:
+
+    void work()
+    {
+      while(true)
+      {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock{m_mutex};
+          m_condition.wait(lock, [this]() { return m_stop or not m_tasks.empty(); });
+          if(m_tasks.empty()) // and m_stop
+            return;
+
+          task = std::move(m_tasks.front());
+          m_tasks.pop_front();
+        }
+
+        task();
+      }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks = {};
+    bool m_stop = false;
+
+    std::vector<std::thread> m_threads = {};
+  };
+} // namespace
+
+auto interleave_jobs(std::vector<size_t> const& sizes) -> std::vector<std::tuple<size_t, size_t>>
+{
+  std::vector<std::tuple<size_t, size_t>> order = {};
+
+  size_t const rounds = sizes.empty() ? 0 : std::ranges::max(sizes);
+  for(size_t i=0; i<rounds; i++)
+  {
+    for(size_t j=0; j<sizes.size(); j++)
+    {
+      if(i < sizes[j])
+        order.push_back(std::make_tuple(j, i));
+    }
+  }
+
+  return order;
+}
+
+auto run_jobs(curl_wrapper& curl, std::vector<job_t>& jobs, size_t muxers, job_observer_t const& observer)
+  -> std::vector<job_result_t>
+{
+  using namespace std::chrono_literals;
+
+  std::vector<job_result_t> results(jobs.size());
+  bool const quiet = jobs.size() > 1;
+
+  std::vector<size_t> sizes = {};
+  std::vector<std::vector<curl_wrapper::download_t>> job_downloads = {};
+  for(auto const& job : jobs)
+  {
+    job_downloads.push_back(job.downloads());
+    sizes.push_back(job.size());
+  }
+
+  auto const order = interleave_jobs(sizes);
+  std::vector<curl_wrapper::download_t> downloads = {};
+  std::map<std::filesystem::path, size_t> job_of = {}; // path of a download -> job
+  for(auto const& [j, i] : order)
+  {
+    downloads.push_back(job_downloads[j][i]);
+    job_of[downloads.back().path] = j;
+  }
+
+  // Mux every job as soon as all of its downloads succeeded.
+  std::vector<size_t> remaining = sizes;
+  std::vector<size_t> failed(jobs.size(), 0);
+  std::vector<std::vector<bool>> succeeded(jobs.size()); // per download of a job
+  std::vector<size_t> ready(jobs.size(), 0);             // succeeded downloads at the beginning of a job
+  for(size_t j=0; j<jobs.size(); j++)
+    succeeded[j].resize(sizes[j], false);
+  std::vector<bool> muxing(jobs.size(), false);
+  auto pool = std::make_unique<worker_pool_t>(muxers);
+
+  auto done = [&results, &observer](size_t j)
+  {
+    if(observer.on_done)
+      observer.on_done(j, results[j]);
+  };
+
+  auto mux = [&](size_t j)
+  {
+    muxing[j] = true;
+    pool->submit([&jobs, &results, &done, j, quiet]()
+    {
+      try
+      {
+        results[j].status = jobs[j].mux(quiet);
+      }
+      catch(...)
+      {
+        results[j].error = std::current_exception();
+      }
+      done(j);
+    });
+  };
+
+  auto is_canceled = [&observer](size_t j)
+  {
+    return observer.is_canceled and observer.is_canceled(j);
+  };
+
+  for(size_t j=0; j<jobs.size(); j++)
+  {
+    if(sizes[j] == 0)
+      mux(j);
+  }
+
+  curl_wrapper::hooks_t hooks = {};
+  hooks.on_start = [&](size_t index, curl_wrapper::download_t& download)
+  {
+    auto const [j, i] = order[index];
+    jobs[j].on_start(i, download);
+    job_of[download.path] = j;
+  };
+  hooks.on_finish = [&](size_t index, curl_wrapper::transfer_t const& transfer)
+  {
+    auto const [j, i] = order[index];
+    jobs[j].on_finish(i, transfer);
+
+    remaining[j]--;
+    if(not transfer.succeeded)
+      failed[j]++;
+
+    succeeded[j][i] = transfer.succeeded;
+    while(ready[j] < sizes[j] and succeeded[j][ready[j]])
+      ready[j]++;
+
+    if(observer.on_progress)
+      observer.on_progress(j, sizes[j] - remaining[j], ready[j], sizes[j]);
+    if(remaining[j] == 0 and failed[j] == 0 and not is_canceled(j))
+      mux(j);
+  };
+  if(observer.is_canceled)
+  {
+    hooks.is_canceled = [&](size_t index)
+    {
+      return is_canceled(std::get<0>(order[index]));
+    };
+  }
+
+  recorder_t const recorder{curl.trace().get(), curl.profiler().get()};
+  std::optional<phase_scope_t> download_span{std::in_place, recorder, "download", "download"};
+  download_span->arg("downloads", downloads.size());
+  auto download_results = curl.download_files(downloads, hooks);
+  download_span->bytes(download_results.stats.bytes());
+  download_span.reset();
+
+  curl.messages() << std::format("successful downloads: {}", download_results.succeeded_files.size()) << std::endl;
+  curl.messages() << std::format("    failed downloads: {}", download_results.errors.size()) << std::endl;
+  curl.messages() << std::format("          of overall: {} urls", downloads.size()) << std::endl;
+  if(download_results.predicted_seconds.has_value())
+    curl.messages() << std::format("            makespan: {:.1f} s (predicted {:.1f} s)",
+        download_results.seconds, download_results.predicted_seconds.value()) << std::endl;
+
+  // Sort the errors to their jobs.
+  std::vector<std::vector<curl_wrapper_error>> errors(jobs.size());
+  auto sort_errors = [&](std::vector<curl_wrapper_error> const& new_errors)
+  {
+    for(auto const& error : new_errors)
+    {
+      if(job_of.contains(error.filename()))
+        errors[job_of.at(error.filename())].push_back(error);
+      else // Not of a single download, then it concerns all unfinished jobs.
+      {
+        for(size_t j=0; j<jobs.size(); j++)
+          if(remaining[j] > 0 or failed[j] > 0)
+            errors[j].push_back(error);
+      }
+    }
+  };
+  sort_errors(download_results.errors);
+
+  // If there were download errors, but only for a few files of a job (less than 10%)
+  // -> try to download them again.
+  auto is_retryable = [&](size_t j)
+  {
+    size_t const succeeded = sizes[j] - std::min(sizes[j], remaining[j] + errors[j].size());
+    return not errors[j].empty() and remaining[j] == 0 and succeeded > 0
+      and static_cast<double>(errors[j].size())/static_cast<double>(succeeded) < 0.1;
+  };
+
+  for(size_t round=1; ; round++)
+  {
+    std::vector<curl_wrapper::download_t> rest = {};
+    for(size_t j=0; j<jobs.size(); j++)
+    {
+      if(not is_retryable(j) or is_canceled(j))
+        continue;
+
+      for(auto const& error : errors[j])
+      {
+        auto const download = jobs[j].find_download(error);
+        assert(download.has_value() and "Couldn't find result in downloads?!");
+        rest.push_back(download.value());
+      }
+      errors[j].clear();
+    }
+
+    if(rest.empty())
+      break;
+
+    curl.messages() << "Couldn't download some files due to errors. Try them again." << std::endl;
+    std::this_thread::sleep_for(1s);
+
+    phase_scope_t retry_span{recorder, "retry round", "download"};
+    retry_span.arg("round", round);
+    retry_span.arg("downloads", rest.size());
+    auto const retry_results = curl.download_files(rest);
+    retry_span.bytes(retry_results.stats.bytes());
+    sort_errors(retry_results.errors);
+  }
+
+  for(size_t j=0; j<jobs.size(); j++)
+  {
+    if(muxing[j])
+      continue;
+
+    if(is_canceled(j))
+    {
+      jobs[j].discard();
+      results[j].error = std::make_exception_ptr(curl_wrapper_error{"Canceled", jobs[j].spec().url});
+      done(j);
+      continue;
+    }
+
+    if(remaining[j] > 0 and errors[j].empty())
+      errors[j].push_back(curl_wrapper_error{"Download aborted after too many errors", jobs[j].spec().url});
+
+    if(not errors[j].empty())
+    {
+      double const error_ratio = static_cast<double>(errors[j].size())/static_cast<double>(sizes[j]);
+      if(remaining[j] > 0 or error_ratio >= 0.01)
+      {
+        results[j].error = std::make_exception_ptr(errors[j]);
+        done(j);
+        continue;
+      }
+
+      std::cerr
+        << std::format("Warning: Ignore download errors in less than {:.0f}% of the files.", error_ratio*100.0)
+        << std::endl;
+
+      // filter
+      for(auto const& error : errors[j])
+        jobs[j].drop_download(error.filename());
+    }
+
+    mux(j);
+  }
+
+  pool.reset(); // Waits for the muxing.
+
+  return results;
+}
+
+// ---
+
+//! Returns the given keys plus the keys of the m3u8-file.
+auto fetch_keys(curl_wrapper const& curl, m3u8_t const& m3u8, std::map<std::string, aes128_block_t> keys)
+  -> std::map<std::string, aes128_block_t>
+{
+  for(auto const& url : m3u8.get_urls())
+  {
+    if(not url.properties.contains("KEY-METHOD"))
+      continue;
+
+    if(url.properties.at("KEY-METHOD") != "AES-128" or not url.properties.contains("KEY-URI"))
+      throw m3u8_errc::unsupported_encryption;
+
+    std::string const& keyurl = url.properties.at("KEY-URI");
+    if(keys.contains(keyurl)) // Every key only once.
+      continue;
+
+    auto result = curl.download_buffer(keyurl);
+    if(std::holds_alternative<curl_wrapper_error>(result))
+      throw std::get<curl_wrapper_error>(result);
+
+    auto const& buffer = std::get<std::vector<char>>(result);
+    if(buffer.size() != sizeof(aes128_block_t))
+      throw curl_wrapper_error{std::format("Key has {} instead of 16 bytes", buffer.size()), keyurl};
+
+    aes128_block_t key;
+    std::copy(buffer.begin(), buffer.end(), key.begin());
+    keys[keyurl] = key;
+  }
+
+  return keys;
+}
+
+auto get_aes128(urlprops_t const& segment, std::map<std::string, aes128_block_t> const& keys) -> std::optional<aes128_t>
+{
+  auto const& props = segment.properties;
+  if(not props.contains("KEY-METHOD"))
+    return {};
+
+  assert(keys.contains(props.at("KEY-URI")) and "keys need to be fetched before");
+  aes128_block_t const& key = keys.at(props.at("KEY-URI"));
+
+  if(props.contains("KEY-IV"))
+  {
+    auto const iv = parse_iv(props.at("KEY-IV"));
+    if(not iv.has_value())
+      throw m3u8_errc::unsupported_encryption;
+    return aes128_t{key, iv.value()};
+  }
+
+  // Without IV the media sequence number is the IV.
+  assert(props.contains("MEDIA-SEQUENCE"));
+  return aes128_t{key, iv_from_sequence(std::stoull(props.at("MEDIA-SEQUENCE")))};
+}
+
+auto download_m3u8(curl_wrapper const& curl, std::string const& url) -> m3u8_t
+{
+  auto result = curl.download_buffer(url);
+  if(std::holds_alternative<curl_wrapper_error>(result))
+    throw std::get<curl_wrapper_error>(result);
+
+  assert(std::holds_alternative<std::vector<char>>(result));
+  auto buffer = std::get<std::vector<char>>(result);
+  //std::ranges::copy(buffer, std::ostream_iterator<char>(std::cout, ""));
+
+  if(not is_m3u8(buffer))
+  {
+    std::string const page{buffer.data(), buffer.size()};
+    bool is_html = page.find("<html") != std::string::npos;
+    if(is_html)
+      print_lines(curl.messages(), page, 10);
+
+    throw m3u8_errc::wrong_file_format;
+  }
+
+  // Relative urls are relative to the url of the m3u8-file itself.
+  m3u8_t m3u8{buffer};
+  m3u8.resolve_urls(url);
+
+  return m3u8;
+}
+
+/**
+ * Downloads the playlists of all variants for switching between them.
+ * Needs #EXT-X-INDEPENDENT-SEGMENTS, otherwise the segments can't be mixed.
+ */
+auto make_switcher(curl_wrapper const& curl, m3u8_t const& master, int picked, m3u8_t const& playlist,
+    std::optional<double> deadline) -> std::optional<variant_switcher_t>
+{
+  assert(master.is_master());
+
+  if(not master.has_independent_segments())
+  {
+    std::cerr << "Warning: Can't switch between playlists without #EXT-X-INDEPENDENT-SEGMENTS." << std::endl;
+    return {};
+  }
+
+  auto const variants = parse_variants(master);
+
+  std::vector<m3u8_t> playlists = {};
+  for(auto const& variant : variants)
+    playlists.push_back(static_cast<int>(variant.index) == picked ? playlist : download_m3u8(curl, variant.url));
+
+  return variant_switcher_t{variants, playlists, static_cast<size_t>(picked), deadline};
+}
+
+/**
+ * The pathway-priority of content steering (#EXT-X-CONTENT-STEERING): From the steering manifest,
+ * or if that isn't available the default pathway (PATHWAY-ID). Empty without content steering.
+ * The manifest is only fetched once, as the jobs are short compared to its TTL.
+ */
+auto steering_priority(curl_wrapper const& curl, m3u8_t const& master) -> std::vector<std::string>
+{
+  auto const& steering = master.get_steering();
+
+  if(steering.contains("SERVER-URI"))
+  {
+    auto const result = curl.download_buffer(steering.at("SERVER-URI"));
+    if(std::holds_alternative<std::vector<char>>(result))
+    {
+      auto const& buffer = std::get<std::vector<char>>(result);
+      auto const priority = parse_steering_manifest(std::string_view{buffer.data(), buffer.size()});
+      if(priority.has_value() and not priority->empty())
+        return priority.value();
+    }
+
+    std::cerr << "Warning: Couldn't get the pathway-priority from the steering manifest." << std::endl;
+  }
+
+  if(steering.contains("PATHWAY-ID"))
+    return {steering.at("PATHWAY-ID")};
+
+  return {};
+}
+
+/**
+ * Downloads the playlist of the picked variant and of its redundant variants (e.g. on other CDNs).
+ * The first one in the order of the pathway-priority, that can be downloaded, is used and becomes picked,
+ * the others are its mirrors. Throws if none can be downloaded.
+ */
+auto download_redundant(curl_wrapper const& curl, m3u8_t const& master, int& picked) -> std::vector<m3u8_t>
+{
+  auto const variants = parse_variants(master);
+  auto const redundant = redundant_variants(variants, static_cast<size_t>(picked), steering_priority(curl, master));
+
+  std::vector<m3u8_t> playlists = {};
+  std::exception_ptr error = nullptr;
+  for(size_t const v : redundant)
+  {
+    try
+    {
+      playlists.push_back(download_m3u8(curl, variants[v].url));
+      if(playlists.size() == 1)
+        picked = static_cast<int>(variants[v].index);
+    }
+    catch(...)
+    {
+      if(error == nullptr)
+        error = std::current_exception();
+    }
+  }
+
+  if(playlists.empty())
+    std::rethrow_exception(error);
+
+  if(playlists.size() > 1)
+    curl.messages() << std::format("Found {} mirror(s) of the playlist.", playlists.size()-1) << std::endl;
+
+  return playlists;
+}
+
+/**
+ * Adds the urls of the same segments in the mirror playlists to the downloads.
+ * Segments are identified by their media sequence number and need the same decryption.
+ */
+void add_mirrors(track_t& track, std::map<std::string, aes128_block_t> const& keys)
+{
+  auto const& segments = track.playlist.get_urls();
+  assert(segments.size() == track.downloads.size());
+
+  for(auto const& mirror : track.mirrors)
+  {
+    std::map<std::string, urlprops_t const*> by_sequence = {};
+    for(auto const& segment : mirror.get_urls())
+    {
+      if(segment.properties.contains("MEDIA-SEQUENCE"))
+        by_sequence[segment.properties.at("MEDIA-SEQUENCE")] = &segment;
+    }
+
+    for(size_t i=0; i<segments.size(); i++)
+    {
+      if(not segments[i].properties.contains("MEDIA-SEQUENCE"))
+        continue;
+
+      auto it = by_sequence.find(segments[i].properties.at("MEDIA-SEQUENCE"));
+      if(it == by_sequence.end())
+        continue;
+
+      try
+      {
+        if(get_aes128(*it->second, keys) == track.downloads[i].aes128)
+          track.downloads[i].mirrors.push_back(it->second->url);
+      }
+      catch(m3u8_errc) // unsupported encryption of the mirror
+      {}
+    }
+  }
+}
+
+//! The segment with the (0-based) index is downloaded to "<NAME>-<INDEX>-<SUFFIX>"
+//! e.g. "name-007-v1-a1.ts" for the suffix "v1-a1.ts".
+auto make_download(std::string const& name, size_t index, size_t ndigits, std::string const& suffix,
+    urlprops_t const& segment, std::map<std::string, aes128_block_t> const& keys) -> curl_wrapper::download_t
+{
+  std::string const segname = std::format("{}-{:0>{}}-{}", name, index+1, ndigits, suffix);
+  return curl_wrapper::download_t{segname, segment.url, get_aes128(segment, keys)};
+}
+
+/**
+ * The time range (from, to) of the job in seconds of the playlist, nothing if the whole playlist is downloaded.
+ * Throws if a wall-clock time can't be mapped or nothing of the playlist is in the range.
+ */
+auto resolve_range(jobspec_t const& spec, m3u8_t const& playlist) -> std::optional<std::tuple<double, double>>
+{
+  if(not spec.from.has_value() and not spec.to.has_value())
+    return {};
+
+  auto const& segments = playlist.get_urls();
+  double const duration = segment_starts(segments).back();
+
+  auto resolve = [&segments](position_t const& position)
+  {
+    auto const offset = resolve_position(position, segments);
+    if(not offset.has_value())
+      throw std::runtime_error{std::format("The playlist has no #EXT-X-PROGRAM-DATE-TIME to find {}",
+          format_position(position))};
+    return offset.value();
+  };
+
+  double const from = spec.from.has_value() ? std::max(0.0, resolve(spec.from.value())) : 0.0;
+  double const to = spec.to.has_value() ? std::min(duration, resolve(spec.to.value())) : duration;
+  if(from >= to)
+    throw std::runtime_error{std::format("The time range isn't within the playlist of {:.1f} s", duration)};
+
+  return std::make_tuple(from, to);
+}
+
+//! Writes the downloads of the track one after the other into output, if none of them is decrypted
+//! (the size differs) and the sizes of all are known by HEAD-requests. The offsets of the parts are
+//! known upfront, so they are written in any order without reordering, part files and concat.
+void place_downloads(curl_wrapper const& curl, track_t& track, std::filesystem::path const& output)
+{
+  if(track.downloads.empty()
+      or std::ranges::any_of(track.downloads, [](auto const& download) { return download.aes128.has_value(); }))
+    return;
+
+  auto const heads = curl.head_files(track.downloads);
+  if(std::ranges::any_of(heads, [](auto const& head) { return head.content_length == 0; }))
+    return;
+
+  uint64_t offset = 0;
+  for(size_t i=0; i<track.downloads.size(); i++)
+  {
+    auto& download = track.downloads[i];
+    download.content_length = heads[i].content_length;
+    download.predicted_bytes = heads[i].content_length;
+    download.output = std::make_tuple(output, offset);
+    offset += download.content_length;
+  }
+
+  track.output = output;
+}
+
+//! Copies the parts out of the output of the track into their own files (the ones without one)
+//! and removes the output, so the track is concatenated from its parts.
+void split_output(track_t& track)
+{
+  std::ifstream in{track.output, std::ios::binary};
+  std::vector<char> buffer = {};
+  for(auto const& download : track.downloads)
+  {
+    if(not download.output.has_value() or std::filesystem::exists(download.path))
+      continue;
+
+    buffer.resize(download.content_length);
+    in.seekg(static_cast<std::streamoff>(std::get<1>(download.output.value())));
+    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+    std::ofstream out{download.path, std::ios::binary};
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if(in.fail() or out.fail())
+    {
+      int const err = errno;
+      std::error_code errc{err, std::generic_category()};
+      throw std::filesystem::filesystem_error{"Couldn't split file", track.output, download.path, errc};
+    }
+  }
+
+  in.close();
+  std::remove(track.output.c_str());
+  track.output = "";
+}
+
+//! Merges the WebVTT-parts of the subtitle track into output (see concat_webvtt()), then the track
+//! is muxed from it. Parts that are missing (e.g. failed downloads) are left out.
+void merge_subtitles(track_t& track, std::filesystem::path const& output)
+{
+  std::vector<std::string> parts = {};
+  for(auto const& download : track.downloads)
+  {
+    std::ifstream in{download.path, std::ios::binary};
+    if(in.fail())
+      continue;
+
+    std::stringstream part;
+    part << in.rdbuf();
+    parts.push_back(part.str());
+  }
+
+  std::ofstream out{output, std::ios::binary};
+  out << concat_webvtt(parts, track.offset);
+  out.close();
+  if(out.fail())
+  {
+    int const err = errno;
+    std::error_code errc{err, std::generic_category()};
+    throw std::filesystem::filesystem_error{"Couldn't write file", output, errc};
+  }
+
+  track.output = output;
+}
+
+//! Keeps only the segments of the playlist that overlap the range, returns the start of the first one.
+auto cut_playlist(m3u8_t& playlist, std::tuple<double, double> const& range) -> double
+{
+  auto const starts = segment_starts(playlist.get_urls());
+  auto const [first, last] = select_segments(starts, std::get<0>(range), std::get<1>(range));
+  playlist.keep_urls(first, last);
+  return starts[first];
+}
+
+//! The fetch of I-frames with the (0-based) index is downloaded to "<NAME>-<INDEX>-i.ts" e.g. "name-007-i.ts".
+auto fetch_path(std::string const& name, size_t index, size_t ndigits) -> std::filesystem::path
+{
+  return std::format("{}-{:0>{}}-i.ts", name, index+1, ndigits);
+}
+
+/**
+ * Returns the (track, segment)-pairs of all tracks ordered by their position in the playback
+ * (relative to the length of the track), so the tracks are downloaded side by side
+ * and not one after the other.
+ */
+auto interleave(std::vector<track_t> const& tracks) -> std::vector<std::tuple<size_t, size_t>>
+{
+  std::vector<std::tuple<double, size_t, size_t>> positions = {};
+  for(size_t t=0; t<tracks.size(); t++)
+  {
+    size_t const n = tracks[t].downloads.size();
+    for(size_t i=0; i<n; i++)
+      positions.push_back(std::make_tuple((static_cast<double>(i) + 0.5)/static_cast<double>(n), t, i));
+  }
+
+  std::ranges::stable_sort(positions, {}, [](auto const& position) { return std::get<0>(position); });
+
+  std::vector<std::tuple<size_t, size_t>> order = {};
+  for(auto const& [_, t, i] : positions)
+    order.push_back(std::make_tuple(t, i));
+
+  return order;
+}
+
+auto pick_variant(curl_wrapper const& curl, m3u8_t const& master, jobspec_t const& spec, job_t::ask_t const& ask)
+  -> int
+{
+  assert(master.is_master());
+
+  if(spec.variant_policy == variant_policy_t::ask)
+  {
+    assert(ask and "Nobody to ask");
+    return ask(master);
+  }
+  // else
+
+  auto const variants = parse_variants(master);
+
+  std::optional<size_t> picked = {};
+  if(spec.variant_policy == variant_policy_t::automatic)
+  {
+    // Probe with the smallest variant, this measures the throughput with the least waste.
+    auto const smallest = select_variant(variants, variant_policy_t::min_bandwidth);
+    if(not smallest.has_value())
+      return -1;
+
+    m3u8_t const playlist = download_m3u8(curl, variants[smallest.value()].url);
+    double const duration = playlist_duration(playlist);
+
+    curl_wrapper probe_curl{curl};
+    probe_curl.clear_default_progressmeter();
+    double const throughput = probe_throughput(probe_curl, spec.name, playlist);
+
+    picked = select_variant(variants, throughput, duration, spec.deadline);
+
+    auto const [speed, speed_unit] = shorten_bytes(static_cast<size_t>(throughput));
+    curl.messages() << std::format("Measured throughput: {:.1f} {}/s", speed, speed_unit) << std::endl;
+  }
+  else
+    picked = select_variant(variants, spec.variant_policy);
+
+  if(not picked.has_value())
+    return -1;
+
+  auto const& variant = variants[picked.value()];
+  curl.messages() << std::format("Picked playlist {}: {}", variant.index+1, variant.str()) << std::endl;
+
+  return static_cast<int>(variant.index);
+}
+
+/**
+ * Picks the audio- and subtitle-renditions (#EXT-X-MEDIA) of the picked variant
+ * and downloads their playlists.
+ * Renditions without URI are contained in the variant stream and need no own track.
+ */
+auto pick_renditions(curl_wrapper const& curl, m3u8_t const& master, int picked) -> std::vector<track_t>
+{
+  assert(master.is_master());
+
+  auto const variants = parse_variants(master);
+  auto const renditions = parse_renditions(master);
+  auto const& variant = variants[picked];
+
+  std::vector<track_t> tracks = {};
+  for(auto const& [type, group_id] : {std::make_tuple("AUDIO", variant.audio), std::make_tuple("SUBTITLES", variant.subtitles)})
+  {
+    if(group_id.empty())
+      continue;
+
+    auto const selected = select_rendition(renditions, type, group_id);
+    if(not selected.has_value() or renditions[selected.value()].url.empty())
+      continue;
+
+    auto const& rendition = renditions[selected.value()];
+    curl.messages() << std::format("Picked {} rendition: {} {}", type, rendition.name, rendition.language) << std::endl;
+
+    tracks.push_back(track_t{type, rendition.language, download_m3u8(curl, rendition.url)});
+  }
+
+  return tracks;
+}
+
+/**
+ * Downloads the first segments of the playlist (as many as are downloaded in parallel)
+ * and returns the achieved throughput in bytes/s.
+ * The probe-files are deleted afterwards.
+ */
+auto probe_throughput(curl_wrapper& curl, std::string const& name, m3u8_t const& playlist) -> double
+{
+  size_t constexpr PROBE_SEGMENTS = 5;
+
+  std::vector<curl_wrapper::download_t> probes = {};
+  for(auto const& url : playlist.get_urls() | std::views::take(PROBE_SEGMENTS))
+    probes.push_back(curl_wrapper::download_t{std::format("{}-probe-{}.ts", name, probes.size()+1), url.url});
+
+  auto const start = std::chrono::steady_clock::now();
+  auto const results = curl.download_files(probes);
+  double const duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  size_t bytes = 0;
+  for(auto const& path : results.succeeded_files)
+  {
+    std::error_code errc;
+    auto const size = std::filesystem::file_size(path, errc);
+    if(not errc)
+      bytes += size;
+  }
+
+  for(auto const& probe : probes)
+    std::remove(probe.path.c_str());
+
+  return duration > 0.0 ? static_cast<double>(bytes)/duration : 0.0;
+}
+
+void print_lines(std::ostream& out, std::string const& str, int maxlines)
+{
+  std::stringstream ss{str};
+
+  std::string line = "";
+  std::getline(ss, line);
+  for(int i=0; ss.good() and i < maxlines; i++)
+  {
+    out << line << std::endl;
+    std::getline(ss, line);
+  }
+}
+
+/**
+ * Concats the parts of every track (or takes its output) and muxes all tracks into <NAME>.mp4 in a single ffmpeg-run.
+ * The first track is the variant stream, with audio-renditions only its video is used.
+ * With a time range (in seconds of the playlist) the output is cut precisely to it.
+ */
+int concat_ffmpeg(recorder_t const& recorder, std::string const& name, std::vector<track_t> const& tracks,
+    std::optional<std::tuple<uint32_t, uint32_t>> scale, std::optional<std::tuple<double, double>> range, bool quiet)
+{
+  assert(not tracks.empty());
+
+  std::optional<phase_scope_t> phase_span{std::in_place, recorder, "list files", "mux"};
+  std::vector<std::filesystem::path> listfilenames = {};
+  for(size_t t=0; t<tracks.size(); t++)
+  {
+    if(not tracks[t].output.empty()) // The parts are in one file already.
+    {
+      listfilenames.push_back("");
+      continue;
+    }
+
+    std::filesystem::path const listfilename = t == 0 ? name + "-list.txt" : std::format("{}-list-{}.txt", name, t+1);
+    listfilenames.push_back(listfilename);
+
+    std::ofstream listfile{listfilename};
+    for(auto const& download : tracks[t].downloads)
+    {
+      if(listfile.fail())
+        break;
+
+      // Quoted, a ' is written as '\'' (closing the quotes, an escaped ', opening them again).
+      std::string quoted = "";
+      for(char const c : download.path.string())
+        quoted += c == '\'' ? std::string{"'\\''"} : std::string{c};
+      listfile << "file '" << quoted << "'" << std::endl;
+    }
+
+    if(listfile.fail())
+    {
+      int const err = errno;
+      std::error_code errc{err, std::generic_category()};
+      throw std::filesystem::filesystem_error{"Couldn't write file", listfilename, errc};
+    }
+
+    listfile.close();
+  }
+
+  // ---
+
+  // The arguments are passed to ffmpeg as they are (no shell), so names can have any characters.
+  std::vector<std::string> command = {"ffmpeg"};
+
+  // Quiet for running in the background, then ffmpeg mustn't read the keyboard either.
+  if(quiet)
+    command.insert(command.end(), {"-nostdin", "-loglevel", "error"});
+
+  for(size_t t=0; t<listfilenames.size(); t++)
+  {
+    // The renditions start at their own segment boundaries, so they are shifted relative to the video.
+    if(range.has_value() and t > 0)
+      command.insert(command.end(), {"-itsoffset", std::format("{:.3f}", tracks[t].offset - tracks[0].offset)});
+    if(not tracks[t].output.empty())
+      command.insert(command.end(), {"-i", tracks[t].output.string()});
+    else
+      command.insert(command.end(), {"-f", "concat", "-safe", "0", "-i", listfilenames[t].string()});
+  }
+
+  // Without renditions ffmpeg picks the streams itself.
+  if(tracks.size() > 1)
+  {
+    bool const has_audio = std::ranges::any_of(tracks, [](auto const& track) { return track.type == "AUDIO"; });
+    if(has_audio)
+      command.insert(command.end(), {"-map", "0:v"});
+    else
+      command.insert(command.end(), {"-map", "0:v", "-map", "0:a?"});
+
+    size_t naudio = 0, nsubtitles = 0;
+    for(size_t t=1; t<tracks.size(); t++)
+    {
+      auto const& track = tracks[t];
+      if(track.type == "AUDIO")
+      {
+        command.insert(command.end(), {"-map", std::format("{}:a", t)});
+        if(not track.language.empty())
+          command.insert(command.end(), {std::format("-metadata:s:a:{}", naudio), "language=" + track.language});
+        naudio++;
+      }
+      else if(track.type == "SUBTITLES")
+      {
+        command.insert(command.end(), {"-map", std::format("{}:s", t)});
+        if(not track.language.empty())
+          command.insert(command.end(), {std::format("-metadata:s:s:{}", nsubtitles), "language=" + track.language});
+        nsubtitles++;
+      }
+    }
+
+    if(nsubtitles > 0) // mp4 supports only this subtitle-format.
+      command.insert(command.end(), {"-c:s", "mov_text"});
+  }
+
+  // Scale (and pad) to the same resolution, if it changes between the parts.
+  if(scale.has_value())
+    command.insert(command.end(), {"-vf",
+      std::format("scale={0}:{1}:force_original_aspect_ratio=decrease,pad={0}:{1}:(ow-iw)/2:(oh-ih)/2",
+        std::get<0>(scale.value()), std::get<1>(scale.value()))});
+
+  // The downloaded segments cover a bit more than the time range.
+  if(range.has_value())
+    command.insert(command.end(), {"-ss", std::format("{:.3f}", std::get<0>(range.value()) - tracks[0].offset),
+      "-t", std::format("{:.3f}", std::get<1>(range.value()) - std::get<0>(range.value()))});
+
+  command.push_back(name + ".mp4");
+  phase_span.emplace(recorder, "ffmpeg", "mux");
+  int ret = run_command(command);
+
+  // Delete all intermediated files.
+  phase_span.emplace(recorder, "cleanup", "mux");
+  for(auto const& listfilename : listfilenames)
+    if(not listfilename.empty())
+      std::remove(listfilename.c_str());
+  for(auto const& track : tracks)
+  {
+    for(auto const& download : track.downloads)
+      std::remove(download.path.c_str());
+    if(not track.output.empty())
+      std::remove(track.output.c_str());
+  }
+
+  return ret;
+}
+
+/**
+ * Runs the program of args[0] (searched in PATH) with the arguments, without a shell, and waits for it.
+ * Returns its exit-code, 128 plus the signal if a signal killed it and 127 if it couldn't be started.
+ */
+int run_command(std::vector<std::string> const& args)
+{
+  assert(not args.empty());
+
+  std::vector<char*> argv = {};
+  for(auto const& arg : args)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  pid_t pid = 0;
+  if(posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+    return 127;
+
+  int status = 0;
+  while(waitpid(pid, &status, 0) < 0)
+    if(errno != EINTR)
+      return 127;
+
+  return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
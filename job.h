@@ -0,0 +1,164 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <exception> // std::exception_ptr
+#include <filesystem>
+#include <functional>
+#include <iostream> // std::cout
+#include <istream>
+#include <map>
+#include <memory> // std::shared_ptr
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "aes128.h"
+#include "curl_wrapper.h"
+#include "m3u8.h"
+#include "preview.h"
+#include "profiler.h"
+#include "timerange.h"
+#include "trace.h"
+#include "variant.h"
+
+//
+// A job downloads all parts of a m3u8-file and muxes them into <NAME>.mp4 via ffmpeg.
+// run_jobs() downloads the parts of many jobs in a single download_files()-run,
+// so they share the parallel transfers, the connections and the bandwidth budget.
+//
+
+//! What to download, given on the command line or as a line of a batch-file.
+struct jobspec_t
+{
+  std::string url = "";
+  std::string name = "";
+
+  variant_policy_t variant_policy = variant_policy_t::automatic;
+  std::optional<double> deadline = {}; // in seconds
+  bool adaptive = false;
+
+  // Only the clip [from, to) is downloaded, by default from the beginning to the end.
+  std::optional<position_t> from = {};
+  std::optional<position_t> to = {};
+
+  preview_t preview = preview_t::none; // only the key frames of the I-frame playlist
+
+  bool one_file = false; // the parts of a track are written right into one file, see track_t::output
+};
+
+//! Parse a batch-file with one job per line: "<URL> <NAME> [<POLICY>]".
+//! Empty lines and comments (starting with #) are skipped, the rest is taken from the defaults.
+//! Returns the jobs or an error-message.
+auto parse_batchfile(std::istream& istream, jobspec_t const& defaults)
+  -> std::variant<std::vector<jobspec_t>, std::string>;
+
+//! A playlist whose segments are downloaded and then muxed with the other tracks into the output.
+struct track_t
+{
+  std::string type; // VIDEO (the variant stream itself), AUDIO or SUBTITLES (an #EXT-X-MEDIA rendition)
+  std::string language;
+  m3u8_t playlist;
+  std::vector<curl_wrapper::download_t> downloads = {};
+
+  std::vector<m3u8_t> mirrors = {}; // the same playlist on other pathways (redundant variants)
+
+  double offset = 0.0; // start of the first segment in seconds, if the playlist was cut to a time range
+
+  //! The downloads are written one after the other into this file (see curl_wrapper::download_t::output)
+  //! instead of their own files, empty if they aren't.
+  std::filesystem::path output = "";
+};
+
+class job_t
+{
+public:
+
+  //! Lets the user pick a variant (for variant_policy_t::ask), returns its index or -1 for cancel.
+  using ask_t = std::function<int(m3u8_t const& master)>;
+
+  explicit job_t(jobspec_t const& spec);
+
+  //! Downloads the m3u8-file(s), picks the variant and renditions and fetches the keys.
+  //! The job records its phases into the trace and profiler of the curl (see curl_wrapper::trace() and
+  //! curl_wrapper::profiler()), if it has them.
+  //! Returns false if the user canceled. Throws on error.
+  bool prepare(curl_wrapper const& curl, ask_t const& ask = {});
+
+  //! The downloads of all tracks in playback order.
+  auto downloads() const -> std::vector<curl_wrapper::download_t>;
+
+  //! Hooks for download_files(), the index is the position in downloads().
+  void on_start(size_t index, curl_wrapper::download_t& download);
+  void on_finish(size_t index, curl_wrapper::transfer_t const& transfer);
+
+  //! The download (as it was started) that failed with the error.
+  auto find_download(curl_wrapper_error const& error) const -> std::optional<curl_wrapper::download_t>;
+
+  //! Leave out a failed download of the output.
+  void drop_download(std::filesystem::path const& path);
+
+  //! Removes all downloaded parts (of a canceled or failed job).
+  void discard();
+
+  //! Concat and mux all parts into <NAME>.mp4 via ffmpeg and returns the exit-code of ffmpeg.
+  //! Quiet lets ffmpeg only print errors (for muxing many jobs at once). Throws on error.
+  int mux(bool quiet = false);
+
+  inline auto spec() const -> jobspec_t const& { return m_spec; }
+  inline auto size() const -> size_t { return m_order.size(); }
+
+
+private:
+
+  bool prepare_preview(curl_wrapper const& curl, m3u8_t const& m3u8);
+  int mux_preview(bool quiet);
+
+  jobspec_t m_spec;
+
+  // With adaptive the variant may change at every segment.
+  std::vector<variant_t> m_variants = {};
+  std::optional<variant_switcher_t> m_switcher = {};
+
+  std::vector<track_t> m_tracks = {};
+  std::vector<std::tuple<size_t, size_t>> m_order = {}; // (track, segment) of the downloads
+  std::map<std::string, aes128_block_t> m_keys = {};
+
+  std::optional<std::tuple<double, double>> m_range = {}; // (from, to) in seconds of the time range
+
+  std::optional<coalesced_t> m_preview = {}; // the I-frames, if only they are downloaded
+
+  std::shared_ptr<trace_t> m_trace = nullptr;
+  std::shared_ptr<profiler_t> m_profiler = nullptr;
+  std::ostream* m_messages = &std::cout; // see curl_wrapper::messages()
+};
+
+//! The outcome of a job in run_jobs().
+struct job_result_t
+{
+  std::exception_ptr error = nullptr; // set if the job failed
+  int status = 0;                     // exit-code of ffmpeg
+};
+
+//! Lets the caller of run_jobs() follow and cancel the jobs, all callbacks are optional.
+//! on_progress and is_canceled are called from the downloading thread, on_done also from the muxing threads.
+//! The ready downloads of on_progress are the ones at the beginning of the job that all succeeded,
+//! so the job can be consumed (e.g. previewed) up to them.
+struct job_observer_t
+{
+  std::function<void(size_t job, size_t finished, size_t ready, size_t total)> on_progress = {};
+  std::function<void(size_t job, job_result_t const& result)> on_done = {};
+  std::function<bool(size_t job)> is_canceled = {};
+};
+
+//! Takes the downloads of the jobs round robin, so every job gets its share of the parallel transfers.
+//! Returns (job, index)-pairs for the given number of downloads per job.
+auto interleave_jobs(std::vector<size_t> const& sizes) -> std::vector<std::tuple<size_t, size_t>>;
+
+//! Downloads the (prepared) jobs in one download_files()-run and muxes every job as soon as its downloads
+//! are complete, with at most muxers ffmpeg-runs at the same time.
+auto run_jobs(curl_wrapper& curl, std::vector<job_t>& jobs, size_t muxers, job_observer_t const& observer = {})
+  -> std::vector<job_result_t>;
+
+//! Download a m3u8-file and resolve its urls. Throws on error.
+auto download_m3u8(curl_wrapper const& curl, std::string const& url) -> m3u8_t;
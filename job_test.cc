@@ -0,0 +1,65 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "job.h"
+
+TEST(job_tests, parse_batchfile)
+{
+  std::stringstream batchfile{
+    "# url name [policy]\n"
+    "https://server/first/master.m3u8 first\n"
+    "\n"
+    "  https://server/second/master.m3u8\tsecond  max-resolution  \n"
+  };
+
+  jobspec_t defaults;
+  defaults.deadline = 600.0;
+
+  auto const result = parse_batchfile(batchfile, defaults);
+  ASSERT_TRUE(std::holds_alternative<std::vector<jobspec_t>>(result));
+
+  auto const& jobs = std::get<std::vector<jobspec_t>>(result);
+  ASSERT_EQ(jobs.size(), 2);
+
+  EXPECT_EQ(jobs[0].url, "https://server/first/master.m3u8");
+  EXPECT_EQ(jobs[0].name, "first");
+  EXPECT_EQ(jobs[0].variant_policy, variant_policy_t::automatic);
+  EXPECT_EQ(jobs[0].deadline, 600.0);
+
+  EXPECT_EQ(jobs[1].url, "https://server/second/master.m3u8");
+  EXPECT_EQ(jobs[1].name, "second");
+  EXPECT_EQ(jobs[1].variant_policy, variant_policy_t::max_resolution);
+}
+
+TEST(job_tests, parse_batchfile_errors)
+{
+  auto error = [](std::string const& content) -> std::string
+  {
+    std::stringstream batchfile{content};
+    auto const result = parse_batchfile(batchfile, jobspec_t{});
+    return std::holds_alternative<std::string>(result) ? std::get<std::string>(result) : "";
+  };
+
+  EXPECT_EQ(error("https://server/master.m3u8\n"), "Line 1: Expected `<URL> <NAME> [<POLICY>]'");
+  EXPECT_EQ(error("\nhttps://server/master.m3u8 name auto extra\n"), "Line 2: Expected `<URL> <NAME> [<POLICY>]'");
+  EXPECT_EQ(error("https://server/master.m3u8 name best\n"), "Line 1: Unknown pick-policy `best'");
+  EXPECT_EQ(error("https://server/master.m3u8 name ask\n"), "Line 1: The pick-policy ask isn't possible in a batch");
+  EXPECT_EQ(error("https://server/a.m3u8 name\nhttps://server/b.m3u8 name\n"), "Line 2: The name `name' is used twice");
+  EXPECT_EQ(error("# only a comment\n"), "");
+}
+
+TEST(job_tests, interleave_jobs)
+{
+  auto const order = interleave_jobs({3, 1, 2});
+
+  std::vector<std::tuple<size_t, size_t>> const expected = {
+    {0, 0}, {1, 0}, {2, 0},
+    {0, 1}, {2, 1},
+    {0, 2},
+  };
+  EXPECT_EQ(order, expected);
+
+  EXPECT_TRUE(interleave_jobs({}).empty());
+  EXPECT_TRUE(interleave_jobs({0, 0}).empty());
+}
@@ -0,0 +1,387 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <cmath> // std::isfinite, std::trunc, std::abs
+#include <cstdlib> // std::strtod
+#include <format>
+
+#include "json.h"
+
+auto json_t::get(std::string const& key) const -> std::optional<json_t>
+{
+  if(not is_object())
+    return {};
+
+  auto const& object = as_object();
+  auto it = object.find(key);
+  if(it == object.end())
+    return {};
+
+  return it->second;
+}
+
+auto json_t::get_string(std::string const& key) const -> std::optional<std::string>
+{
+  auto const value = get(key);
+  if(not value.has_value() or not value->is_string())
+    return {};
+  return value->as_string();
+}
+
+auto json_t::get_number(std::string const& key) const -> std::optional<double>
+{
+  auto const value = get(key);
+  if(not value.has_value() or not value->is_number())
+    return {};
+  return value->as_number();
+}
+
+void append_json_string(std::string& out, std::string_view str)
+{
+  out += '"';
+  for(unsigned char c : str)
+  {
+    switch(c)
+    {
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if(c < 0x20)
+          out += std::format("\\u{:04x}", c);
+        else
+          out += static_cast<char>(c);
+    }
+  }
+  out += '"';
+}
+
+static void append_json(std::string& out, json_t const& json)
+{
+  if(json.is_null())
+    out += "null";
+  else if(json.is_bool())
+    out += json.as_bool() ? "true" : "false";
+  else if(json.is_number())
+  {
+    double const number = json.as_number();
+    if(not std::isfinite(number)) // not representable in JSON
+      out += "null";
+    else if(std::abs(number) < 9007199254740992.0 and number == std::trunc(number)) // integral and exact (2^53)
+      out += std::format("{}", static_cast<int64_t>(number));
+    else
+      out += std::format("{}", number);
+  }
+  else if(json.is_string())
+    append_json_string(out, json.as_string());
+  else if(json.is_array())
+  {
+    out += '[';
+    bool first = true;
+    for(auto const& value : json.as_array())
+    {
+      if(not first)
+        out += ',';
+      first = false;
+      append_json(out, value);
+    }
+    out += ']';
+  }
+  else
+  {
+    out += '{';
+    bool first = true;
+    for(auto const& [key, value] : json.as_object())
+    {
+      if(not first)
+        out += ',';
+      first = false;
+      append_json_string(out, key);
+      out += ':';
+      append_json(out, value);
+    }
+    out += '}';
+  }
+}
+
+auto json_t::str() const -> std::string
+{
+  std::string out = "";
+  append_json(out, *this);
+  return out;
+}
+
+// ---
+
+namespace
+{
+  //! Recursive descent over the grammar of RFC 8259 section 2.
+  class json_parser_t
+  {
+  public:
+
+    explicit json_parser_t(std::string_view text) : m_text{text} {}
+
+    auto parse() -> std::optional<json_t>
+    {
+      auto value = parse_value(0);
+      skip_whitespace();
+      if(not value.has_value() or m_pos != m_text.size())
+        return {};
+      return value;
+    }
+
+
+  private:
+
+    // Limits the recursion for nested arrays and objects of untrusted input.
+    static constexpr size_t max_depth = 64;
+
+    void skip_whitespace()
+    {
+      while(m_pos < m_text.size()
+          and (m_text[m_pos] == ' ' or m_text[m_pos] == '\t' or m_text[m_pos] == '\n' or m_text[m_pos] == '\r'))
+        m_pos++;
+    }
+
+    auto consume(std::string_view literal) -> bool
+    {
+      if(m_text.substr(m_pos, literal.size()) != literal)
+        return false;
+      m_pos += literal.size();
+      return true;
+    }
+
+    auto parse_value(size_t depth) -> std::optional<json_t>
+    {
+      skip_whitespace();
+      if(m_pos >= m_text.size() or depth > max_depth)
+        return {};
+
+      switch(m_text[m_pos])
+      {
+        case '{': return parse_object(depth);
+        case '[': return parse_array(depth);
+        case '"':
+        {
+          auto s = parse_string();
+          if(not s.has_value())
+            return {};
+          return json_t{std::move(s.value())};
+        }
+        case 't': return consume("true") ? std::optional<json_t>{true} : std::nullopt;
+        case 'f': return consume("false") ? std::optional<json_t>{false} : std::nullopt;
+        case 'n': return consume("null") ? std::optional<json_t>{nullptr} : std::nullopt;
+        default: return parse_number();
+      }
+    }
+
+    auto parse_object(size_t depth) -> std::optional<json_t>
+    {
+      m_pos++; // {
+      json_t::object_t object = {};
+
+      skip_whitespace();
+      if(consume("}"))
+        return json_t{std::move(object)};
+
+      while(true)
+      {
+        skip_whitespace();
+        if(m_pos >= m_text.size() or m_text[m_pos] != '"')
+          return {};
+        auto key = parse_string();
+        if(not key.has_value())
+          return {};
+
+        skip_whitespace();
+        if(not consume(":"))
+          return {};
+
+        auto value = parse_value(depth+1);
+        if(not value.has_value())
+          return {};
+        object.insert_or_assign(std::move(key.value()), std::move(value.value()));
+
+        skip_whitespace();
+        if(consume("}"))
+          return json_t{std::move(object)};
+        if(not consume(","))
+          return {};
+      }
+    }
+
+    auto parse_array(size_t depth) -> std::optional<json_t>
+    {
+      m_pos++; // [
+      json_t::array_t array = {};
+
+      skip_whitespace();
+      if(consume("]"))
+        return json_t{std::move(array)};
+
+      while(true)
+      {
+        auto value = parse_value(depth+1);
+        if(not value.has_value())
+          return {};
+        array.push_back(std::move(value.value()));
+
+        skip_whitespace();
+        if(consume("]"))
+          return json_t{std::move(array)};
+        if(not consume(","))
+          return {};
+      }
+    }
+
+    auto parse_hex4() -> std::optional<uint32_t>
+    {
+      if(m_pos+4 > m_text.size())
+        return {};
+
+      uint32_t code = 0;
+      for(size_t k=0; k<4; k++)
+      {
+        char const c = m_text[m_pos++];
+        code <<= 4;
+        if(c >= '0' and c <= '9')
+          code |= c - '0';
+        else if(c >= 'a' and c <= 'f')
+          code |= c - 'a' + 10;
+        else if(c >= 'A' and c <= 'F')
+          code |= c - 'A' + 10;
+        else
+          return {};
+      }
+      return code;
+    }
+
+    static void append_utf8(std::string& out, uint32_t code)
+    {
+      if(code < 0x80)
+        out += static_cast<char>(code);
+      else if(code < 0x800)
+      {
+        out += static_cast<char>(0xc0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+      }
+      else if(code < 0x10000)
+      {
+        out += static_cast<char>(0xe0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+      }
+      else
+      {
+        out += static_cast<char>(0xf0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+      }
+    }
+
+    auto parse_string() -> std::optional<std::string>
+    {
+      m_pos++; // "
+      std::string s = "";
+
+      while(m_pos < m_text.size())
+      {
+        char const c = m_text[m_pos++];
+        if(c == '"')
+          return s;
+        if(static_cast<unsigned char>(c) < 0x20) // control characters must be escaped
+          return {};
+        if(c != '\\')
+        {
+          s += c;
+          continue;
+        }
+
+        if(m_pos >= m_text.size())
+          return {};
+        switch(m_text[m_pos++])
+        {
+          case '"':  s += '"'; break;
+          case '\\': s += '\\'; break;
+          case '/':  s += '/'; break;
+          case 'b':  s += '\b'; break;
+          case 'f':  s += '\f'; break;
+          case 'n':  s += '\n'; break;
+          case 'r':  s += '\r'; break;
+          case 't':  s += '\t'; break;
+          case 'u':
+          {
+            auto code = parse_hex4();
+            if(not code.has_value())
+              return {};
+
+            // A high surrogate must be followed by a low one.
+            if(code.value() >= 0xd800 and code.value() <= 0xdbff)
+            {
+              if(not consume("\\u"))
+                return {};
+              auto const low = parse_hex4();
+              if(not low.has_value() or low.value() < 0xdc00 or low.value() > 0xdfff)
+                return {};
+              code = 0x10000 + ((code.value() - 0xd800) << 10) + (low.value() - 0xdc00);
+            }
+            else if(code.value() >= 0xdc00 and code.value() <= 0xdfff)
+              return {};
+
+            append_utf8(s, code.value());
+            break;
+          }
+          default:
+            return {};
+        }
+      }
+
+      return {}; // unterminated
+    }
+
+    auto parse_number() -> std::optional<json_t>
+    {
+      size_t const start = m_pos;
+      auto digits = [this]()
+      {
+        size_t const begin = m_pos;
+        while(m_pos < m_text.size() and m_text[m_pos] >= '0' and m_text[m_pos] <= '9')
+          m_pos++;
+        return m_pos - begin;
+      };
+
+      consume("-");
+      if(consume("0"))
+        ;
+      else if(digits() == 0)
+        return {};
+
+      if(consume(".") and digits() == 0)
+        return {};
+
+      if(m_pos < m_text.size() and (m_text[m_pos] == 'e' or m_text[m_pos] == 'E'))
+      {
+        m_pos++;
+        if(not consume("+"))
+          consume("-");
+        if(digits() == 0)
+          return {};
+      }
+
+      std::string const number{m_text.substr(start, m_pos-start)};
+      return json_t{std::strtod(number.c_str(), nullptr)};
+    }
+
+    std::string_view m_text;
+    size_t m_pos = 0;
+  };
+}
+
+auto parse_json(std::string_view text) -> std::optional<json_t>
+{
+  return json_parser_t{text}.parse();
+}
@@ -0,0 +1,72 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <cstdint> // int64_t
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+//
+// Hand-written reader and writer for JSON, just enough for the protocol of the daemon.
+// The spec is https://datatracker.ietf.org/doc/html/rfc8259.
+// Numbers are kept as double, strings as UTF-8 (\u-escapes are decoded, surrogate pairs included).
+//
+
+class json_t
+{
+public:
+
+  using array_t = std::vector<json_t>;
+  using object_t = std::map<std::string, json_t>;
+
+  json_t() = default; // null
+  json_t(std::nullptr_t) {}
+  json_t(bool value) : m_value{value} {}
+  json_t(double value) : m_value{value} {}
+  json_t(int value) : m_value{static_cast<double>(value)} {}
+  json_t(int64_t value) : m_value{static_cast<double>(value)} {}
+  json_t(size_t value) : m_value{static_cast<double>(value)} {}
+  json_t(char const* value) : m_value{std::string{value}} {}
+  json_t(std::string value) : m_value{std::move(value)} {}
+  json_t(array_t value) : m_value{std::move(value)} {}
+  json_t(object_t value) : m_value{std::move(value)} {}
+
+  inline auto is_null() const -> bool { return std::holds_alternative<std::nullptr_t>(m_value); }
+  inline auto is_bool() const -> bool { return std::holds_alternative<bool>(m_value); }
+  inline auto is_number() const -> bool { return std::holds_alternative<double>(m_value); }
+  inline auto is_string() const -> bool { return std::holds_alternative<std::string>(m_value); }
+  inline auto is_array() const -> bool { return std::holds_alternative<array_t>(m_value); }
+  inline auto is_object() const -> bool { return std::holds_alternative<object_t>(m_value); }
+
+  //! Throw std::bad_variant_access on the wrong type.
+  inline auto as_bool() const -> bool { return std::get<bool>(m_value); }
+  inline auto as_number() const -> double { return std::get<double>(m_value); }
+  inline auto as_string() const -> std::string const& { return std::get<std::string>(m_value); }
+  inline auto as_array() const -> array_t const& { return std::get<array_t>(m_value); }
+  inline auto as_object() const -> object_t const& { return std::get<object_t>(m_value); }
+
+  //! The member of an object, if this is an object and has the member.
+  auto get(std::string const& key) const -> std::optional<json_t>;
+
+  //! Typed shortcuts for get(), empty if the member is missing or has another type.
+  auto get_string(std::string const& key) const -> std::optional<std::string>;
+  auto get_number(std::string const& key) const -> std::optional<double>;
+
+  //! Serialize without any whitespace, so the result fits into a single line.
+  auto str() const -> std::string;
+
+  auto operator==(json_t const& other) const -> bool = default;
+
+
+private:
+
+  std::variant<std::nullptr_t, bool, double, std::string, array_t, object_t> m_value = nullptr;
+};
+
+//! Append the string as JSON-string (quoted and escaped), e.g. for writing JSON without a json_t.
+void append_json_string(std::string& out, std::string_view str);
+
+//! Parse a complete JSON-text (surrounding whitespace is allowed), empty on a syntax error.
+auto parse_json(std::string_view text) -> std::optional<json_t>;
@@ -0,0 +1,55 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "json.h"
+
+TEST(json_tests, parse)
+{
+  auto const json = parse_json(R"( {"cmd": "submit", "id": 12, "ratio": -1.5e1, "ok": true, "none": null,
+      "list": [1, "two", [], {}], "text": "a\"b\\c\n\u00e9\ud83d\ude00"} )");
+  ASSERT_TRUE(json.has_value());
+  ASSERT_TRUE(json->is_object());
+
+  EXPECT_EQ(json->get_string("cmd"), "submit");
+  EXPECT_EQ(json->get_number("id"), 12.0);
+  EXPECT_EQ(json->get_number("ratio"), -15.0);
+  EXPECT_EQ(json->get("ok"), json_t{true});
+  EXPECT_TRUE(json->get("none")->is_null());
+  EXPECT_EQ(json->get_string("text"), "a\"b\\c\n\xc3\xa9\xf0\x9f\x98\x80");
+
+  auto const list = json->get("list");
+  ASSERT_TRUE(list.has_value() and list->is_array());
+  ASSERT_EQ(list->as_array().size(), 4);
+  EXPECT_EQ(list->as_array()[1], json_t{"two"});
+
+  EXPECT_FALSE(json->get("missing").has_value());
+  EXPECT_FALSE(json->get_string("id").has_value()); // wrong type
+}
+
+TEST(json_tests, parse_errors)
+{
+  for(auto const text : {"", "{", "{\"a\"}", "{\"a\":1,}", "[1 2]", "\"abc", "01", "1.", "-", "tru", "{} {}",
+      "\"\\x\"", "\"\\ud800\"", "\"tab\there\"", "{a:1}"})
+    EXPECT_FALSE(parse_json(text).has_value()) << text;
+
+  // The nesting is limited.
+  EXPECT_TRUE(parse_json(std::string(10, '[') + std::string(10, ']')).has_value());
+  EXPECT_FALSE(parse_json(std::string(1000, '[') + std::string(1000, ']')).has_value());
+}
+
+TEST(json_tests, str)
+{
+  json_t const json = json_t::object_t{
+    {"id", 3},
+    {"name", "a \"quoted\"\nline"},
+    {"progress", 0.25},
+    {"done", false},
+    {"jobs", json_t::array_t{json_t{}, 1, "x"}},
+  };
+
+  std::string const text = json.str();
+  EXPECT_EQ(text, R"({"done":false,"id":3,"jobs":[null,1,"x"],"name":"a \"quoted\"\nline","progress":0.25})");
+  EXPECT_EQ(parse_json(text), json);
+
+  EXPECT_EQ(json_t{std::string{"\x01"}}.str(), R"("\u0001")");
+}
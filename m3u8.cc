@@ -1,10 +1,10 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
 #include <cassert>
+#include <charconv> // std::from_chars
 #include <cstring> // strerror
 #include <filesystem>
 #include <fstream>
 #include <ranges>
-#include <regex>
 #include <system_error> // std::error_code
 #include <variant>
 
@@ -13,6 +13,7 @@
 
 #include "m3u8.h"
 #include "string_util.h"
+#include "url.h"
 
 namespace fs = std::filesystem;
 
@@ -21,6 +22,12 @@ static constexpr std::string EXTM3U = "#EXTM3U";
 auto parse_m3u8(std::istream& istream) -> std::variant<std::vector<urlprops_t>, m3u8_errc>;
 auto parse_extinf(std::string const& line) -> std::map<std::string, std::string>;
 auto parse_extxstreaminfo(std::string const& line) -> std::map<std::string, std::string>;
+auto parse_extxkey(std::string const& line) -> std::map<std::string, std::string>;
+auto parse_extxmedia(std::string const& line) -> std::map<std::string, std::string>;
+auto parse_extxiframestreaminf(std::string const& line) -> std::map<std::string, std::string>;
+auto parse_extxbyterange(std::string const& line) -> std::optional<std::tuple<uint64_t, std::optional<uint64_t>>>;
+auto parse_extxcontentsteering(std::string const& line) -> std::map<std::string, std::string>;
+auto parse_number(std::string const& line) -> std::optional<uint64_t>;
 
 auto tokenize_properties(std::string const& info) -> std::vector<std::string>;
 auto parse_properties(std::vector<std::string> const& props) -> std::map<std::string, std::string>;
@@ -45,6 +52,15 @@ void m3u8_t::parse_m3u8(std::istream& istream)
 
   std::map<std::string, std::string> properties = {};
 
+  // #EXT-X-KEY applies to all following segments (until the next #EXT-X-KEY).
+  std::map<std::string, std::string> key = {};
+  uint64_t sequence = 0;
+  bool segment = false;
+
+  // #EXT-X-BYTERANGE without offset continues after the one of the segment before.
+  std::optional<std::tuple<uint64_t, std::optional<uint64_t>>> byterange = {};
+  uint64_t next_offset = 0;
+
   while(std::getline(istream, line))
   {
     if(line.starts_with("#EXT-X-STREAM-INF:"))
@@ -55,6 +71,33 @@ void m3u8_t::parse_m3u8(std::istream& istream)
 
       m_master = true;
     }
+    else if(line.starts_with("#EXT-X-MEDIA:"))
+    {
+      auto props = parse_extxmedia(line);
+      std::string const uri = props.contains("URI") ? props.at("URI") : "";
+      props.erase("URI");
+      m_media.push_back(urlprops_t{uri, props});
+
+      m_master = true;
+    }
+    else if(line.starts_with("#EXT-X-I-FRAME-STREAM-INF:"))
+    {
+      auto props = parse_extxiframestreaminf(line);
+      std::string const uri = props.contains("URI") ? props.at("URI") : "";
+      props.erase("URI");
+      if(not uri.empty())
+        m_iframe_streams.push_back(urlprops_t{uri, props});
+
+      m_master = true;
+    }
+    else if(line == "#EXT-X-I-FRAMES-ONLY")
+    {
+      m_iframes_only = true;
+    }
+    else if(line.starts_with("#EXT-X-BYTERANGE:"))
+    {
+      byterange = parse_extxbyterange(line);
+    }
     else if(line.starts_with("#EXTINF:"))
     {
       auto props = parse_extinf(line);
@@ -62,9 +105,52 @@ void m3u8_t::parse_m3u8(std::istream& istream)
         properties[prop.first] = prop.second;
 
       m_playlist = true;
+      segment = true;
+    }
+    else if(line.starts_with("#EXT-X-CONTENT-STEERING:"))
+    {
+      m_steering = parse_extxcontentsteering(line);
+      m_master = true;
+    }
+    else if(line == "#EXT-X-INDEPENDENT-SEGMENTS")
+    {
+      m_independent_segments = true;
+    }
+    else if(line.starts_with("#EXT-X-PROGRAM-DATE-TIME:"))
+    {
+      properties["PROGRAM-DATE-TIME"] = line.substr(line.find(':') + 1);
+    }
+    else if(line.starts_with("#EXT-X-MEDIA-SEQUENCE:"))
+    {
+      sequence = parse_number(line).value_or(0);
+    }
+    else if(line.starts_with("#EXT-X-KEY:"))
+    {
+      key = parse_extxkey(line);
+      if(key.contains("METHOD") and key.at("METHOD") == "NONE")
+        key = {};
     }
     else if(not line.starts_with("#") and not line.empty())
     {
+      if(segment)
+      {
+        properties["MEDIA-SEQUENCE"] = std::to_string(sequence);
+        for(auto const& [name, value] : key)
+          properties["KEY-" + name] = value;
+
+        sequence++;
+        segment = false;
+
+        if(byterange.has_value())
+        {
+          auto const [length, offset] = byterange.value();
+          properties["BYTERANGE-OFFSET"] = std::to_string(offset.value_or(next_offset));
+          properties["BYTERANGE-LENGTH"] = std::to_string(length);
+          next_offset = offset.value_or(next_offset) + length;
+          byterange = {};
+        }
+      }
+
       urls.push_back(urlprops_t{line, properties});
       properties = {};
     }
@@ -150,6 +236,125 @@ auto parse_extxstreaminfo(std::string const& line) -> std::map<std::string, std:
   return parse_properties(tokens);
 }
 
+//! Format is "#EXT-X-KEY:METHOD=AES-128,URI="...",IV=0x..."
+//! see https://datatracker.ietf.org/doc/html/rfc8216#section-4.3.2.4
+auto parse_extxkey(std::string const& line) -> std::map<std::string, std::string>
+{
+  assert(line.starts_with("#EXT-X-KEY:"));
+
+  auto pos = line.find(':');
+  if(pos == std::string::npos)
+    return {};
+
+  std::string info = line.substr(pos+1);
+
+  auto tokens = tokenize_properties(info);
+  if(tokens.size() == 0)
+    return {};
+
+  return parse_properties(tokens);
+}
+
+//! Format is "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID="...",NAME="...",LANGUAGE="...",DEFAULT=YES,URI="...""
+//! see https://datatracker.ietf.org/doc/html/rfc8216#section-4.3.4.1
+auto parse_extxmedia(std::string const& line) -> std::map<std::string, std::string>
+{
+  assert(line.starts_with("#EXT-X-MEDIA:"));
+
+  auto pos = line.find(':');
+  if(pos == std::string::npos)
+    return {};
+
+  std::string info = line.substr(pos+1);
+
+  auto tokens = tokenize_properties(info);
+  if(tokens.size() == 0)
+    return {};
+
+  return parse_properties(tokens);
+}
+
+//! Format is "#EXT-X-I-FRAME-STREAM-INF:BANDWIDTH=...,RESOLUTION=...,URI="...""
+//! see https://datatracker.ietf.org/doc/html/rfc8216#section-4.3.4.3
+auto parse_extxiframestreaminf(std::string const& line) -> std::map<std::string, std::string>
+{
+  assert(line.starts_with("#EXT-X-I-FRAME-STREAM-INF:"));
+
+  auto pos = line.find(':');
+  if(pos == std::string::npos)
+    return {};
+
+  std::string info = line.substr(pos+1);
+
+  auto tokens = tokenize_properties(info);
+  if(tokens.size() == 0)
+    return {};
+
+  return parse_properties(tokens);
+}
+
+//! Format is "#EXT-X-BYTERANGE:<LENGTH>[@<OFFSET>]", returns length and offset.
+//! see https://datatracker.ietf.org/doc/html/rfc8216#section-4.3.2.2
+auto parse_extxbyterange(std::string const& line) -> std::optional<std::tuple<uint64_t, std::optional<uint64_t>>>
+{
+  assert(line.starts_with("#EXT-X-BYTERANGE:"));
+
+  std::string const info = line.substr(line.find(':') + 1);
+  auto const at = info.find('@');
+
+  uint64_t length = 0;
+  auto const end = info.data() + (at == std::string::npos ? info.size() : at);
+  auto const [ptr, errc] = std::from_chars(info.data(), end, length);
+  if(errc != std::errc{} or ptr != end or length == 0)
+    return {};
+
+  if(at == std::string::npos)
+    return std::make_tuple(length, std::optional<uint64_t>{});
+
+  uint64_t offset = 0;
+  auto const [optr, oerrc] = std::from_chars(info.data() + at + 1, info.data() + info.size(), offset);
+  if(oerrc != std::errc{} or optr != info.data() + info.size())
+    return {};
+
+  return std::make_tuple(length, std::optional<uint64_t>{offset});
+}
+
+//! Format is "#EXT-X-CONTENT-STEERING:SERVER-URI="...",PATHWAY-ID="...""
+//! see https://datatracker.ietf.org/doc/html/draft-pantos-hls-rfc8216bis#section-4.4.6.6
+auto parse_extxcontentsteering(std::string const& line) -> std::map<std::string, std::string>
+{
+  assert(line.starts_with("#EXT-X-CONTENT-STEERING:"));
+
+  auto pos = line.find(':');
+  if(pos == std::string::npos)
+    return {};
+
+  std::string info = line.substr(pos+1);
+
+  auto tokens = tokenize_properties(info);
+  if(tokens.size() == 0)
+    return {};
+
+  return parse_properties(tokens);
+}
+
+//! Parse tags of format "#TAG:NUMBER" e.g. "#EXT-X-MEDIA-SEQUENCE:42".
+auto parse_number(std::string const& line) -> std::optional<uint64_t>
+{
+  auto pos = line.find(':');
+  if(pos == std::string::npos)
+    return {};
+
+  std::string const value = trim(line.substr(pos+1));
+
+  uint64_t number = 0;
+  auto const [end, errc] = std::from_chars(value.data(), value.data() + value.size(), number);
+  if(errc != std::errc{} or end != value.data() + value.size())
+    return {};
+
+  return number;
+}
+
 //! The info-string is of format: (KEY1=VALUE1, KEY2=VALUE2, ...)
 //! Caution: The value-strings can be quotation-mark string ("...") that contain commas
 //  e.g. CODECS="mp4a.40.2,avc1.42c01e".
@@ -285,7 +490,7 @@ bool is_absolute_url(urlprops_t const& urlprops);
 
 bool m3u8_t::contains_absolute_urls() const
 {
-  for(auto url : m_urls)
+  for(auto const& url : m_urls)
   {
     if(is_absolute_url(url))
       return true;
@@ -296,7 +501,7 @@ bool m3u8_t::contains_absolute_urls() const
 
 bool m3u8_t::contains_relative_urls() const
 {
-  for(auto url : m_urls)
+  for(auto const& url : m_urls)
   {
     if(not is_absolute_url(url))
       return true;
@@ -307,15 +512,15 @@ bool m3u8_t::contains_relative_urls() const
 
 bool is_absolute_url(urlprops_t const& urlprops)
 {
-  return std::regex_match(urlprops.url, std::regex("^\\w{3,5}://.*$"));
+  return is_absolute_url(urlprops.url);
 }
 
 auto get_urlbase(std::string const& url) -> std::string
 {
-  std::smatch results;
-  if(std::regex_match(url, results, std::regex("^(\\w{3,5}://[^/]*)/.*$")))
-    return results[1];
-  return "";
+  url_t const parsed = parse_url(url);
+  if(parsed.scheme.empty() or not parsed.has_authority)
+    return "";
+  return parsed.scheme + "://" + parsed.authority;
 }
 
 auto get_urlpath(std::string const& url) -> std::string
@@ -346,6 +551,40 @@ void m3u8_t::set_urlprefix(std::string const& prefix)
   }
 }
 
+void m3u8_t::keep_urls(size_t first, size_t last)
+{
+  assert(first <= last and last <= m_urls.size());
+
+  m_urls.erase(m_urls.begin() + static_cast<std::ptrdiff_t>(last), m_urls.end());
+  m_urls.erase(m_urls.begin(), m_urls.begin() + static_cast<std::ptrdiff_t>(first));
+}
+
+void m3u8_t::resolve_urls(std::string const& baseurl)
+{
+  url_resolver_t const resolver{baseurl};
+
+  for(auto& url : m_urls)
+  {
+    assert(not url.url.empty());
+    url.url = resolver.resolve(url.url);
+
+    if(url.properties.contains("KEY-URI"))
+      url.properties["KEY-URI"] = resolver.resolve(url.properties["KEY-URI"]);
+  }
+
+  for(auto& media : m_media)
+  {
+    if(not media.url.empty())
+      media.url = resolver.resolve(media.url);
+  }
+
+  for(auto& stream : m_iframe_streams)
+    stream.url = resolver.resolve(stream.url);
+
+  if(m_steering.contains("SERVER-URI"))
+    m_steering["SERVER-URI"] = resolver.resolve(m_steering["SERVER-URI"]);
+}
+
 // ---
 
 auto is_m3u8(fs::path const& path) -> std::variant<bool, fs::filesystem_error>
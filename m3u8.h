@@ -12,6 +12,14 @@
 // "Supportes" only a tiny subset (#EXTINF and #EXT-X-STREAM-INF somewhat) of M3U.
 // The spec is https://datatracker.ietf.org/doc/html/rfc8216.
 //
+// Segments of a playlist additionally get the properties
+// MEDIA-SEQUENCE (their media sequence number), PROGRAM-DATE-TIME (if tagged with #EXT-X-PROGRAM-DATE-TIME),
+// BYTERANGE-OFFSET and BYTERANGE-LENGTH (if only a sub-range of the url, #EXT-X-BYTERANGE)
+// and, if encrypted, the attributes of the #EXT-X-KEY prefixed with KEY- (e.g. KEY-METHOD, KEY-URI, KEY-IV).
+//
+// The alternative renditions (#EXT-X-MEDIA) and the I-frame playlists (#EXT-X-I-FRAME-STREAM-INF)
+// of a master m3u8-file are kept separately (see get_media() and get_iframe_streams()).
+//
 
 auto is_m3u8(std::filesystem::path const& path) -> std::variant<bool, std::filesystem::filesystem_error>;
 auto is_m3u8(std::vector<char> const& buffer) -> bool;
@@ -28,6 +36,7 @@ auto get_urlpath(std::string const& url) -> std::string;
 enum class m3u8_errc
 {
   wrong_file_format = 1,
+  unsupported_encryption = 2,
 };
 
 struct urlprops_t
@@ -53,8 +62,26 @@ public:
   inline bool is_master() const { return m_master; }
   inline bool is_playlist() const { return m_playlist; }
 
-  inline auto get_urls() const -> std::vector<urlprops_t> { return m_urls; }
-  inline auto get_url(size_t i) const -> urlprops_t { return m_urls[i]; }
+  //! #EXT-X-INDEPENDENT-SEGMENTS: every segment can be decoded without the ones before,
+  //! so segments of different variants can be mixed.
+  inline bool has_independent_segments() const { return m_independent_segments; }
+
+  inline auto get_urls() const -> std::vector<urlprops_t> const& { return m_urls; }
+  inline auto get_url(size_t i) const -> urlprops_t const& { return m_urls[i]; }
+
+  //! The #EXT-X-MEDIA entries with their attributes as properties (TYPE, GROUP-ID, NAME, ...).
+  //! The url is the URI-attribute, it is empty if the rendition is contained in the variant stream.
+  inline auto get_media() const -> std::vector<urlprops_t> const& { return m_media; }
+
+  //! The #EXT-X-I-FRAME-STREAM-INF entries with their attributes (BANDWIDTH, RESOLUTION, ...),
+  //! the url is the URI-attribute.
+  inline auto get_iframe_streams() const -> std::vector<urlprops_t> const& { return m_iframe_streams; }
+
+  //! #EXT-X-I-FRAMES-ONLY: every segment is a single I-frame (usually a byte range of a media segment).
+  inline bool is_iframes_only() const { return m_iframes_only; }
+
+  //! The attributes of #EXT-X-CONTENT-STEERING (SERVER-URI and PATHWAY-ID), empty if there is none.
+  inline auto get_steering() const -> std::map<std::string, std::string> const& { return m_steering; }
 
   bool contains_absolute_urls() const;
   bool contains_relative_urls() const;
@@ -62,6 +89,14 @@ public:
   //! For relative urls set the prefix (base-or path-url) to make the absolute urls.
   void set_urlprefix(std::string const& prefix);
 
+  //! Keep only the urls [first, last) e.g. the segments of a time range.
+  void keep_urls(size_t first, size_t last);
+
+  //! Resolve all (relative) urls against the url of the m3u8-file itself (see RFC 3986 section 5).
+  //! This includes the key-urls (KEY-URI), the urls of the renditions and I-frame playlists
+  //! and the steering server (SERVER-URI).
+  void resolve_urls(std::string const& baseurl);
+
   // For testing.
   explicit m3u8_t(std::vector<urlprops_t> urls);
 
@@ -84,8 +119,13 @@ protected:
 private:
 
   std::vector<urlprops_t> m_urls = {};
+  std::vector<urlprops_t> m_media = {};
+  std::vector<urlprops_t> m_iframe_streams = {};
+  std::map<std::string, std::string> m_steering = {};
   bool m_master = false;
   bool m_playlist = false;
+  bool m_independent_segments = false;
+  bool m_iframes_only = false;
 
   std::optional<std::variant<m3u8_errc, std::filesystem::filesystem_error>> m_error = {};
 };
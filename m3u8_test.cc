@@ -67,6 +67,30 @@ TEST(m3u8_tests, set_urlprefix)
   EXPECT_EQ(master.get_url(2).url, std::string{"https://server/path3/"});
 }
 
+TEST(m3u8_tests, keep_urls)
+{
+  std::string const playlist_str =
+    "#EXTM3U\n"
+    "#EXT-X-MEDIA-SEQUENCE:7\n"
+    "#EXT-X-PROGRAM-DATE-TIME:2026-10-16T20:00:00.000Z\n"
+    "#EXTINF:10.0,\n"
+    "seg0.ts\n"
+    "#EXTINF:10.0,\n"
+    "seg1.ts\n"
+    "#EXTINF:10.0,\n"
+    "seg2.ts\n"
+  ;
+  m3u8_t playlist{std::vector<char>{playlist_str.begin(), playlist_str.end()}};
+  EXPECT_EQ(playlist.get_url(0).properties.at("PROGRAM-DATE-TIME"), "2026-10-16T20:00:00.000Z");
+  EXPECT_FALSE(playlist.get_url(1).properties.contains("PROGRAM-DATE-TIME"));
+
+  playlist.keep_urls(1, 2);
+
+  ASSERT_EQ(playlist.get_urls().size(), 1);
+  EXPECT_EQ(playlist.get_url(0).url, "seg1.ts");
+  EXPECT_EQ(playlist.get_url(0).properties.at("MEDIA-SEQUENCE"), "8");
+}
+
 TEST(m3u8_tests, get_urlbase)
 {
   EXPECT_EQ(get_urlbase("https://server/path"), std::string{"https://server"});
@@ -114,3 +138,144 @@ TEST(m3u8_tests, is_absolute_url)
   EXPECT_FALSE(is_absolute_url(urlprops_t{"path", {}}));
 }
 
+
+TEST(m3u8_tests, extxkey)
+{
+  std::string const playlist_str =
+    "#EXTM3U\n"
+    "#EXT-X-MEDIA-SEQUENCE:7\n"
+    "#EXTINF:10.0,\n"
+    "segment7.ts\n"
+    "#EXT-X-KEY:METHOD=AES-128,URI=\"key1.bin\",IV=0x0000000000000000000000000000002a\n"
+    "#EXTINF:10.0,\n"
+    "segment8.ts\n"
+    "#EXTINF:10.0,\n"
+    "segment9.ts\n"
+    "#EXT-X-KEY:METHOD=NONE\n"
+    "#EXTINF:10.0,\n"
+    "segment10.ts\n"
+  ;
+  std::vector<char> const playlist_buffer{playlist_str.begin(), playlist_str.end()};
+
+  m3u8_t playlist{playlist_buffer};
+  playlist.resolve_urls("https://server/dir/index.m3u8");
+
+  auto urls = playlist.get_urls();
+  ASSERT_EQ(urls.size(), 4);
+
+  EXPECT_EQ(urls[0].properties["MEDIA-SEQUENCE"], "7");
+  EXPECT_FALSE(urls[0].properties.contains("KEY-METHOD"));
+
+  EXPECT_EQ(urls[1].properties["MEDIA-SEQUENCE"], "8");
+  EXPECT_EQ(urls[1].properties["KEY-METHOD"], "AES-128");
+  EXPECT_EQ(urls[1].properties["KEY-URI"], "https://server/dir/key1.bin");
+  EXPECT_EQ(urls[1].properties["KEY-IV"], "0x0000000000000000000000000000002a");
+
+  EXPECT_EQ(urls[2].properties["MEDIA-SEQUENCE"], "9");
+  EXPECT_EQ(urls[2].properties["KEY-URI"], "https://server/dir/key1.bin");
+
+  EXPECT_EQ(urls[3].properties["MEDIA-SEQUENCE"], "10");
+  EXPECT_FALSE(urls[3].properties.contains("KEY-METHOD"));
+}
+
+TEST(m3u8_tests, extxmedia)
+{
+  std::string const master_str =
+    "#EXTM3U\n"
+    "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"aac\",NAME=\"English\",LANGUAGE=\"en\",DEFAULT=YES,AUTOSELECT=YES,URI=\"audio/en.m3u8\"\n"
+    "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"aac\",NAME=\"Deutsch\",LANGUAGE=\"de\",DEFAULT=NO,URI=\"audio/de.m3u8\"\n"
+    "#EXT-X-MEDIA:TYPE=CLOSED-CAPTIONS,GROUP-ID=\"cc\",NAME=\"CC1\",INSTREAM-ID=\"CC1\"\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,CODECS=\"mp4a.40.2,avc1.42c01e\",AUDIO=\"aac\",CLOSED-CAPTIONS=\"cc\"\n"
+    "video/index.m3u8\n"
+  ;
+  std::vector<char> const master_buffer{master_str.begin(), master_str.end()};
+
+  m3u8_t master{master_buffer};
+  master.resolve_urls("https://server/dir/master.m3u8");
+
+  EXPECT_TRUE(master.is_master());
+
+  ASSERT_EQ(master.get_urls().size(), 1);
+  EXPECT_EQ(master.get_url(0).url, "https://server/dir/video/index.m3u8");
+  EXPECT_EQ(master.get_url(0).properties.at("AUDIO"), "aac");
+
+  auto media = master.get_media();
+  ASSERT_EQ(media.size(), 3);
+
+  EXPECT_EQ(media[0].url, "https://server/dir/audio/en.m3u8");
+  EXPECT_EQ(media[0].properties["TYPE"], "AUDIO");
+  EXPECT_EQ(media[0].properties["GROUP-ID"], "aac");
+  EXPECT_EQ(media[0].properties["LANGUAGE"], "en");
+  EXPECT_FALSE(media[0].properties.contains("URI"));
+
+  EXPECT_EQ(media[1].url, "https://server/dir/audio/de.m3u8");
+  EXPECT_EQ(media[1].properties["NAME"], "Deutsch");
+
+  EXPECT_TRUE(media[2].url.empty());
+  EXPECT_EQ(media[2].properties["TYPE"], "CLOSED-CAPTIONS");
+}
+
+TEST(m3u8_tests, extxiframestreaminf)
+{
+  std::string const master_str =
+    "#EXTM3U\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,RESOLUTION=640x360\n"
+    "video/index.m3u8\n"
+    "#EXT-X-I-FRAME-STREAM-INF:BANDWIDTH=86000,RESOLUTION=640x360,URI=\"video/iframes.m3u8\"\n"
+  ;
+  m3u8_t master{std::vector<char>{master_str.begin(), master_str.end()}};
+  master.resolve_urls("https://server/dir/master.m3u8");
+
+  EXPECT_TRUE(master.is_master());
+  ASSERT_EQ(master.get_urls().size(), 1);
+
+  auto const& streams = master.get_iframe_streams();
+  ASSERT_EQ(streams.size(), 1);
+  EXPECT_EQ(streams[0].url, "https://server/dir/video/iframes.m3u8");
+  EXPECT_EQ(streams[0].properties.at("BANDWIDTH"), "86000");
+  EXPECT_FALSE(streams[0].properties.contains("URI"));
+}
+
+TEST(m3u8_tests, extxbyterange)
+{
+  std::string const playlist_str =
+    "#EXTM3U\n"
+    "#EXT-X-I-FRAMES-ONLY\n"
+    "#EXTINF:2.0,\n"
+    "#EXT-X-BYTERANGE:9400@376\n"
+    "seg0.ts\n"
+    "#EXTINF:2.0,\n"
+    "#EXT-X-BYTERANGE:7520\n"
+    "seg0.ts\n"
+    "#EXTINF:2.0,\n"
+    "seg1.ts\n"
+  ;
+  m3u8_t const playlist{std::vector<char>{playlist_str.begin(), playlist_str.end()}};
+
+  EXPECT_TRUE(playlist.is_iframes_only());
+  ASSERT_EQ(playlist.get_urls().size(), 3);
+  EXPECT_EQ(playlist.get_url(0).properties.at("BYTERANGE-OFFSET"), "376");
+  EXPECT_EQ(playlist.get_url(0).properties.at("BYTERANGE-LENGTH"), "9400");
+  EXPECT_EQ(playlist.get_url(1).properties.at("BYTERANGE-OFFSET"), "9776"); // right after the one before
+  EXPECT_EQ(playlist.get_url(1).properties.at("BYTERANGE-LENGTH"), "7520");
+  EXPECT_FALSE(playlist.get_url(2).properties.contains("BYTERANGE-LENGTH"));
+}
+
+TEST(m3u8_tests, extxcontentsteering)
+{
+  std::string const master_str =
+    "#EXTM3U\n"
+    "#EXT-X-CONTENT-STEERING:SERVER-URI=\"steering.json\",PATHWAY-ID=\"cdn-a\"\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,PATHWAY-ID=\"cdn-a\"\n"
+    "video/index.m3u8\n"
+  ;
+  std::vector<char> const master_buffer{master_str.begin(), master_str.end()};
+
+  m3u8_t master{master_buffer};
+  master.resolve_urls("https://server/dir/master.m3u8");
+
+  auto const& steering = master.get_steering();
+  ASSERT_EQ(steering.size(), 2);
+  EXPECT_EQ(steering.at("SERVER-URI"), "https://server/dir/steering.json");
+  EXPECT_EQ(steering.at("PATHWAY-ID"), "cdn-a");
+}
@@ -1,29 +1,30 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <chrono>
 #include <cmath>    // std::pow()
-#include <cstdio>   // std::remove()
 #include <cstring>  // std::strerror()
-#include <cstdlib>  // std::system()
-#include <chrono>
+#include <cstdlib>  // std::system(), std::strtod()
+#include <exception> // std::exception_ptr
+#include <filesystem>
 #include <format>
-#include <fstream>  // std::ofstream
+#include <fstream>  // std::ifstream
 #include <iostream>
 #include <iterator>
 #include <optional>
-#include <ranges>
-#include <regex>
 #include <string>
-#include <thread>
+#include <string_view>
 #include <system_error> // std::error_code
 #include <variant>
 
 #include <getopt.h>
 #include <sys/wait.h> // WEXITSTATUS
 #include <termios.h>  // see function getch() below
+#include <unistd.h>   // isatty()
 
 #include "curl_wrapper.h"
+#include "daemon.h"
+#include "job.h"
 #include "m3u8.h"
-#include "pngfakeheader.h"
-#include "string_util.h"
+#include "variant.h"
 
 const char* const VERSION = "0.6";
 
@@ -36,28 +37,55 @@ struct cmdline_t
 
   std::string name = "";
   std::string url = "";
+
+  variant_policy_t variant_policy = isatty(STDIN_FILENO) ? variant_policy_t::ask : variant_policy_t::automatic;
+  std::optional<double> deadline = {}; // in seconds
+  bool adaptive_flag = false;
+  std::optional<position_t> from = {};
+  std::optional<position_t> to = {};
+  preview_t preview = preview_t::none;
+  bool one_file_flag = false;
+
+  std::string batchfile = "";
+  int parallel = 5;
+  std::optional<size_t> max_speed = {}; // in bytes/s
+  size_t muxers = 2;
+  double hedge = 10.0; // in percent
+  size_t window = 0;   // playback order, 0 is off
+  bool largest_first_flag = false;
+  bool preflight_flag = false;
+  std::optional<size_t> cache_size = {}; // in bytes, no cache without
+
+  progress_format_t progress_format = isatty(STDOUT_FILENO) ? progress_format_t::terminal : progress_format_t::json;
+  double progress_interval = 1.0; // in seconds
+  std::filesystem::path stats_file = "";
+  std::filesystem::path trace_file = "";
+  bool profile_flag = false;
+  std::filesystem::path profile_file = "";
+
+  bool daemon_flag = false;
+  bool local_flag = false;
+  bool run_options = false; // options of the download run (e.g. --parallel or --trace), a daemon has its own
+  std::filesystem::path socket = default_socket_path();
 };
 
 bool check_command(std::string const& cmd);
-auto download_m3u8(curl_wrapper const& curl, std::string const& url) -> m3u8_t; // throws on error
 auto pick_playlist(m3u8_t const& m3u8) -> int;
-int concat_ffmpeg(std::string const& name, std::vector<std::filesystem::path> const& parts);
 
-void print_lines(std::string const& str, int maxlines);
+auto run_single(curl_wrapper& curl, cmdline_t const& cmdline) -> int; // throws on error
+auto run_batch(curl_wrapper& curl, cmdline_t const& cmdline) -> int;
+
+//! Prints the error (an exception thrown by a job) and returns the exit-code for it.
+auto report_error(std::exception_ptr error) -> int;
 
 auto parse_options(int argc, char* argv[]) -> std::optional<cmdline_t>;
+auto parse_size(std::string const& size) -> std::optional<size_t>;
 void print_usage(const char* progname);
 
 //! Read a single key-press from the keyboard (without enter).
 //! The ASCII-code is returned (e.g. 'c' for the c-key).
 static char getch(bool echo = true);
 
-inline auto error_ratio(curl_wrapper::results_t const& results) -> double
-{
-  assert(results.succeeded_files.size() > 0);
-  return static_cast<double>(results.errors.size())/static_cast<double>(results.succeeded_files.size());
-}
-
 // ---
 
 // TODO: on verbose implement more logging
@@ -98,6 +126,10 @@ int main(int argc, char** argv)
 
   curl_wrapper::init();
 
+  // The daemon has recorders per run, see daemon_recorders_t.
+  auto const trace = cmdline.trace_file.empty() or cmdline.daemon_flag ? nullptr : std::make_shared<trace_t>();
+  auto const profiler = not cmdline.profile_flag or cmdline.daemon_flag ? nullptr : std::make_shared<profiler_t>();
+
   try
   {
     curl_wrapper curl{"curl_m3u8/0.6"};
@@ -106,119 +138,187 @@ int main(int argc, char** argv)
       curl.set_verbose();
     //curl.set_default_progressmeter();
 
-    std::string const url = cmdline.url;
-    std::string const name = cmdline.name;
+    curl.parallel(cmdline.parallel);
+    if(cmdline.max_speed.has_value())
+      curl.max_speed(cmdline.max_speed.value());
+    else // 1 MB/s per transfer
+      curl.max_speed(static_cast<size_t>(cmdline.parallel)*1'024*1'024);
+    curl.hedge_budget(cmdline.hedge/100.0);
+    curl.playback_window(cmdline.window);
+    curl.largest_first(cmdline.largest_first_flag);
+    curl.preflight(cmdline.preflight_flag);
+    if(cmdline.cache_size.has_value())
+      curl.cache(std::make_shared<segment_cache_t>(segment_cache_t::default_dir(), cmdline.cache_size.value()));
+    curl.progress_format(cmdline.progress_format);
+    curl.progress_interval(std::chrono::milliseconds{static_cast<long>(cmdline.progress_interval*1'000.0)});
+    curl.stats_file(cmdline.stats_file);
+    curl.trace(trace);
+    curl.profiler(profiler);
+
+    if(cmdline.daemon_flag)
+      ret = run_daemon(curl, cmdline.socket, cmdline.muxers,
+          daemon_recorders_t{cmdline.trace_file, cmdline.profile_flag, cmdline.profile_file});
+    else
+      ret = cmdline.batchfile.empty() ? run_single(curl, cmdline) : run_batch(curl, cmdline);
+  }
+  catch(...)
+  {
+    ret = report_error(std::current_exception());
+  }
 
-    bool cancel = false;
+  // Also of a failed run, to see what went wrong.
+  try
+  {
+    if(trace != nullptr)
+      trace->write(cmdline.trace_file);
 
-    //
-    // 1. Download m3u8-file(s)
-    //
-    m3u8_t m3u8 = download_m3u8(curl, url);
-    if(m3u8.is_master()) // Pick and download playlist m3u8-file.
+    if(profiler != nullptr)
     {
-      int i = pick_playlist(m3u8);
-      cancel = i == -1;
-
-      if(not cancel)
-        m3u8 = download_m3u8(curl, m3u8.get_url(i).url);
+      std::cerr << profiler->str() << std::endl;
+      if(not cmdline.profile_file.empty())
+        profiler->write(cmdline.profile_file);
     }
+  }
+  catch(...)
+  {
+    ret = report_error(std::current_exception());
+  }
 
-    // TODO: handle cancel
+  curl_wrapper::cleanup();
 
-    assert(m3u8.is_playlist());
-    assert(not m3u8.contains_relative_urls());
+  return ret;
+}
 
-    //
-    // 2. Download all video-parts from the m3u8-file.
-    //
+auto run_single(curl_wrapper& curl, cmdline_t const& cmdline) -> int
+{
+  jobspec_t const spec{cmdline.url, cmdline.name, cmdline.variant_policy, cmdline.deadline, cmdline.adaptive_flag,
+    cmdline.from, cmdline.to, cmdline.preview, cmdline.one_file_flag};
 
-    curl.set_default_progressmeter();
+  // A running daemon does the job (it has no terminal to ask). Options of the download run would be
+  // lost there (the daemon has its own), so with them it's done here.
+  if(not cmdline.local_flag and not cmdline.run_options and spec.variant_policy != variant_policy_t::ask)
+  {
+    jobspec_t remote = spec;
+    remote.name = std::filesystem::absolute(spec.name).string(); // The daemon has its own working directory.
 
-    std::vector<std::tuple<std::filesystem::path, std::string>> pathurls = {};
-    size_t const ndigits = calc_numberlength(m3u8.get_urls().size());
-    int i=1;
-    for(auto url : m3u8.get_urls())
-    {
-      std::string segname = std::format("{}-{:0>{}}-v1-a1.ts", name, i, ndigits);
-      //std::string segname = curl_wrapper::get_filename_from_url(url.url);
-      pathurls.push_back(std::make_tuple(segname, url.url));
-      i++;
-    }
+    auto const ret = submit_to_daemon(cmdline.socket, remote);
+    if(ret.has_value())
+      return ret.value();
+  }
 
-    auto results = curl.download_files(pathurls);
+  //
+  // 1. Download m3u8-file(s)
+  //
+  std::vector<job_t> jobs = {job_t{spec}};
+  if(not jobs.front().prepare(curl, pick_playlist))
+  {
+    curl.messages() << "Canceled." << std::endl;
+    return 0;
+  }
 
-    std::cout << std::format("successful downloads: {}", results.succeeded_files.size()) << std::endl;
-    std::cout << std::format("    failed downloads: {}", results.errors.size()) << std::endl;
-    std::cout << std::format("          of overall: {} urls", pathurls.size()) << std::endl;
+  //
+  // 2. Download all video-parts from the m3u8-file.
+  // 3. Concat and convert all video-parts to mp4 via ffmpeg.
+  //
+  curl.set_default_progressmeter();
+  auto const results = run_jobs(curl, jobs, 1);
 
-    // If there were download errors, but only for a few files (less than 10%)
-    // -> try to download them again.
-    while(results.errors.size() > 0 and results.succeeded_files.size() > 0
-        and static_cast<double>(results.errors.size())/static_cast<double>(results.succeeded_files.size()) < 0.1)
-    {
-      using namespace std::chrono_literals;
+  if(results.front().error != nullptr)
+    std::rethrow_exception(results.front().error);
 
-      std::cout << "Couldn't download some files due to errors. Try them again." << std::endl;
-      std::this_thread::sleep_for(1s);
+  return results.front().status;
+}
 
-      std::vector<std::tuple<std::filesystem::path, std::string>> rest = {};
-      for(auto error : results.errors)
-        rest.push_back(std::make_tuple(error.filename(), error.url()));
+/**
+ * All jobs of the batch-file share one download_files()-run and thus the parallel transfers,
+ * the connections and the bandwidth budget. A failing job doesn't stop the others.
+ */
+auto run_batch(curl_wrapper& curl, cmdline_t const& cmdline) -> int
+{
+  std::ifstream file{cmdline.batchfile};
+  if(file.fail())
+  {
+    int const err = errno;
+    std::error_code errc{err, std::generic_category()};
+    throw std::filesystem::filesystem_error{"Couldn't open file", cmdline.batchfile, errc};
+  }
 
-      results = curl.download_files(rest);
-    }
+  jobspec_t defaults;
+  defaults.variant_policy = cmdline.variant_policy == variant_policy_t::ask
+    ? variant_policy_t::automatic // Nobody is there to ask.
+    : cmdline.variant_policy;
+  defaults.deadline = cmdline.deadline;
+  defaults.adaptive = cmdline.adaptive_flag;
+  defaults.from = cmdline.from;
+  defaults.to = cmdline.to;
+  defaults.preview = cmdline.preview;
+  defaults.one_file = cmdline.one_file_flag;
+
+  auto const specs_error = parse_batchfile(file, defaults);
+  if(std::holds_alternative<std::string>(specs_error))
+  {
+    std::cerr << std::format("Error: {} in {}!", std::get<std::string>(specs_error), cmdline.batchfile) << std::endl;
+    return -1;
+  }
+
+  int ret = 0;
+  size_t failed = 0;
+
+  auto const& specs = std::get<std::vector<jobspec_t>>(specs_error);
+  std::vector<job_t> jobs = {};
+  for(auto const& spec : specs)
+  {
+    curl.messages() << std::format("Job {}: {}", spec.name, spec.url) << std::endl;
 
-    if(results.errors.size() > 0)
+    job_t job{spec};
+    try
     {
-      double const error_ratio = static_cast<double>(results.errors.size())/static_cast<double>(pathurls.size());
-      if(error_ratio < 0.01)
-      {
-         std::cerr
-           << std::format("Warning: Ignore download errors in less than {:.0f}% of the files.", error_ratio*100.0)
-           << std::endl;
-
-         // filter
-         for(auto const& error : results.errors)
-         {
-           auto it = std::find(pathurls.begin(), pathurls.end(), std::make_tuple(error.filename(), error.url()));
-           assert(it != pathurls.end() and "Couldn't find result in path-urls?!");
-           pathurls.erase(it);
-           std::remove(error.filename().c_str());
-         }
-      }
-      else
-        throw results.errors;
+      job.prepare(curl);
+      jobs.push_back(std::move(job));
     }
+    catch(...)
+    {
+      std::cerr << std::format("Job {} failed:", spec.name) << std::endl;
+      ret = report_error(std::current_exception());
+      failed++;
+    }
+  }
 
-    //
-    // 3. Concat and convert all video-parts to mp4 via ffmpeg.
-    //
-
-    std::vector<std::filesystem::path> paths = {};
-    for(auto pathurl : pathurls)
-      paths.push_back(std::get<0>(pathurl));
+  curl.set_default_progressmeter();
+  auto const results = run_jobs(curl, jobs, cmdline.muxers);
 
-    bool has_pngfakeheader = false;
-    for(auto path : paths)
+  for(size_t j=0; j<jobs.size(); j++)
+  {
+    auto const& result = results[j];
+    if(result.error != nullptr)
     {
-      auto haspng_error = check_and_remove_pngfakeheader(path);
-      if(std::holds_alternative<std::filesystem::filesystem_error>(haspng_error))
-        throw std::get<std::filesystem::filesystem_error>(haspng_error);
-
-      if(std::get<bool>(haspng_error))
-        has_pngfakeheader = true;
+      std::cerr << std::format("Job {} failed:", jobs[j].spec().name) << std::endl;
+      ret = report_error(result.error);
+      failed++;
+    }
+    else if(result.status != 0)
+    {
+      std::cerr << std::format("Job {} failed: ffmpeg exited with {}", jobs[j].spec().name, result.status) << std::endl;
+      ret = result.status;
+      failed++;
     }
+  }
+
+  curl.messages() << std::format("Finished {} of {} jobs.", specs.size() - failed, specs.size()) << std::endl;
 
-    if(has_pngfakeheader)
-      std::cout << "Found and removed PNG fake-header(s)." << std::endl;
+  return ret;
+}
 
-    ret = concat_ffmpeg(name, paths);
+auto report_error(std::exception_ptr error) -> int
+{
+  try
+  {
+    std::rethrow_exception(error);
   }
   catch(std::filesystem::filesystem_error const& error)
   {
     std::cerr << std::format("Error: {}!", error.what()) << std::endl;
-    ret = -3;
+    return -3;
   }
   catch(curl_wrapper_error const& error)
   {
@@ -226,7 +326,7 @@ int main(int argc, char** argv)
       std::cerr << std::format("Error: {} while downloading {} to {}!", error.what(), error.url(), error.filename()) << std::endl;
     else
       std::cerr << std::format("Error: {} while downloading {}!", error.what(), error.url()) << std::endl;
-    ret = -4;
+    return -4;
   }
   catch(std::vector<curl_wrapper_error> const& errors)
   {
@@ -235,77 +335,28 @@ int main(int argc, char** argv)
         std::cerr << std::format("Error: {} while downloading {} to {}!", error.what(), error.url(), error.filename()) << std::endl;
       else
         std::cerr << std::format("Error: {} while downloading {}!", error.what(), error.url()) << std::endl;
-    ret = -4;
+    return -4;
   }
   catch(m3u8_errc const& error)
   {
-    std::cerr << "Error: Url is not a m3u8-file!" << std::endl;
-    ret = -5;
-  }
-
-  curl_wrapper::cleanup();
-
-  return ret;
-}
-
-bool check_command(std::string const& cmd)
-{
-  return WEXITSTATUS(std::system((cmd + " > /dev/null 2>&1").c_str())) == 0;
-}
-
-auto download_m3u8(curl_wrapper const& curl, std::string const& url) -> m3u8_t
-{
-  auto result = curl.download_buffer(url);
-  if(std::holds_alternative<curl_wrapper_error>(result))
-    throw std::get<curl_wrapper_error>(result);
-
-  assert(std::holds_alternative<std::vector<char>>(result));
-  auto buffer = std::get<std::vector<char>>(result);
-  //std::ranges::copy(buffer, std::ostream_iterator<char>(std::cout, ""));
-
-  if(not is_m3u8(buffer))
-  {
-    std::string const page{buffer.data(), buffer.size()};
-    bool is_html = page.find("<html") != std::string::npos;
-    if(is_html)
-      print_lines(page, 10);
-
-    throw m3u8_errc::wrong_file_format;
+    if(error == m3u8_errc::unsupported_encryption)
+      std::cerr << "Error: The m3u8-file uses an unsupported encryption method!" << std::endl;
+    else
+      std::cerr << "Error: Url is not a m3u8-file!" << std::endl;
+    return -5;
   }
-
-  m3u8_t m3u8{buffer};
-  if((not m3u8.get_urls().empty()) and m3u8.contains_relative_urls())
+  catch(std::exception const& error)
   {
-    // If m3u8 contain only relative filenames than prefix them with the url-path ...
-    // (The relative filename is a relative path with only the filename e.g. "file1".)
-    if(std::regex_match(m3u8.get_url(0).url, std::regex("^[\\w.-]+$")))
-    {
-      std::string const& path = get_urlpath(url);
-      m3u8.set_urlprefix(path);
-    }
-    // ... otherwise if it contains real relative paths only prefix them with the server
-    // (server = protocol + host) in this case.
-    else
-    {
-      std::string const& server = get_urlbase(url);
-      m3u8.set_urlprefix(server);
-    }
+    std::cerr << std::format("Error: {}!", error.what()) << std::endl;
+    return -6;
   }
 
-  return m3u8;
+  return 0;
 }
 
-void print_lines(std::string const& str, int maxlines)
+bool check_command(std::string const& cmd)
 {
-  std::stringstream ss{str};
-
-  std::string line = "";
-  std::getline(ss, line);
-  for(int i=0; ss.good() and i < maxlines; i++)
-  {
-    std::cout << line << std::endl;
-    std::getline(ss, line);
-  }
+  return WEXITSTATUS(std::system((cmd + " > /dev/null 2>&1").c_str())) == 0;
 }
 
 auto pick_playlist(m3u8_t const& m3u8) -> int
@@ -318,17 +369,16 @@ auto pick_playlist(m3u8_t const& m3u8) -> int
 
   std::vector<char> keys{CTRLC, CTRLD, ENTER, 'c' /* cancel */};
   int n = 1;
-  for(auto const& url : m3u8.get_urls())
+  for(auto const& variant : parse_variants(m3u8))
   {
-    std::string line = "";
-    if(url.properties.contains("RESOLUTION"))
-      line = url.properties.at("RESOLUTION");
-    else
+    std::string line = variant.str();
+    if(line.empty())
     {
-      for(auto const& [key, value] : url.properties)
+      for(auto const& [key, value] : m3u8.get_url(variant.index).properties)
         line += key + "=" + value + " ";
     }
-    assert(not line.empty());
+    if(line.empty())
+      line = variant.url;
 
     if(n == 1)
       line += " (default: 1)";
@@ -372,54 +422,65 @@ auto pick_playlist(m3u8_t const& m3u8) -> int
   return index;
 }
 
-int concat_ffmpeg(std::string const& name, std::vector<std::filesystem::path> const& parts)
-{
-  std::filesystem::path const listfilename = name + "-list.txt";
-
-  std::ofstream listfile{listfilename};
-  for(auto part : parts)
-  {
-    if(listfile.fail())
-      break;
-
-    listfile << "file '" << part.c_str() << "'" << std::endl;
-  }
-
-  if(listfile.fail())
-  {
-    int const err = errno;
-    std::error_code errc{err, std::generic_category()};
-    throw std::filesystem::filesystem_error{"Couldn't write file", listfilename, errc};
-  }
-
-  listfile.close();
-
-  // ---
-
-  std::string const command = std::string{"ffmpeg -f concat -safe 0 -i "} + listfilename.c_str() + " " + name + ".mp4";
-  int ret = WEXITSTATUS(std::system(command.c_str()));
-
-  // Delete all intermediated files.
-  std::remove(listfilename.c_str());
-  for(auto part : parts)
-    std::remove(part.c_str());
-
-  return ret;
-}
-
 // ---
 
 void print_usage(const char* progname)
 {
   std::cout << std::format(
-      "Usage: {} [-v|--verbose] (-n|--name) <NAME> <URL>\n"
+      "Usage: {0} [OPTIONS] (-n|--name) <NAME> <URL>\n"
+      "   or: {0} [OPTIONS] (-b|--batch) <FILE>\n"
+      "   or: {0} [OPTIONS] (-D|--daemon)\n"
       "Options:\n"
       "-h, --help       \t\tShow help.\n"
       "-v, --verbose    \t\tEnable verbose output.\n"
       "-n, --name <NAME>\t\t<NAME>.mp4 is the resulting filename.\n"
+      "-p, --pick <POLICY>\t\tHow to pick the playlist of a master m3u8-file: ask, auto,\n"
+      "                 \t\tmax-resolution, max-bandwidth or min-bandwidth\n"
+      "                 \t\t(default: ask on a terminal, otherwise auto).\n"
+      "-d, --deadline <SECONDS>\tWith auto pick the best playlist that downloads within SECONDS.\n"
+      "-a, --adaptive   \t\tSwitch between the playlists during the download to keep up\n"
+      "                 \t\twith the throughput (and deadline).\n"
+      "-f, --from <TIME>\t\tDownload only the clip from TIME on: [[HH:]MM:]SS into the playlist\n"
+      "                 \t\tor a date-time like 2026-10-16T20:15:00Z (#EXT-X-PROGRAM-DATE-TIME).\n"
+      "-t, --to <TIME>  \t\tDownload only the clip up to TIME (like --from).\n"
+      "-P, --preview <KIND>\t\tDownload only the key frames of the I-frame playlist and make\n"
+      "                 \t\tkeyframes (<NAME>.mp4) or thumbnails (<NAME>-00001.jpg, ...) of them.\n"
+      "-O, --one-file   \t\tWrite the parts right into one file per track at their offsets (by\n"
+      "                 \t\ttheir sizes from HEAD-requests), without part files to concat.\n"
+      "-b, --batch <FILE>\t\tDownload all jobs of FILE (a line \"<URL> <NAME> [<POLICY>]\" per job)\n"
+      "                 \t\tat once.\n"
+      "-j, --parallel <N>\t\tNumber of parallel transfers (default: 5).\n"
+      "-r, --limit-rate <SPEED>\tBandwidth budget of all transfers in bytes/s, with suffix K, M or G\n"
+      "                 \t\tfor KB/s, MB/s or GB/s (default: 1M per transfer).\n"
+      "-m, --muxers <N> \t\tNumber of parallel ffmpeg-runs in a batch (default: 2).\n"
+      "-H, --hedge <PERCENT>\t\tRequest straggling parts a second time in idle slots, with at most\n"
+      "                 \t\tPERCENT extra bytes (default: 10, 0 disables it).\n"
+      "-w, --window <N> \t\tDownload in playback order: At most N parts ahead of the first\n"
+      "                 \t\tunfinished one, so the beginning is ready early (default: 0, off).\n"
+      "-L, --largest-first\t\tStart the parts by their predicted size, largest first, so no big part\n"
+      "                 \t\tstalls the end (not together with --window).\n"
+      "-F, --preflight  \t\tAsk for the sizes of all parts first (HEAD-requests), to show the exact\n"
+      "                 \t\ttotal, stop early without enough free space and preallocate the files.\n"
+      "-c, --cache <SIZE>\t\tKeep up to SIZE bytes (with suffix K, M or G) of downloaded parts in\n"
+      "                 \t\t{3} and take them from there next time.\n"
+      "-g, --progress <FORMAT>\t\tPrint the progress for a terminal or as JSON-lines (json)\n"
+      "                 \t\t(default: terminal on a terminal, otherwise json).\n"
+      "-i, --interval <SECONDS>\tPrint the progress every SECONDS (default: 1).\n"
+      "-S, --stats <FILE>\t\tAppend the timing statistics (DNS, connect, TLS, first byte, transfer)\n"
+      "                 \t\tof the transfers to FILE as JSON-lines and print them.\n"
+      "-T, --trace <FILE>\t\tWrite a timeline of the transfers (one track per parallel transfer)\n"
+      "                 \t\tand phases to FILE, for https://ui.perfetto.dev or chrome://tracing.\n"
+      "-R, --profile    \t\tPrint the wall and CPU time, bytes and memory (RSS) of the phases\n"
+      "                 \t\t(playlist, download, ffmpeg, ...) at the end.\n"
+      "-J, --profile-json <FILE>\tLike --profile and write them to FILE as JSON.\n"
+      "-D, --daemon     \t\tRun as daemon, that takes jobs over a unix domain socket.\n"
+      "                 \t\tWhile it runs, downloads are handed to it (except with --pick ask).\n"
+      "-s, --socket <PATH>\t\tSocket of the daemon (default: {2}).\n"
+      "-l, --local      \t\tDownload here, even if a daemon runs.\n"
       "<URL>            \t\tUrl pointing to a m3u8-file.\n"
       "Download all the parts in a m3u8-file via libcurl and concat them together via ffmpeg.\n"
-      "curl_m3u8 {} - licence GPLv3+ (GNU GPL Version 3 or later).", progname, VERSION)
+      "curl_m3u8 {1} - licence GPLv3+ (GNU GPL Version 3 or later).", progname, VERSION,
+      default_socket_path().string(), segment_cache_t::default_dir().string())
     << std::endl;
 }
 
@@ -427,13 +488,45 @@ auto parse_options(int argc, char* argv[]) -> std::optional<cmdline_t>
 {
   cmdline_t cmdline;
 
-  // Usage: <argv[0]> [--verbose|-v] --name NAME URL
+  // Usage: <argv[0]> [--verbose|-v] [--pick|-p POLICY] [--deadline|-d SECONDS] [--adaptive|-a]
+  //                  [--parallel|-j N] [--limit-rate|-r SPEED] [--muxers|-m N] [--hedge|-H PERCENT]
+  //                  [--from|-f TIME] [--to|-t TIME] [--preview|-P KIND] [--one-file|-O]
+  //                  [--window|-w N | --largest-first|-L] [--preflight|-F] [--cache|-c SIZE]
+  //                  [--progress|-g FORMAT] [--interval|-i SECONDS] [--stats|-S FILE]
+  //                  [--trace|-T FILE] [--profile|-R] [--profile-json|-J FILE]
+  //                  [--socket|-s PATH] [--local|-l]
+  //                  (--name NAME URL | --batch FILE | --daemon)
   struct option long_options[] =
   {
     // long name, no_argument|required_argument, flag, val or nullptr
     {"help", no_argument, nullptr, 'h'},
     {"verbose", no_argument, nullptr, 'v'},
     {"name", required_argument, nullptr, 'n'},
+    {"pick", required_argument, nullptr, 'p'},
+    {"deadline", required_argument, nullptr, 'd'},
+    {"adaptive", no_argument, nullptr, 'a'},
+    {"batch", required_argument, nullptr, 'b'},
+    {"parallel", required_argument, nullptr, 'j'},
+    {"limit-rate", required_argument, nullptr, 'r'},
+    {"muxers", required_argument, nullptr, 'm'},
+    {"hedge", required_argument, nullptr, 'H'},
+    {"window", required_argument, nullptr, 'w'},
+    {"largest-first", no_argument, nullptr, 'L'},
+    {"preflight", no_argument, nullptr, 'F'},
+    {"from", required_argument, nullptr, 'f'},
+    {"to", required_argument, nullptr, 't'},
+    {"preview", required_argument, nullptr, 'P'},
+    {"one-file", no_argument, nullptr, 'O'},
+    {"cache", required_argument, nullptr, 'c'},
+    {"progress", required_argument, nullptr, 'g'},
+    {"interval", required_argument, nullptr, 'i'},
+    {"stats", required_argument, nullptr, 'S'},
+    {"trace", required_argument, nullptr, 'T'},
+    {"profile", no_argument, nullptr, 'R'},
+    {"profile-json", required_argument, nullptr, 'J'},
+    {"daemon", no_argument, nullptr, 'D'},
+    {"socket", required_argument, nullptr, 's'},
+    {"local", no_argument, nullptr, 'l'},
     {nullptr, 0, nullptr, 0}
   };
 
@@ -442,8 +535,13 @@ auto parse_options(int argc, char* argv[]) -> std::optional<cmdline_t>
 
   int c = 0;
   int option_index = 0;
-  while((c = getopt_long(argc, argv, "hvn:", long_options, &option_index)) != -1)
+  while((c = getopt_long(argc, argv, "hvn:p:d:af:t:P:Ob:j:r:m:H:w:LFc:g:i:S:T:RJ:Ds:l", long_options, &option_index)) != -1)
   {
+    // -v, --parallel, --limit-rate, --muxers, --hedge, --window, --largest-first, --preflight, --cache,
+    // --progress, --interval, --stats, --trace and --profile(-json)
+    if(std::string_view{"vjrmHwLFcgiSTRJ"}.contains(static_cast<char>(c)))
+      cmdline.run_options = true;
+
     switch(c)
     {
       // long option
@@ -463,21 +561,271 @@ auto parse_options(int argc, char* argv[]) -> std::optional<cmdline_t>
         parsed_options++;
         break;
 
+      case 'a':
+        cmdline.adaptive_flag = true;
+        parsed_options++;
+        break;
+
+      case 'D':
+        cmdline.daemon_flag = true;
+        parsed_options++;
+        break;
+
+      case 'l':
+        cmdline.local_flag = true;
+        parsed_options++;
+        break;
+
+      case 'O':
+        cmdline.one_file_flag = true;
+        parsed_options++;
+        break;
+
+      case 'L':
+        cmdline.largest_first_flag = true;
+        parsed_options++;
+        break;
+
+      case 'F':
+        cmdline.preflight_flag = true;
+        parsed_options++;
+        break;
+
+      case 'R':
+        cmdline.profile_flag = true;
+        parsed_options++;
+        break;
+
+      case 's':
+        cmdline.socket = optarg;
+        parsed_options += 2;
+        break;
+
+      case 'S':
+        cmdline.stats_file = optarg;
+        parsed_options += 2;
+        break;
+
+      case 'T':
+        cmdline.trace_file = optarg;
+        parsed_options += 2;
+        break;
+
+      case 'J':
+        cmdline.profile_flag = true;
+        cmdline.profile_file = optarg;
+        parsed_options += 2;
+        break;
+
       case 'n':
         name_option = true;
         cmdline.name = optarg;
         parsed_options += 2;
         break;
 
+      case 'p':
+      {
+        auto const policy = parse_variant_policy(optarg);
+        if(not policy.has_value())
+        {
+          std::cerr << std::format("Error: Unknown pick-policy `{}'!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.variant_policy = policy.value();
+        parsed_options += 2;
+        break;
+      }
+
+      case 'd':
+      {
+        char* end = nullptr;
+        double const deadline = std::strtod(optarg, &end);
+        if(end == optarg or *end != '\0' or deadline <= 0.0)
+        {
+          std::cerr << std::format("Error: Deadline `{}' is not a positive number of seconds!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.deadline = deadline;
+        parsed_options += 2;
+        break;
+      }
+
+      case 'f':
+      case 't':
+      {
+        auto const position = parse_position(optarg);
+        if(not position.has_value())
+        {
+          std::cerr << std::format("Error: `{}' is neither a time like 1:30:00 nor a date-time like "
+            "2026-10-16T20:15:00Z!", optarg) << std::endl;
+          return {};
+        }
+        (c == 'f' ? cmdline.from : cmdline.to) = position.value();
+        parsed_options += 2;
+        break;
+      }
+
+      case 'P':
+      {
+        auto const preview = parse_preview(optarg);
+        if(not preview.has_value())
+        {
+          std::cerr << std::format("Error: Unknown preview `{}', either keyframes or thumbnails!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.preview = preview.value();
+        parsed_options += 2;
+        break;
+      }
+
+      case 'b':
+        cmdline.batchfile = optarg;
+        parsed_options += 2;
+        break;
+
+      case 'j':
+      case 'm':
+      {
+        char* end = nullptr;
+        long const n = std::strtol(optarg, &end, 10);
+        if(end == optarg or *end != '\0' or n <= 0 or n > 100)
+        {
+          std::cerr << std::format("Error: `{}' is not a number between 1 and 100!", optarg) << std::endl;
+          return {};
+        }
+        if(c == 'j')
+          cmdline.parallel = static_cast<int>(n);
+        else
+          cmdline.muxers = static_cast<size_t>(n);
+        parsed_options += 2;
+        break;
+      }
+
+      case 'H':
+      {
+        char* end = nullptr;
+        double const hedge = std::strtod(optarg, &end);
+        if(end == optarg or *end != '\0' or hedge < 0.0 or hedge > 100.0)
+        {
+          std::cerr << std::format("Error: `{}' is not a percentage between 0 and 100!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.hedge = hedge;
+        parsed_options += 2;
+        break;
+      }
+
+      case 'w':
+      {
+        char* end = nullptr;
+        long const n = std::strtol(optarg, &end, 10);
+        if(end == optarg or *end != '\0' or n < 0 or n > 10'000)
+        {
+          std::cerr << std::format("Error: `{}' is not a number between 0 and 10000!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.window = static_cast<size_t>(n);
+        parsed_options += 2;
+        break;
+      }
+
+      case 'r':
+      {
+        auto const speed = parse_size(optarg);
+        if(not speed.has_value())
+        {
+          std::cerr << std::format("Error: `{}' is not a speed like 500K or 10M!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.max_speed = speed.value();
+        parsed_options += 2;
+        break;
+      }
+
+      case 'c':
+      {
+        auto const size = parse_size(optarg);
+        if(not size.has_value())
+        {
+          std::cerr << std::format("Error: `{}' is not a size like 500M or 2G!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.cache_size = size.value();
+        parsed_options += 2;
+        break;
+      }
+
+      case 'g':
+      {
+        auto const format = parse_progress_format(optarg);
+        if(not format.has_value())
+        {
+          std::cerr << std::format("Error: Unknown progress format `{}', either terminal or json!", optarg) << std::endl;
+          return {};
+        }
+        cmdline.progress_format = format.value();
+        parsed_options += 2;
+        break;
+      }
+
+      case 'i':
+      {
+        char* end = nullptr;
+        double const interval = std::strtod(optarg, &end);
+        if(end == optarg or *end != '\0' or not (interval >= 0.1 and interval <= 3'600.0))
+        {
+          std::cerr << std::format("Error: Interval `{}' is not a number of seconds between 0.1 and 3600!", optarg)
+            << std::endl;
+          return {};
+        }
+        cmdline.progress_interval = interval;
+        parsed_options += 2;
+        break;
+      }
+
       case '?': // getopt_long printed an error-message.
       default:
         return {};
     }
   }
 
+  if(cmdline.from.has_value() and cmdline.to.has_value()
+      and cmdline.from->index() == cmdline.to->index() and not (cmdline.from.value() < cmdline.to.value()))
+  {
+    std::cerr << "Error: --from needs to be before --to!" << std::endl;
+    return {};
+  }
+
+  if(cmdline.window > 0 and cmdline.largest_first_flag)
+  {
+    std::cerr << "Error: The parts are either downloaded in playback order or largest first!" << std::endl;
+    return {};
+  }
+
   if(cmdline.help_flag)
     return cmdline;
 
+  if(cmdline.daemon_flag)
+  {
+    if(name_option or not cmdline.batchfile.empty() or parsed_options < argc)
+    {
+      std::cerr << "Error: The daemon takes its jobs over the socket, no name, URL or batch-file can be given!"
+        << std::endl;
+      return {};
+    }
+    return cmdline;
+  }
+
+  if(not cmdline.batchfile.empty())
+  {
+    if(name_option or parsed_options < argc)
+    {
+      std::cerr << "Error: With a batch-file no name and URL can be given!" << std::endl;
+      return {};
+    }
+    return cmdline;
+  }
+
   cmdline.url = parsed_options < argc ? argv[parsed_options] : "";
 
   if(not name_option)
@@ -499,6 +847,28 @@ auto parse_options(int argc, char* argv[]) -> std::optional<cmdline_t>
   return cmdline;
 }
 
+//! Parse a number of bytes (or bytes/s) with optional suffix K, M or G (like curl --limit-rate) e.g. "500K".
+auto parse_size(std::string const& size) -> std::optional<size_t>
+{
+  char* end = nullptr;
+  double const value = std::strtod(size.c_str(), &end);
+  if(end == size.c_str() or value <= 0.0)
+    return {};
+
+  std::string const suffix = end;
+  double factor = 1.0;
+  if(suffix == "K" or suffix == "k")
+    factor = 1'024.0;
+  else if(suffix == "M" or suffix == "m")
+    factor = 1'024.0*1'024.0;
+  else if(suffix == "G" or suffix == "g")
+    factor = 1'024.0*1'024.0*1'024.0;
+  else if(not suffix.empty())
+    return {};
+
+  return static_cast<size_t>(value*factor);
+}
+
 /**
  * In Linux there is no conio.h with getch().
  * The internet says use getch() from ncurses or do it yourself.
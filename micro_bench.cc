@@ -0,0 +1,259 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <atomic>
+#include <chrono>
+#include <cstdlib> // std::malloc(), std::free()
+#include <format>
+#include <new>     // std::bad_alloc
+#include <string>
+#include <vector>
+
+#include <fcntl.h>  // open()
+#include <unistd.h> // dup(), dup2()
+
+#include <benchmark/benchmark.h>
+
+#include "curl_wrapper.h"
+#include "m3u8.h"
+#include "progressmeter.h"
+#include "throughput.h"
+
+//
+// Microbenchmarks of the hot paths: the m3u8-parsing, the url handling and the progressmeter.
+// Beside the time every benchmark reports its allocations (allocs/op and bytes/op) by the counting
+// operator new below, to hold the hot paths to allocation budgets.
+//
+
+// Internal function of m3u8.cc.
+auto tokenize_properties(std::string const& info) -> std::vector<std::string>;
+
+namespace
+{
+  std::atomic<bool> g_counting = false;
+  std::atomic<size_t> g_allocations = 0;
+  std::atomic<size_t> g_allocated = 0; // bytes
+
+  //! Counts the allocations from its construction to its destruction (except when paused)
+  //! into the counters allocs/op and bytes/op of the benchmark.
+  class allocation_counter_t
+  {
+  public:
+
+    explicit allocation_counter_t(benchmark::State& state)
+      : m_state{state}
+    {
+      g_allocations = 0;
+      g_allocated = 0;
+      g_counting = true;
+    }
+
+    ~allocation_counter_t()
+    {
+      g_counting = false;
+      m_state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(g_allocations.load()),
+          benchmark::Counter::kAvgIterations);
+      m_state.counters["bytes/op"] = benchmark::Counter(static_cast<double>(g_allocated.load()),
+          benchmark::Counter::kAvgIterations);
+    }
+
+    allocation_counter_t(allocation_counter_t const&) = delete;
+    auto operator=(allocation_counter_t const&) -> allocation_counter_t& = delete;
+
+    //! Pauses the timing and the counting e.g. for the setup of an iteration.
+    inline void pause() { m_state.PauseTiming(); g_counting = false; }
+    inline void resume() { g_counting = true; m_state.ResumeTiming(); }
+
+
+  private:
+
+    benchmark::State& m_state;
+  };
+
+  //! Redirects stdout to /dev/null until its destruction.
+  class silence_stdout_t
+  {
+  public:
+
+    silence_stdout_t()
+      : m_stdout{dup(STDOUT_FILENO)}
+    {
+      int const null = open("/dev/null", O_WRONLY);
+      dup2(null, STDOUT_FILENO);
+      close(null);
+    }
+
+    ~silence_stdout_t()
+    {
+      dup2(m_stdout, STDOUT_FILENO);
+      close(m_stdout);
+    }
+
+    silence_stdout_t(silence_stdout_t const&) = delete;
+    auto operator=(silence_stdout_t const&) -> silence_stdout_t& = delete;
+
+
+  private:
+
+    int const m_stdout;
+  };
+
+  //! A playlist with n segments.
+  auto make_playlist(size_t n, std::string const& prefix = "") -> std::vector<char>
+  {
+    std::string playlist = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:4\n#EXT-X-MEDIA-SEQUENCE:0\n";
+    for(size_t i=0; i<n; i++)
+      playlist += std::format("#EXTINF:4.000,\n{}seg{:07d}.ts\n", prefix, i);
+    playlist += "#EXT-X-ENDLIST\n";
+
+    return std::vector<char>(playlist.begin(), playlist.end());
+  }
+
+  std::string const stream_info = "BANDWIDTH=2999153,CODECS=\"mp4a.40.2,avc1.64001f\",RESOLUTION=1280x720,"
+    "FRAME-RATE=24,VIDEO-RANGE=SDR,CLOSED-CAPTIONS=NONE";
+}
+
+// ---
+
+void* operator new(size_t size)
+{
+  if(g_counting.load(std::memory_order_relaxed))
+  {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if(p == nullptr)
+    throw std::bad_alloc{};
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+// ---
+
+static void bm_m3u8_parse(benchmark::State& state)
+{
+  auto const buffer = make_playlist(static_cast<size_t>(state.range(0)));
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+  {
+    m3u8_t const m3u8{buffer};
+    benchmark::DoNotOptimize(m3u8.get_urls().data());
+  }
+
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+  state.SetBytesProcessed(state.iterations()*static_cast<int64_t>(buffer.size()));
+}
+BENCHMARK(bm_m3u8_parse)->Arg(1'000)->Arg(100'000)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+
+static void bm_m3u8_set_urlprefix(benchmark::State& state)
+{
+  m3u8_t const relative{make_playlist(static_cast<size_t>(state.range(0)))};
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+  {
+    allocations.pause();
+    m3u8_t m3u8 = relative;
+    allocations.resume();
+
+    m3u8.set_urlprefix("https://cdn.example.com/vod/1080p/");
+    benchmark::DoNotOptimize(m3u8.get_urls().data());
+  }
+
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(bm_m3u8_set_urlprefix)->Arg(1'000)->Arg(100'000)->Unit(benchmark::kMicrosecond);
+
+static void bm_m3u8_contains_relative_urls(benchmark::State& state)
+{
+  // The worst case, all urls have to be looked at.
+  m3u8_t const m3u8{make_playlist(static_cast<size_t>(state.range(0)), "https://cdn.example.com/vod/")};
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+    benchmark::DoNotOptimize(m3u8.contains_relative_urls());
+
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(bm_m3u8_contains_relative_urls)->Arg(1'000)->Arg(100'000)->Unit(benchmark::kMicrosecond);
+
+static void bm_tokenize_properties(benchmark::State& state)
+{
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+    benchmark::DoNotOptimize(tokenize_properties(stream_info));
+}
+BENCHMARK(bm_tokenize_properties);
+
+static void bm_get_filename_from_url(benchmark::State& state)
+{
+  std::string const url = "https://cdn.example.com/vod/1080p/segment_00042.ts?token=abcdef&expires=1700000000";
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+    benchmark::DoNotOptimize(curl_wrapper::get_filename_from_url(url));
+}
+BENCHMARK(bm_get_filename_from_url);
+
+static void bm_calc_eta(benchmark::State& state)
+{
+  auto const start = throughput_t::clock::now();
+  throughput_t throughput{3.0, start};
+  for(int i=1; i<=64; i++)
+    throughput.update(static_cast<size_t>(i)*100'000, start + std::chrono::milliseconds{100*i});
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+    benchmark::DoNotOptimize(calc_eta(throughput, throughput.bytes(), 0.4));
+}
+BENCHMARK(bm_calc_eta);
+
+static void bm_format_line(benchmark::State& state)
+{
+  download_process_t process{1, "segment_00042.ts"};
+  process.update(5'000'000, 2'000'000);
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+    benchmark::DoNotOptimize(format_line(process, 120));
+}
+BENCHMARK(bm_format_line);
+
+//! A frame of the progressmeter with so many running downloads.
+static void bm_progressmeter_print(benchmark::State& state)
+{
+  progressmeter_t progress;
+  progress.set_interval(std::chrono::milliseconds{0}); // every print() renders
+  progress.set_number_of_downloads(static_cast<size_t>(state.range(0)));
+
+  std::vector<download_process_t*> downloads = {};
+  for(int id=0; id<state.range(0); id++)
+    downloads.push_back(progress.add_download(id, std::format("segment_{:05d}.ts", id)));
+
+  silence_stdout_t silence;
+  size_t transfered = 0;
+
+  allocation_counter_t allocations{state};
+  for(auto _ : state)
+  {
+    transfered += 1'000;
+    for(auto download : downloads)
+      download->update(5'000'000, transfered);
+    progress.print();
+  }
+
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(bm_progressmeter_print)->Arg(1)->Arg(10)->Arg(100);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include "mirror.h"
+#include "url.h"
+
+void host_health_t::succeeded(std::string const& host, size_t bytes, double seconds)
+{
+  std::lock_guard lock{m_mutex};
+
+  auto& h = m_hosts[host];
+  h.failures = 0;
+
+  if(seconds <= 0.0)
+    return;
+
+  double const throughput = static_cast<double>(bytes)/seconds;
+  h.throughput = h.throughput.has_value() ? alpha*throughput + (1.0-alpha)*h.throughput.value() : throughput;
+}
+
+void host_health_t::failed(std::string const& host, clock::time_point now)
+{
+  std::lock_guard lock{m_mutex};
+
+  auto& h = m_hosts[host];
+  h.failures++;
+  h.last_failure = now;
+}
+
+auto host_health_t::is_down(std::string const& host, clock::time_point now) const -> bool
+{
+  std::lock_guard lock{m_mutex};
+  return down(host, now);
+}
+
+auto host_health_t::throughput(std::string const& host) const -> std::optional<double>
+{
+  std::lock_guard lock{m_mutex};
+  return measured(host);
+}
+
+auto host_health_t::down(std::string const& host, clock::time_point now) const -> bool
+{
+  auto it = m_hosts.find(host);
+  if(it == m_hosts.end())
+    return false;
+
+  return it->second.failures >= max_failures and now - it->second.last_failure < down_time;
+}
+
+auto host_health_t::measured(std::string const& host) const -> std::optional<double>
+{
+  auto it = m_hosts.find(host);
+  if(it == m_hosts.end())
+    return {};
+  return it->second.throughput;
+}
+
+auto host_health_t::pick(std::vector<std::string> const& urls, std::set<size_t> const& exclude,
+    clock::time_point now) const -> std::optional<size_t>
+{
+  std::optional<size_t> first = {};    // not excluded
+  std::optional<size_t> first_up = {};
+  std::optional<size_t> fastest = {};  // of the hosts that are up
+  double fastest_throughput = 0.0;
+
+  std::lock_guard lock{m_mutex};
+  for(size_t u=0; u<urls.size(); u++)
+  {
+    if(exclude.contains(u))
+      continue;
+    if(not first.has_value())
+      first = u;
+
+    std::string const host = host_of(urls[u]);
+    if(down(host, now))
+      continue;
+    if(not first_up.has_value())
+      first_up = u;
+
+    auto const t = measured(host);
+    if(t.has_value() and t.value() > fastest_throughput)
+    {
+      fastest = u;
+      fastest_throughput = t.value();
+    }
+  }
+
+  if(not first_up.has_value())
+    return first;
+
+  auto const t = measured(host_of(urls[first_up.value()]));
+  if(fastest.has_value() and t.has_value() and fastest_throughput > 2.0*t.value())
+    return fastest;
+
+  return first_up;
+}
+
+auto host_health_t::host_of(std::string const& url) -> std::string
+{
+  return parse_url(url).authority;
+}
@@ -0,0 +1,61 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Health and throughput per host, for picking between the mirrors of a download
+ * (the same segment on several hosts e.g. from redundant variants on different CDNs).
+ *
+ * A host is down after 3 consecutive failures, for 30 seconds since the last failure.
+ * Then it gets another chance. The throughput is a moving average of the finished downloads.
+ * It's thread-safe, so the concurrent runs of the daemon can share it.
+ */
+class host_health_t
+{
+public:
+
+  using clock = std::chrono::steady_clock;
+
+  void succeeded(std::string const& host, size_t bytes, double seconds);
+  void failed(std::string const& host, clock::time_point now = clock::now());
+
+  auto is_down(std::string const& host, clock::time_point now = clock::now()) const -> bool;
+
+  //! Measured throughput in bytes/s, if there was a download from the host yet.
+  auto throughput(std::string const& host) const -> std::optional<double>;
+
+  //! Returns the position in urls (ordered by priority) of the url to use, skipping the excluded positions:
+  //! The first one whose host is up, unless another host that is up is more than twice as fast.
+  //! If all hosts are down, the first not excluded one. Nothing if all are excluded.
+  auto pick(std::vector<std::string> const& urls, std::set<size_t> const& exclude = {},
+      clock::time_point now = clock::now()) const -> std::optional<size_t>;
+
+  //! The host (authority) of an url e.g. "cdn-a.example.com:8080".
+  static auto host_of(std::string const& url) -> std::string;
+
+
+private:
+
+  static constexpr size_t max_failures = 3;
+  static constexpr std::chrono::seconds down_time{30};
+  static constexpr double alpha = 0.3; // weight of the newest download in the moving average
+
+  struct host_t
+  {
+    size_t failures = 0; // consecutive
+    clock::time_point last_failure = {};
+    std::optional<double> throughput = {};
+  };
+
+  auto down(std::string const& host, clock::time_point now) const -> bool; // with locked mutex
+  auto measured(std::string const& host) const -> std::optional<double>;  // with locked mutex
+
+  mutable std::mutex m_mutex;
+  std::map<std::string, host_t> m_hosts = {};
+};
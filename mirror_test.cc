@@ -0,0 +1,75 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "mirror.h"
+
+using namespace std::chrono_literals;
+
+static std::vector<std::string> const urls = {
+  "https://cdn-a.example.com/v/seg1.ts",
+  "https://cdn-b.example.com/v/seg1.ts",
+  "https://cdn-c.example.com:8080/v/seg1.ts",
+};
+
+TEST(mirror_tests, host_of)
+{
+  EXPECT_EQ(host_health_t::host_of(urls[0]), "cdn-a.example.com");
+  EXPECT_EQ(host_health_t::host_of(urls[2]), "cdn-c.example.com:8080");
+}
+
+TEST(mirror_tests, is_down)
+{
+  host_health_t health;
+  auto const now = host_health_t::clock::now();
+
+  health.failed("cdn-a.example.com", now);
+  health.failed("cdn-a.example.com", now);
+  EXPECT_FALSE(health.is_down("cdn-a.example.com", now));
+  health.failed("cdn-a.example.com", now);
+  EXPECT_TRUE(health.is_down("cdn-a.example.com", now));
+  EXPECT_FALSE(health.is_down("cdn-a.example.com", now + 31s)); // another chance
+
+  health.succeeded("cdn-a.example.com", 1000, 1.0);
+  health.failed("cdn-a.example.com", now);
+  EXPECT_FALSE(health.is_down("cdn-a.example.com", now));
+}
+
+TEST(mirror_tests, pick)
+{
+  host_health_t health;
+  auto const now = host_health_t::clock::now();
+
+  EXPECT_EQ(health.pick(urls, {}, now), 0);
+  EXPECT_EQ(health.pick(urls, {0}, now), 1);
+  EXPECT_FALSE(health.pick(urls, {0, 1, 2}, now).has_value());
+
+  for(int n=0; n<3; n++)
+    health.failed("cdn-a.example.com", now);
+  EXPECT_EQ(health.pick(urls, {}, now), 1);
+
+  for(int n=0; n<3; n++)
+  {
+    health.failed("cdn-b.example.com", now);
+    health.failed("cdn-c.example.com:8080", now);
+  }
+  EXPECT_EQ(health.pick(urls, {}, now), 0); // all down
+  EXPECT_EQ(health.pick(urls, {0}, now), 1);
+}
+
+TEST(mirror_tests, pick_throughput)
+{
+  host_health_t health;
+  auto const now = host_health_t::clock::now();
+
+  health.succeeded("cdn-a.example.com", 1'000'000, 1.0);
+  health.succeeded("cdn-b.example.com", 1'500'000, 1.0);
+  EXPECT_EQ(health.pick(urls, {}, now), 0); // not more than twice as fast
+
+  health.succeeded("cdn-c.example.com:8080", 3'000'000, 1.0);
+  EXPECT_EQ(health.pick(urls, {}, now), 2);
+  ASSERT_TRUE(health.throughput("cdn-c.example.com:8080").has_value());
+  EXPECT_DOUBLE_EQ(health.throughput("cdn-c.example.com:8080").value(), 3'000'000.0);
+
+  health.succeeded("cdn-c.example.com:8080", 1'000'000, 1.0); // moving average
+  EXPECT_DOUBLE_EQ(health.throughput("cdn-c.example.com:8080").value(), 0.3*1'000'000.0 + 0.7*3'000'000.0);
+}
@@ -0,0 +1,436 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::max, std::min
+#include <cerrno>
+#include <charconv>  // std::from_chars
+#include <format>
+#include <string>
+#include <system_error> // std::system_error
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>   // htonl, htons, ntohs
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <poll.h>
+#include <strings.h>     // strncasecmp
+#include <sys/socket.h>
+#include <unistd.h>      // close
+
+#include "origin.h"
+
+static constexpr size_t ts_packet_size = 188;
+static constexpr size_t chunk_size = 16*1'024; // bytes sent at once
+
+static auto parse_number(std::string_view str) -> std::optional<uint64_t>;
+static auto parse_range(std::string_view value) -> std::optional<std::tuple<uint64_t, std::optional<uint64_t>>>;
+static void throw_errno(std::string const& what);
+
+// ---
+
+auto origin_segment_size(origin_config_t const& config, size_t variant) -> size_t
+{
+  size_t const variants = std::max<size_t>(config.variants, 1);
+  return std::max<size_t>(config.segment_bytes*variant/variants, 2*1'024);
+}
+
+auto origin_resource(origin_config_t const& config, std::string_view path) -> std::optional<origin_resource_t>
+{
+  constexpr char const* m3u8_type = "application/vnd.apple.mpegurl";
+
+  if(path == "/master.m3u8")
+  {
+    std::string body = "#EXTM3U\n#EXT-X-VERSION:3\n";
+    for(size_t v=1; v<=config.variants; v++)
+    {
+      auto const bandwidth = static_cast<uint64_t>(
+          static_cast<double>(origin_segment_size(config, v))*8.0/config.segment_seconds);
+      body += std::format("#EXT-X-STREAM-INF:BANDWIDTH={},RESOLUTION={}x{}\nv{}/index.m3u8\n",
+          bandwidth, 640*v, 360*v, v);
+    }
+    return origin_resource_t{m3u8_type, body};
+  }
+
+  // /v<VARIANT>/...
+  if(not path.starts_with("/v"))
+    return {};
+  size_t const slash = path.find('/', 2);
+  auto const variant = parse_number(path.substr(2, slash == std::string_view::npos ? slash : slash - 2));
+  if(slash == std::string_view::npos or not variant.has_value() or variant.value() < 1
+      or variant.value() > config.variants)
+    return {};
+
+  std::string_view const file = path.substr(slash + 1);
+  if(file == "index.m3u8")
+  {
+    std::string body = std::format("#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:{:.0f}\n"
+        "#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n", config.segment_seconds);
+    for(size_t i=0; i<config.segments; i++)
+      body += std::format("#EXTINF:{:.3f},\nseg{:05}.ts\n", config.segment_seconds, i);
+    body += "#EXT-X-ENDLIST\n";
+    return origin_resource_t{m3u8_type, body};
+  }
+
+  if(file.starts_with("seg") and file.ends_with(".ts"))
+  {
+    auto const index = parse_number(file.substr(3, file.size() - 6));
+    if(not index.has_value() or index.value() >= config.segments)
+      return {};
+    return origin_resource_t{"video/mp2t", "", origin_segment_size(config, variant.value())};
+  }
+
+  return {};
+}
+
+void origin_fill(char* out, uint64_t offset, size_t size)
+{
+  // A packet: sync byte, PID 0x100 (payload start at the first one of 16), continuity counter, payload.
+  for(size_t i=0; i<size; i++)
+  {
+    uint64_t const position = offset + i;
+    uint64_t const packet = position/ts_packet_size;
+    switch(position % ts_packet_size)
+    {
+      case 0:  out[i] = 0x47; break;
+      case 1:  out[i] = static_cast<char>(packet % 16 == 0 ? 0x41 : 0x01); break;
+      case 2:  out[i] = 0x00; break;
+      case 3:  out[i] = static_cast<char>(0x10 | (packet % 16)); break;
+      default: out[i] = static_cast<char>(position*31 % 251); break;
+    }
+  }
+}
+
+auto parse_http_request(std::string_view head) -> std::optional<http_request_t>
+{
+  http_request_t request;
+
+  // METHOD SP PATH SP HTTP/1.x
+  size_t end = head.find("\r\n");
+  std::string_view const line = head.substr(0, end);
+  size_t const first = line.find(' ');
+  size_t const second = first == std::string_view::npos ? first : line.find(' ', first + 1);
+  if(second == std::string_view::npos or not line.substr(second + 1).starts_with("HTTP/1."))
+    return {};
+
+  request.method = line.substr(0, first);
+  request.path = line.substr(first + 1, second - first - 1);
+  if(request.path.empty() or request.path.front() != '/')
+    return {};
+  request.keep_alive = line.substr(second + 1) != "HTTP/1.0";
+
+  while(end != std::string_view::npos)
+  {
+    size_t const begin = end + 2;
+    end = head.find("\r\n", begin);
+    std::string_view const header = head.substr(begin, end == std::string_view::npos ? end : end - begin);
+
+    size_t const colon = header.find(':');
+    if(colon == std::string_view::npos)
+      continue;
+    std::string_view const name = header.substr(0, colon);
+    std::string_view value = header.substr(colon + 1);
+    while(value.starts_with(' '))
+      value.remove_prefix(1);
+
+    if(name.size() == 5 and strncasecmp(name.data(), "Range", 5) == 0)
+    {
+      request.range = parse_range(value);
+      if(not request.range.has_value())
+        return {};
+    }
+    else if(name.size() == 10 and strncasecmp(name.data(), "Connection", 10) == 0)
+    {
+      if(value.size() == 5 and strncasecmp(value.data(), "close", 5) == 0)
+        request.keep_alive = false;
+      else if(value.size() == 10 and strncasecmp(value.data(), "keep-alive", 10) == 0)
+        request.keep_alive = true;
+    }
+  }
+
+  return request;
+}
+
+// ---
+
+origin_t::origin_t(origin_config_t const& config, uint16_t port)
+  : m_config{config}
+{
+  m_listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(m_listener < 0)
+    throw_errno("Couldn't create socket");
+
+  int const one = 1;
+  setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+
+  socklen_t length = sizeof(address);
+  if(bind(m_listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0
+      or listen(m_listener, 128) != 0
+      or getsockname(m_listener, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+  {
+    int const err = errno;
+    close(m_listener);
+    errno = err;
+    throw_errno(std::format("Couldn't listen on port {}", port));
+  }
+
+  m_port = ntohs(address.sin_port);
+}
+
+origin_t::~origin_t()
+{
+  close(m_listener);
+}
+
+auto origin_t::url(std::string_view path) const -> std::string
+{
+  return std::format("http://127.0.0.1:{}{}", m_port, path);
+}
+
+void origin_t::run()
+{
+  using namespace std::chrono_literals;
+
+  std::vector<std::thread> connections = {};
+  uint32_t seed = m_config.seed;
+
+  while(not m_stop)
+  {
+    pollfd pfd{m_listener, POLLIN, 0};
+    constexpr int timeout = std::chrono::milliseconds{100ms}.count(); // for noticing stop()
+    if(poll(&pfd, 1, timeout) <= 0)
+      continue;
+
+    int const fd = accept4(m_listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if(fd < 0)
+      continue;
+
+    int const one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    connections.emplace_back(&origin_t::serve, this, fd, seed++);
+  }
+
+  for(auto& connection : connections)
+    connection.join();
+}
+
+void origin_t::serve(int fd, uint32_t seed)
+{
+  using namespace std::chrono_literals;
+
+  std::mt19937 random{seed};
+  std::string buffer = "";
+
+  bool open = true;
+  while(open and not m_stop)
+  {
+    size_t const end = buffer.find("\r\n\r\n");
+    if(end == std::string::npos)
+    {
+      pollfd pfd{fd, POLLIN, 0};
+      constexpr int timeout = std::chrono::milliseconds{100ms}.count();
+      int const ready = poll(&pfd, 1, timeout);
+      if(ready < 0 and errno != EINTR)
+        break;
+      if(ready <= 0)
+        continue;
+
+      char data[4'096];
+      ssize_t const n = recv(fd, data, sizeof(data), 0);
+      if(n < 0 and errno == EINTR)
+        continue;
+      if(n <= 0)
+        break;
+
+      buffer.append(data, static_cast<size_t>(n));
+      constexpr size_t max_head = 64*1'024; // A request is never that long.
+      open = buffer.size() <= max_head;
+      continue;
+    }
+
+    auto const request = parse_http_request(std::string_view{buffer}.substr(0, end + 2));
+    buffer.erase(0, end + 4);
+    m_requests++;
+
+    if(not request.has_value())
+    {
+      send_all(fd, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+      break;
+    }
+
+    open = respond(fd, request.value(), random) and request->keep_alive;
+  }
+
+  close(fd);
+}
+
+auto origin_t::respond(int fd, http_request_t const& request, std::mt19937& random) -> bool
+{
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+
+  double const latency = m_config.latency + m_config.jitter*uniform(random);
+  if(latency > 0.0)
+    std::this_thread::sleep_for(std::chrono::duration<double>{latency});
+
+  auto const resource = origin_resource(m_config, request.path);
+  if((request.method != "GET" and request.method != "HEAD") or not resource.has_value())
+  {
+    std::string_view const status = resource.has_value() ? "405 Method Not Allowed" : "404 Not Found";
+    return send_all(fd, std::format("HTTP/1.1 {}\r\nContent-Length: 0\r\n\r\n", status));
+  }
+
+  bool const head = request.method == "HEAD";
+  bool const is_segment = resource->body.empty();
+
+  // The errors of a CDN, only of downloads of segments.
+  double const error = is_segment and not head ? uniform(random) : 1.0;
+  double threshold = m_config.error_429;
+  if(error < threshold)
+  {
+    m_errors++;
+    return send_all(fd, "HTTP/1.1 429 Too Many Requests\r\nContent-Type: text/plain\r\nRetry-After: 1\r\n"
+        "Content-Length: 17\r\n\r\nToo Many Requests");
+  }
+  threshold += m_config.error_1015;
+  if(error < threshold)
+  {
+    m_errors++;
+    return send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 16\r\n\r\nerror code: 1015");
+  }
+  threshold += m_config.reset;
+  bool const reset = error < threshold;
+  threshold += m_config.truncate;
+  bool const truncate = not reset and error < threshold;
+
+  size_t const size = is_segment ? resource->segment_size : resource->body.size();
+  uint64_t first = 0;
+  uint64_t length = size;
+  std::string status = "200 OK";
+  std::string content_range = "";
+  if(request.range.has_value())
+  {
+    auto const& [from, to] = request.range.value();
+    uint64_t const last = std::min<uint64_t>(to.value_or(size - 1), size - 1);
+    if(from > last)
+      return send_all(fd, std::format("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */{}\r\n"
+          "Content-Length: 0\r\n\r\n", size));
+
+    first = from;
+    length = last - from + 1;
+    status = "206 Partial Content";
+    content_range = std::format("Content-Range: bytes {}-{}/{}\r\n", first, last, size);
+  }
+
+  std::string const header = std::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\n{}"
+      "Accept-Ranges: bytes\r\n\r\n", status, resource->content_type, length, content_range);
+  if(not send_all(fd, header))
+    return false;
+  if(head)
+    return true;
+
+  if(not is_segment)
+  {
+    m_sent += length;
+    return send_all(fd, std::string_view{resource->body}.substr(first, length));
+  }
+
+  if(reset or truncate)
+  {
+    m_errors++;
+    send_segment(fd, first, length/2);
+    if(reset) // An abortive close sends RST instead of FIN.
+    {
+      linger const abort{1, 0};
+      setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+    return false;
+  }
+
+  return send_segment(fd, first, length);
+}
+
+auto origin_t::send_segment(int fd, uint64_t offset, size_t size) -> bool
+{
+  auto const start = clock::now();
+
+  char chunk[chunk_size];
+  size_t sent = 0;
+  while(sent < size and not m_stop)
+  {
+    size_t const n = std::min(chunk_size, size - sent);
+    origin_fill(chunk, offset + sent, n);
+    if(not send_all(fd, std::string_view{chunk, n}))
+      return false;
+    sent += n;
+    m_sent += n;
+
+    // Not faster than the bandwidth.
+    if(m_config.bandwidth > 0)
+    {
+      double const seconds = static_cast<double>(sent)/static_cast<double>(m_config.bandwidth);
+      std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(
+          std::chrono::duration<double>{seconds}));
+    }
+  }
+
+  return sent == size;
+}
+
+auto origin_t::send_all(int fd, std::string_view data) -> bool
+{
+  size_t sent = 0;
+  while(sent < data.size())
+  {
+    ssize_t const n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if(n < 0 and errno == EINTR)
+      continue;
+    if(n <= 0)
+      return false;
+    sent += static_cast<size_t>(n);
+  }
+
+  return true;
+}
+
+// ---
+
+auto parse_number(std::string_view str) -> std::optional<uint64_t>
+{
+  uint64_t value = 0;
+  auto const [ptr, errc] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if(str.empty() or errc != std::errc{} or ptr != str.data() + str.size())
+    return {};
+  return value;
+}
+
+//! bytes=FIRST-[LAST], a single range only.
+auto parse_range(std::string_view value) -> std::optional<std::tuple<uint64_t, std::optional<uint64_t>>>
+{
+  if(not value.starts_with("bytes="))
+    return {};
+  value.remove_prefix(6);
+
+  size_t const dash = value.find('-');
+  if(dash == std::string_view::npos)
+    return {};
+
+  auto const first = parse_number(value.substr(0, dash));
+  if(not first.has_value())
+    return {};
+  if(dash + 1 == value.size())
+    return std::make_tuple(first.value(), std::optional<uint64_t>{});
+
+  auto const last = parse_number(value.substr(dash + 1));
+  if(not last.has_value() or last.value() < first.value())
+    return {};
+  return std::make_tuple(first.value(), last);
+}
+
+void throw_errno(std::string const& what)
+{
+  throw std::system_error{errno, std::generic_category(), what};
+}
@@ -0,0 +1,123 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint> // uint16_t, uint32_t, uint64_t
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+//
+// A local HLS origin, to benchmark and test download_files() without a network: An HTTP/1.1-server on the
+// loopback, that generates a master m3u8-file, a playlist per variant and its MPEG-TS segments:
+//   /master.m3u8, /v<VARIANT>/index.m3u8 and /v<VARIANT>/seg<INDEX>.ts (VARIANT from 1, INDEX from 0)
+// Every connection has the configured bandwidth and latency (plus jitter) and the segment requests fail
+// at random like at a real CDN: 429, a short "error code: 1015" page, a reset or a truncated body.
+// Keep-alive, HEAD-requests (see curl_wrapper::preflight()) and byte ranges are supported.
+//
+
+struct origin_config_t
+{
+  size_t variants = 3;
+  size_t segments = 100;              // per playlist
+  size_t segment_bytes = 1'024*1'024; // of the highest variant, the others are smaller by their bandwidth
+  double segment_seconds = 4.0;       // #EXTINF
+
+  size_t bandwidth = 0; // per connection in bytes/s, 0 is unlimited
+  double latency = 0.0; // seconds until a response starts
+  double jitter = 0.0;  // up to so many seconds more latency (uniformly random)
+
+  // Probabilities (0.0 to 1.0) of the errors of a segment request.
+  double error_429 = 0.0;  // 429 Too Many Requests
+  double error_1015 = 0.0; // 200 with the short page "error code: 1015" (rate limit of Cloudflare)
+  double reset = 0.0;      // the connection is reset in the middle of the body
+  double truncate = 0.0;   // the connection is closed in the middle of the body
+
+  uint32_t seed = 1; // of the jitter and the errors
+};
+
+//! What the origin serves at a path.
+struct origin_resource_t
+{
+  std::string content_type = "";
+  std::string body = "";   // of a m3u8-file
+  size_t segment_size = 0; // of a segment, its bytes are generated by origin_fill()
+};
+
+//! The resource at the path, nothing if there is none.
+auto origin_resource(origin_config_t const& config, std::string_view path) -> std::optional<origin_resource_t>;
+
+//! The size of the segments of the variant (1 to variants, the last is the largest), at least 2 KB.
+auto origin_segment_size(origin_config_t const& config, size_t variant) -> size_t;
+
+//! The bytes [offset, offset+size) of a segment: MPEG-TS packets of 188 bytes (starting with 0x47).
+void origin_fill(char* out, uint64_t offset, size_t size);
+
+//! The request line and headers of an HTTP/1.1-request, as far as the origin needs them.
+struct http_request_t
+{
+  std::string method = "";
+  std::string path = "";
+  std::optional<std::tuple<uint64_t, std::optional<uint64_t>>> range = {}; // Range: bytes=FIRST-[LAST]
+  bool keep_alive = true;
+};
+
+//! Parse the head of a request (up to the empty line), nothing if it's malformed.
+auto parse_http_request(std::string_view head) -> std::optional<http_request_t>;
+
+class origin_t
+{
+public:
+
+  using clock = std::chrono::steady_clock;
+
+  //! Listens on 127.0.0.1 at the port (0 for any free one). Throws std::system_error.
+  explicit origin_t(origin_config_t const& config, uint16_t port = 0);
+  ~origin_t();
+
+  origin_t(origin_t const&) = delete;
+  auto operator=(origin_t const&) -> origin_t& = delete;
+
+  //! Serves every connection in a thread of its own until stop().
+  void run();
+
+  //! Lets run() return, thread-safe.
+  inline void stop() { m_stop = true; }
+
+  inline auto port() const -> uint16_t { return m_port; }
+
+  //! http://127.0.0.1:<PORT><PATH>
+  auto url(std::string_view path = "/master.m3u8") const -> std::string;
+
+  inline auto requests() const -> size_t { return m_requests; }
+  inline auto sent_bytes() const -> size_t { return m_sent; }
+  inline auto injected_errors() const -> size_t { return m_errors; }
+
+
+private:
+
+  //! Answers the requests of the connection until it's closed, then closes it.
+  void serve(int fd, uint32_t seed);
+
+  //! Sends the response to the request, false if the connection has to be closed (e.g. for an error).
+  auto respond(int fd, http_request_t const& request, std::mt19937& random) -> bool;
+
+  //! Sends the generated bytes [offset, offset+size) of a segment at the bandwidth, false if the connection broke.
+  auto send_segment(int fd, uint64_t offset, size_t size) -> bool;
+
+  //! Sends all of data, false if the connection broke.
+  auto send_all(int fd, std::string_view data) -> bool;
+
+  origin_config_t const m_config;
+
+  int m_listener = -1;
+  uint16_t m_port = 0;
+
+  std::atomic<bool> m_stop = false;
+  std::atomic<size_t> m_requests = 0;
+  std::atomic<size_t> m_sent = 0; // bytes of the bodies
+  std::atomic<size_t> m_errors = 0;
+};
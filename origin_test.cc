@@ -0,0 +1,192 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "curl_wrapper.h"
+#include "json.h"
+#include "m3u8.h"
+#include "origin.h"
+#include "trace.h"
+
+TEST(origin_tests, resources)
+{
+  origin_config_t config;
+  config.variants = 2;
+  config.segments = 3;
+  config.segment_bytes = 100'000;
+
+  auto const master = origin_resource(config, "/master.m3u8");
+  ASSERT_TRUE(master.has_value());
+  EXPECT_NE(master->body.find("#EXT-X-STREAM-INF:BANDWIDTH=200000,RESOLUTION=1280x720\nv2/index.m3u8"),
+      std::string::npos);
+
+  auto const playlist = origin_resource(config, "/v1/index.m3u8");
+  ASSERT_TRUE(playlist.has_value());
+  EXPECT_NE(playlist->body.find("seg00002.ts\n#EXT-X-ENDLIST"), std::string::npos);
+
+  auto const segment = origin_resource(config, "/v1/seg00002.ts");
+  ASSERT_TRUE(segment.has_value());
+  EXPECT_TRUE(segment->body.empty());
+  EXPECT_EQ(segment->segment_size, 50'000);
+  EXPECT_EQ(origin_segment_size(config, 2), 100'000);
+
+  EXPECT_FALSE(origin_resource(config, "/v1/seg00003.ts").has_value()); // only 3 segments
+  EXPECT_FALSE(origin_resource(config, "/v3/index.m3u8").has_value());
+  EXPECT_FALSE(origin_resource(config, "/v0/index.m3u8").has_value());
+  EXPECT_FALSE(origin_resource(config, "/index.m3u8").has_value());
+
+  // The same bytes in any pieces.
+  char whole[400];
+  char piece[200];
+  origin_fill(whole, 0, sizeof(whole));
+  origin_fill(piece, 200, sizeof(piece));
+  EXPECT_EQ(whole[0], 0x47);
+  EXPECT_EQ(whole[188], 0x47);
+  EXPECT_EQ(std::string(whole + 200, 200), std::string(piece, 200));
+}
+
+TEST(origin_tests, parse_http_request)
+{
+  auto const request = parse_http_request("GET /v1/seg00001.ts HTTP/1.1\r\nHost: 127.0.0.1\r\nrange: bytes=10-19\r\n");
+  ASSERT_TRUE(request.has_value());
+  EXPECT_EQ(request->method, "GET");
+  EXPECT_EQ(request->path, "/v1/seg00001.ts");
+  EXPECT_EQ(request->range, std::make_tuple(10, std::optional<uint64_t>{19}));
+  EXPECT_TRUE(request->keep_alive);
+
+  auto const open_range = parse_http_request("HEAD / HTTP/1.1\r\nRange: bytes=5-\r\nConnection: close\r\n");
+  ASSERT_TRUE(open_range.has_value());
+  EXPECT_EQ(open_range->range, std::make_tuple(5, std::optional<uint64_t>{}));
+  EXPECT_FALSE(open_range->keep_alive);
+
+  EXPECT_FALSE(parse_http_request("GET /\r\n").has_value());
+  EXPECT_FALSE(parse_http_request("GET / SPDY/3\r\n").has_value());
+  EXPECT_FALSE(parse_http_request("GET / HTTP/1.1\r\nRange: bytes=9-1\r\n").has_value());
+}
+
+//! Downloads from the origin on the loopback.
+class origin_download_tests : public testing::Test
+{
+protected:
+
+  void SetUp() override
+  {
+    curl_wrapper::init();
+
+    m_dir = std::filesystem::temp_directory_path() / std::format("origin_test-{}", getpid());
+    std::filesystem::create_directories(m_dir);
+
+    m_config.variants = 1;
+    m_config.segments = 8;
+    m_config.segment_bytes = 20'000;
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(m_dir);
+    curl_wrapper::cleanup();
+  }
+
+  //! The downloads of the segments of the playlist of the origin, only the range of each if given.
+  auto download(origin_config_t const& config, double hedge_budget = 0.0,
+      std::optional<std::tuple<uint64_t, uint64_t>> const& range = {}, std::shared_ptr<trace_t> trace = nullptr)
+    -> curl_wrapper::results_t
+  {
+    origin_t origin{config};
+    std::thread server{&origin_t::run, &origin};
+
+    curl_wrapper curl;
+    curl.hedge_budget(hedge_budget);
+    curl.trace(std::move(trace));
+
+    auto const buffer = curl.download_buffer(origin.url("/v1/index.m3u8"));
+    EXPECT_TRUE(std::holds_alternative<std::vector<char>>(buffer));
+    m3u8_t playlist{std::get<std::vector<char>>(buffer)};
+    playlist.resolve_urls(origin.url("/v1/index.m3u8"));
+
+    std::vector<curl_wrapper::download_t> downloads = {};
+    for(size_t i=0; i<playlist.get_urls().size(); i++)
+    {
+      downloads.push_back({m_dir / std::format("{}.ts", i), playlist.get_urls()[i].url});
+      downloads.back().range = range;
+    }
+    auto results = curl.download_files(downloads);
+
+    origin.stop();
+    server.join();
+    return results;
+  }
+
+  origin_config_t m_config = {};
+  std::filesystem::path m_dir = "";
+};
+
+TEST_F(origin_download_tests, download)
+{
+  auto const results = download(m_config);
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), 8);
+  EXPECT_EQ(results.stats.bytes(), 8*20'000);
+  EXPECT_EQ(std::filesystem::file_size(m_dir / "7.ts"), 20'000);
+}
+
+TEST_F(origin_download_tests, errors)
+{
+  // Every segment fails, a fourth in each way.
+  origin_config_t config = m_config;
+  config.error_429 = 0.25;
+  config.error_1015 = 0.25;
+  config.reset = 0.25;
+  config.truncate = 0.25;
+
+  auto const results = download(config);
+  EXPECT_TRUE(results.succeeded_files.empty());
+  EXPECT_FALSE(results.errors.empty());
+}
+
+TEST_F(origin_download_tests, hedges)
+{
+  // The jitter makes stragglers, which are hedged at the end. The one of a download and its hedge that
+  // finishes first wins, often both in the same round.
+  origin_config_t config = m_config;
+  config.segments = 40;
+  config.jitter = 0.2;
+
+  auto const results = download(config, 1.0);
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), 40);
+  for(size_t i=0; i<40; i++)
+    EXPECT_EQ(std::filesystem::file_size(m_dir / std::format("{}.ts", i)), 20'000);
+}
+
+TEST_F(origin_download_tests, hedges_of_byte_ranges)
+{
+  // A byte range is smaller than a segment has to be (1 KB), so a won hedge is verified by the length of the range.
+  // A download the hedge won against is canceled, the larger jitter makes stragglers that lose to their hedges.
+  origin_config_t config = m_config;
+  config.segments = 40;
+  config.jitter = 0.5;
+
+  auto const trace = std::make_shared<trace_t>();
+  auto const results = download(config, 1.0, std::make_tuple(100, 500), trace);
+  EXPECT_TRUE(results.errors.empty());
+  EXPECT_EQ(results.succeeded_files.size(), 40);
+  for(size_t i=0; i<40; i++)
+    EXPECT_EQ(std::filesystem::file_size(m_dir / std::format("{}.ts", i)), 500);
+
+  auto const json = parse_json(trace->json());
+  ASSERT_TRUE(json.has_value());
+  auto const events = json->get("traceEvents").value().as_array();
+  size_t won = 0;
+  for(auto const& event : events)
+    if(event.get_string("cat") == "transfer" and event.get("args").value_or(json_t{}).get("canceled") == json_t{true})
+      won++;
+  EXPECT_GT(won, 0);
+}
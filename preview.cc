@@ -0,0 +1,150 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::max, std::min, std::ranges::sort, std::ranges::stable_sort
+#include <cerrno>
+#include <charconv>  // std::from_chars
+#include <fstream>
+#include <map>
+#include <system_error> // std::error_code
+
+#include "preview.h"
+
+static auto parse_integer(std::string const& str) -> std::optional<uint64_t>;
+
+auto parse_preview(std::string const& preview) -> std::optional<preview_t>
+{
+  if(preview == "keyframes")
+    return preview_t::keyframes;
+  if(preview == "thumbnails")
+    return preview_t::thumbnails;
+  return {};
+}
+
+auto pick_iframe_stream(m3u8_t const& master, variant_policy_t policy) -> std::optional<size_t>
+{
+  // The I-frame playlists have the attributes of variants (BANDWIDTH, RESOLUTION, CODECS), so pick them alike.
+  auto const variants = parse_variants(m3u8_t{master.get_iframe_streams()});
+  bool const by_policy = policy != variant_policy_t::ask and policy != variant_policy_t::automatic;
+  return select_variant(variants, by_policy ? policy : variant_policy_t::max_bandwidth);
+}
+
+auto iframe_ranges(m3u8_t const& playlist) -> std::vector<byterange_t>
+{
+  std::vector<byterange_t> ranges = {};
+
+  for(auto const& segment : playlist.get_urls())
+  {
+    // Only whole segments can be decrypted.
+    if(segment.properties.contains("KEY-METHOD"))
+      throw m3u8_errc::unsupported_encryption;
+
+    byterange_t range{segment.url};
+    if(segment.properties.contains("BYTERANGE-LENGTH"))
+    {
+      range.offset = parse_integer(segment.properties.at("BYTERANGE-OFFSET")).value_or(0);
+      range.length = parse_integer(segment.properties.at("BYTERANGE-LENGTH")).value_or(0);
+    }
+    ranges.push_back(range);
+  }
+
+  return ranges;
+}
+
+auto coalesce_ranges(std::vector<byterange_t> const& ranges, uint64_t max_gap) -> coalesced_t
+{
+  // (first range, fetch, ranges) - the first range is for ordering the fetches by the playback.
+  std::vector<std::tuple<size_t, byterange_t, std::vector<size_t>>> fetches = {};
+
+  std::map<std::string, std::vector<size_t>> by_url = {};
+  for(size_t i=0; i<ranges.size(); i++)
+    by_url[ranges[i].url].push_back(i);
+
+  for(auto& [url, indices] : by_url)
+  {
+    std::ranges::stable_sort(indices, {}, [&ranges](size_t i) { return ranges[i].offset; });
+
+    std::optional<size_t> current = {}; // fetch of the url to extend
+    for(size_t i : indices)
+    {
+      auto const& range = ranges[i];
+      if(current.has_value())
+      {
+        auto& [first, fetch, merged] = fetches[current.value()];
+        uint64_t const end = fetch.offset + fetch.length;
+        if(range.length > 0 and fetch.length > 0 and range.offset <= end + max_gap)
+        {
+          fetch.length = std::max(end, range.offset + range.length) - fetch.offset;
+          first = std::min(first, i);
+          merged.push_back(i);
+          continue;
+        }
+      }
+
+      fetches.push_back(std::make_tuple(i, range, std::vector<size_t>{i}));
+      current = fetches.size() - 1;
+    }
+  }
+
+  std::ranges::sort(fetches, {}, [](auto const& fetch) { return std::get<0>(fetch); });
+
+  coalesced_t coalesced;
+  coalesced.pieces.resize(ranges.size());
+  for(size_t f=0; f<fetches.size(); f++)
+  {
+    auto const& [_, fetch, merged] = fetches[f];
+    coalesced.fetches.push_back(fetch);
+    for(size_t i : merged)
+      coalesced.pieces[i] = std::make_tuple(f, ranges[i].offset - fetch.offset, ranges[i].length);
+  }
+
+  return coalesced;
+}
+
+auto write_pieces(coalesced_t const& coalesced, std::vector<std::filesystem::path> const& paths,
+    std::filesystem::path const& out) -> size_t
+{
+  std::ofstream file{out, std::ios::binary};
+
+  size_t written = 0;
+  std::vector<char> buffer = {};
+  for(auto const& [f, offset, length] : coalesced.pieces)
+  {
+    if(file.fail())
+      break;
+
+    std::error_code errc;
+    auto const size = std::filesystem::file_size(paths[f], errc);
+    if(errc or offset + length > size)
+      continue;
+
+    std::ifstream in{paths[f], std::ios::binary};
+    in.seekg(static_cast<std::streamoff>(offset));
+
+    buffer.resize(length > 0 ? length : size);
+    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if(in.gcount() != static_cast<std::streamsize>(buffer.size()))
+      continue;
+
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    written++;
+  }
+
+  if(file.fail())
+  {
+    int const err = errno;
+    std::error_code errc{err, std::generic_category()};
+    throw std::filesystem::filesystem_error{"Couldn't write file", out, errc};
+  }
+
+  return written;
+}
+
+// ---
+
+auto parse_integer(std::string const& str) -> std::optional<uint64_t>
+{
+  uint64_t value = 0;
+  auto const [ptr, errc] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if(errc != std::errc{} or ptr != str.data() + str.size())
+    return {};
+  return value;
+}
@@ -0,0 +1,61 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "m3u8.h"
+#include "variant.h"
+
+//
+// A preview (--preview) downloads only the key frames of a programme via its I-frame playlist
+// (#EXT-X-I-FRAME-STREAM-INF), whose segments are byte ranges of the media segments (#EXT-X-BYTERANGE).
+// Neighbouring ranges are fetched together and the key frames are put together into a sparse keyframe stream,
+// that ffmpeg turns into a video or thumbnails. That's a small fraction of the bytes of the programme.
+//
+
+enum class preview_t
+{
+  none,
+  keyframes,  // <NAME>.mp4 of the key frames only
+  thumbnails, // <NAME>-00001.jpg, ... one per key frame
+};
+
+//! Parse "keyframes" or "thumbnails".
+auto parse_preview(std::string const& preview) -> std::optional<preview_t>;
+
+//! Bytes [offset, offset+length) of the url, a length of 0 is all of it.
+struct byterange_t
+{
+  std::string url = "";
+  uint64_t offset = 0;
+  uint64_t length = 0;
+
+  auto operator==(byterange_t const& other) const -> bool = default;
+};
+
+//! The fetches (byte ranges to download) for some byte ranges and where to find each range in them.
+struct coalesced_t
+{
+  std::vector<byterange_t> fetches = {};
+  std::vector<std::tuple<size_t, uint64_t, uint64_t>> pieces = {}; // per range: fetch, offset in it and length
+};
+
+//! The I-frame playlist of the master to take (position in get_iframe_streams()), nothing if there is none.
+//! It's picked like a variant, for the policies ask and automatic the one with the highest bandwidth.
+auto pick_iframe_stream(m3u8_t const& master, variant_policy_t policy) -> std::optional<size_t>;
+
+//! The byte ranges of the I-frames in playback order. Throws if they are encrypted.
+auto iframe_ranges(m3u8_t const& playlist) -> std::vector<byterange_t>;
+
+//! Merges the byte ranges of the same url, that are at most max_gap bytes apart, into one fetch.
+//! (A request costs a round trip, in which the gap could be downloaded as well.)
+auto coalesce_ranges(std::vector<byterange_t> const& ranges, uint64_t max_gap) -> coalesced_t;
+
+//! Writes the pieces out of the fetched files (paths[i] of fetches[i]) one after the other to out.
+//! Pieces of missing (failed) fetches are left out, returns how many were written. Throws on error.
+auto write_pieces(coalesced_t const& coalesced, std::vector<std::filesystem::path> const& paths,
+    std::filesystem::path const& out) -> size_t;
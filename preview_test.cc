@@ -0,0 +1,91 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#include "preview.h"
+
+TEST(preview_tests, pick_iframe_stream)
+{
+  std::string const master_str =
+    "#EXTM3U\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,RESOLUTION=640x360\n"
+    "low/index.m3u8\n"
+    "#EXT-X-I-FRAME-STREAM-INF:BANDWIDTH=86000,RESOLUTION=640x360,URI=\"low/iframes.m3u8\"\n"
+    "#EXT-X-I-FRAME-STREAM-INF:BANDWIDTH=328000,RESOLUTION=1920x1080,URI=\"high/iframes.m3u8\"\n"
+  ;
+  m3u8_t const master{std::vector<char>{master_str.begin(), master_str.end()}};
+
+  EXPECT_EQ(pick_iframe_stream(master, variant_policy_t::automatic), 1);
+  EXPECT_EQ(pick_iframe_stream(master, variant_policy_t::min_bandwidth), 0);
+  EXPECT_EQ(pick_iframe_stream(master, variant_policy_t::max_resolution), 1);
+
+  m3u8_t const without{std::vector<char>{master_str.begin(), master_str.begin() + master_str.find("#EXT-X-I-FRAME")}};
+  EXPECT_FALSE(pick_iframe_stream(without, variant_policy_t::automatic).has_value());
+}
+
+TEST(preview_tests, iframe_ranges)
+{
+  std::string const playlist_str =
+    "#EXTM3U\n"
+    "#EXT-X-I-FRAMES-ONLY\n"
+    "#EXTINF:2.0,\n"
+    "#EXT-X-BYTERANGE:9400@376\n"
+    "seg0.ts\n"
+    "#EXTINF:2.0,\n"
+    "seg1.ts\n"
+    "#EXT-X-KEY:METHOD=AES-128,URI=\"key.bin\"\n"
+    "#EXTINF:2.0,\n"
+    "#EXT-X-BYTERANGE:7520@0\n"
+    "seg2.ts\n"
+  ;
+  m3u8_t playlist{std::vector<char>{playlist_str.begin(), playlist_str.end()}};
+
+  EXPECT_THROW(iframe_ranges(playlist), m3u8_errc);
+
+  playlist.keep_urls(0, 2);
+  EXPECT_EQ(iframe_ranges(playlist), (std::vector<byterange_t>{{"seg0.ts", 376, 9'400}, {"seg1.ts", 0, 0}}));
+}
+
+TEST(preview_tests, coalesce_ranges)
+{
+  std::vector<byterange_t> const ranges = {
+    {"a.ts", 0, 100},
+    {"a.ts", 150, 100},  // 50 bytes after the one before
+    {"b.ts", 0, 100},
+    {"a.ts", 1'000, 50}, // too far
+    {"b.ts", 100, 10},   // adjacent
+    {"c.ts", 0, 0},      // the whole url
+  };
+
+  auto const coalesced = coalesce_ranges(ranges, 64);
+
+  EXPECT_EQ(coalesced.fetches, (std::vector<byterange_t>{{"a.ts", 0, 250}, {"b.ts", 0, 110}, {"a.ts", 1'000, 50},
+      {"c.ts", 0, 0}}));
+
+  using piece_t = std::tuple<size_t, uint64_t, uint64_t>;
+  EXPECT_EQ(coalesced.pieces, (std::vector<piece_t>{{0, 0, 100}, {0, 150, 100}, {1, 0, 100}, {2, 0, 50},
+      {1, 100, 10}, {3, 0, 0}}));
+}
+
+TEST(preview_tests, write_pieces)
+{
+  auto const dir = std::filesystem::temp_directory_path() / std::format("preview_test-{}", getpid());
+  std::filesystem::create_directories(dir);
+  std::ofstream{dir / "0.ts"} << "0123456789";
+  std::ofstream{dir / "2.ts"} << "abc";
+
+  coalesced_t const coalesced{
+    {{"a", 0, 10}, {"b", 0, 5}, {"c", 0, 0}},
+    {{0, 7, 3}, {1, 0, 5}, {0, 0, 2}, {2, 0, 0}}, // the second fetch failed
+  };
+
+  EXPECT_EQ(write_pieces(coalesced, {dir / "0.ts", dir / "1.ts", dir / "2.ts"}, dir / "out.ts"), 3);
+
+  std::stringstream ss;
+  ss << std::ifstream{dir / "out.ts"}.rdbuf();
+  EXPECT_EQ(ss.str(), "78901abc");
+
+  std::filesystem::remove_all(dir);
+}
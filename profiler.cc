@@ -0,0 +1,185 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::max, std::ranges::find
+#include <cerrno>
+#include <format>
+#include <fstream>
+#include <system_error> // std::error_code
+
+#include <sys/resource.h> // getrusage
+#include <time.h>         // clock_gettime
+#include <unistd.h>       // sysconf
+
+#include "profiler.h"
+#include "progressmeter.h" // shorten_bytes()
+
+static auto process_cpu_seconds() -> double;
+static auto children_cpu_seconds() -> double;
+static auto format_bytes(size_t bytes) -> std::string;
+static auto format_growth(int64_t bytes) -> std::string;
+
+// ---
+
+profiler_t::profiler_t(clock::time_point start)
+  : m_start{start}, m_start_cpu{process_cpu_seconds()}
+{
+}
+
+void profiler_t::add(std::string const& name, double wall, double cpu, size_t bytes, size_t rss, int64_t rss_growth)
+{
+  std::lock_guard<std::mutex> lock{m_mutex};
+
+  auto it = std::ranges::find(m_phases, name, &phase_profile_t::name);
+  if(it == m_phases.end())
+    it = m_phases.insert(it, phase_profile_t{name});
+
+  it->rss_growth = it->count == 0 ? rss_growth : std::max(it->rss_growth, rss_growth);
+  it->count++;
+  it->wall += wall;
+  it->cpu += cpu;
+  it->bytes += bytes;
+  it->rss = std::max(it->rss, rss);
+}
+
+auto profiler_t::phases() const -> std::vector<phase_profile_t>
+{
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_phases;
+}
+
+auto profiler_t::str(clock::time_point now) const -> std::string
+{
+  std::string str = std::format("{:<16} {:>6} {:>9} {:>9} {:>10} {:>10} {:>10}\n",
+      "phase", "count", "wall", "cpu", "bytes", "rss", "growth");
+  for(auto const& phase : phases())
+  {
+    str += std::format("{:<16} {:>6} {:>7.3f} s {:>7.3f} s {:>10} {:>10} {:>10}\n", phase.name, phase.count,
+        phase.wall, phase.cpu, format_bytes(phase.bytes), format_bytes(phase.rss), format_growth(phase.rss_growth));
+  }
+
+  double const wall = std::chrono::duration<double>(now - m_start).count();
+  str += std::format("{:<16} {:>6} {:>7.3f} s {:>7.3f} s {:>10} {:>10}\n", "all", "", wall,
+      process_cpu_seconds() - m_start_cpu, "", format_bytes(rss()));
+  str += std::format("peak rss of the process so far: {}", format_bytes(peak_rss()));
+  return str;
+}
+
+auto profiler_t::json(clock::time_point now) const -> json_t
+{
+  json_t::array_t phases = {};
+  for(auto const& phase : this->phases())
+  {
+    phases.push_back(json_t::object_t{{"name", phase.name}, {"count", phase.count}, {"seconds", phase.wall},
+      {"cpu", phase.cpu}, {"bytes", phase.bytes}, {"rss", phase.rss}, {"rss_growth", phase.rss_growth}});
+  }
+
+  return json_t::object_t{
+    {"seconds", std::chrono::duration<double>(now - m_start).count()},
+    {"cpu", process_cpu_seconds() - m_start_cpu},
+    {"rss", rss()},
+    {"peak_rss", peak_rss()},
+    {"phases", phases}};
+}
+
+void profiler_t::write(std::filesystem::path const& path) const
+{
+  std::ofstream file{path};
+  file << json().str() << '\n';
+  file.close();
+
+  if(file.fail())
+  {
+    int const err = errno;
+    std::error_code errc{err, std::generic_category()};
+    throw std::filesystem::filesystem_error{"Couldn't write file", path, errc};
+  }
+}
+
+auto profiler_t::cpu_seconds() -> double
+{
+  timespec time{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec)/1e9 + children_cpu_seconds();
+}
+
+auto profiler_t::rss() -> size_t
+{
+  // The size and the resident pages.
+  std::ifstream file{"/proc/self/statm"};
+  size_t pages = 0;
+  size_t resident = 0;
+  if(not (file >> pages >> resident))
+    return 0;
+
+  return resident*static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+auto profiler_t::peak_rss() -> size_t
+{
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss)*1'024; // in KB on Linux
+}
+
+// ---
+
+profile_scope_t::profile_scope_t(profiler_t* profiler, std::string name)
+  : m_profiler{profiler}, m_name{std::move(name)}
+{
+  if(m_profiler == nullptr)
+    return;
+
+  m_begin = profiler_t::clock::now();
+  m_begin_cpu = profiler_t::cpu_seconds();
+  m_begin_rss = profiler_t::rss();
+}
+
+profile_scope_t::~profile_scope_t()
+{
+  if(m_profiler == nullptr)
+    return;
+
+  double const wall = std::chrono::duration<double>(profiler_t::clock::now() - m_begin).count();
+  size_t const rss = profiler_t::rss();
+  m_profiler->add(m_name, wall, profiler_t::cpu_seconds() - m_begin_cpu, m_bytes, rss,
+      static_cast<int64_t>(rss) - static_cast<int64_t>(m_begin_rss));
+}
+
+// ---
+
+//! Of all threads of the process plus its children.
+auto process_cpu_seconds() -> double
+{
+  timespec time{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec)/1e9 + children_cpu_seconds();
+}
+
+auto children_cpu_seconds() -> double
+{
+  rusage usage{};
+  getrusage(RUSAGE_CHILDREN, &usage);
+
+  auto seconds = [](timeval const& time)
+  {
+    return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec)/1e6;
+  };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+auto format_bytes(size_t bytes) -> std::string
+{
+  if(bytes == 0)
+    return "-";
+
+  auto const [quantity, unit] = shorten_bytes(bytes);
+  return std::format("{:.1f} {}", quantity, unit);
+}
+
+auto format_growth(int64_t bytes) -> std::string
+{
+  if(bytes == 0)
+    return "-";
+
+  auto const [quantity, unit] = shorten_bytes(static_cast<size_t>(bytes < 0 ? -bytes : bytes));
+  return std::format("{}{:.1f} {}", bytes < 0 ? "-" : "+", quantity, unit);
+}
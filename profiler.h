@@ -0,0 +1,102 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint> // int64_t
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "json.h"
+
+//
+// Where the time of a run goes, by its phases (playlist, variant pick, download, retry rounds, muxing, ...):
+// the wall time (steady clock), the CPU time, the bytes and the RSS (at the end and its growth) of every phase,
+// summed up over all runs of it (e.g. the retry rounds or the muxing of the jobs). Cheap enough to be always on.
+//
+
+//! The sums of the runs of a phase.
+struct phase_profile_t
+{
+  std::string name = "";
+  size_t count = 0;    // runs
+  double wall = 0.0;   // seconds
+  double cpu = 0.0;    // seconds of the thread and of the child processes (ffmpeg)
+  size_t bytes = 0;
+  size_t rss = 0;         // bytes, the highest RSS of the process at the end of a run
+  int64_t rss_growth = 0; // bytes, the largest change of the RSS from the begin to the end of a run
+};
+
+class profiler_t
+{
+public:
+
+  using clock = std::chrono::steady_clock;
+
+  explicit profiler_t(clock::time_point start = clock::now());
+
+  profiler_t(profiler_t const&) = delete;
+  auto operator=(profiler_t const&) -> profiler_t& = delete;
+
+  //! Adds a run of the phase with the name (thread-safe).
+  void add(std::string const& name, double wall, double cpu, size_t bytes = 0, size_t rss = 0, int64_t rss_growth = 0);
+
+  //! In the order they first ran.
+  auto phases() const -> std::vector<phase_profile_t>;
+
+  //! A table of the phases and a line of the whole run (wall and CPU time since the start, the RSS now)
+  //! and the peak RSS of the process.
+  auto str(clock::time_point now = clock::now()) const -> std::string;
+
+  //! {"seconds":S,"cpu":C,"rss":R,"peak_rss":P,"phases":[{"name":..,"count":..,"seconds":..,"cpu":..,"bytes":..,
+  //! "rss":..,"rss_growth":..},...]} like str().
+  auto json(clock::time_point now = clock::now()) const -> json_t;
+
+  //! Writes json() to the file. Throws std::filesystem::filesystem_error.
+  void write(std::filesystem::path const& path) const;
+
+  //! CPU time in seconds of the calling thread plus of the terminated and waited-for child processes.
+  static auto cpu_seconds() -> double;
+
+  //! The current resident set size of the process in bytes (from /proc/self/statm, 0 if unknown).
+  static auto rss() -> size_t;
+
+  //! The peak resident set size of the process in bytes, so far.
+  static auto peak_rss() -> size_t;
+
+
+private:
+
+  clock::time_point const m_start;
+  double const m_start_cpu; // of the process
+
+  mutable std::mutex m_mutex;
+  std::vector<phase_profile_t> m_phases = {};
+};
+
+//! Adds a run of the phase from its construction to its destruction, nothing if profiler is nullptr.
+//! The CPU time of child processes is of all threads, it's only exact when one phase at a time waits for them.
+class profile_scope_t
+{
+public:
+
+  profile_scope_t(profiler_t* profiler, std::string name);
+  ~profile_scope_t();
+
+  profile_scope_t(profile_scope_t const&) = delete;
+  auto operator=(profile_scope_t const&) -> profile_scope_t& = delete;
+
+  //! The bytes processed in the phase.
+  inline void bytes(size_t bytes) { m_bytes = bytes; }
+
+
+private:
+
+  profiler_t* m_profiler;
+  std::string m_name;
+  profiler_t::clock::time_point m_begin;
+  double m_begin_cpu = 0.0;
+  size_t m_begin_rss = 0;
+  size_t m_bytes = 0;
+};
@@ -0,0 +1,63 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "profiler.h"
+
+using namespace std::chrono_literals;
+
+TEST(profiler_tests, phases)
+{
+  auto const start = profiler_t::clock::now();
+  profiler_t profiler{start};
+
+  profiler.add("download", 10.0, 2.0, 1'000'000, 50'000'000, 20'000'000);
+  profiler.add("retry round", 1.0, 0.25, 1'000, 0, -1'000'000);
+  profiler.add("retry round", 2.0, 0.25, 2'000, 60'000'000, -2'000'000);
+
+  auto const phases = profiler.phases();
+  ASSERT_EQ(phases.size(), 2);
+  EXPECT_EQ(phases[0].name, "download");
+  EXPECT_EQ(phases[1].name, "retry round"); // summed up
+  EXPECT_EQ(phases[1].count, 2);
+  EXPECT_DOUBLE_EQ(phases[1].wall, 3.0);
+  EXPECT_DOUBLE_EQ(phases[1].cpu, 0.5);
+  EXPECT_EQ(phases[1].bytes, 3'000);
+  EXPECT_EQ(phases[1].rss, 60'000'000);
+  EXPECT_EQ(phases[1].rss_growth, -1'000'000); // the largest, even if the memory shrank
+
+  auto const json = profiler.json(start + 15s);
+  EXPECT_EQ(json.get_number("seconds"), 15.0);
+  auto const json_phases = json.get("phases").value().as_array();
+  ASSERT_EQ(json_phases.size(), 2);
+  EXPECT_EQ(json_phases[0].get_string("name"), "download");
+  EXPECT_EQ(json_phases[0].get_number("bytes"), 1'000'000.0);
+  EXPECT_EQ(json_phases[0].get_number("rss"), 50'000'000.0);
+  EXPECT_EQ(json_phases[0].get_number("rss_growth"), 20'000'000.0);
+  EXPECT_TRUE(json.get_number("peak_rss").has_value());
+
+  auto const table = profiler.str(start + 15s);
+  EXPECT_NE(table.find("retry round"), std::string::npos);
+  EXPECT_NE(table.find("15.000 s"), std::string::npos);
+  EXPECT_NE(table.find("+19.1 MiB"), std::string::npos);
+  EXPECT_NE(table.find("peak rss of the process so far"), std::string::npos);
+}
+
+TEST(profiler_tests, scope)
+{
+  profiler_t profiler;
+  {
+    profile_scope_t scope{&profiler, "ffmpeg"};
+    scope.bytes(42);
+    profile_scope_t none{nullptr, "nothing"}; // without a profiler
+  }
+
+  auto const phases = profiler.phases();
+  ASSERT_EQ(phases.size(), 1);
+  EXPECT_EQ(phases[0].count, 1);
+  EXPECT_EQ(phases[0].bytes, 42);
+  EXPECT_GE(phases[0].wall, 0.0);
+  EXPECT_GE(phases[0].cpu, 0.0);
+  EXPECT_GT(phases[0].rss, 0);
+  EXPECT_GT(profiler_t::rss(), 0);
+  EXPECT_GT(profiler_t::peak_rss(), 0);
+}
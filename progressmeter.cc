@@ -1,19 +1,30 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
 #include <cassert>
+#include <cerrno>
 #include <cmath>
-#include <algorithm> // std::find_if
+#include <csignal>   // SIGWINCH, sig_atomic_t
+#include <algorithm> // std::find_if, std::min
+#include <atomic>
 #include <format>
 #include <optional>
 #include <iostream> // std::cout, std::cerr
+#include <iterator> // std::back_inserter
+#include <mutex>    // std::call_once
+#include <string_view>
 #include <vector>
 
 #include <sys/ioctl.h>
-#include <unistd.h> // STDOUT_FILENO
+#include <unistd.h> // STDOUT_FILENO, write
 
+#include "json.h" // append_json_string()
 #include "progressmeter.h"
 #include "string_util.h"
 
-// Slightly overengineered: the multi-threading support is unnecessary for libcurl, I think, but whatever.
+// The transfers may run in other threads (see progressmeter_check.cc), they only store atomic counters
+// (see download_process_t) and the rest is guarded by the mutex of the progressmeter.
+//
+// A frame is rendered into a reused buffer and written with one write(2), the terminal width is only
+// asked for again after a SIGWINCH. So printing many transfers doesn't allocate nor make a syscall per line.
 
 // ---
 
@@ -23,46 +34,51 @@ static const char* CURSOR_UP = "\33[A";
 using namespace std::chrono;
 using namespace std::chrono_literals;
 
-auto format_line(process_t const& process,
-    int const length) -> std::string;
-auto format_totalline(process_t const& main_process, size_t const finished, size_t const total,
-    int const length) -> std::string;
+static void append_line(std::string& out, process_t const& process, int const length);
+static void append_totalline(std::string& out, process_t const& main_process, size_t const finished, size_t const total,
+    std::optional<size_t> const watermark, std::optional<size_t> const total_bytes, int const length);
 
-auto format_line(std::string name, size_t transfered_bytes, std::optional<size_t> avg_speed,
-    std::chrono::milliseconds const& duration, double percent, int const length) -> std::string;
+static void append_line(std::string& out, std::string_view name, size_t transfered_bytes, std::optional<size_t> avg_speed,
+    std::chrono::milliseconds const& duration, std::optional<double> eta, double percent, int const length);
 
-static void transfered_list_push_back(process_t& process, size_t transfered);
+static auto calc_total_percent(process_t const& main_process, size_t const finished, size_t const total,
+    std::optional<size_t> const total_bytes) -> double;
+
+static void append_progressbar_filled(std::string& out, double const percent, size_t const barlength);
+static void append_progressbar_undefined(std::string& out, size_t secs, std::string_view cursor, size_t barlength);
+
+static auto speed_of(throughput_t const& throughput) -> std::optional<size_t>;
+static void sample_throughput(throughput_t& throughput, size_t transfered);
+
+static auto terminal_columns() -> int;
+static void write_frame(std::string const& frame);
 
 // ---
 
-download_process_t::download_process_t(int id, std::string const& name)
-  : m_mutex{}, m_id{id}, m_process{name, std::chrono::system_clock::now()}
+auto parse_progress_format(std::string const& format) -> std::optional<progress_format_t>
 {
+  if(format == "terminal")
+    return progress_format_t::terminal;
+  if(format == "json")
+    return progress_format_t::json;
+  return {};
 }
 
-void download_process_t::update(size_t total, size_t transfered)
+download_process_t::download_process_t(int id, std::string const& name)
+  : m_id{id}, m_process{name, std::chrono::system_clock::now()}
 {
-  std::lock_guard<std::mutex> guard{m_mutex};
-
-  m_process.transfered = transfered;
-  m_process.total = total;
-
-  transfered_list_push_back(m_process, transfered);
 }
 
-auto download_process_t::copy() -> std::tuple<int, process_t>
+auto download_process_t::sample() -> process_t const&
 {
-  int id;
-  process_t process;
-
-  { // critical copy-section
-    std::lock_guard<std::mutex> guard(m_mutex);
+  // Finished first, then the counters are the last ones of the transfer (see finish()).
+  m_process.is_finished = m_finished.load(std::memory_order_acquire);
+  m_process.total = m_total.load(std::memory_order_relaxed);
+  m_process.transfered = m_transfered.load(std::memory_order_relaxed);
 
-    id = m_id;
-    process = m_process;
-  }
+  sample_throughput(m_process.throughput, m_process.transfered);
 
-  return std::make_tuple(id, process);
+  return m_process;
 }
 
 // ---
@@ -97,7 +113,7 @@ void progressmeter_t::remove_download(int id)
   m_processes.erase(it);
 }
 
-void progressmeter_t::finish_download(int id)
+void progressmeter_t::finish_download(int id, std::optional<std::string> error)
 {
   std::lock_guard<std::mutex> lock(m_mutex);
 
@@ -105,6 +121,7 @@ void progressmeter_t::finish_download(int id)
   [[maybe_unused]] auto it = std::find_if(m_processes.begin(), m_processes.end(), has_id);
   assert(it != m_processes.end() and "a process with this id doesn't exist");
 
+  it->m_process.error = std::move(error); // only read by the one printing, which holds the mutex as well
   it->finish();
 }
 
@@ -116,6 +133,34 @@ void progressmeter_t::set_number_of_downloads(size_t n)
     m_all = n;
 }
 
+void progressmeter_t::set_watermark(size_t n)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_watermark = n;
+}
+
+void progressmeter_t::set_total_bytes(size_t n)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_total_bytes = n;
+}
+
+void progressmeter_t::set_format(progress_format_t format)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_format = format;
+}
+
+void progressmeter_t::set_interval(std::chrono::milliseconds interval)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_interval = interval;
+}
+
 void progressmeter_t::print()
 {
   std::lock_guard<std::mutex> lock(m_mutex);
@@ -124,24 +169,16 @@ void progressmeter_t::print()
 
   auto now = std::chrono::system_clock::now();
 
-  int last_printed_lines = 0;
-
-  // Copy main-process (m_main_process) and running-processes-list (m_processes).
-  process_t main_process;
-  std::list<std::tuple<int, process_t>> processes;
+  // Sample the running processes (m_processes) in place, the finished ones go into m_main_process.
+  process_t main_process = m_main_process;
+  bool tick = false;
   {
-    last_printed_lines = m_last_printed_lines;
     bool processes_finished = false;
-
-    // copy m_main_process
-    main_process = m_main_process;
     bool with_unknown_totals = false;
 
-    // copy m_processes
     for(auto& process : m_processes)
     {
-      processes.push_back(process.copy());
-      auto const& [_, p] = processes.back();
+      auto const& p = process.sample();
 
       if(p.is_finished)
       {
@@ -160,76 +197,153 @@ void progressmeter_t::print()
         with_unknown_totals = true;
     }
 
-    transfered_list_push_back(main_process, main_process.transfered);
+    // The throughput of all is sampled like the ones of the processes (and kept in m_main_process).
+    sample_throughput(m_main_process.throughput, main_process.transfered);
+    main_process.throughput = m_main_process.throughput;
 
     // If one is unknown the overall total is unknown.
     if(with_unknown_totals)
       main_process.total = 0;
 
     // If processes finished we print the progressmeter
-    // otherwise only if 1s past already.
-    if(not processes_finished and now - m_last < 1s)
+    // otherwise only if the interval past already.
+    tick = now - m_last >= m_interval;
+    if(not processes_finished and not tick)
       return;
-    m_last = now;
   }
 
+  if(m_format == progress_format_t::json)
   {
-    auto running = std::partition(processes.begin(), processes.end(),
-        [](auto const& p) { return std::get<1>(p).is_finished; });
+    render_json(main_process, tick);
+    if(tick or m_processes.empty())
+      m_last = now;
+  }
+  else
+  {
+    render_terminal(main_process);
+    m_last = now;
+  }
 
-    // Get terminal-window size.
-    struct winsize w; // ws_row, ws_col
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+  write_frame(m_frame);
+}
 
-    for(int i=0; i<last_printed_lines; i++)
-      std::cout << CURSOR_UP << DEL_LINE;
+void progressmeter_t::render_terminal(process_t const& main_process)
+{
+  int const columns = terminal_columns();
 
-    last_printed_lines = 0;
+  m_frame.clear();
+  for(int i=0; i<m_last_printed_lines; i++)
+    m_frame.append(CURSOR_UP).append(DEL_LINE);
 
-    // print finished processes
-    for(auto finished = processes.begin(); finished != running; finished++)
-    {
-      auto const& [id, process] = *finished;
-      std::cout << format_line(process, w.ws_col) << std::endl;
+  int last_printed_lines = 0;
 
-      m_finished++;
-      m_processes.erase(std::find_if(m_processes.begin(), m_processes.end(),
-            [id](download_process_t const& p) { return p.get_id() == id; }));
+  // print finished processes (a last time, they stay above the running ones)
+  for(auto it = m_processes.begin(); it != m_processes.end();)
+  {
+    if(not it->m_process.is_finished)
+    {
+      ++it;
+      continue;
     }
 
-    // print unfinished processes
-    size_t running_processes = 0;
-    for(; running != processes.end(); running++)
-    {
-      auto const& [_, process] = *running;
+    append_line(m_frame, it->m_process, columns);
+    m_frame += '\n';
+
+    m_finished++;
+    it = m_processes.erase(it);
+  }
+
+  // print unfinished processes
+  for(auto const& process : m_processes)
+  {
+    append_line(m_frame, process.m_process, columns);
+    m_frame += '\n';
+
+    last_printed_lines++;
+  }
+
+  // print total-line
+  {
+    append_totalline(m_frame, main_process, m_finished, m_all, m_watermark, m_total_bytes, columns);
+    m_frame += '\n';
+    last_printed_lines++;
+  }
 
-      std::cout << format_line(process, w.ws_col) << std::endl;
-      running_processes++;
+  m_last_printed_lines = last_printed_lines;
+}
+
+//! The JSON-lines are described at print(), the progress of all only on a tick (or when all are finished).
+void progressmeter_t::render_json(process_t const& main_process, bool tick)
+{
+  using namespace std::chrono;
+
+  auto out = std::back_inserter(m_frame);
+  m_frame.clear();
+
+  auto const now = system_clock::now();
 
-      last_printed_lines++;
+  for(auto it = m_processes.begin(); it != m_processes.end();)
+  {
+    process_t const& process = it->m_process;
+    if(not process.is_finished)
+    {
+      ++it;
+      continue;
     }
 
-    // print total-line
+    std::format_to(out, "{{\"type\":\"download\",\"id\":{},\"name\":", it->get_id());
+    append_json_string(m_frame, process.name);
+    std::format_to(out, ",\"bytes\":{},\"seconds\":{:.1f}", process.transfered,
+        duration<double>(now - process.start).count());
+    if(process.error.has_value())
     {
-      std::cout << format_totalline(main_process, m_finished, m_all, w.ws_col) << std::endl;
-      last_printed_lines++;
+      m_frame += ",\"error\":";
+      append_json_string(m_frame, process.error.value());
     }
+    m_frame += "}\n";
 
-    m_last_printed_lines = last_printed_lines;
+    m_finished++;
+    it = m_processes.erase(it);
   }
+
+  if(not tick and not m_processes.empty())
+    return;
+
+  double const percent = calc_total_percent(main_process, m_finished, m_all, m_total_bytes);
+  auto const rate = main_process.throughput.rate();
+  auto const eta = calc_eta(main_process.throughput, main_process.transfered, percent);
+
+  std::format_to(out, "{{\"type\":\"progress\",\"finished\":{},\"total\":{},\"bytes\":{},\"total_bytes\":",
+      m_finished, m_all, main_process.transfered);
+  if(m_total_bytes.has_value())
+    std::format_to(out, "{}", m_total_bytes.value());
+  else
+    m_frame += "null";
+  m_frame += ",\"rate\":";
+  if(rate.has_value())
+    std::format_to(out, "{:.0f}", rate.value());
+  else
+    m_frame += "null";
+  m_frame += ",\"eta\":";
+  if(eta.has_value())
+    std::format_to(out, "{:.1f}", eta.value());
+  else
+    m_frame += "null";
+  std::format_to(out, ",\"seconds\":{:.1f},\"running\":{}}}\n",
+      duration<double>(now - main_process.start).count(), m_processes.size());
 }
 
 auto format_line(download_process_t& process, int const length) -> std::string
 {
-  return format_line(std::get<1>(process.copy()), length);
+  std::string line = "";
+  append_line(line, process.sample(), length);
+  return line;
 }
 
-auto format_line(process_t const& process, int const length) -> std::string
+void append_line(std::string& out, process_t const& process, int const length)
 {
   assert(process.total >= 0);
 
-  auto const avg_speed = calc_avg_speed(process.transfered_list);
-
   using namespace std::chrono;
   milliseconds const duration = duration_cast<milliseconds>(system_clock::now() - process.start);
 
@@ -237,44 +351,49 @@ auto format_line(process_t const& process, int const length) -> std::string
   if(process.is_finished)
     percent = 1.0;
   else if(process.total > 0)
-    percent = static_cast<double>(process.transfered)/static_cast<double>(process.total);
+    percent = std::min(1.0, static_cast<double>(process.transfered)/static_cast<double>(process.total));
 
-  return format_line(process.name, process.transfered, avg_speed, duration, percent, length);
+  append_line(out, process.name, process.transfered, speed_of(process.throughput), duration,
+      calc_eta(process.throughput, process.transfered, percent), percent, length);
 }
 
 /**
- * name         downloaded  speed  time      progress percent
- * total ( x/n      100 MB 5 MB/s 14:13 [########   ] 67%
+ * name         downloaded  speed  time       eta      progress percent
+ * total ( x/n      100 MB 5 MB/s 14:13 ETA 07:01 [########   ] 67%
  *
  * Everything element is overall e.g. overall transfered bytes, except for speed.
  * Speed is actual speed, not overall speed.
  */
-auto format_totalline(process_t const& main_process, size_t const finished, size_t total,
-    int const length) -> std::string
+//! With a watermark e.g. "total ( 7/40, first  5)".
+//! With the total bytes the percent is by the transfered bytes, otherwise by the finished downloads.
+void append_totalline(std::string& out, process_t const& main_process, size_t const finished, size_t total,
+    std::optional<size_t> const watermark, std::optional<size_t> const total_bytes, int const length)
 {
   assert(finished <= total);
   size_t const len = calc_numberlength(total);
-  std::string const name = std::format("total ({0:{2}}/{1:{2}})", finished, total, len);
 
-  auto const avg_speed = calc_avg_speed(main_process.transfered_list);
+  std::array<char, 96> buffer;
+  auto const end = watermark.has_value()
+    ? std::format_to_n(buffer.data(), buffer.size(), "total ({0:{3}}/{1:{3}}, first {2:{3}})",
+        finished, total, watermark.value(), len).out
+    : std::format_to_n(buffer.data(), buffer.size(), "total ({0:{2}}/{1:{2}})", finished, total, len).out;
+  std::string_view const name{buffer.data(), std::min(end, buffer.data() + buffer.size())};
 
   using namespace std::chrono;
   milliseconds const duration = duration_cast<milliseconds>(system_clock::now() - main_process.start);
 
-  double const percent = finished < total
-    ? static_cast<double>(finished)/static_cast<double>(total)
-    : 1.0;
+  double const percent = calc_total_percent(main_process, finished, total, total_bytes);
 
-  return format_line(name, main_process.transfered, avg_speed, duration, percent,
-      length);
+  append_line(out, name, main_process.transfered, speed_of(main_process.throughput), duration,
+      calc_eta(main_process.throughput, main_process.transfered, percent), percent, length);
 }
 
 /**
- * name      downloaded     speed  time            progress percent
- * name       122,2 KiB 463 KiB/s 00:00 [#############    ] 100%
+ * name      downloaded     speed  time       eta            progress percent
+ * name       122,2 KiB 463 KiB/s 00:00 ETA 00:00 [#############    ] 100%
  */
-auto format_line(std::string name, size_t transfered_bytes, std::optional<size_t> avg_speed,
-    std::chrono::milliseconds const& duration, double percent, int const length) -> std::string
+void append_line(std::string& out, std::string_view name, size_t transfered_bytes, std::optional<size_t> avg_speed,
+    std::chrono::milliseconds const& duration, std::optional<double> eta, double percent, int const length)
 {
   using namespace std::chrono;
 
@@ -289,107 +408,123 @@ auto format_line(std::string name, size_t transfered_bytes, std::optional<size_t
   // name  percent downloaded    speed  estimated time until finished
   // name     100%      400MB  1.5MB/s       14:13 ETA                  <- scp
 
-  // std::format("{:<20} {:5.1f} {}", process.m_name, transfered_quantity, transfered_unit);
-  // {:<20} name: left-aligned 20 characters long (padded with space by default)
   // {:0>2} time: right-aligned 2 characters long (padded with 0)
   // {:5.1f} transfered in total(!) 5 character long from this 1 character after the decimal point
   // {:3} percent: left-aligned 3-characters long
+  //
+  // The columns are formatted into buffers on the stack and appended to out, nothing is allocated
+  // once out has grown to a frame.
+
+  // Formats into the buffer and returns the formatted part of it.
+  auto format_to = []<typename... Args>(std::array<char, 32>& buffer, std::format_string<Args...> fmt, Args&&... args)
+  {
+    auto const end = std::format_to_n(buffer.data(), buffer.size(), fmt, std::forward<Args>(args)...).out;
+    return std::string_view{buffer.data(), std::min(end, buffer.data() + buffer.size())};
+  };
 
   auto const [transfered_quantity, transfered_unit] = shorten_bytes(transfered_bytes);
 
   // already transfered
   // e.g. 122,2 KiB
-  std::string const transfered_str = std::format("{:5.1f} {:>3}", transfered_quantity, transfered_unit);
+  std::array<char, 32> transfered_buffer;
+  auto const transfered_str = format_to(transfered_buffer, "{:5.1f} {:>3}", transfered_quantity, transfered_unit);
 
   // time it took until now
   // e.g. 01:50
   auto const minutes = duration_cast<std::chrono::minutes>(duration);
   auto const seconds = duration_cast<std::chrono::seconds>(duration - minutes);
-  std::string const time_str = std::format("{:0>2}:{:0>2}", minutes.count(), seconds.count());
+  std::array<char, 32> time_buffer;
+  auto const time_str = format_to(time_buffer, "{:0>2}:{:0>2}", minutes.count(), seconds.count());
+
+  // estimated time until finished (unknown beyond 100 hours)
+  // e.g. ETA 03:20
+  std::array<char, 32> eta_buffer;
+  auto const eta_str = eta.has_value() and eta.value() < 360'000.0
+    ? format_to(eta_buffer, "ETA {:0>2}:{:0>2}", static_cast<size_t>(eta.value())/60, static_cast<size_t>(eta.value())%60)
+    : format_to(eta_buffer, "ETA --:--");
 
   // transfer-speed
-  // e.g. 463,0 KiB/s
+  // e.g. 463,0 KiB/s (the unit has at most 3 characters)
   auto const [speed, speed_unit] = shorten_bytes(avg_speed.has_value() ? avg_speed.value() : 0.0);
-  std::string const speed_str = avg_speed.has_value()
-    ? std::format("{:5.1f} {:>5}", speed, speed_unit + "/s")
-    : std::format(  "  -.- {:>5}", speed_unit + "/s");
+  std::array<char, 32> speed_buffer;
+  auto const speed_str = avg_speed.has_value()
+    ? format_to(speed_buffer, "{:5.1f} {:>3}/s", speed, speed_unit)
+    : format_to(speed_buffer,   "  -.- {:>3}/s", speed_unit);
 
   // percentage completed
-  std::string percent_str = (percent != -1.0) ? std::format("{:3.0f}%", percent*100.0) : std::string{"---%"};
-  if(percent >= 1.0)
-    percent_str = "100%";
+  std::array<char, 32> percent_buffer;
+  std::string_view const percent_str = percent >= 1.0 ? "100%"
+    : (percent != -1.0) ? format_to(percent_buffer, "{:3.0f}%", percent*100.0)
+    : "---%";
 
   // length without name and progess-bar (with padding whitespace in-between
-  size_t length1 = 1 + transfered_str.length() + 2 + speed_str.length() + 1 + time_str.length() + 1 + percent_str.length();
+  size_t length1 = 1 + transfered_str.length() + 2 + speed_str.length() + 1 + time_str.length() + 1 + eta_str.length()
+    + 1 + percent_str.length();
   if(length1 + 20 > static_cast<size_t>(length)) // I want at least 20 characters for the name and the progress-bar.
-    return "";
+    return;
   // else
 
   size_t length2 = static_cast<size_t>(length) - length1; // space left for the name and the progress-bar
 
-  // name
-  std::string name_str = std::format("{: <{}}", shorten_string(name, length2/2 - 1), length2/2 - 1); // 1 is padding
+  out += ' ';
+
+  // name, shortened with ".." (see shorten_string) or padded
+  size_t const name_length = length2/2 - 1; // 1 is padding
+  if(name.size() <= name_length)
+    out.append(name).append(name_length - name.size(), ' ');
+  else if(name_length > 2)
+    out.append(name.substr(0, name_length - 2)).append("..");
+  else
+    out.append(name.substr(0, name_length));
+
+  out.append(" ").append(transfered_str).append("  ").append(speed_str).append(" ").append(time_str).append(" ").append(eta_str).append(" ");
 
   // progressbar
   int const barlength = length2/2 - 3; // 3 is for the one character padding, "[" and "]".
 
-  std::string const progressbar_str = percent != -1.0
-    ? std::string{"["} + calc_progressbar_filled(percent, barlength) + std::string{"]"}
-    : std::string{"["} + calc_progressbar_undefined(seconds.count(), "<->", barlength) + std::string{"]"};
+  out += '[';
+  if(percent != -1.0)
+    append_progressbar_filled(out, percent, barlength);
+  else
+    append_progressbar_undefined(out, seconds.count(), "<->", barlength);
+  out += ']';
 
-  return std::format(" {} {}  {} {} {} {}", name_str, transfered_str, speed_str, time_str, progressbar_str, percent_str);
+  out.append(" ").append(percent_str);
 }
 
-auto calc_avg_speed(std::list<std::tuple<system_clock::time_point, size_t>> transfered_list) -> std::optional<size_t>
+//! With the total bytes the percent is by the transfered bytes, otherwise by the finished downloads.
+auto calc_total_percent(process_t const& main_process, size_t const finished, size_t const total,
+    std::optional<size_t> const total_bytes) -> double
 {
-  // The first entry of the transfered_list it (start-time, 0),
-  // so two entries are needed for calculating the avg. speed.
-  if(transfered_list.size() >= 2)
-  {
-    auto const [last_time, last_transfered] = *(transfered_list.rbegin());
-    auto const [before_last_time, before_last_transfered] = *(++transfered_list.rbegin());
-
-    assert(last_time > before_last_time and "duration should be greater 0s (something around at least 1s)");
-    assert(last_transfered >= before_last_transfered and "transfered bytes only grows");
-
-    double const duration_last = std::chrono::duration<double>(last_time - before_last_time).count();
-    size_t const transfered_diff = last_transfered - before_last_transfered;
+  return finished >= total ? 1.0
+    : total_bytes.value_or(0) > 0
+      ? std::min(1.0, static_cast<double>(main_process.transfered)/static_cast<double>(total_bytes.value()))
+    : static_cast<double>(finished)/static_cast<double>(total);
+}
 
-    size_t avg_speed = static_cast<size_t>(static_cast<double>(transfered_diff) / duration_last);
-    return avg_speed;
-  }
+auto calc_eta(throughput_t const& throughput, size_t transfered, double percent) -> std::optional<double>
+{
+  if(percent >= 1.0)
+    return 0.0;
+  if(percent <= 0.0) // also unknown (-1.0)
+    return {};
 
-  return {};
+  // e.g. with 25% transfered the rest are three times the transfered bytes
+  double const remaining = static_cast<double>(transfered)*(1.0 - percent)/percent;
+  return throughput.eta(static_cast<size_t>(remaining));
 }
 
 auto calc_progressbar_filled(double const percent, size_t const barlength) -> std::string
 {
-  assert((0.0 <= percent) and (percent <= 1.0));
-
-  //double const percent = static_cast<double>(transfered)/static_cast<double>(total);
-  size_t const filled = static_cast<size_t>(barlength * percent);
-
-  std::string progressbar = std::format("{: <{}}", std::string(filled, '#'), barlength);
-  assert(progressbar.length() == barlength);
+  std::string progressbar = "";
+  append_progressbar_filled(progressbar, percent, barlength);
   return progressbar;
 }
 
 auto calc_progressbar_undefined(size_t secs, std::string const& cursor, size_t barlength) -> std::string
 {
-  assert(cursor.length() < barlength);
-
-  size_t const cursor_length = static_cast<int>(cursor.length());
-
-  size_t pos = secs % (2*(barlength - cursor_length + 1));
-  if(pos > barlength - cursor_length) // after barlength the cursor should go back (not jump at the begining!)
-    pos = 2*(barlength - cursor_length) - pos + 1;
-  size_t rightfill = barlength - pos - cursor_length;
-
-  assert(0 <= pos and pos <= barlength - cursor_length);
-  assert(0 <= rightfill and rightfill <= barlength - cursor_length);
-
-  std::string progressbar = std::string(pos, ' ') + cursor + std::string(rightfill, ' ');
-  assert(progressbar.length() == barlength);
+  std::string progressbar = "";
+  append_progressbar_undefined(progressbar, secs, cursor, barlength);
   return progressbar;
 }
 
@@ -442,15 +577,92 @@ auto shorten_string(std::string const& str, size_t const& maxlen) -> std::string
   return ret;
 }
 
-void transfered_list_push_back(process_t& process, size_t transfered)
+void append_progressbar_filled(std::string& out, double const percent, size_t const barlength)
 {
-  auto const now = system_clock::now();
+  assert((0.0 <= percent) and (percent <= 1.0));
+
+  [[maybe_unused]] size_t const before = out.size();
+
+  size_t const filled = static_cast<size_t>(barlength * percent);
+  out.append(filled, '#').append(barlength - filled, ' ');
+
+  assert(out.size() - before == barlength);
+}
 
-  if((now - std::get<0>(process.transfered_list.back())) > 1s)
+void append_progressbar_undefined(std::string& out, size_t secs, std::string_view cursor, size_t barlength)
+{
+  assert(cursor.length() < barlength);
+
+  [[maybe_unused]] size_t const before = out.size();
+
+  size_t const cursor_length = static_cast<int>(cursor.length());
+
+  size_t pos = secs % (2*(barlength - cursor_length + 1));
+  if(pos > barlength - cursor_length) // after barlength the cursor should go back (not jump at the begining!)
+    pos = 2*(barlength - cursor_length) - pos + 1;
+  size_t rightfill = barlength - pos - cursor_length;
+
+  assert(0 <= pos and pos <= barlength - cursor_length);
+  assert(0 <= rightfill and rightfill <= barlength - cursor_length);
+
+  out.append(pos, ' ').append(cursor).append(rightfill, ' ');
+  assert(out.size() - before == barlength);
+}
+
+auto speed_of(throughput_t const& throughput) -> std::optional<size_t>
+{
+  return throughput.rate().transform([](double rate) { return static_cast<size_t>(rate); });
+}
+
+void sample_throughput(throughput_t& throughput, size_t transfered)
+{
+  if(throughput_t::clock::now() - throughput.last() > 1s)
+    throughput.update(transfered);
+}
+
+namespace
+{
+  volatile std::sig_atomic_t terminal_resized = 1; // set by the SIGWINCH-handler, at first to ask at all
+}
+
+auto terminal_columns() -> int
+{
+  static std::once_flag handler_installed;
+  std::call_once(handler_installed, []()
   {
-    process.transfered_list.push_back(std::make_tuple(now, transfered));
-    while(process.transfered_list.size() > 5) // only keep the last 5 records
-      process.transfered_list.pop_front();
+    struct sigaction action = {};
+    action.sa_handler = [](int) { terminal_resized = 1; };
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART; // don't interrupt the transfers' syscalls
+    sigaction(SIGWINCH, &action, nullptr);
+  });
+
+  static std::atomic<int> columns = 80; // the concurrent runs of the daemon each have a progressmeter
+  if(terminal_resized)
+  {
+    terminal_resized = 0;
+
+    struct winsize w = {}; // ws_row, ws_col
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == 0)
+      columns = w.ws_col;
   }
+
+  return columns;
 }
 
+void write_frame(std::string const& frame)
+{
+  // What was printed with std::cout before goes out first.
+  std::cout.flush();
+
+  size_t written = 0;
+  while(written < frame.size())
+  {
+    ssize_t const n = ::write(STDOUT_FILENO, frame.data() + written, frame.size() - written);
+    if(n == -1 and errno == EINTR)
+      continue;
+    if(n <= 0)
+      return; // e.g. closed, then there is no one to show the progress
+    written += static_cast<size_t>(n);
+  }
+}
@@ -1,5 +1,6 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
 #pragma once
+#include <atomic>
 #include <chrono>
 #include <list>
 #include <mutex>
@@ -7,6 +8,21 @@
 #include <string>
 #include <tuple>
 
+#include "throughput.h"
+
+// ---
+
+//! How the progress is printed: lines redrawn on a terminal, or JSON-lines (see progressmeter_t::print())
+//! for a pipe or a log file.
+enum class progress_format_t
+{
+  terminal,
+  json,
+};
+
+//! Parse "terminal" or "json".
+auto parse_progress_format(std::string const& format) -> std::optional<progress_format_t>;
+
 // ---
 
 struct process_t
@@ -19,8 +35,9 @@ struct process_t
   size_t transfered = 0;
   size_t total = 0;
 
-  std::list<std::tuple<std::chrono::system_clock::time_point, size_t>> transfered_list = {std::make_tuple(start, 0)};
+  throughput_t throughput = throughput_t{}; // sampled about every second
   bool is_finished = false;
+  std::optional<std::string> error = {}; // why it failed, if it did
 };
 
 // ---
@@ -39,29 +56,58 @@ public:
 
   auto add_download(int id, std::string const& name) -> download_process_t*;
   void remove_download(int id);
-  void finish_download(int id);
-
+  void finish_download(int id, std::optional<std::string> error = {});
+
+  //! Prints the progress, if downloads finished or the interval passed since the last time.
+  //!
+  //! As JSON-lines each object is on a line of its own, a finished download is printed right away as
+  //!   {"type":"download","id":3,"name":"file3.ts","bytes":5800000,"seconds":12.1[,"error":"..."]}
+  //! and the progress of all (with null for unknown) only every interval (and when all are finished) as
+  //!   {"type":"progress","finished":8,"total":10,"bytes":42364000,"total_bytes":null,"rate":2100000,
+  //!    "eta":5.2,"seconds":15.3,"running":2}
   void print();
 
+  void set_format(progress_format_t format);
+  void set_interval(std::chrono::milliseconds interval);
+
   void set_number_of_downloads(size_t n);
 
+  //! Show the watermark (the number of finished downloads at the beginning) in the total-line.
+  void set_watermark(size_t n);
+
+  //! The exact number of bytes of all downloads (e.g. from HEAD-requests), then the total-line
+  //! shows the progress by bytes instead of by finished downloads.
+  void set_total_bytes(size_t n);
+
 
 private:
 
+  void render_terminal(process_t const& main_process);
+  void render_json(process_t const& main_process, bool tick);
+
   std::mutex m_mutex;
 
   process_t m_main_process{"total"};
   size_t m_finished = 0;
   size_t m_all = 0;
+  std::optional<size_t> m_watermark = {};
+  std::optional<size_t> m_total_bytes = {};
 
   std::list<download_process_t> m_processes = {}; // currently running processes
 
+  progress_format_t m_format = progress_format_t::terminal;
+  std::chrono::milliseconds m_interval{1'000};
+
   int m_last_printed_lines = 0;
   std::chrono::system_clock::time_point m_last = std::chrono::system_clock::now();
+
+  std::string m_frame = ""; // reused for every frame, which is written at once
 };
 
 // ---
 
+//! The transfer only stores its numbers in atomic counters (without locking or allocating),
+//! the progressmeter samples them when printing.
 class download_process_t
 {
 public:
@@ -77,30 +123,41 @@ public:
   download_process_t(download_process_t const& other) = delete;
   auto operator=(download_process_t const&) -> download_process_t& = delete;
 
-  void update(size_t total, size_t now);
+  //! Called by the transfer e.g. on every progress-callback of libcurl.
+  inline void update(size_t total, size_t now)
+  {
+    m_total.store(total, std::memory_order_relaxed);
+    m_transfered.store(now, std::memory_order_relaxed);
+  }
 
-  auto copy() -> std::tuple<int, process_t>;
+  //! Samples the counters (into the throughput) and returns the process with them.
+  //! Only called by the one printing, not by the transfer.
+  auto sample() -> process_t const&;
+  inline auto copy() -> std::tuple<int, process_t> { return std::make_tuple(m_id, sample()); }
 
   inline int get_id() const { return m_id; }
   inline void finish()
   {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_process.is_finished = true;
+    m_finished.store(true, std::memory_order_release); // after the last update()
   }
 
 
 private:
 
-  std::mutex m_mutex;
-
   int const m_id;
-  process_t m_process;
+
+  std::atomic<size_t> m_total = 0;
+  std::atomic<size_t> m_transfered = 0;
+  std::atomic<bool> m_finished = false;
+
+  process_t m_process; // the samples, see sample()
 };
 
 // Internal functions exposed for testing.
 auto format_line(download_process_t& process, int const length) -> std::string;
 
-auto calc_avg_speed(std::list<std::tuple<std::chrono::system_clock::time_point, size_t>> transfered_list) -> std::optional<size_t>;
+//! The seconds until the rest is transfered, the transfered bytes are the percent (by the progress) of all.
+auto calc_eta(throughput_t const& throughput, size_t transfered, double percent) -> std::optional<double>;
 auto calc_progressbar_filled(double const percent, size_t const barlength) -> std::string;
 auto calc_progressbar_undefined(size_t secs, std::string const& cursor, size_t barlength) -> std::string;
 
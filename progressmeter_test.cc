@@ -1,6 +1,11 @@
 // GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
 #include <gtest/gtest.h>
+#include <cstdio> // std::tmpfile
+#include <thread>
 
+#include <unistd.h> // dup, dup2
+
+#include "json.h"
 #include "progressmeter.h"
 
 TEST(progressmeter_tests, shorten_bytes)
@@ -64,3 +69,110 @@ TEST(progressmeter_tests, calc_progressbar_undefined)
   EXPECT_EQ(progressbar77,  std::string{" <->                                    "});
 }
 
+
+TEST(progressmeter_tests, download_process_update)
+{
+  progressmeter_t progressmeter;
+  download_process_t* process = progressmeter.add_download(0, "name");
+
+  // The transfer updates in its own thread, while the numbers are sampled.
+  std::thread transfer{[process]()
+  {
+    for(size_t i=1; i<=100'000; i++)
+      process->update(100'000, i);
+    process->finish();
+  }};
+
+  size_t last = 0;
+  bool is_finished = false;
+  while(not is_finished)
+  {
+    auto const [id, sample] = process->copy();
+    EXPECT_EQ(id, 0);
+    EXPECT_GE(sample.transfered, last);
+    last = sample.transfered;
+    is_finished = sample.is_finished;
+  }
+  transfer.join();
+
+  EXPECT_EQ(last, 100'000);
+  EXPECT_EQ(std::get<1>(process->copy()).total, 100'000);
+}
+
+TEST(progressmeter_tests, calc_eta)
+{
+  using namespace std::chrono_literals;
+  auto const start = throughput_t::clock::now();
+
+  throughput_t throughput{3.0, start - 2s};
+  EXPECT_FALSE(calc_eta(throughput, 1'000, 0.5).has_value()); // no rate yet
+
+  throughput.add(2'000'000, start); // 1 MB/s
+  EXPECT_EQ(calc_eta(throughput, 2'000'000, 1.0), 0.0);
+  EXPECT_FALSE(calc_eta(throughput, 2'000'000, -1.0).has_value()); // unknown total
+
+  // 2 MB are 25%, so 6 MB remain.
+  EXPECT_NEAR(calc_eta(throughput, 2'000'000, 0.25).value(), 6.0, 0.1);
+}
+
+TEST(progressmeter_tests, print_json)
+{
+  // Capture what's written to stdout.
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  int const stdout_fd = dup(STDOUT_FILENO);
+  dup2(fileno(file), STDOUT_FILENO);
+
+  {
+    progressmeter_t progressmeter;
+    progressmeter.set_format(progress_format_t::json);
+    progressmeter.set_interval(std::chrono::hours{1});
+    progressmeter.set_number_of_downloads(2);
+
+    progressmeter.add_download(0, "a \"0\".ts")->update(100, 100);
+    progressmeter.add_download(1, "b.ts")->update(200, 50);
+
+    // Only the finished download, the progress of all waits for the interval ...
+    progressmeter.finish_download(0, "timeout");
+    progressmeter.print();
+
+    // ... or until all are finished.
+    progressmeter.print(); // nothing new
+    progressmeter.finish_download(1);
+    progressmeter.print();
+  }
+
+  dup2(stdout_fd, STDOUT_FILENO);
+  close(stdout_fd);
+
+  std::vector<json_t> lines = {};
+  std::rewind(file);
+  char buffer[1024];
+  while(std::fgets(buffer, sizeof(buffer), file) != nullptr)
+  {
+    auto const json = parse_json(buffer);
+    ASSERT_TRUE(json.has_value()) << buffer;
+    lines.push_back(json.value());
+  }
+  std::fclose(file);
+
+  ASSERT_EQ(lines.size(), 3);
+
+  EXPECT_EQ(lines[0].get_string("type"), "download");
+  EXPECT_EQ(lines[0].get_number("id"), 0.0);
+  EXPECT_EQ(lines[0].get_string("name"), "a \"0\".ts");
+  EXPECT_EQ(lines[0].get_number("bytes"), 100.0);
+  EXPECT_EQ(lines[0].get_string("error"), "timeout");
+
+  EXPECT_EQ(lines[1].get_string("type"), "download");
+  EXPECT_EQ(lines[1].get_number("id"), 1.0);
+  EXPECT_FALSE(lines[1].get("error").has_value());
+
+  EXPECT_EQ(lines[2].get_string("type"), "progress");
+  EXPECT_EQ(lines[2].get_number("finished"), 2.0);
+  EXPECT_EQ(lines[2].get_number("total"), 2.0);
+  EXPECT_EQ(lines[2].get_number("bytes"), 150.0);
+  EXPECT_EQ(lines[2].get("total_bytes"), json_t{});
+  EXPECT_EQ(lines[2].get_number("eta"), 0.0);
+  EXPECT_EQ(lines[2].get_number("running"), 0.0);
+}
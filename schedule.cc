@@ -0,0 +1,41 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::ranges::stable_sort, std::ranges::max
+#include <cassert>
+#include <functional> // std::greater
+#include <numeric>    // std::iota
+#include <queue>
+
+#include "schedule.h"
+
+auto lpt_order(std::vector<size_t> const& sizes) -> std::vector<size_t>
+{
+  std::vector<size_t> order(sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  std::ranges::stable_sort(order, std::greater{}, [&sizes](size_t i) { return sizes[i]; });
+
+  return order;
+}
+
+auto predict_makespan(std::vector<size_t> const& sizes, std::vector<size_t> const& order, size_t slots,
+    double bytes_per_second) -> double
+{
+  assert(slots > 0);
+  assert(bytes_per_second > 0.0);
+
+  // The times the slots become free, earliest on top.
+  std::priority_queue<double, std::vector<double>, std::greater<double>> free_at = {};
+  for(size_t s=0; s<slots; s++)
+    free_at.push(0.0);
+
+  double makespan = 0.0;
+  for(size_t const i : order)
+  {
+    double const end = free_at.top() + static_cast<double>(sizes[i])/bytes_per_second;
+    free_at.pop();
+    free_at.push(end);
+    makespan = std::max(makespan, end);
+  }
+
+  return makespan;
+}
@@ -0,0 +1,18 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <cstddef> // size_t
+#include <vector>
+
+//
+// Scheduling of the downloads onto the parallel transfers (slots) of download_files().
+// A slot takes the next download as soon as it is free (list scheduling), so only the order matters.
+//
+
+//! Longest-processing-time-first: The indices of sizes ordered by size, largest first
+//! (equal sizes keep their order). It keeps big downloads from landing at the end, where they stall the tail.
+auto lpt_order(std::vector<size_t> const& sizes) -> std::vector<size_t>;
+
+//! The makespan in seconds of downloading sizes (in bytes) in the order on the slots,
+//! each at bytes_per_second. Ignores the latency of the requests.
+auto predict_makespan(std::vector<size_t> const& sizes, std::vector<size_t> const& order, size_t slots,
+    double bytes_per_second) -> double;
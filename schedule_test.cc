@@ -0,0 +1,23 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "schedule.h"
+
+TEST(schedule_tests, lpt_order)
+{
+  EXPECT_EQ(lpt_order({3, 7, 1, 7, 5}), (std::vector<size_t>{1, 3, 4, 0, 2}));
+  EXPECT_TRUE(lpt_order({}).empty());
+}
+
+TEST(schedule_tests, predict_makespan)
+{
+  std::vector<size_t> const sizes = {2, 2, 2, 2, 8};
+  std::vector<size_t> const in_order = {0, 1, 2, 3, 4};
+
+  // The big one at the end stalls the tail, first it runs alongside the small ones.
+  EXPECT_DOUBLE_EQ(predict_makespan(sizes, in_order, 2, 1.0), 12.0);
+  EXPECT_DOUBLE_EQ(predict_makespan(sizes, lpt_order(sizes), 2, 1.0), 8.0);
+
+  EXPECT_DOUBLE_EQ(predict_makespan(sizes, in_order, 1, 2.0), 8.0);
+  EXPECT_DOUBLE_EQ(predict_makespan({}, {}, 3, 1.0), 0.0);
+}
@@ -0,0 +1,117 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::ranges::lower_bound, std::max, std::min
+#include <cmath>     // std::ceil
+#include <format>
+
+#include "progressmeter.h" // shorten_bytes()
+#include "stats.h"
+
+static auto format_seconds(double seconds) -> std::string;
+
+// ---
+
+void histogram_t::add(double value)
+{
+  value = std::max(value, 0.0);
+
+  size_t const bucket = std::ranges::lower_bound(bounds, value) - bounds.begin();
+  m_counts[bucket]++;
+  m_count++;
+  m_sum += value;
+  m_max = std::max(m_max, value);
+}
+
+auto histogram_t::percentile(double p) const -> double
+{
+  if(m_count == 0)
+    return 0.0;
+
+  size_t const rank = std::max<size_t>(1, static_cast<size_t>(std::ceil(p*static_cast<double>(m_count))));
+  size_t seen = 0;
+  for(size_t b=0; b<bounds.size(); b++)
+  {
+    seen += m_counts[b];
+    if(seen >= rank)
+      return std::min(bounds[b], m_max);
+  }
+  return m_max;
+}
+
+auto histogram_t::json() const -> json_t
+{
+  json_t::array_t buckets = {};
+  for(size_t b=0; b<m_counts.size(); b++)
+  {
+    if(m_counts[b] == 0)
+      continue;
+    json_t const bound = b < bounds.size() ? json_t{bounds[b]} : json_t{};
+    buckets.push_back(json_t::array_t{bound, m_counts[b]});
+  }
+
+  return json_t::object_t{
+    {"count", m_count}, {"sum", m_sum}, {"max", m_max},
+    {"p50", percentile(0.5)}, {"p90", percentile(0.9)}, {"p99", percentile(0.99)},
+    {"buckets", buckets}};
+}
+
+// ---
+
+void transfer_stats_t::add(timing_t const& timing)
+{
+  m_transfers++;
+  m_bytes += timing.bytes;
+  m_connects += static_cast<size_t>(std::max(timing.connects, 0L));
+  if(timing.connects == 0)
+    m_reused++;
+
+  // The times include the ones before, the phases are the differences.
+  // Only new connections count for dns, tcp and tls (a connection without TLS has no appconnect).
+  double const connected = std::max(timing.connect, timing.appconnect);
+  if(timing.connects > 0)
+  {
+    m_histograms[dns].add(timing.namelookup);
+    m_histograms[tcp].add(timing.connect - timing.namelookup);
+    if(timing.appconnect > 0.0)
+      m_histograms[tls].add(timing.appconnect - timing.connect);
+  }
+  m_histograms[wait].add(timing.starttransfer - connected);
+  m_histograms[transfer].add(timing.total - std::max(timing.starttransfer, connected));
+  m_histograms[total].add(timing.total);
+}
+
+auto transfer_stats_t::str() const -> std::string
+{
+  std::string str = std::format("{:<8} {:>6} {:>8} {:>8} {:>8} {:>8}\n", "phase", "count", "p50", "p90", "p99", "max");
+  for(size_t p=0; p<phases; p++)
+  {
+    auto const& h = m_histograms[p];
+    if(h.count() == 0)
+      continue;
+    str += std::format("{:<8} {:>6} {:>8} {:>8} {:>8} {:>8}\n", phase_names[p], h.count(),
+        format_seconds(h.percentile(0.5)), format_seconds(h.percentile(0.9)), format_seconds(h.percentile(0.99)),
+        format_seconds(h.max()));
+  }
+
+  auto const [quantity, unit] = shorten_bytes(m_bytes);
+  str += std::format("{} transfers of {:.1f} {}, {} new connections, {} transfers over a reused one",
+      m_transfers, quantity, unit, m_connects, m_reused);
+  return str;
+}
+
+auto transfer_stats_t::json() const -> json_t
+{
+  json_t::object_t json = {
+    {"transfers", m_transfers}, {"bytes", m_bytes}, {"connects", m_connects}, {"reused", m_reused}};
+  for(size_t p=0; p<phases; p++)
+    json[phase_names[p]] = m_histograms[p].json();
+  return json;
+}
+
+// ---
+
+auto format_seconds(double seconds) -> std::string
+{
+  if(seconds < 1.0)
+    return std::format("{:.0f} ms", seconds*1'000.0);
+  return std::format("{:.1f} s", seconds);
+}
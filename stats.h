@@ -0,0 +1,99 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <array>
+#include <cstddef> // size_t
+#include <string>
+
+#include "json.h"
+
+//
+// Timing statistics of the transfers of download_files() (from curl_easy_getinfo()), to tell whether
+// the downloads are bound by DNS, connecting, TLS, the server (time to first byte) or the bandwidth.
+//
+
+//! The times of a transfer in seconds since its start, as libcurl reports them (each includes the ones before).
+struct timing_t
+{
+  double namelookup = 0.0;    // DNS
+  double connect = 0.0;       // TCP
+  double appconnect = 0.0;    // TLS, 0 without
+  double starttransfer = 0.0; // first byte
+  double total = 0.0;
+
+  size_t bytes = 0;
+  long connects = 0; // new connections, 0 if it reused one
+};
+
+//! Counts of values (seconds) in fixed buckets with bounds from 1 ms to 100 s (1-2-5 steps) and one above.
+class histogram_t
+{
+public:
+
+  static constexpr std::array<double, 16> bounds = {
+    0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0};
+
+  void add(double value);
+
+  inline auto count() const -> size_t { return m_count; }
+  inline auto sum() const -> double { return m_sum; }
+  inline auto max() const -> double { return m_max; }
+
+  //! The upper bound of the bucket of the p-th percentile (0.0 to 1.0), at most the maximum.
+  auto percentile(double p) const -> double;
+
+  //! {"count":N,"sum":S,"max":M,"p50":..,"p90":..,"p99":..,"buckets":[[BOUND,COUNT],...]} with the non-empty
+  //! buckets only, the one above the bounds has the bound null.
+  auto json() const -> json_t;
+
+
+private:
+
+  std::array<size_t, bounds.size() + 1> m_counts = {};
+  size_t m_count = 0;
+  double m_sum = 0.0;
+  double m_max = 0.0;
+};
+
+//! The timing statistics of the transfers of a download_files()-run.
+class transfer_stats_t
+{
+public:
+
+  //! The phases of a transfer, which are histograms of their durations.
+  enum phase_t
+  {
+    dns,      // namelookup
+    tcp,      // connect after the namelookup
+    tls,      // appconnect after the connect
+    wait,     // first byte after the request was sent (time to first byte of the server)
+    transfer, // the rest
+    total,
+    phases    // number of the phases
+  };
+
+  static constexpr std::array<char const*, phases> phase_names = {"dns", "tcp", "tls", "wait", "transfer", "total"};
+
+  void add(timing_t const& timing);
+
+  inline auto transfers() const -> size_t { return m_transfers; }
+  inline auto bytes() const -> size_t { return m_bytes; }
+  inline auto connects() const -> size_t { return m_connects; }
+  inline auto reused() const -> size_t { return m_reused; }
+  inline auto histogram(phase_t phase) const -> histogram_t const& { return m_histograms[phase]; }
+
+  //! A table of the phases with their percentiles and a line about the connections.
+  auto str() const -> std::string;
+
+  //! {"transfers":N,"bytes":B,"connects":C,"reused":R,"dns":HISTOGRAM,...} see histogram_t::json().
+  auto json() const -> json_t;
+
+
+private:
+
+  size_t m_transfers = 0;
+  size_t m_bytes = 0;
+  size_t m_connects = 0; // new connections
+  size_t m_reused = 0;   // transfers over a reused connection
+
+  std::array<histogram_t, phases> m_histograms = {};
+};
@@ -0,0 +1,54 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "stats.h"
+
+TEST(stats_tests, histogram)
+{
+  histogram_t histogram;
+  EXPECT_EQ(histogram.percentile(0.5), 0.0);
+
+  for(int n=0; n<8; n++)
+    histogram.add(0.015); // bucket up to 20 ms
+  histogram.add(0.3);     // up to 500 ms
+  histogram.add(250.0);   // above the bounds
+
+  EXPECT_EQ(histogram.count(), 10);
+  EXPECT_DOUBLE_EQ(histogram.max(), 250.0);
+  EXPECT_DOUBLE_EQ(histogram.percentile(0.5), 0.02);
+  EXPECT_DOUBLE_EQ(histogram.percentile(0.9), 0.5);
+  EXPECT_DOUBLE_EQ(histogram.percentile(1.0), 250.0);
+
+  auto const json = histogram.json();
+  EXPECT_EQ(json.get_number("count"), 10.0);
+  auto const buckets = json.get("buckets").value().as_array();
+  ASSERT_EQ(buckets.size(), 3);
+  EXPECT_EQ(buckets[0], (json_t{json_t::array_t{0.02, 8}}));
+  EXPECT_EQ(buckets[2], (json_t{json_t::array_t{json_t{}, 1}}));
+}
+
+TEST(stats_tests, transfer_stats)
+{
+  transfer_stats_t stats;
+
+  // A new TLS-connection ...
+  stats.add(timing_t{0.004, 0.015, 0.060, 0.150, 1.150, 1'000'000, 1});
+  // ... and one reused.
+  stats.add(timing_t{0.0, 0.0, 0.0, 0.080, 0.580, 500'000, 0});
+
+  EXPECT_EQ(stats.transfers(), 2);
+  EXPECT_EQ(stats.bytes(), 1'500'000);
+  EXPECT_EQ(stats.connects(), 1);
+  EXPECT_EQ(stats.reused(), 1);
+
+  EXPECT_EQ(stats.histogram(transfer_stats_t::dns).count(), 1);
+  EXPECT_NEAR(stats.histogram(transfer_stats_t::tls).max(), 0.045, 1e-9);
+  EXPECT_EQ(stats.histogram(transfer_stats_t::wait).count(), 2);
+  EXPECT_NEAR(stats.histogram(transfer_stats_t::wait).max(), 0.090, 1e-9);
+  EXPECT_NEAR(stats.histogram(transfer_stats_t::transfer).max(), 1.0, 1e-9);
+
+  auto const json = stats.json();
+  EXPECT_EQ(json.get_number("reused"), 1.0);
+  EXPECT_EQ(json.get("total").value().get_number("count"), 2.0);
+  EXPECT_NE(stats.str().find("tls"), std::string::npos);
+}
@@ -3,6 +3,7 @@
 
 #include <algorithm> // std::find_if
 #include <string>
+#include <vector>
 
 #include <cassert>
 
@@ -0,0 +1,84 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::nth_element
+#include <cassert>
+#include <cmath>     // std::ceil, std::exp2
+
+#include "throughput.h"
+
+throughput_t::throughput_t(double half_life, clock::time_point start)
+  : m_half_life{half_life}, m_last{start}
+{
+  assert(half_life > 0.0);
+}
+
+void throughput_t::add(size_t bytes, clock::time_point now)
+{
+  m_bytes += bytes;
+  m_pending += bytes;
+
+  double const seconds = std::chrono::duration<double>(now - m_last).count();
+  if(seconds <= 0.0)
+    return;
+
+  double const rate = static_cast<double>(m_pending)/seconds;
+  m_rate = averaged(rate, seconds);
+  m_last = now;
+  m_pending = 0;
+
+  m_rates[m_next] = rate;
+  m_next = (m_next + 1) % window;
+  if(m_size < window)
+    m_size++;
+}
+
+void throughput_t::update(size_t transfered, clock::time_point now)
+{
+  if(transfered < m_bytes)
+    m_bytes = transfered;
+  add(transfered - m_bytes, now);
+}
+
+auto throughput_t::rate(clock::time_point now) const -> std::optional<double>
+{
+  if(not m_rate.has_value())
+    return {};
+
+  double const seconds = std::chrono::duration<double>(now - m_last).count();
+  if(seconds <= 0.0)
+    return m_rate;
+
+  return averaged(static_cast<double>(m_pending)/seconds, seconds);
+}
+
+auto throughput_t::percentile(double p) const -> std::optional<double>
+{
+  assert(0.0 <= p and p <= 1.0);
+
+  if(m_size == 0)
+    return {};
+
+  std::array<double, window> rates = m_rates;
+  size_t const rank = static_cast<size_t>(std::ceil(p*static_cast<double>(m_size)));
+  size_t const n = rank > 0 ? rank-1 : 0;
+  std::nth_element(rates.begin(), rates.begin()+n, rates.begin()+m_size);
+  return rates[n];
+}
+
+auto throughput_t::eta(size_t remaining, clock::time_point now) const -> std::optional<double>
+{
+  auto const r = rate(now);
+  if(not r.has_value() or (r.value() <= 0.0 and remaining > 0))
+    return {};
+  if(remaining == 0)
+    return 0.0;
+  return static_cast<double>(remaining)/r.value();
+}
+
+auto throughput_t::averaged(double rate, double seconds) const -> double
+{
+  if(not m_rate.has_value())
+    return rate;
+
+  double const alpha = 1.0 - std::exp2(-seconds/m_half_life);
+  return m_rate.value() + alpha*(rate - m_rate.value());
+}
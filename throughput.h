@@ -0,0 +1,64 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef> // size_t
+#include <optional>
+
+/**
+ * Estimates the throughput of a transfer (or of all of them) from records of the transfered bytes.
+ *
+ * The rate is an exponentially weighted moving average of the rates between the records, weighted by time:
+ * A record over dt seconds moves the average by 1 - 2^(-dt/half_life) towards its rate. Until the next
+ * record the bytes since the last one count as a record up to now, so the rate decays when nothing arrives.
+ * The rates of the last records are kept (in a fixed array) for percentiles.
+ *
+ * The progressmeter shows the rates and ETAs of it and the variant_switcher_t decides with it.
+ */
+class throughput_t
+{
+public:
+
+  using clock = std::chrono::steady_clock;
+
+  static constexpr size_t window = 32; // rates kept for the percentiles
+
+  explicit throughput_t(double half_life = 3.0, clock::time_point start = clock::now());
+
+  //! Record bytes transfered since the last record (or the start).
+  //! Records at the same time as the last one are added up into the next one.
+  void add(size_t bytes, clock::time_point now = clock::now());
+
+  //! Record the bytes transfered so far (a growing counter), the difference to the last one is added.
+  //! A smaller counter (e.g. a restarted transfer) starts over from there.
+  void update(size_t transfered, clock::time_point now = clock::now());
+
+  //! The rate in bytes/s, nothing before the first record.
+  auto rate(clock::time_point now = clock::now()) const -> std::optional<double>;
+
+  //! The p-th percentile (0.0 to 1.0) of the rates of the last records (nearest-rank).
+  auto percentile(double p) const -> std::optional<double>;
+
+  //! Seconds until the remaining bytes are transfered at the rate, nothing without a rate.
+  auto eta(size_t remaining, clock::time_point now = clock::now()) const -> std::optional<double>;
+
+  //! All bytes recorded and the time of the last record.
+  inline auto bytes() const -> size_t { return m_bytes; }
+  inline auto last() const -> clock::time_point { return m_last; }
+
+
+private:
+
+  auto averaged(double rate, double seconds) const -> double;
+
+  double m_half_life; // in seconds
+  clock::time_point m_last;
+
+  size_t m_bytes = 0;
+  size_t m_pending = 0; // bytes of records at the time of the last one
+  std::optional<double> m_rate = {};
+
+  std::array<double, window> m_rates = {};
+  size_t m_size = 0;
+  size_t m_next = 0; // where the next rate goes
+};
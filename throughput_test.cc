@@ -0,0 +1,66 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "throughput.h"
+
+using namespace std::chrono_literals;
+
+TEST(throughput_tests, rate)
+{
+  auto const start = throughput_t::clock::now();
+  throughput_t throughput{2.0, start};
+  EXPECT_FALSE(throughput.rate(start).has_value());
+
+  // The first record is the rate.
+  throughput.add(1'000'000, start + 1s);
+  EXPECT_DOUBLE_EQ(throughput.rate(start + 1s).value(), 1'000'000.0);
+
+  // A record over the half-life moves the rate half way.
+  throughput.add(6'000'000, start + 3s);
+  EXPECT_DOUBLE_EQ(throughput.rate(start + 3s).value(), 2'000'000.0);
+
+  // Without records it decays, as if nothing arrived.
+  EXPECT_DOUBLE_EQ(throughput.rate(start + 5s).value(), 1'000'000.0);
+
+  // Records at the same time count together with the next one.
+  throughput.add(1'000'000, start + 3s);
+  throughput.add(3'000'000, start + 5s);
+  EXPECT_DOUBLE_EQ(throughput.rate(start + 5s).value(), 2'000'000.0);
+
+  EXPECT_EQ(throughput.bytes(), 11'000'000);
+  EXPECT_DOUBLE_EQ(throughput.eta(4'000'000, start + 5s).value(), 2.0);
+  EXPECT_DOUBLE_EQ(throughput.eta(0, start + 5s).value(), 0.0);
+}
+
+TEST(throughput_tests, update)
+{
+  auto const start = throughput_t::clock::now();
+  throughput_t throughput{2.0, start};
+
+  throughput.update(1'000, start + 1s);
+  throughput.update(3'000, start + 2s);
+  EXPECT_EQ(throughput.bytes(), 3'000);
+
+  // A restarted transfer starts over.
+  throughput.update(500, start + 3s);
+  EXPECT_EQ(throughput.bytes(), 500);
+  throughput.update(1'500, start + 4s);
+  EXPECT_EQ(throughput.bytes(), 1'500);
+}
+
+TEST(throughput_tests, percentile)
+{
+  auto const start = throughput_t::clock::now();
+  throughput_t throughput{2.0, start};
+  EXPECT_FALSE(throughput.percentile(0.5).has_value());
+
+  for(size_t i=1; i<=10; i++)
+    throughput.add(i*1'000, start + i*1s);
+  EXPECT_DOUBLE_EQ(throughput.percentile(0.5).value(), 5'000.0);
+  EXPECT_DOUBLE_EQ(throughput.percentile(0.9).value(), 9'000.0);
+
+  // Only the last ones are kept.
+  for(size_t i=11; i<=10+throughput_t::window; i++)
+    throughput.add(100, start + i*1s);
+  EXPECT_DOUBLE_EQ(throughput.percentile(1.0).value(), 100.0);
+}
@@ -0,0 +1,156 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <charconv> // std::from_chars
+#include <cmath>    // std::floor
+#include <cstdio>   // std::sscanf
+#include <format>
+
+#include "timerange.h"
+#include "variant.h" // parse_runtime
+
+auto parse_position(std::string const& str) -> std::optional<position_t>
+{
+  if(str.find('T') != std::string::npos)
+  {
+    auto const time = parse_date_time(str);
+    if(not time.has_value())
+      return {};
+    return position_t{time.value()};
+  }
+
+  // [[HH:]MM:]SS, only the seconds can have a fraction.
+  double seconds = 0.0;
+  size_t parts = 0;
+  size_t begin = 0;
+  while(begin <= str.size())
+  {
+    size_t end = str.find(':', begin);
+    if(end == std::string::npos)
+      end = str.size();
+
+    double value = 0.0;
+    auto const [ptr, errc] = std::from_chars(str.data() + begin, str.data() + end, value);
+    if(errc != std::errc{} or ptr != str.data() + end or value < 0.0)
+      return {};
+
+    bool const last = end == str.size();
+    if((parts > 0 and value >= 60.0) or (not last and value != std::floor(value)))
+      return {};
+
+    seconds = 60.0*seconds + value;
+    parts++;
+    begin = end + 1;
+  }
+
+  if(parts > 3)
+    return {};
+
+  return position_t{seconds};
+}
+
+auto format_position(position_t const& position) -> std::string
+{
+  using namespace std::chrono;
+
+  if(std::holds_alternative<double>(position))
+    return std::format("{}", std::get<double>(position));
+
+  auto const time = floor<milliseconds>(std::get<system_clock::time_point>(position));
+  auto const date = floor<days>(time);
+  year_month_day const ymd{date};
+  hh_mm_ss const hms{time - date};
+
+  return std::format("{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:03}Z", static_cast<int>(ymd.year()),
+      static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()), hms.hours().count(),
+      hms.minutes().count(), hms.seconds().count(), hms.subseconds().count());
+}
+
+auto parse_date_time(std::string const& str) -> std::optional<std::chrono::system_clock::time_point>
+{
+  using namespace std::chrono;
+
+  int y = 0, mon = 0, d = 0, h = 0, min = 0;
+  double s = 0.0;
+  int n = 0;
+  if(std::sscanf(str.c_str(), "%4d-%2d-%2dT%2d:%2d:%lf%n", &y, &mon, &d, &h, &min, &s, &n) != 6)
+    return {};
+
+  year_month_day const date{year{y}, month{static_cast<unsigned>(mon)}, day{static_cast<unsigned>(d)}};
+  if(not date.ok() or h < 0 or h > 23 or min < 0 or min > 59 or not (s >= 0.0 and s < 61.0))
+    return {};
+
+  // Z, +hh:mm, +hhmm or +hh (or - instead of +)
+  std::string const zone = str.substr(static_cast<size_t>(n));
+  minutes offset{0};
+  if(not zone.empty() and zone != "Z")
+  {
+    int zh = 0, zm = 0;
+    char sign = '\0';
+    int m = 0;
+    if((std::sscanf(zone.c_str(), "%c%2d:%2d%n", &sign, &zh, &zm, &m) != 3 or m != static_cast<int>(zone.size()))
+        and (std::sscanf(zone.c_str(), "%c%2d%2d%n", &sign, &zh, &zm, &m) != 3 or m != static_cast<int>(zone.size()))
+        and (std::sscanf(zone.c_str(), "%c%2d%n", &sign, &zh, &m) != 2 or m != static_cast<int>(zone.size())))
+      return {};
+    if((sign != '+' and sign != '-') or zh < 0 or zh > 23 or zm < 0 or zm > 59)
+      return {};
+
+    offset = hours{zh} + minutes{zm};
+    if(sign == '-')
+      offset = -offset;
+  }
+
+  return sys_days{date} + hours{h} + minutes{min}
+    + duration_cast<system_clock::duration>(duration<double>{s}) - offset;
+}
+
+auto segment_starts(std::vector<urlprops_t> const& segments) -> std::vector<double>
+{
+  std::vector<double> starts = {0.0};
+  for(auto const& segment : segments)
+    starts.push_back(starts.back() + parse_runtime(segment));
+  return starts;
+}
+
+auto resolve_position(position_t const& position, std::vector<urlprops_t> const& segments) -> std::optional<double>
+{
+  using namespace std::chrono;
+
+  if(std::holds_alternative<double>(position))
+    return std::get<double>(position);
+
+  auto const time = std::get<system_clock::time_point>(position);
+  auto const starts = segment_starts(segments);
+
+  // The date-time of a segment counts up to the next one, e.g. after a discontinuity.
+  std::optional<double> offset = {};
+  for(size_t i=0; i<segments.size(); i++)
+  {
+    if(not segments[i].properties.contains("PROGRAM-DATE-TIME"))
+      continue;
+
+    auto const date_time = parse_date_time(segments[i].properties.at("PROGRAM-DATE-TIME"));
+    if(not date_time.has_value())
+      continue;
+
+    if(not offset.has_value() or date_time.value() <= time)
+      offset = starts[i] + duration<double>{time - date_time.value()}.count();
+    if(date_time.value() > time)
+      break;
+  }
+
+  return offset;
+}
+
+auto select_segments(std::vector<double> const& starts, double from, double to) -> std::tuple<size_t, size_t>
+{
+  size_t const n = starts.empty() ? 0 : starts.size() - 1;
+
+  size_t first = 0;
+  while(first < n and starts[first+1] <= from)
+    first++;
+
+  size_t last = first;
+  while(last < n and starts[last] < to)
+    last++;
+
+  return std::make_tuple(first, last);
+}
@@ -0,0 +1,40 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <chrono>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "m3u8.h"
+
+//
+// Time ranges of a playlist (--from/--to), so only the segments of a clip are downloaded.
+// A position is either an offset from the beginning of the playlist or a wall-clock time,
+// that is mapped to an offset via #EXT-X-PROGRAM-DATE-TIME.
+//
+
+//! Seconds from the beginning of the playlist or a wall-clock time.
+using position_t = std::variant<double, std::chrono::system_clock::time_point>;
+
+//! Parse an offset "SS", "MM:SS" or "HH:MM:SS" (with optional fraction e.g. "1:02:03.5")
+//! or a date-time (see parse_date_time()).
+auto parse_position(std::string const& str) -> std::optional<position_t>;
+
+//! The inverse of parse_position(), wall-clock times in UTC (e.g. "2026-10-16T20:15:00.000Z").
+auto format_position(position_t const& position) -> std::string;
+
+//! Parse an ISO 8601 date-time like "2026-10-16T20:15:00.000+02:00" (the format of #EXT-X-PROGRAM-DATE-TIME).
+//! Without Z or an offset it's taken as UTC.
+auto parse_date_time(std::string const& str) -> std::optional<std::chrono::system_clock::time_point>;
+
+//! The start of every segment in seconds (by the #EXTINF-runtimes) and the end of the playlist as last element.
+auto segment_starts(std::vector<urlprops_t> const& segments) -> std::vector<double>;
+
+//! The position as offset in seconds. A wall-clock time is mapped via the closest #EXT-X-PROGRAM-DATE-TIME
+//! before it, without one in the playlist there is nothing.
+auto resolve_position(position_t const& position, std::vector<urlprops_t> const& segments) -> std::optional<double>;
+
+//! The segments [first, last) that overlap the range [from, to) in seconds (see segment_starts()).
+auto select_segments(std::vector<double> const& starts, double from, double to) -> std::tuple<size_t, size_t>;
@@ -0,0 +1,99 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "timerange.h"
+
+using namespace std::chrono;
+
+static std::string const playlist_str =
+  "#EXTM3U\n"
+  "#EXT-X-TARGETDURATION:10\n"
+  "#EXT-X-PROGRAM-DATE-TIME:2026-10-16T20:00:00.000Z\n"
+  "#EXTINF:10.0,\n"
+  "seg0.ts\n"
+  "#EXTINF:10.0,\n"
+  "seg1.ts\n"
+  "#EXTINF:5.0,\n"
+  "seg2.ts\n"
+  "#EXT-X-DISCONTINUITY\n"
+  "#EXT-X-PROGRAM-DATE-TIME:2026-10-16T23:00:00.000+02:00\n"
+  "#EXTINF:10.0,\n"
+  "seg3.ts\n"
+  "#EXTINF:10.0,\n"
+  "seg4.ts\n"
+;
+
+static auto playlist_segments() -> std::vector<urlprops_t>
+{
+  m3u8_t const playlist{std::vector<char>{playlist_str.begin(), playlist_str.end()}};
+  return playlist.get_urls();
+}
+
+TEST(timerange_tests, parse_position)
+{
+  EXPECT_EQ(parse_position("90"), position_t{90.0});
+  EXPECT_EQ(parse_position("1:30"), position_t{90.0});
+  EXPECT_EQ(parse_position("1:02:03.5"), position_t{3'723.5});
+  EXPECT_EQ(parse_position("2026-10-16T20:15:00Z"), position_t{sys_days{2026y/10/16} + 20h + 15min});
+
+  EXPECT_FALSE(parse_position("").has_value());
+  EXPECT_FALSE(parse_position("1:60").has_value());
+  EXPECT_FALSE(parse_position("1.5:30").has_value());
+  EXPECT_FALSE(parse_position("1:2:3:4").has_value());
+  EXPECT_FALSE(parse_position("-5").has_value());
+  EXPECT_FALSE(parse_position("5s").has_value());
+  EXPECT_FALSE(parse_position("2026-13-16T20:15:00Z").has_value());
+}
+
+TEST(timerange_tests, format_position)
+{
+  EXPECT_EQ(format_position(90.0), "90");
+  EXPECT_EQ(format_position(1.5), "1.5");
+
+  position_t const time = sys_days{2026y/10/16} + 20h + 15min + 250ms;
+  EXPECT_EQ(format_position(time), "2026-10-16T20:15:00.250Z");
+  EXPECT_EQ(parse_position(format_position(time)), time);
+}
+
+TEST(timerange_tests, parse_date_time)
+{
+  auto const expected = sys_days{2026y/10/16} + 18h + 15min + 30s;
+  EXPECT_EQ(parse_date_time("2026-10-16T18:15:30Z"), expected);
+  EXPECT_EQ(parse_date_time("2026-10-16T18:15:30"), expected);
+  EXPECT_EQ(parse_date_time("2026-10-16T20:15:30.000+02:00"), expected);
+  EXPECT_EQ(parse_date_time("2026-10-16T20:15:30+0200"), expected);
+  EXPECT_EQ(parse_date_time("2026-10-16T13:15:30-05"), expected);
+  EXPECT_EQ(parse_date_time("2026-10-16T18:15:30.5Z"), expected + 500ms);
+
+  EXPECT_FALSE(parse_date_time("2026-10-16").has_value());
+  EXPECT_FALSE(parse_date_time("2026-10-16T25:00:00Z").has_value());
+  EXPECT_FALSE(parse_date_time("2026-10-16T18:15:30 CEST").has_value());
+}
+
+TEST(timerange_tests, resolve_position)
+{
+  auto const segments = playlist_segments();
+
+  EXPECT_EQ(segment_starts(segments), (std::vector<double>{0.0, 10.0, 20.0, 25.0, 35.0, 45.0}));
+
+  EXPECT_EQ(resolve_position(12.5, segments), 12.5);
+  EXPECT_EQ(resolve_position(sys_days{2026y/10/16} + 20h + 15s, segments), 15.0);
+  EXPECT_EQ(resolve_position(sys_days{2026y/10/16} + 19h + 59min, segments), -60.0);
+  // After the discontinuity (a gap of almost an hour) by its own date-time.
+  EXPECT_EQ(resolve_position(sys_days{2026y/10/16} + 21h + 5s, segments), 30.0);
+  EXPECT_EQ(resolve_position(sys_days{2026y/10/16} + 21h + 1min, segments), 85.0);
+
+  m3u8_t const without{std::vector<urlprops_t>{{"seg0.ts", {{"RUNTIME", "10"}}}}};
+  EXPECT_FALSE(resolve_position(sys_days{2026y/10/16} + 20h, without.get_urls()).has_value());
+}
+
+TEST(timerange_tests, select_segments)
+{
+  std::vector<double> const starts = {0.0, 10.0, 20.0, 25.0, 35.0, 45.0};
+
+  EXPECT_EQ(select_segments(starts, 0.0, 45.0), std::make_tuple(0, 5));
+  EXPECT_EQ(select_segments(starts, 12.0, 22.0), std::make_tuple(1, 3));
+  EXPECT_EQ(select_segments(starts, 10.0, 20.0), std::make_tuple(1, 2));
+  EXPECT_EQ(select_segments(starts, 40.0, 100.0), std::make_tuple(4, 5));
+  EXPECT_EQ(select_segments(starts, 50.0, 100.0), std::make_tuple(5, 5));
+}
@@ -0,0 +1,134 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::max
+#include <cerrno>
+#include <format>
+#include <fstream>
+#include <system_error> // std::error_code
+
+#include "trace.h"
+
+trace_t::trace_t(clock::time_point start)
+  : m_start{start}
+{
+  name_track(pipeline, -1, "curl_m3u8");
+  name_track(pipeline, 0, "main");
+  name_track(transfers, -1, "transfers");
+}
+
+void trace_t::span(std::string const& name, std::string const& category, int pid, int tid,
+    clock::time_point begin, clock::time_point end, json_t::object_t args)
+{
+  json_t::object_t event = {{"name", name}, {"cat", category}, {"ph", "X"}, {"pid", pid}, {"tid", tid},
+    {"ts", timestamp(begin)}, {"dur", std::max(timestamp(end) - timestamp(begin), 0.0)}};
+  if(not args.empty())
+    event["args"] = std::move(args);
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  m_events.push_back(std::move(event));
+}
+
+void trace_t::async_span(std::string const& name, std::string const& category, int pid, uint64_t id,
+    clock::time_point begin, clock::time_point end)
+{
+  std::string const hex = std::format("{:#x}", id);
+  json_t::object_t event = {{"name", name}, {"cat", category}, {"pid", pid}, {"tid", 0}, {"id", hex}};
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  event["ph"] = "b";
+  event["ts"] = timestamp(begin);
+  m_events.push_back(event);
+  event["ph"] = "e";
+  event["ts"] = timestamp(end);
+  m_events.push_back(std::move(event));
+}
+
+void trace_t::name_track(int pid, int tid, std::string const& name)
+{
+  json_t::object_t event = {{"ph", "M"}, {"pid", pid}, {"args", json_t::object_t{{"name", name}}}};
+  if(tid == -1)
+    event["name"] = "process_name";
+  else
+  {
+    event["name"] = "thread_name";
+    event["tid"] = tid;
+  }
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  m_events.push_back(std::move(event));
+}
+
+auto trace_t::track(int pid, std::string const& name) -> int
+{
+  int tid = 0;
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto const key = std::make_tuple(pid, name);
+    if(m_tracks.contains(key))
+      return m_tracks.at(key);
+
+    tid = ++m_next_track[pid];
+    m_tracks[key] = tid;
+  }
+
+  name_track(pid, tid, name);
+  return tid;
+}
+
+auto trace_t::events() const -> size_t
+{
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_events.size();
+}
+
+auto trace_t::json() const -> std::string
+{
+  std::lock_guard<std::mutex> lock{m_mutex};
+
+  std::string json = "{\"traceEvents\":[";
+  for(size_t e=0; e<m_events.size(); e++)
+  {
+    json += e == 0 ? "\n" : ",\n";
+    json += m_events[e].str();
+  }
+  json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  return json;
+}
+
+void trace_t::write(std::filesystem::path const& path) const
+{
+  std::ofstream file{path};
+  file << json();
+  file.close();
+
+  if(file.fail())
+  {
+    int const err = errno;
+    std::error_code errc{err, std::generic_category()};
+    throw std::filesystem::filesystem_error{"Couldn't write file", path, errc};
+  }
+}
+
+auto trace_t::timestamp(clock::time_point time) const -> double
+{
+  return std::chrono::duration<double, std::micro>(time - m_start).count();
+}
+
+// ---
+
+trace_scope_t::trace_scope_t(trace_t* trace, std::string name, std::string category, int pid, int tid)
+  : m_trace{trace}, m_name{std::move(name)}, m_category{std::move(category)}, m_pid{pid}, m_tid{tid},
+    m_begin{trace_t::clock::now()}
+{
+}
+
+trace_scope_t::~trace_scope_t()
+{
+  if(m_trace != nullptr)
+    m_trace->span(m_name, m_category, m_pid, m_tid, m_begin, trace_t::clock::now(), std::move(m_args));
+}
+
+void trace_scope_t::arg(std::string const& key, json_t value)
+{
+  m_args[key] = std::move(value);
+}
@@ -0,0 +1,98 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <chrono>
+#include <cstdint> // uint64_t
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "json.h"
+
+//
+// A timeline of the download in the Trace Event Format of Chrome
+// (https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nRJmzZIQs6A), which
+// https://ui.perfetto.dev and chrome://tracing show. The transfers are on one track per handle slot,
+// so idle slots, stragglers and phases waiting for each other are visible at a glance.
+//
+
+class trace_t
+{
+public:
+
+  using clock = std::chrono::steady_clock;
+
+  // The processes of the tracks, each with its own tracks (threads in the format).
+  static constexpr int pipeline = 1;  // the phases: track 0 the main thread, then the muxing of the jobs
+  static constexpr int transfers = 2; // one track per handle slot of download_files()
+
+  explicit trace_t(clock::time_point start = clock::now());
+
+  trace_t(trace_t const&) = delete;
+  auto operator=(trace_t const&) -> trace_t& = delete;
+
+  //! A span [begin, end) on the track tid of the process pid. Args are shown with the span.
+  void span(std::string const& name, std::string const& category, int pid, int tid,
+      clock::time_point begin, clock::time_point end, json_t::object_t args = {});
+
+  //! A span on its own track (an async event with the id), for spans that overlap on a track
+  //! e.g. of the downloads waiting to start.
+  void async_span(std::string const& name, std::string const& category, int pid, uint64_t id,
+      clock::time_point begin, clock::time_point end);
+
+  //! Names the track tid of the process pid, a tid of -1 names the process.
+  void name_track(int pid, int tid, std::string const& name);
+
+  //! The track of the process pid with the name, a new one (named) on the first call.
+  auto track(int pid, std::string const& name) -> int;
+
+  inline auto start() const -> clock::time_point { return m_start; }
+  auto events() const -> size_t;
+
+  //! {"traceEvents":[...],"displayTimeUnit":"ms"} with one event per line.
+  auto json() const -> std::string;
+
+  //! Writes json() to the file. Throws std::filesystem::filesystem_error.
+  void write(std::filesystem::path const& path) const;
+
+
+private:
+
+  //! Microseconds since the start.
+  auto timestamp(clock::time_point time) const -> double;
+
+  clock::time_point const m_start;
+
+  mutable std::mutex m_mutex;
+  std::vector<json_t> m_events = {};
+  std::map<std::tuple<int, std::string>, int> m_tracks = {}; // (pid, name) -> tid, see track()
+  std::map<int, int> m_next_track = {};                      // pid -> tid
+};
+
+//! Records a span on the track from its construction to its destruction, nothing if trace is nullptr.
+class trace_scope_t
+{
+public:
+
+  trace_scope_t(trace_t* trace, std::string name, std::string category, int pid = trace_t::pipeline, int tid = 0);
+  ~trace_scope_t();
+
+  trace_scope_t(trace_scope_t const&) = delete;
+  auto operator=(trace_scope_t const&) -> trace_scope_t& = delete;
+
+  //! Shown with the span.
+  void arg(std::string const& key, json_t value);
+
+
+private:
+
+  trace_t* m_trace;
+  std::string m_name;
+  std::string m_category;
+  int m_pid;
+  int m_tid;
+  trace_t::clock::time_point m_begin;
+  json_t::object_t m_args = {};
+};
@@ -0,0 +1,70 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "trace.h"
+
+using namespace std::chrono_literals;
+
+TEST(trace_tests, spans)
+{
+  auto const start = trace_t::clock::now();
+  trace_t trace{start};
+  size_t const names = trace.events(); // of the processes
+
+  trace.span("seg-1.ts", "transfer", trace_t::transfers, 1, start + 1ms, start + 3ms,
+      json_t::object_t{{"bytes", 1'000}});
+  trace.async_span("queued", "queue", trace_t::transfers, 7, start, start + 1ms);
+  EXPECT_EQ(trace.events(), names + 3);
+
+  // A track is named once.
+  EXPECT_EQ(trace.track(trace_t::pipeline, "mux a"), 1);
+  EXPECT_EQ(trace.track(trace_t::pipeline, "mux b"), 2);
+  EXPECT_EQ(trace.track(trace_t::pipeline, "mux a"), 1);
+  EXPECT_EQ(trace.track(trace_t::transfers, "slot 1"), 1);
+  EXPECT_EQ(trace.events(), names + 6);
+
+  auto const json = parse_json(trace.json());
+  ASSERT_TRUE(json.has_value());
+  EXPECT_EQ(json->get_string("displayTimeUnit"), "ms");
+
+  auto const events = json->get("traceEvents").value().as_array();
+  ASSERT_EQ(events.size(), names + 6);
+
+  auto const& span = events[names];
+  EXPECT_EQ(span.get_string("ph"), "X");
+  EXPECT_EQ(span.get_string("name"), "seg-1.ts");
+  EXPECT_EQ(span.get_number("pid"), trace_t::transfers);
+  EXPECT_EQ(span.get_number("tid"), 1.0);
+  EXPECT_DOUBLE_EQ(span.get_number("ts").value(), 1'000.0); // in µs
+  EXPECT_DOUBLE_EQ(span.get_number("dur").value(), 2'000.0);
+  EXPECT_EQ(span.get("args")->get_number("bytes"), 1'000.0);
+
+  EXPECT_EQ(events[names+1].get_string("ph"), "b");
+  EXPECT_EQ(events[names+2].get_string("ph"), "e");
+  EXPECT_EQ(events[names+1].get_string("id"), events[names+2].get_string("id"));
+  EXPECT_DOUBLE_EQ(events[names+2].get_number("ts").value(), 1'000.0);
+
+  EXPECT_EQ(events[names+3].get_string("name"), "thread_name");
+  EXPECT_EQ(events[names+3].get("args")->get_string("name"), "mux a");
+}
+
+TEST(trace_tests, scope)
+{
+  trace_t trace;
+  size_t const names = trace.events();
+
+  {
+    trace_scope_t scope{&trace, "download", "download"};
+    scope.arg("downloads", 3);
+    trace_scope_t none{nullptr, "nothing", "download"}; // without a trace
+  }
+  ASSERT_EQ(trace.events(), names + 1);
+
+  auto const events = parse_json(trace.json())->get("traceEvents").value().as_array();
+  auto const& span = events.back();
+  EXPECT_EQ(span.get_string("name"), "download");
+  EXPECT_EQ(span.get_number("pid"), trace_t::pipeline);
+  EXPECT_EQ(span.get_number("tid"), 0.0);
+  EXPECT_GE(span.get_number("dur").value(), 0.0);
+  EXPECT_EQ(span.get("args")->get_number("downloads"), 3.0);
+}
@@ -0,0 +1,237 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::min
+#include <cassert>
+#include <cctype> // std::isalpha, std::isalnum
+
+#include "url.h"
+
+static auto scheme_length(std::string_view ref) -> size_t;
+static auto merge_paths(url_t const& base, std::string_view path) -> std::string;
+
+// ---
+
+auto url_t::str() const -> std::string
+{
+  std::string ret = "";
+  ret.reserve(scheme.length() + authority.length() + path.length() + query.length() + fragment.length() + 6);
+
+  if(not scheme.empty())
+    ret.append(scheme).append(":");
+  if(has_authority)
+    ret.append("//").append(authority);
+  ret.append(path);
+  if(has_query)
+    ret.append("?").append(query);
+  if(has_fragment)
+    ret.append("#").append(fragment);
+
+  return ret;
+}
+
+/**
+ * Same as the regex in RFC 3986 appendix B
+ *   ^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\?([^#]*))?(#(.*))?
+ * but additionally the scheme has to be valid (see RFC 3986 section 3.1),
+ * otherwise "1:2" would have the scheme "1".
+ */
+auto parse_url(std::string_view ref) -> url_t
+{
+  url_t url;
+
+  size_t const schemelen = scheme_length(ref);
+  if(schemelen > 0)
+  {
+    url.scheme = ref.substr(0, schemelen);
+    ref.remove_prefix(schemelen + 1); // +1 for ':'
+  }
+
+  if(ref.starts_with("//"))
+  {
+    ref.remove_prefix(2);
+    size_t const end = std::min(ref.find_first_of("/?#"), ref.length());
+    url.authority = ref.substr(0, end);
+    url.has_authority = true;
+    ref.remove_prefix(end);
+  }
+
+  {
+    size_t const end = std::min(ref.find_first_of("?#"), ref.length());
+    url.path = ref.substr(0, end);
+    ref.remove_prefix(end);
+  }
+
+  if(ref.starts_with('?'))
+  {
+    ref.remove_prefix(1);
+    size_t const end = std::min(ref.find('#'), ref.length());
+    url.query = ref.substr(0, end);
+    url.has_query = true;
+    ref.remove_prefix(end);
+  }
+
+  if(ref.starts_with('#'))
+  {
+    url.fragment = ref.substr(1);
+    url.has_fragment = true;
+  }
+
+  return url;
+}
+
+auto is_absolute_url(std::string_view ref) -> bool
+{
+  return scheme_length(ref) > 0;
+}
+
+//! Returns the length of the scheme without the ':' or 0 if there is none.
+//! scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) ":"
+auto scheme_length(std::string_view ref) -> size_t
+{
+  if(ref.empty() or not std::isalpha(static_cast<unsigned char>(ref[0])))
+    return 0;
+
+  for(size_t i=1; i<ref.length(); i++)
+  {
+    char const c = ref[i];
+    if(c == ':')
+      return i;
+    if(not std::isalnum(static_cast<unsigned char>(c)) and c != '+' and c != '-' and c != '.')
+      return 0;
+  }
+
+  return 0;
+}
+
+auto remove_dot_segments(std::string_view in) -> std::string
+{
+  std::string out = "";
+  out.reserve(in.length());
+
+  auto remove_last_segment = [&out]()
+  {
+    size_t const pos = out.rfind('/');
+    out.erase(pos != std::string::npos ? pos : 0);
+  };
+
+  while(not in.empty())
+  {
+    // A
+    if(in.starts_with("../"))
+      in.remove_prefix(3);
+    else if(in.starts_with("./"))
+      in.remove_prefix(2);
+    // B
+    else if(in.starts_with("/./"))
+      in.remove_prefix(2);
+    else if(in == "/.")
+      in = "/";
+    // C
+    else if(in.starts_with("/../"))
+    {
+      in.remove_prefix(3);
+      remove_last_segment();
+    }
+    else if(in == "/..")
+    {
+      in = "/";
+      remove_last_segment();
+    }
+    // D
+    else if(in == "." or in == "..")
+      in = "";
+    // E
+    else
+    {
+      size_t const end = std::min(in.find('/', 1), in.length());
+      out.append(in.substr(0, end));
+      in.remove_prefix(end);
+    }
+  }
+
+  return out;
+}
+
+//! See RFC 3986 section 5.2.3.
+auto merge_paths(url_t const& base, std::string_view path) -> std::string
+{
+  if(base.has_authority and base.path.empty())
+    return std::string{"/"}.append(path);
+
+  size_t const pos = base.path.rfind('/');
+  if(pos == std::string::npos)
+    return std::string{path};
+
+  return base.path.substr(0, pos+1).append(path);
+}
+
+auto resolve_url(url_t const& base, url_t const& ref) -> url_t
+{
+  url_t target;
+
+  if(not ref.scheme.empty())
+  {
+    target = ref;
+    target.path = remove_dot_segments(ref.path);
+    return target;
+  }
+  // else
+
+  if(ref.has_authority)
+  {
+    target.authority = ref.authority;
+    target.has_authority = true;
+    target.path = remove_dot_segments(ref.path);
+    target.query = ref.query;
+    target.has_query = ref.has_query;
+  }
+  else
+  {
+    if(ref.path.empty())
+    {
+      target.path = base.path;
+      target.query = ref.has_query ? ref.query : base.query;
+      target.has_query = ref.has_query or base.has_query;
+    }
+    else
+    {
+      target.path = ref.path.starts_with('/')
+        ? remove_dot_segments(ref.path)
+        : remove_dot_segments(merge_paths(base, ref.path));
+      target.query = ref.query;
+      target.has_query = ref.has_query;
+    }
+
+    target.authority = base.authority;
+    target.has_authority = base.has_authority;
+  }
+
+  target.scheme = base.scheme;
+  target.fragment = ref.fragment;
+  target.has_fragment = ref.has_fragment;
+
+  return target;
+}
+
+auto resolve_url(std::string_view base, std::string_view ref) -> std::string
+{
+  return resolve_url(parse_url(base), parse_url(ref)).str();
+}
+
+// ---
+
+url_resolver_t::url_resolver_t(std::string_view base)
+  : m_base{parse_url(base)}
+{
+  assert(not m_base.scheme.empty() and "base-url has to be absolute");
+}
+
+auto url_resolver_t::resolve(std::string_view ref) const -> std::string
+{
+  return resolve_url(m_base, parse_url(ref)).str();
+}
+
+void url_resolver_t::resolve(std::vector<std::string>& refs) const
+{
+  for(auto& ref : refs)
+    ref = resolve(ref);
+}
@@ -0,0 +1,64 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// Hand-written parser and reference-resolver for URLs (without std::regex).
+// The spec is https://datatracker.ietf.org/doc/html/rfc3986.
+//
+
+//! The components of an URI-reference (see RFC 3986 section 3).
+//! An undefined component is different from an empty one,
+//! e.g. "http://host/?" has an empty query whereas "http://host/" has none.
+struct url_t
+{
+  std::string scheme = "";
+  std::string authority = "";
+  std::string path = "";
+  std::string query = "";
+  std::string fragment = "";
+
+  bool has_authority = false;
+  bool has_query = false;
+  bool has_fragment = false;
+
+  //! Recompose the components into an URI-reference (see RFC 3986 section 5.3).
+  auto str() const -> std::string;
+};
+
+//! Split an URI-reference into its components (see RFC 3986 appendix B).
+//! This never fails, every string is a valid URI-reference in this sense.
+auto parse_url(std::string_view ref) -> url_t;
+
+//! An url is absolute if it starts with a scheme (e.g. "https:").
+auto is_absolute_url(std::string_view ref) -> bool;
+
+//! Remove "." and ".." segments from a path (see RFC 3986 section 5.2.4).
+auto remove_dot_segments(std::string_view path) -> std::string;
+
+//! Resolve a reference against a base-url (see RFC 3986 section 5.2.2).
+auto resolve_url(url_t const& base, url_t const& ref) -> url_t;
+auto resolve_url(std::string_view base, std::string_view ref) -> std::string;
+
+//! Resolves many references against the same base-url.
+//! The base-url is parsed only once, which matters for playlists with thousands of segments.
+class url_resolver_t
+{
+public:
+
+  explicit url_resolver_t(std::string_view base);
+
+  auto resolve(std::string_view ref) const -> std::string;
+
+  //! Resolve all urls in-place.
+  void resolve(std::vector<std::string>& refs) const;
+
+  inline auto base() const -> url_t const& { return m_base; }
+
+
+private:
+
+  url_t m_base;
+};
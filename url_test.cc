@@ -0,0 +1,136 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "m3u8.h"
+#include "url.h"
+
+TEST(url_tests, parse_url)
+{
+  url_t const url = parse_url("https://user@server:8080/dir/file.m3u8?token=abc#frag");
+
+  EXPECT_EQ(url.scheme, "https");
+  EXPECT_TRUE(url.has_authority);
+  EXPECT_EQ(url.authority, "user@server:8080");
+  EXPECT_EQ(url.path, "/dir/file.m3u8");
+  EXPECT_TRUE(url.has_query);
+  EXPECT_EQ(url.query, "token=abc");
+  EXPECT_TRUE(url.has_fragment);
+  EXPECT_EQ(url.fragment, "frag");
+
+  EXPECT_EQ(url.str(), "https://user@server:8080/dir/file.m3u8?token=abc#frag");
+
+  // ---
+
+  url_t const relative = parse_url("segment-1.ts");
+
+  EXPECT_TRUE(relative.scheme.empty());
+  EXPECT_FALSE(relative.has_authority);
+  EXPECT_EQ(relative.path, "segment-1.ts");
+  EXPECT_FALSE(relative.has_query);
+  EXPECT_FALSE(relative.has_fragment);
+}
+
+TEST(url_tests, is_absolute_url)
+{
+  EXPECT_TRUE(is_absolute_url("https://server/path"));
+  EXPECT_TRUE(is_absolute_url("g:h"));
+
+  EXPECT_FALSE(is_absolute_url("//server/path"));
+  EXPECT_FALSE(is_absolute_url("/path:with:colons"));
+  EXPECT_FALSE(is_absolute_url("1:2"));
+  EXPECT_FALSE(is_absolute_url(""));
+}
+
+TEST(url_tests, remove_dot_segments)
+{
+  EXPECT_EQ(remove_dot_segments("/a/b/c/./../../g"), "/a/g");
+  EXPECT_EQ(remove_dot_segments("mid/content=5/../6"), "mid/6");
+}
+
+// Examples from RFC 3986 section 5.4.
+TEST(url_tests, resolve_url_normal)
+{
+  std::string const base = "http://a/b/c/d;p?q";
+
+  EXPECT_EQ(resolve_url(base, "g:h"),     "g:h");
+  EXPECT_EQ(resolve_url(base, "g"),       "http://a/b/c/g");
+  EXPECT_EQ(resolve_url(base, "./g"),     "http://a/b/c/g");
+  EXPECT_EQ(resolve_url(base, "g/"),      "http://a/b/c/g/");
+  EXPECT_EQ(resolve_url(base, "/g"),      "http://a/g");
+  EXPECT_EQ(resolve_url(base, "//g"),     "http://g");
+  EXPECT_EQ(resolve_url(base, "?y"),      "http://a/b/c/d;p?y");
+  EXPECT_EQ(resolve_url(base, "g?y"),     "http://a/b/c/g?y");
+  EXPECT_EQ(resolve_url(base, "#s"),      "http://a/b/c/d;p?q#s");
+  EXPECT_EQ(resolve_url(base, "g#s"),     "http://a/b/c/g#s");
+  EXPECT_EQ(resolve_url(base, "g?y#s"),   "http://a/b/c/g?y#s");
+  EXPECT_EQ(resolve_url(base, ";x"),      "http://a/b/c/;x");
+  EXPECT_EQ(resolve_url(base, "g;x"),     "http://a/b/c/g;x");
+  EXPECT_EQ(resolve_url(base, "g;x?y#s"), "http://a/b/c/g;x?y#s");
+  EXPECT_EQ(resolve_url(base, ""),        "http://a/b/c/d;p?q");
+  EXPECT_EQ(resolve_url(base, "."),       "http://a/b/c/");
+  EXPECT_EQ(resolve_url(base, "./"),      "http://a/b/c/");
+  EXPECT_EQ(resolve_url(base, ".."),      "http://a/b/");
+  EXPECT_EQ(resolve_url(base, "../"),     "http://a/b/");
+  EXPECT_EQ(resolve_url(base, "../g"),    "http://a/b/g");
+  EXPECT_EQ(resolve_url(base, "../.."),   "http://a/");
+  EXPECT_EQ(resolve_url(base, "../../"),  "http://a/");
+  EXPECT_EQ(resolve_url(base, "../../g"), "http://a/g");
+}
+
+TEST(url_tests, resolve_url_abnormal)
+{
+  std::string const base = "http://a/b/c/d;p?q";
+
+  EXPECT_EQ(resolve_url(base, "../../../g"),    "http://a/g");
+  EXPECT_EQ(resolve_url(base, "../../../../g"), "http://a/g");
+  EXPECT_EQ(resolve_url(base, "/./g"),          "http://a/g");
+  EXPECT_EQ(resolve_url(base, "/../g"),         "http://a/g");
+  EXPECT_EQ(resolve_url(base, "g."),            "http://a/b/c/g.");
+  EXPECT_EQ(resolve_url(base, ".g"),            "http://a/b/c/.g");
+  EXPECT_EQ(resolve_url(base, "g.."),           "http://a/b/c/g..");
+  EXPECT_EQ(resolve_url(base, "..g"),           "http://a/b/c/..g");
+  EXPECT_EQ(resolve_url(base, "./../g"),        "http://a/b/g");
+  EXPECT_EQ(resolve_url(base, "./g/."),         "http://a/b/c/g/");
+  EXPECT_EQ(resolve_url(base, "g/./h"),         "http://a/b/c/g/h");
+  EXPECT_EQ(resolve_url(base, "g/../h"),        "http://a/b/c/h");
+  EXPECT_EQ(resolve_url(base, "g;x=1/./y"),     "http://a/b/c/g;x=1/y");
+  EXPECT_EQ(resolve_url(base, "g;x=1/../y"),    "http://a/b/c/y");
+  EXPECT_EQ(resolve_url(base, "g?y/./x"),       "http://a/b/c/g?y/./x");
+  EXPECT_EQ(resolve_url(base, "g#s/../x"),      "http://a/b/c/g#s/../x");
+}
+
+TEST(url_tests, url_resolver)
+{
+  url_resolver_t const resolver{"https://server/dir/master.m3u8?token=abc"};
+
+  EXPECT_EQ(resolver.resolve("segment1.ts"), "https://server/dir/segment1.ts");
+  EXPECT_EQ(resolver.resolve("/path/index.m3u8"), "https://server/path/index.m3u8");
+  EXPECT_EQ(resolver.resolve("../other/index.m3u8"), "https://server/other/index.m3u8");
+  EXPECT_EQ(resolver.resolve("https://cdn/segment1.ts"), "https://cdn/segment1.ts");
+
+  std::vector<std::string> urls = {"a.ts", "sub/b.ts"};
+  resolver.resolve(urls);
+
+  ASSERT_EQ(urls.size(), 2);
+  EXPECT_EQ(urls[0], "https://server/dir/a.ts");
+  EXPECT_EQ(urls[1], "https://server/dir/sub/b.ts");
+}
+
+TEST(url_tests, m3u8_resolve_urls)
+{
+  std::vector<urlprops_t> const urls = {
+    urlprops_t{"https://server/path1", {}},
+    urlprops_t{"/path2/index.m3u8", {}},
+    urlprops_t{"segment3.ts", {}},
+  };
+
+  m3u8_t m3u8{urls};
+
+  m3u8.resolve_urls("https://host/dir/master.m3u8");
+
+  ASSERT_EQ(m3u8.get_urls().size(), 3);
+  EXPECT_EQ(m3u8.get_url(0).url, "https://server/path1");
+  EXPECT_EQ(m3u8.get_url(1).url, "https://host/path2/index.m3u8");
+  EXPECT_EQ(m3u8.get_url(2).url, "https://host/dir/segment3.ts");
+  EXPECT_FALSE(m3u8.contains_relative_urls());
+}
@@ -0,0 +1,450 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::ranges::max_element, std::ranges::find, std::ranges::stable_sort, std::max
+#include <cassert>
+#include <charconv> // std::from_chars
+#include <format>
+#include <iterator> // std::distance
+
+#include "json.h"
+#include "string_util.h"
+#include "variant.h"
+
+// Only use this fraction of the measured throughput, so there is some headroom for fluctuations.
+static constexpr double HEADROOM = 0.8;
+// Switching up needs more headroom than staying, otherwise it would switch back and forth.
+static constexpr double HEADROOM_UP = 0.6;
+
+// The variant_switcher_t averages the throughput of the finished downloads with this half-life in seconds.
+static constexpr double THROUGHPUT_HALF_LIFE = 5.0;
+// Don't switch before this many downloads are finished ...
+static constexpr size_t MIN_FINISHED = 3;
+// ... and stay at least this many segments with a variant before switching up.
+static constexpr size_t MIN_DWELL = 5;
+
+
+template<typename T>
+static auto parse_integer(std::string_view str) -> std::optional<T>;
+
+// ---
+
+auto variant_t::str() const -> std::string
+{
+  std::string ret = "";
+
+  if(width > 0 and height > 0)
+    ret += std::format("{}x{} ", width, height);
+  if(bandwidth > 0)
+    ret += std::format("{} kbit/s ", bandwidth/1'000);
+  if(not codecs.empty())
+  {
+    std::string codecs_str = "";
+    for(auto const& codec : codecs)
+      codecs_str += (codecs_str.empty() ? "" : ",") + codec;
+    ret += std::format("({}) ", codecs_str);
+  }
+
+  return trim(ret);
+}
+
+auto parse_variants(m3u8_t const& master) -> std::vector<variant_t>
+{
+  std::vector<variant_t> variants = {};
+
+  auto const& urls = master.get_urls();
+  for(size_t i=0; i<urls.size(); i++)
+  {
+    auto const& props = urls[i].properties;
+
+    variant_t variant;
+    variant.index = i;
+    variant.url = urls[i].url;
+
+    if(props.contains("BANDWIDTH"))
+      variant.bandwidth = parse_integer<uint64_t>(props.at("BANDWIDTH")).value_or(0);
+
+    if(props.contains("RESOLUTION"))
+    {
+      auto const resolution = parse_resolution(props.at("RESOLUTION"));
+      if(resolution.has_value())
+        std::tie(variant.width, variant.height) = resolution.value();
+    }
+
+    if(props.contains("CODECS"))
+    {
+      for(auto const& codec : tokenize(props.at("CODECS"), ','))
+        variant.codecs.push_back(trim(codec));
+    }
+
+    if(props.contains("AUDIO"))
+      variant.audio = props.at("AUDIO");
+    if(props.contains("SUBTITLES"))
+      variant.subtitles = props.at("SUBTITLES");
+    if(props.contains("PATHWAY-ID"))
+      variant.pathway = props.at("PATHWAY-ID");
+
+    variants.push_back(variant);
+  }
+
+  return variants;
+}
+
+auto parse_renditions(m3u8_t const& master) -> std::vector<rendition_t>
+{
+  std::vector<rendition_t> renditions = {};
+
+  auto const& media = master.get_media();
+  for(size_t i=0; i<media.size(); i++)
+  {
+    auto const& props = media[i].properties;
+    auto property = [&props](std::string const& key) { return props.contains(key) ? props.at(key) : ""; };
+
+    rendition_t rendition;
+    rendition.index = i;
+    rendition.url = media[i].url;
+    rendition.type = property("TYPE");
+    rendition.group_id = property("GROUP-ID");
+    rendition.name = property("NAME");
+    rendition.language = property("LANGUAGE");
+    rendition.is_default = property("DEFAULT") == "YES";
+    rendition.autoselect = property("AUTOSELECT") == "YES";
+
+    renditions.push_back(rendition);
+  }
+
+  return renditions;
+}
+
+auto select_rendition(std::vector<rendition_t> const& renditions, std::string const& type, std::string const& group_id)
+  -> std::optional<size_t>
+{
+  std::optional<size_t> first = {};
+  std::optional<size_t> autoselect = {};
+
+  for(size_t i=0; i<renditions.size(); i++)
+  {
+    auto const& rendition = renditions[i];
+    if(rendition.type != type or rendition.group_id != group_id)
+      continue;
+
+    if(rendition.is_default)
+      return i;
+    if(rendition.autoselect and not autoselect.has_value())
+      autoselect = i;
+    if(not first.has_value())
+      first = i;
+  }
+
+  return autoselect.has_value() ? autoselect : first;
+}
+
+auto redundant_variants(std::vector<variant_t> const& variants, size_t picked,
+    std::vector<std::string> const& priority) -> std::vector<size_t>
+{
+  assert(picked < variants.size());
+  auto const& p = variants[picked];
+
+  std::vector<size_t> redundant = {picked};
+  for(size_t v=0; v<variants.size(); v++)
+  {
+    auto const& variant = variants[v];
+    if(v != picked and variant.url != p.url and variant.bandwidth == p.bandwidth and variant.width == p.width
+        and variant.height == p.height and variant.codecs == p.codecs and variant.audio == p.audio
+        and variant.subtitles == p.subtitles)
+      redundant.push_back(v);
+  }
+
+  if(not priority.empty())
+  {
+    auto rank = [&](size_t v)
+    {
+      auto const it = std::ranges::find(priority, variants[v].pathway);
+      return static_cast<size_t>(std::distance(priority.begin(), it));
+    };
+    std::ranges::stable_sort(redundant, {}, rank);
+  }
+
+  return redundant;
+}
+
+auto parse_steering_manifest(std::string_view manifest) -> std::optional<std::vector<std::string>>
+{
+  auto const json = parse_json(manifest);
+  if(not json.has_value())
+    return {};
+
+  auto const priority = json->get("PATHWAY-PRIORITY");
+  if(not priority.has_value() or not priority->is_array())
+    return {};
+
+  std::vector<std::string> pathways = {};
+  for(auto const& pathway : priority->as_array())
+  {
+    if(not pathway.is_string())
+      return {};
+    pathways.push_back(pathway.as_string());
+  }
+
+  return pathways;
+}
+
+auto parse_resolution(std::string const& resolution) -> std::optional<std::tuple<uint32_t, uint32_t>>
+{
+  auto const pos = resolution.find('x');
+  if(pos == std::string::npos)
+    return {};
+
+  auto const width  = parse_integer<uint32_t>(std::string_view{resolution}.substr(0, pos));
+  auto const height = parse_integer<uint32_t>(std::string_view{resolution}.substr(pos+1));
+  if(not width.has_value() or not height.has_value())
+    return {};
+
+  return std::make_tuple(width.value(), height.value());
+}
+
+auto parse_variant_policy(std::string const& policy) -> std::optional<variant_policy_t>
+{
+  if(policy == "ask")
+    return variant_policy_t::ask;
+  else if(policy == "auto")
+    return variant_policy_t::automatic;
+  else if(policy == "max-resolution")
+    return variant_policy_t::max_resolution;
+  else if(policy == "max-bandwidth")
+    return variant_policy_t::max_bandwidth;
+  else if(policy == "min-bandwidth")
+    return variant_policy_t::min_bandwidth;
+
+  return {};
+}
+
+auto select_variant(std::vector<variant_t> const& variants, variant_policy_t policy) -> std::optional<size_t>
+{
+  assert(policy != variant_policy_t::ask and policy != variant_policy_t::automatic);
+
+  if(variants.empty())
+    return {};
+
+  // Ties are broken by the other property (resolution <-> bandwidth).
+  auto by_resolution = [](variant_t const& a, variant_t const& b)
+    { return std::make_tuple(a.pixels(), a.bandwidth) < std::make_tuple(b.pixels(), b.bandwidth); };
+  auto by_bandwidth = [](variant_t const& a, variant_t const& b)
+    { return std::make_tuple(a.bandwidth, a.pixels()) < std::make_tuple(b.bandwidth, b.pixels()); };
+
+  std::vector<variant_t>::const_iterator it = variants.end();
+  switch(policy)
+  {
+    case variant_policy_t::max_resolution:
+      it = std::ranges::max_element(variants, by_resolution);
+      break;
+
+    case variant_policy_t::max_bandwidth:
+      it = std::ranges::max_element(variants, by_bandwidth);
+      break;
+
+    case variant_policy_t::min_bandwidth:
+      it = std::ranges::min_element(variants, by_bandwidth);
+      break;
+
+    default:
+      return {};
+  }
+
+  return std::distance(variants.begin(), it);
+}
+
+auto select_variant(std::vector<variant_t> const& variants, double throughput, double duration,
+    std::optional<double> deadline) -> std::optional<size_t>
+{
+  assert(throughput >= 0.0);
+  assert(duration >= 0.0);
+
+  if(variants.empty())
+    return {};
+
+  // Download-time is bandwidth/8 * duration / throughput, which has to be less than the deadline.
+  double const time = deadline.has_value() ? deadline.value() : duration;
+  double const max_bandwidth = duration > 0.0
+    ? HEADROOM * throughput * 8.0 * time / duration
+    : HEADROOM * throughput * 8.0;
+
+  std::optional<size_t> best = {};
+  for(size_t i=0; i<variants.size(); i++)
+  {
+    auto const& variant = variants[i];
+    if(static_cast<double>(variant.bandwidth) > max_bandwidth)
+      continue;
+
+    if(not best.has_value()
+        or std::make_tuple(variant.bandwidth, variant.pixels())
+         > std::make_tuple(variants[best.value()].bandwidth, variants[best.value()].pixels()))
+      best = i;
+  }
+
+  if(not best.has_value()) // Nothing fits, so take the smallest.
+    return select_variant(variants, variant_policy_t::min_bandwidth);
+
+  return best;
+}
+
+auto playlist_duration(m3u8_t const& playlist) -> double
+{
+  double duration = 0.0;
+
+  for(auto const& url : playlist.get_urls())
+    duration += parse_runtime(url);
+
+  return duration;
+}
+
+auto parse_runtime(urlprops_t const& url) -> double
+{
+  if(not url.properties.contains("RUNTIME"))
+    return 0.0;
+
+  std::string const& runtime = url.properties.at("RUNTIME");
+
+  double seconds = 0.0;
+  auto const [_, errc] = std::from_chars(runtime.data(), runtime.data() + runtime.size(), seconds);
+  if(errc != std::errc{} or seconds < 0.0)
+    return 0.0;
+
+  return seconds;
+}
+
+// ---
+
+variant_switcher_t::variant_switcher_t(std::vector<variant_t> const& variants, std::vector<m3u8_t> const& playlists,
+    size_t start, std::optional<double> deadline, clock::time_point now)
+  : m_variants{variants}, m_playlists{playlists}, m_segment_by_sequence(playlists.size()),
+    m_deadline{deadline}, m_start{now}, m_start_variant{start}, m_current{start},
+    m_throughput{THROUGHPUT_HALF_LIFE, now}
+{
+  assert(variants.size() == playlists.size());
+  assert(start < variants.size());
+
+  for(size_t v=0; v<m_playlists.size(); v++)
+  {
+    auto const& urls = m_playlists[v].get_urls();
+    for(size_t i=0; i<urls.size(); i++)
+    {
+      if(urls[i].properties.contains("MEDIA-SEQUENCE"))
+        m_segment_by_sequence[v][std::stoull(urls[i].properties.at("MEDIA-SEQUENCE"))] = i;
+    }
+  }
+
+  auto const& urls = m_playlists[start].get_urls();
+  m_sequences.resize(urls.size());
+  m_remaining.resize(urls.size() + 1, 0.0);
+  for(size_t i=urls.size(); i-- > 0;)
+  {
+    m_sequences[i] = urls[i].properties.contains("MEDIA-SEQUENCE")
+      ? std::stoull(urls[i].properties.at("MEDIA-SEQUENCE"))
+      : i;
+    m_remaining[i] = m_remaining[i+1] + parse_runtime(urls[i]);
+  }
+}
+
+void variant_switcher_t::finished(size_t bytes, clock::time_point now)
+{
+  m_finished++;
+  m_throughput.add(bytes, now);
+}
+
+auto variant_switcher_t::throughput(clock::time_point now) const -> std::optional<double>
+{
+  if(m_finished < MIN_FINISHED)
+    return {};
+
+  return m_throughput.rate(now);
+}
+
+auto variant_switcher_t::segment_of(size_t variant, size_t index) const -> std::optional<size_t>
+{
+  auto const& by_sequence = m_segment_by_sequence[variant];
+  auto const it = by_sequence.find(m_sequences[index]);
+  if(it == by_sequence.end())
+    return {};
+  return it->second;
+}
+
+auto variant_switcher_t::select(size_t index, clock::time_point now) -> std::tuple<size_t, urlprops_t const&>
+{
+  assert(index < m_sequences.size());
+
+  auto const measured = throughput(now);
+  if(measured.has_value() and m_remaining[index] > 0.0)
+  {
+    double const elapsed = std::chrono::duration<double>(now - m_start).count();
+    double const time_left = m_deadline.has_value()
+      ? std::max(m_deadline.value() - elapsed, 1.0)
+      : m_remaining[index]; // at least in real time
+
+    // The bandwidth (in bits/s) of a variant, that can be downloaded in the time left.
+    double const sustainable = measured.value() * 8.0 * time_left / m_remaining[index];
+
+    auto fits = [&](size_t v, double headroom)
+      { return static_cast<double>(m_variants[v].bandwidth) <= headroom * sustainable; };
+
+    // The best variant, that fits and has this segment.
+    auto best_fitting = [&](double headroom) -> std::optional<size_t>
+    {
+      std::optional<size_t> best = {};
+      for(size_t v=0; v<m_variants.size(); v++)
+      {
+        if(not fits(v, headroom) or not segment_of(v, index).has_value())
+          continue;
+        if(not best.has_value() or m_variants[v].bandwidth > m_variants[best.value()].bandwidth)
+          best = v;
+      }
+      return best;
+    };
+
+    std::optional<size_t> next = {};
+    if(not fits(m_current, HEADROOM)) // down
+    {
+      next = best_fitting(HEADROOM);
+      if(not next.has_value()) // Nothing fits, so take the smallest.
+      {
+        for(size_t v=0; v<m_variants.size(); v++)
+          if(segment_of(v, index).has_value()
+              and (not next.has_value() or m_variants[v].bandwidth < m_variants[next.value()].bandwidth))
+            next = v;
+      }
+    }
+    else if(index >= m_last_switch + MIN_DWELL) // up
+    {
+      next = best_fitting(HEADROOM_UP);
+      if(next.has_value() and m_variants[next.value()].bandwidth <= m_variants[m_current].bandwidth)
+        next = {};
+    }
+
+    if(next.has_value() and next.value() != m_current)
+    {
+      m_current = next.value();
+      m_last_switch = index;
+      m_switches++;
+    }
+  }
+
+  // Without a matching segment in the current variant, fall back to the starting one (which has all).
+  size_t variant = m_current;
+  auto segment = segment_of(variant, index);
+  if(not segment.has_value())
+  {
+    variant = m_start_variant;
+    segment = index;
+  }
+
+  m_used.insert(variant);
+  return {variant, m_playlists[variant].get_url(segment.value())};
+}
+
+template<typename T>
+auto parse_integer(std::string_view str) -> std::optional<T>
+{
+  T value = 0;
+  auto const [end, errc] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if(errc != std::errc{} or end != str.data() + str.size())
+    return {};
+  return value;
+}
@@ -0,0 +1,167 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <chrono>
+#include <cstdint> // uint32_t, uint64_t
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "m3u8.h"
+#include "throughput.h"
+
+//
+// Non-interactive selection of a variant (playlist) of a master m3u8-file.
+//
+
+//! The typed properties of an #EXT-X-STREAM-INF entry.
+struct variant_t
+{
+  size_t index = 0; // index of the url in the master m3u8-file
+  std::string url = "";
+
+  uint64_t bandwidth = 0; // in bits per second
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<std::string> codecs = {};
+
+  // GROUP-IDs of the alternative renditions (#EXT-X-MEDIA) to play with this variant (or empty).
+  std::string audio = "";
+  std::string subtitles = "";
+
+  std::string pathway = ""; // PATHWAY-ID for content steering (or empty)
+
+  inline auto pixels() const -> uint64_t { return static_cast<uint64_t>(width)*height; }
+
+  //! e.g. "1280x720 2999 kbit/s (mp4a.40.2,avc1.64001f)"
+  auto str() const -> std::string;
+};
+
+//! The typed properties of an #EXT-X-MEDIA entry (an alternative rendition).
+struct rendition_t
+{
+  size_t index = 0; // index of the entry in the media of the master m3u8-file
+  std::string url = ""; // empty if the rendition is contained in the variant stream
+
+  std::string type = ""; // AUDIO, VIDEO, SUBTITLES or CLOSED-CAPTIONS
+  std::string group_id = "";
+  std::string name = "";
+  std::string language = "";
+  bool is_default = false;
+  bool autoselect = false;
+};
+
+enum class variant_policy_t
+{
+  ask,            // let the user pick interactively
+  automatic,      // best variant that fits the measured throughput (and deadline)
+  max_resolution,
+  max_bandwidth,
+  min_bandwidth,
+};
+
+auto parse_variants(m3u8_t const& master) -> std::vector<variant_t>;
+
+auto parse_renditions(m3u8_t const& master) -> std::vector<rendition_t>;
+
+//! Returns the position in renditions of the rendition of the type and group, that a player would play:
+//! The one with DEFAULT=YES, otherwise the first with AUTOSELECT=YES, otherwise the first one.
+auto select_rendition(std::vector<rendition_t> const& renditions, std::string const& type, std::string const& group_id)
+  -> std::optional<size_t>;
+
+//! Returns the positions in variants of the redundant variants of the picked one (itself included):
+//! Same bandwidth, resolution, codecs and renditions, but another url (e.g. on another CDN).
+//! They are ordered by the pathway-priority of content steering (unknown pathways last),
+//! without priority the picked one comes first and the others in the order of the master m3u8-file.
+auto redundant_variants(std::vector<variant_t> const& variants, size_t picked,
+    std::vector<std::string> const& priority = {}) -> std::vector<size_t>;
+
+//! Parse the PATHWAY-PRIORITY of a content steering manifest (JSON) e.g.
+//! {"VERSION":1,"TTL":300,"PATHWAY-PRIORITY":["CDN-B","CDN-A"]}.
+auto parse_steering_manifest(std::string_view manifest) -> std::optional<std::vector<std::string>>;
+
+//! Parse "WIDTHxHEIGHT" e.g. "1280x720".
+auto parse_resolution(std::string const& resolution) -> std::optional<std::tuple<uint32_t, uint32_t>>;
+
+//! Parse "ask", "auto", "max-resolution", "max-bandwidth" or "min-bandwidth".
+auto parse_variant_policy(std::string const& policy) -> std::optional<variant_policy_t>;
+
+//! Returns the position in variants of the variant picked by the policy.
+//! Not for the policies ask and automatic, see below for automatic.
+auto select_variant(std::vector<variant_t> const& variants, variant_policy_t policy) -> std::optional<size_t>;
+
+//! Returns the position in variants of the variant with the highest bandwidth,
+//! that can be downloaded with the given throughput (in bytes/s) in time.
+//! In time means within the deadline (in seconds) if given or otherwise at least in real time.
+//! The duration (in seconds) is the playtime of the variant.
+//! If no variant fits, the one with the lowest bandwidth is picked.
+auto select_variant(std::vector<variant_t> const& variants, double throughput, double duration,
+    std::optional<double> deadline) -> std::optional<size_t>;
+
+//! Sum of the #EXTINF-runtimes of a playlist in seconds.
+auto playlist_duration(m3u8_t const& playlist) -> double;
+
+//! The #EXTINF-runtime of a segment in seconds (or 0 if unknown).
+auto parse_runtime(urlprops_t const& url) -> double;
+
+/**
+ * Switches between the variants at segment boundaries during the download,
+ * so that the download finishes within the deadline (or at least in real time).
+ * When the measured throughput can't sustain the current variant anymore it switches down
+ * and when there is enough headroom it switches up again.
+ *
+ * The segments of the variants are aligned by their media sequence number,
+ * which requires #EXT-X-INDEPENDENT-SEGMENTS in the master m3u8-file.
+ */
+class variant_switcher_t
+{
+public:
+
+  using clock = std::chrono::steady_clock;
+
+  //! playlists[i] is the playlist of variants[i] and start is the position of the variant to start with.
+  //! The segments are numbered as in the playlist of the starting variant.
+  variant_switcher_t(std::vector<variant_t> const& variants, std::vector<m3u8_t> const& playlists, size_t start,
+      std::optional<double> deadline, clock::time_point now = clock::now());
+
+  //! Record a finished download (for measuring the throughput).
+  void finished(size_t bytes, clock::time_point now = clock::now());
+
+  //! Returns the variant (position in variants) and its segment to download as segment index.
+  auto select(size_t index, clock::time_point now = clock::now()) -> std::tuple<size_t, urlprops_t const&>;
+
+  //! Measured throughput in bytes/s (if there were enough downloads yet).
+  auto throughput(clock::time_point now = clock::now()) const -> std::optional<double>;
+
+  inline auto playlists() const -> std::vector<m3u8_t> const& { return m_playlists; }
+  inline auto segments() const -> size_t { return m_sequences.size(); }
+  inline auto switches() const -> size_t { return m_switches; }
+  inline auto used_variants() const -> std::set<size_t> const& { return m_used; }
+
+
+private:
+
+  auto segment_of(size_t variant, size_t index) const -> std::optional<size_t>;
+
+  std::vector<variant_t> m_variants;
+  std::vector<m3u8_t> m_playlists;
+  std::vector<std::map<uint64_t, size_t>> m_segment_by_sequence; // per variant: media sequence -> segment
+
+  std::vector<uint64_t> m_sequences;  // media sequence of the segments of the starting variant
+  std::vector<double> m_remaining;    // remaining duration (in seconds) from segment i to the end
+
+  std::optional<double> m_deadline;
+  clock::time_point m_start;
+
+  size_t m_start_variant;
+  size_t m_current;
+  size_t m_last_switch = 0; // segment-index of the last switch
+  size_t m_switches = 0;
+  std::set<size_t> m_used = {};
+
+  size_t m_finished = 0;
+  throughput_t m_throughput; // of the finished downloads
+};
@@ -0,0 +1,244 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+#include <format>
+
+#include "variant.h"
+
+static std::string const master_str =
+  "#EXTM3U\n"
+  "#EXT-X-STREAM-INF:BANDWIDTH=2999153,CODECS=\"mp4a.40.2,avc1.64001f\",RESOLUTION=1280x720\n"
+  "/path2/index.m3u8\n"
+  "#EXT-X-STREAM-INF:BANDWIDTH=716090,CODECS=\"mp4a.40.2,avc1.42c01e\",RESOLUTION=640x360\n"
+  "/path1/index.m3u8\n"
+  "#EXT-X-STREAM-INF:BANDWIDTH=5627358,CODECS=\"mp4a.40.2,avc1.640028\",RESOLUTION=1920x1080\n"
+  "/path3/index.m3u8\n"
+;
+
+static auto master_variants() -> std::vector<variant_t>
+{
+  m3u8_t const master{std::vector<char>{master_str.begin(), master_str.end()}};
+  return parse_variants(master);
+}
+
+TEST(variant_tests, parse_variants)
+{
+  auto const variants = master_variants();
+
+  ASSERT_EQ(variants.size(), 3);
+
+  EXPECT_EQ(variants[0].index, 0);
+  EXPECT_EQ(variants[0].url, "/path2/index.m3u8");
+  EXPECT_EQ(variants[0].bandwidth, 2999153);
+  EXPECT_EQ(variants[0].width, 1280);
+  EXPECT_EQ(variants[0].height, 720);
+  ASSERT_EQ(variants[0].codecs.size(), 2);
+  EXPECT_EQ(variants[0].codecs[0], "mp4a.40.2");
+  EXPECT_EQ(variants[0].codecs[1], "avc1.64001f");
+
+  EXPECT_EQ(variants[0].str(), "1280x720 2999 kbit/s (mp4a.40.2,avc1.64001f)");
+}
+
+TEST(variant_tests, parse_resolution)
+{
+  EXPECT_EQ(parse_resolution("1920x1080"), std::make_tuple(1920u, 1080u));
+  EXPECT_FALSE(parse_resolution("1920").has_value());
+  EXPECT_FALSE(parse_resolution("axb").has_value());
+}
+
+TEST(variant_tests, renditions)
+{
+  std::string const master_str =
+    "#EXTM3U\n"
+    "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"low\",NAME=\"English\",LANGUAGE=\"en\",URI=\"low/en.m3u8\"\n"
+    "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"high\",NAME=\"English\",LANGUAGE=\"en\",AUTOSELECT=YES,URI=\"high/en.m3u8\"\n"
+    "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"high\",NAME=\"Deutsch\",LANGUAGE=\"de\",DEFAULT=YES,URI=\"high/de.m3u8\"\n"
+    "#EXT-X-MEDIA:TYPE=SUBTITLES,GROUP-ID=\"subs\",NAME=\"English\",LANGUAGE=\"en\",AUTOSELECT=YES,URI=\"subs/en.m3u8\"\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,AUDIO=\"low\"\n"
+    "/path1/index.m3u8\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=2999153,AUDIO=\"high\",SUBTITLES=\"subs\"\n"
+    "/path2/index.m3u8\n"
+  ;
+  m3u8_t const master{std::vector<char>{master_str.begin(), master_str.end()}};
+
+  auto const variants = parse_variants(master);
+  ASSERT_EQ(variants.size(), 2);
+  EXPECT_EQ(variants[0].audio, "low");
+  EXPECT_TRUE(variants[0].subtitles.empty());
+  EXPECT_EQ(variants[1].audio, "high");
+  EXPECT_EQ(variants[1].subtitles, "subs");
+
+  auto const renditions = parse_renditions(master);
+  ASSERT_EQ(renditions.size(), 4);
+  EXPECT_EQ(renditions[2].type, "AUDIO");
+  EXPECT_EQ(renditions[2].group_id, "high");
+  EXPECT_EQ(renditions[2].name, "Deutsch");
+  EXPECT_EQ(renditions[2].language, "de");
+  EXPECT_EQ(renditions[2].url, "high/de.m3u8");
+  EXPECT_TRUE(renditions[2].is_default);
+  EXPECT_FALSE(renditions[2].autoselect);
+
+  // Only one in the group -> that one.
+  EXPECT_EQ(select_rendition(renditions, "AUDIO", "low"), 0);
+  // DEFAULT=YES wins over AUTOSELECT=YES.
+  EXPECT_EQ(select_rendition(renditions, "AUDIO", "high"), 2);
+  EXPECT_EQ(select_rendition(renditions, "SUBTITLES", "subs"), 3);
+
+  EXPECT_FALSE(select_rendition(renditions, "AUDIO", "subs").has_value());
+  EXPECT_FALSE(select_rendition(renditions, "VIDEO", "low").has_value());
+}
+
+TEST(variant_tests, select_variant_policy)
+{
+  auto const variants = master_variants();
+
+  EXPECT_EQ(select_variant(variants, variant_policy_t::max_resolution), 2);
+  EXPECT_EQ(select_variant(variants, variant_policy_t::max_bandwidth), 2);
+  EXPECT_EQ(select_variant(variants, variant_policy_t::min_bandwidth), 1);
+
+  EXPECT_FALSE(select_variant({}, variant_policy_t::max_bandwidth).has_value());
+}
+
+TEST(variant_tests, select_variant_throughput)
+{
+  auto const variants = master_variants();
+
+  // 1 MB/s are 8 Mbit/s, with headroom enough for 5.6 Mbit/s.
+  EXPECT_EQ(select_variant(variants, 1'000'000.0, 600.0, {}), 2);
+
+  // 500 KB/s are 4 Mbit/s -> 3 Mbit/s.
+  EXPECT_EQ(select_variant(variants, 500'000.0, 600.0, {}), 0);
+
+  // Too slow for everything -> smallest.
+  EXPECT_EQ(select_variant(variants, 10'000.0, 600.0, {}), 1);
+
+  // With 500 KB/s 10 minutes of 5.6 Mbit/s take ~14 minutes, fits into a 20 minute deadline.
+  EXPECT_EQ(select_variant(variants, 500'000.0, 600.0, 1'200.0), 2);
+
+  // ... but not into a 5 minute deadline, there only 360p fits.
+  EXPECT_EQ(select_variant(variants, 500'000.0, 600.0, 300.0), 1);
+}
+
+TEST(variant_tests, playlist_duration)
+{
+  std::string const playlist_str =
+    "#EXTM3U\n"
+    "#EXTINF:10.5,\n"
+    "segment1.ts\n"
+    "#EXTINF:9.5,\n"
+    "segment2.ts\n"
+  ;
+  m3u8_t const playlist{std::vector<char>{playlist_str.begin(), playlist_str.end()}};
+
+  EXPECT_DOUBLE_EQ(playlist_duration(playlist), 20.0);
+}
+
+static auto make_playlist(uint64_t first_sequence, size_t segments, std::string const& prefix) -> m3u8_t
+{
+  std::string str = std::format("#EXTM3U\n#EXT-X-MEDIA-SEQUENCE:{}\n", first_sequence);
+  for(size_t i=0; i<segments; i++)
+    str += std::format("#EXTINF:10.0,\n{}{}.ts\n", prefix, first_sequence + i);
+  return m3u8_t{std::vector<char>{str.begin(), str.end()}};
+}
+
+TEST(variant_tests, variant_switcher)
+{
+  using namespace std::chrono_literals;
+
+  auto const variants = master_variants(); // 3 Mbit/s, 0.7 Mbit/s, 5.6 Mbit/s
+  std::vector<m3u8_t> const playlists = {
+    make_playlist(100, 60, "720p-"), make_playlist(100, 60, "360p-"), make_playlist(100, 60, "1080p-")};
+
+  auto const start = variant_switcher_t::clock::now();
+  variant_switcher_t switcher{variants, playlists, 0, {}, start};
+
+  // Without measurements it stays with the start-variant.
+  auto const [variant0, segment0] = switcher.select(0, start);
+  EXPECT_EQ(variant0, 0);
+  EXPECT_EQ(segment0.url, "720p-100.ts");
+
+  // 100 KB/s are 0.8 Mbit/s, too slow for 720p in real time -> down to 360p.
+  for(int i=1; i<=5; i++)
+    switcher.finished(100'000, start + i*1s);
+
+  auto const [variant1, segment1] = switcher.select(1, start + 5s);
+  EXPECT_EQ(variant1, 1);
+  EXPECT_EQ(segment1.url, "360p-101.ts");
+  EXPECT_EQ(switcher.switches(), 1);
+
+  // 2 MB/s are 16 Mbit/s, enough for 1080p, but only after staying some segments.
+  for(int i=6; i<=15; i++)
+    switcher.finished(2'000'000, start + i*1s);
+
+  auto const [variant2, _] = switcher.select(2, start + 15s);
+  EXPECT_EQ(variant2, 1);
+
+  auto const [variant6, segment6] = switcher.select(6, start + 15s);
+  EXPECT_EQ(variant6, 2);
+  EXPECT_EQ(segment6.url, "1080p-106.ts");
+
+  EXPECT_EQ(switcher.switches(), 2);
+  EXPECT_EQ(switcher.used_variants(), (std::set<size_t>{0, 1, 2}));
+}
+
+TEST(variant_tests, variant_switcher_unaligned)
+{
+  using namespace std::chrono_literals;
+
+  auto const variants = master_variants();
+  // The 360p-playlist starts later, so its segments for 100-109 are missing.
+  std::vector<m3u8_t> const playlists = {
+    make_playlist(100, 60, "720p-"), make_playlist(110, 50, "360p-"), make_playlist(100, 60, "1080p-")};
+
+  auto const start = variant_switcher_t::clock::now();
+  variant_switcher_t switcher{variants, playlists, 0, {}, start};
+
+  for(int i=1; i<=5; i++)
+    switcher.finished(10'000, start + i*1s);
+
+  // Too slow for anything, but 360p doesn't have segment 101, so stay with 720p.
+  auto const [variant1, segment1] = switcher.select(1, start + 5s);
+  EXPECT_EQ(variant1, 0);
+  EXPECT_EQ(segment1.url, "720p-101.ts");
+
+  auto const [variant10, segment10] = switcher.select(10, start + 5s);
+  EXPECT_EQ(variant10, 1);
+  EXPECT_EQ(segment10.url, "360p-110.ts");
+}
+
+TEST(variant_tests, redundant_variants)
+{
+  std::string const master_str =
+    "#EXTM3U\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,RESOLUTION=640x360,PATHWAY-ID=\"cdn-a\"\n"
+    "https://cdn-a.example.com/low/index.m3u8\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=2999153,RESOLUTION=1280x720,PATHWAY-ID=\"cdn-a\"\n"
+    "https://cdn-a.example.com/high/index.m3u8\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=716090,RESOLUTION=640x360,PATHWAY-ID=\"cdn-b\"\n"
+    "https://cdn-b.example.com/low/index.m3u8\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=2999153,RESOLUTION=1280x720,PATHWAY-ID=\"cdn-b\"\n"
+    "https://cdn-b.example.com/high/index.m3u8\n"
+  ;
+  m3u8_t const master{std::vector<char>{master_str.begin(), master_str.end()}};
+  auto const variants = parse_variants(master);
+
+  ASSERT_EQ(variants.size(), 4);
+  EXPECT_EQ(variants[2].pathway, "cdn-b");
+
+  EXPECT_EQ(redundant_variants(variants, 1), (std::vector<size_t>{1, 3}));
+  EXPECT_EQ(redundant_variants(variants, 3), (std::vector<size_t>{3, 1}));
+  EXPECT_EQ(redundant_variants(variants, 1, {"cdn-b", "cdn-a"}), (std::vector<size_t>{3, 1}));
+  EXPECT_EQ(redundant_variants(variants, 0, {"cdn-a"}), (std::vector<size_t>{0, 2}));
+
+  EXPECT_EQ(redundant_variants(master_variants(), 0), (std::vector<size_t>{0}));
+}
+
+TEST(variant_tests, parse_steering_manifest)
+{
+  auto const priority = parse_steering_manifest(R"({"VERSION":1,"TTL":300,"PATHWAY-PRIORITY":["cdn-b","cdn-a"]})");
+  ASSERT_TRUE(priority.has_value());
+  EXPECT_EQ(priority.value(), (std::vector<std::string>{"cdn-b", "cdn-a"}));
+
+  EXPECT_FALSE(parse_steering_manifest(R"({"VERSION":1,"TTL":300})").has_value());
+  EXPECT_FALSE(parse_steering_manifest(R"({"PATHWAY-PRIORITY":[1,2]})").has_value());
+  EXPECT_FALSE(parse_steering_manifest("<html>").has_value());
+}
@@ -0,0 +1,217 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <algorithm> // std::max(), std::min()
+#include <charconv>  // std::from_chars()
+#include <cmath>     // std::llround()
+#include <cstdint>   // int64_t
+#include <format>
+#include <tuple>
+
+#include "webvtt.h"
+
+static constexpr int64_t mpegts_rollover = int64_t{1} << 33; // the PTS of MPEG-TS have 33 bits
+static constexpr double mpegts_clock = 90'000.0;              // Hz
+
+static auto split_blocks(std::string_view str) -> std::vector<std::string_view>;
+static auto parse_timestamp_map(std::string_view header) -> std::optional<std::tuple<int64_t, double>>;
+static auto shift_timing(std::string_view line, double shift) -> std::optional<std::string>;
+
+// ---
+
+auto parse_webvtt_time(std::string_view str) -> std::optional<double>
+{
+  // [HH:]MM:SS.mmm
+  double seconds = 0.0;
+  size_t fields = 0;
+  while(not str.empty())
+  {
+    size_t const colon = str.find(':');
+    std::string_view const field = str.substr(0, colon);
+
+    double value = 0.0;
+    auto const [end, errc] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if(errc != std::errc{} or end != field.data() + field.size() or value < 0.0)
+      return {};
+
+    seconds = seconds*60.0 + value;
+    fields++;
+    str = colon == std::string_view::npos ? std::string_view{} : str.substr(colon+1);
+  }
+
+  if(fields < 2 or fields > 3)
+    return {};
+  return seconds;
+}
+
+auto format_webvtt_time(double seconds) -> std::string
+{
+  long long const ms = std::llround(std::max(seconds, 0.0)*1'000.0);
+  return std::format("{:02}:{:02}:{:02}.{:03}", ms/3'600'000, ms/60'000%60, ms/1'000%60, ms%1'000);
+}
+
+auto concat_webvtt(std::vector<std::string> const& parts, double start) -> std::string
+{
+  std::string vtt = "WEBVTT\n";
+
+  std::optional<std::tuple<int64_t, double>> first_map = {};
+  for(size_t p=0; p<parts.size(); p++)
+  {
+    std::string part = parts[p];
+    std::erase(part, '\r');
+
+    auto const blocks = split_blocks(part);
+    if(blocks.empty() or not blocks[0].starts_with("WEBVTT"))
+      continue;
+
+    // The timeline of the segment relative to the one of the first, without a map it's the same.
+    double shift = -start;
+    auto const map = parse_timestamp_map(blocks[0]);
+    if(p == 0)
+      first_map = map;
+    else if(map.has_value() and first_map.has_value())
+    {
+      auto const [mpegts, local] = map.value();
+      auto const [first_mpegts, first_local] = first_map.value();
+
+      int64_t ticks = (mpegts - first_mpegts) % mpegts_rollover;
+      if(ticks < -mpegts_rollover/2)
+        ticks += mpegts_rollover;
+      else if(ticks > mpegts_rollover/2)
+        ticks -= mpegts_rollover;
+      shift += static_cast<double>(ticks)/mpegts_clock - local + first_local;
+    }
+
+    for(size_t b=1; b<blocks.size(); b++)
+    {
+      std::string_view const block = blocks[b];
+      if(block.starts_with("STYLE") or block.starts_with("REGION"))
+      {
+        if(p == 0)
+          vtt.append("\n").append(block).append("\n");
+        continue;
+      }
+      if(block.starts_with("NOTE"))
+        continue;
+
+      // A cue: an optional identifier, the timing and the text.
+      size_t const arrow = block.find("-->");
+      if(arrow == std::string_view::npos)
+        continue;
+      size_t const newline = block.rfind('\n', arrow);
+      size_t const line_begin = newline == std::string_view::npos ? 0 : newline+1;
+      size_t const line_end = std::min(block.find('\n', arrow), block.size());
+
+      auto const timing = shift_timing(block.substr(line_begin, line_end-line_begin), shift);
+      if(not timing.has_value())
+        continue;
+
+      vtt.append("\n").append(block.substr(0, line_begin)).append(timing.value()).append(block.substr(line_end))
+        .append("\n");
+    }
+  }
+
+  return vtt;
+}
+
+// ---
+
+//! The blocks separated by empty lines.
+auto split_blocks(std::string_view str) -> std::vector<std::string_view>
+{
+  std::vector<std::string_view> blocks = {};
+
+  size_t begin = std::string_view::npos;
+  size_t end = 0;
+  size_t pos = 0;
+  while(pos <= str.size())
+  {
+    size_t next = str.find('\n', pos);
+    if(next == std::string_view::npos)
+      next = str.size();
+
+    std::string_view const line = str.substr(pos, next-pos);
+    if(line.empty())
+    {
+      if(begin != std::string_view::npos)
+        blocks.push_back(str.substr(begin, end-begin));
+      begin = std::string_view::npos;
+    }
+    else
+    {
+      if(begin == std::string_view::npos)
+        begin = pos;
+      end = pos + line.size();
+    }
+
+    pos = next+1;
+  }
+
+  if(begin != std::string_view::npos)
+    blocks.push_back(str.substr(begin, end-begin));
+
+  return blocks;
+}
+
+//! X-TIMESTAMP-MAP=MPEGTS:<PTS>,LOCAL:<TIME> (in any order) as (PTS, seconds).
+auto parse_timestamp_map(std::string_view header) -> std::optional<std::tuple<int64_t, double>>
+{
+  std::string_view const tag = "X-TIMESTAMP-MAP=";
+  size_t const pos = header.find(tag);
+  if(pos == std::string_view::npos)
+    return {};
+
+  std::string_view attributes = header.substr(pos + tag.size());
+  attributes = attributes.substr(0, attributes.find('\n'));
+
+  std::optional<int64_t> mpegts = {};
+  std::optional<double> local = {};
+  while(not attributes.empty())
+  {
+    size_t const comma = attributes.find(',');
+    std::string_view const attribute = attributes.substr(0, comma);
+    attributes = comma == std::string_view::npos ? std::string_view{} : attributes.substr(comma+1);
+
+    if(attribute.starts_with("MPEGTS:"))
+    {
+      int64_t value = 0;
+      auto const [end, errc] = std::from_chars(attribute.data()+7, attribute.data()+attribute.size(), value);
+      if(errc == std::errc{} and end == attribute.data()+attribute.size())
+        mpegts = value;
+    }
+    else if(attribute.starts_with("LOCAL:"))
+      local = parse_webvtt_time(attribute.substr(6));
+  }
+
+  if(not mpegts.has_value() or not local.has_value())
+    return {};
+  return std::make_tuple(mpegts.value(), local.value());
+}
+
+//! "<BEGIN> --> <END>[ <SETTINGS>]" with both times shifted, nothing if it's malformed or ends before 0.
+auto shift_timing(std::string_view const line, double shift) -> std::optional<std::string>
+{
+  size_t const arrow = line.find("-->");
+  std::string_view const first = line.substr(0, arrow);
+  std::string_view rest = line.substr(arrow+3);
+  while(rest.starts_with(' ') or rest.starts_with('\t'))
+    rest.remove_prefix(1);
+  size_t const space = rest.find_first_of(" \t");
+  std::string_view const second = rest.substr(0, space);
+  std::string_view const settings = space == std::string_view::npos ? std::string_view{} : rest.substr(space);
+
+  auto trim = [](std::string_view str)
+  {
+    while(str.starts_with(' ') or str.starts_with('\t'))
+      str.remove_prefix(1);
+    while(str.ends_with(' ') or str.ends_with('\t'))
+      str.remove_suffix(1);
+    return str;
+  };
+
+  auto const begin = parse_webvtt_time(trim(first));
+  auto const end = parse_webvtt_time(second);
+  if(not begin.has_value() or not end.has_value() or end.value() + shift <= 0.0)
+    return {};
+
+  return std::format("{} --> {}{}", format_webvtt_time(begin.value() + shift), format_webvtt_time(end.value() + shift),
+      settings);
+}
@@ -0,0 +1,25 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// The subtitle segments of HLS are WebVTT-files of their own, each with its header (WEBVTT and
+// X-TIMESTAMP-MAP=MPEGTS:<PTS>,LOCAL:<TIME>, which maps the cue times to the MPEG-TS timestamps of
+// the video). They can't simply be concatenated like the TS segments, they are merged into one
+// WebVTT-file with the cue times on one timeline.
+//
+
+//! Parse a cue time "HH:MM:SS.mmm" or "MM:SS.mmm" into seconds.
+auto parse_webvtt_time(std::string_view str) -> std::optional<double>;
+
+//! The inverse of parse_webvtt_time(), always with hours e.g. "01:02:03.450".
+auto format_webvtt_time(double seconds) -> std::string;
+
+//! Merge the WebVTT-segments (in playback order) into one WebVTT-file: The cues of every segment are
+//! mapped by its X-TIMESTAMP-MAP onto the timeline of the first one and shifted by -start (the start
+//! of the first segment in the playlist, see track_t::offset). Cues ending before 0 are dropped, as
+//! are the STYLE- and REGION-blocks of all but the first segment (they must come before the cues).
+auto concat_webvtt(std::vector<std::string> const& parts, double start = 0.0) -> std::string;
@@ -0,0 +1,38 @@
+// GPL-3.0-or-later (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#include <gtest/gtest.h>
+
+#include "webvtt.h"
+
+TEST(webvtt_tests, time)
+{
+  EXPECT_EQ(parse_webvtt_time("00:01.500"), 1.5);
+  EXPECT_EQ(parse_webvtt_time("01:02:03.250"), 3'723.25);
+  EXPECT_FALSE(parse_webvtt_time("1.5").has_value());
+  EXPECT_FALSE(parse_webvtt_time("00:0x.000").has_value());
+
+  EXPECT_EQ(format_webvtt_time(3'723.25), "01:02:03.250");
+  EXPECT_EQ(format_webvtt_time(-1.0), "00:00:00.000");
+}
+
+TEST(webvtt_tests, concat)
+{
+  std::vector<std::string> const parts = {
+    "WEBVTT\nX-TIMESTAMP-MAP=MPEGTS:900000,LOCAL:00:00:00.000\n\nSTYLE\n::cue { color: yellow }\n\n"
+      "1\n00:00:01.000 --> 00:00:03.000 align:start\nHello\n",
+    "WEBVTT\r\nX-TIMESTAMP-MAP=LOCAL:00:00:00.000,MPEGTS:1260000\r\n\r\nSTYLE\r\n::cue { color: red }\r\n\r\n"
+      "NOTE a comment\r\n\r\n00:00.500 --> 00:01.000\r\nWorld\r\nand more\r\n",
+    "no WebVTT at all",
+  };
+
+  // The second segment is 4 seconds later by its MPEG-TS timestamp.
+  EXPECT_EQ(concat_webvtt(parts),
+      "WEBVTT\n"
+      "\nSTYLE\n::cue { color: yellow }\n"
+      "\n1\n00:00:01.000 --> 00:00:03.000 align:start\nHello\n"
+      "\n00:00:04.500 --> 00:00:05.000\nWorld\nand more\n");
+
+  // Cut to a range starting at 2 seconds, the cue ending before is dropped.
+  std::vector<std::string> const cut = {"WEBVTT\n\n00:00:01.000 --> 00:00:02.000\nGone\n\n"
+    "00:00:02.500 --> 00:00:04.000\nStays\n"};
+  EXPECT_EQ(concat_webvtt(cut, 2.0), "WEBVTT\n\n00:00:00.500 --> 00:00:02.000\nStays\n");
+}